@@ -5,10 +5,9 @@
 # This script is invoked by xcrun upon calling clang.
 ##
 
-TOOL=`/usr/bin/xcrun -sdk / -find ${0}`
-SDKROOT=`/usr/bin/xcrun --show-sdk-path`
-TARGET_TRIPLE=`/usr/bin/xcrun --show-sdk-target-triple`
-TOOLCHAIN_DIR=`/usr/bin/xcrun --show-sdk-toolchain-path`
+# The tool comes from the root SDK, but the sysroot and target are those of the selected SDK.
+QUERY=`/usr/bin/xcrun --format sh --find-sdk / --show-sdk-path --show-sdk-target-triple --show-sdk-toolchain-path -find ${0}` || exit 1
+eval "${QUERY}"
 
 ${TOOL} -target ${TARGET_TRIPLE} -isysroot ${SDKROOT} -B${TOOLCHAIN_DIR}/usr/bin "${@}"
 
@@ -1,7 +1,14 @@
 #!/bin/bash
 
-TOOL=`/usr/bin/xcrun -find clang`
+##
+# cpp wrapper for cross-compiling.
+# This script is invoked by xcrun upon calling cpp.
+##
 
-${TOOL} -E "${@}"
+# The tool comes from the root SDK, but the sysroot and target are those of the selected SDK.
+QUERY=`/usr/bin/xcrun --format sh --find-sdk / --show-sdk-path --show-sdk-target-triple --show-sdk-toolchain-path -find clang` || exit 1
+eval "${QUERY}"
+
+${TOOL} -target ${TARGET_TRIPLE} -isysroot ${SDKROOT} -B${TOOLCHAIN_DIR}/usr/bin -E "${@}"
 
 exit ${?}
@@ -1,13 +1,13 @@
 #!/bin/bash
 
+##
+# Wrapper for target triple prefixed tools (e.g. arm-apple-darwin11-ld).
+# xcrun strips the triple itself, so these names may also be symlinked straight to xcrun.
+##
+
 if [ `basename ${0}` == "xcrun-tool" ]; then
 	echo "xcrun-tool: error: this tool must not be called directly."
 	exit 1
 fi
 
-TARGET_TRIPLE=`/usr/bin/xcrun --show-sdk-target-triple`
-TOOL=`/usr/bin/xcrun -find ${0/${TARGET_TRIPLE}-/}`
-
-${TOOL} "${@}"
-
-exit ${?}
+exec -a `basename ${0}` /usr/bin/xcrun "${@}"
@@ -35,9 +35,13 @@
 #include <getopt.h>
 #include <limits.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include "libxcrun.h"
+
 #define TOOL_VERSION "1.0.1"
 #define SDK_CFG ".xcdev.dat"
 
@@ -93,42 +97,90 @@ static int validate_directory_path(const char *dir)
 }
 
 /**
- * @func get_developer_path -- retrieve current developer path
- * @return: number of bytes read
+ * @func get_config_path -- Build the path of the selection file, without touching HOME itself.
+ * @arg buf  - buffer to hold the path
+ * @arg size - size of buffer
+ * @return: 0 on success, -1 on failure
  */
-static int get_developer_path(char *path)
+static int get_config_path(char *buf, size_t size)
 {
-	FILE *fp;
-	int len = 0;
-	char *home_path, *cfg_path, *dev_path;
-
-	if ((dev_path = getenv("DEVELOPER_DIR")) != NULL) {
-		len = strlen(dev_path);
-		strncpy(path, dev_path, len);
-		return len;
-	}
+	const char *home_path;
 
 	if ((home_path = getenv("HOME")) == NULL) {
 		fprintf(stderr, "xcode-select: error: failed to read HOME environment variable.\n");
-		return len;
+		return -1;
+	}
+
+	if (snprintf(buf, size, "%s/%s", home_path, SDK_CFG) >= (int)size) {
+		fprintf(stderr, "xcode-select: error: HOME is too long.\n");
+		return -1;
 	}
 
-	cfg_path = (char *)calloc((strlen(home_path) + strlen(SDK_CFG) + 2), sizeof(char));
+	return 0;
+}
+
+/**
+ * @func read_selection -- Read the selection file with a single read.
+ * @arg cfg_path   - selection file
+ * @arg path       - buffer of PATH_MAX bytes to hold the selected path
+ * @arg generation - set to the generation of the selection (0 for a file written before generations)
+ * @return: length of the path, 0 on failure
+ */
+static int read_selection(const char *cfg_path, char *path, unsigned long long *generation)
+{
+	int fd;
+	ssize_t len;
+	char *end;
+	char buf[PATH_MAX + 128];
+
+	*generation = 0;
+
+	if ((fd = open(cfg_path, O_RDONLY)) == -1)
+		return 0;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (len <= 0)
+		return 0;
 
-	strcat(home_path, "/");
-	strcat(cfg_path, strcat(home_path, SDK_CFG));
+	buf[len] = '\0';
 
-	if ((fp = fopen(cfg_path, "r")) != NULL) {
-		fseek(fp, 0, SEEK_END);
-		int fsize = ftell(fp);
-		fseek(fp, SEEK_SET, 0);
-		len = fread(path, fsize, 1, fp);
-		fclose(fp);
-	} else {
-		fprintf(stderr, "xcode-select: error: unable to read configuration file. (%s)\n", strerror(errno));
+	if ((end = strchr(buf, '\n')) != NULL) {
+		*end++ = '\0';
+		sscanf(end, "%llu", generation);
 	}
 
-	free(cfg_path);
+	if (*buf == '\0' || strlen(buf) >= PATH_MAX)
+		return 0;
+
+	strcpy(path, buf);
+
+	return strlen(path);
+}
+
+/**
+ * @func get_developer_path -- retrieve current developer path
+ * @return: number of bytes read
+ */
+static int get_developer_path(char *path)
+{
+	int len;
+	char *dev_path;
+	char cfg_path[PATH_MAX];
+	unsigned long long generation;
+
+	if ((dev_path = getenv("DEVELOPER_DIR")) != NULL) {
+		snprintf(path, PATH_MAX, "%s", dev_path);
+		return strlen(path);
+	}
+
+	if (get_config_path(cfg_path, sizeof(cfg_path)) != 0)
+		return 0;
+
+	errno = 0;
+	if ((len = read_selection(cfg_path, path, &generation)) == 0)
+		fprintf(stderr, "xcode-select: error: unable to read configuration file. (%s)\n", (errno != 0 ? strerror(errno) : "empty file"));
 
 	return len;
 }
@@ -137,37 +189,58 @@ static int get_developer_path(char *path)
  * @func set_developer_path -- set the current developer path
  * @arg path - path to set
  * @return: 0 on success, -1 on failure
+ *
+ * The selection file holds the path on its first line, followed by a line with the generation of
+ * the selection, bumped on every switch. It is written to a temporary file renamed into place, so
+ * that xcrun never reads a torn path.
  */
 static int set_developer_path(const char *path)
 {
 	FILE *fp;
-	int status = -1;
-	char *cfg_path, *home_path;
+	char cfg_path[PATH_MAX];
+	char tmp_path[PATH_MAX];
+	char old_path[PATH_MAX];
+	unsigned long long generation;
 
 	if (validate_directory_path(path) < 0)
-		return status;
+		return -1;
 
-	if ((home_path = getenv("HOME")) == NULL) {
-		fprintf(stderr, "xcode-select: error: failed to read HOME variable.\n");
-		return status;
-	}
+	if (get_config_path(cfg_path, sizeof(cfg_path)) != 0)
+		return -1;
 
-        cfg_path = (char *)calloc((strlen(home_path) + strlen(SDK_CFG) + 2), sizeof(char));
+	read_selection(cfg_path, old_path, &generation);
 
-        strcat(home_path, "/");
-	strcat(cfg_path, strcat(home_path, SDK_CFG));
-
-	if ((fp = fopen(cfg_path, "w+")) != NULL) {
-		fwrite(path, 1, strlen(path), fp);
-		fclose(fp);
-		status = 0;
-	} else {
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", cfg_path, (long)getpid()) >= (int)sizeof(tmp_path) || (fp = fopen(tmp_path, "w")) == NULL) {
 		fprintf(stderr, "xcode-select: error: unable to open configuration file. (%s)\n", strerror(errno));
+		return -1;
 	}
 
-	free(cfg_path);
+	fprintf(fp, "%s\n%llu\n", path, (generation + 1));
 
-	return status;
+	if (ferror(fp) != 0 || fclose(fp) != 0 || rename(tmp_path, cfg_path) != 0) {
+		fprintf(stderr, "xcode-select: error: unable to write configuration file. (%s)\n", strerror(errno));
+		unlink(tmp_path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @func index_developer_path -- Write the manifest of a newly selected developer path, so that xcrun doesn't have to parse it.
+ * @arg path - selected path
+ */
+static void index_developer_path(const char *path)
+{
+	xcrun_ctx *ctx;
+	xcrun_options options = { 0 };
+
+	options.developer_dir = path;
+
+	if ((ctx = xcrun_create(&options)) == NULL || xcrun_reindex(ctx) != 0)
+		fprintf(stderr, "xcode-select: warning: unable to index developer directory \'%s\' (%s)\n", path, (ctx != NULL ? xcrun_error(ctx) : strerror(errno)));
+
+	xcrun_free(ctx);
 }
 
 int main(int argc, char *argv[])
@@ -196,8 +269,9 @@ int main(int argc, char *argv[])
 				version();
 				break;
 			case 's':
-				strncpy(path, optarg, strlen(optarg));
-				status = set_developer_path(path);
+				snprintf(path, sizeof(path), "%s", optarg);
+				if ((status = set_developer_path(path)) == 0)
+					index_developer_path(path);
 				break;
 			case 'p':
 				if (get_developer_path(path) > 0) {
@@ -0,0 +1,480 @@
+/* admission.c - memory-aware admission of heavy tools across xcrun processes
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Tools with an [ADMISSION <name>] section in xcrun.ini don't just run: every xcrun about to run
+ * one first takes a place in a queue shared by all of the user's xcruns, and the tool only starts
+ * once it has reached the front and fits in its limits. At most max_jobs instances of a tool run at
+ * once, and the memory expected of all admitted tools running at once stays within the budget of
+ * the [ADMISSION] section (three quarters of physical memory by default). A tool alone always runs,
+ * however much it is expected to need. Tools without a section are never held back. The slices of
+ * a fan-out (see fanout.c) queue up once, as a single entry counting one instance per slice.
+ *
+ * The memory expected of a tool is the peak resident set size it reached in the runs measured so
+ * far, decaying slowly when it needs less, or the memory set in its section until it has been
+ * measured once. To measure it, and to give its place back once done, an admitted tool runs as a
+ * child process of xcrun rather than replacing it.
+ *
+ * The queue, the running tools and the measured peaks live in a small text file in a private
+ * directory under $TMPDIR, read and rewritten under an exclusive flock(). Entries of processes that
+ * died are dropped by whoever reads the file next, so a killed build never leaks its places.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "admission.h"
+#include "compcache.h"
+#include "profile.h"
+#include "util.h"
+
+/* Kinds of entries of the state file */
+enum {
+	ENTRY_NEXT,	/* next ticket to hand out */
+	ENTRY_WAIT,	/* a tool waiting for its turn */
+	ENTRY_RUN,	/* a tool running */
+	ENTRY_PEAK,	/* peak memory measured for a tool */
+	ENTRY_KINDS
+};
+
+/* Names of the kinds of entries, as written in the state file */
+static const char *entry_names[ENTRY_KINDS] = { "next", "wait", "run", "peak" };
+
+/* A line of the state file: "<kind> <pid> <ticket> <jobs> <kilobytes> <tool>" */
+typedef struct {
+	int kind;
+	pid_t pid;
+	unsigned long long ticket;
+	int jobs;		/* instances of the tool the entry stands for, several for the slices of a fan-out */
+	unsigned long kb;
+	char tool[NAME_MAX];
+} admission_entry;
+
+/* Contents of the state file */
+typedef struct {
+	admission_entry *entries;
+	size_t count;
+	size_t size;
+	unsigned long long next_ticket;
+	bool reaped;		/* entries of processes that died were dropped while reading */
+} admission_state;
+
+/**
+ * @func get_state_path -- Build the path of the state file.
+ * @arg buf  - buffer to hold the path
+ * @arg size - size of buffer
+ * @return: 0 on success, -1 on failure
+ */
+static int get_state_path(char *buf, size_t size)
+{
+	char dir[PATH_MAX];
+
+	/* Nobody else gets to tamper with our queue. */
+	if (private_dir(dir, sizeof(dir), NULL, "xcrun-admission", 1) != 0)
+		return -1;
+
+	return (snprintf(buf, size, "%s/state", dir) < (int)size ? 0 : -1);
+}
+
+/* helper function to tell whether a process is still around */
+static bool process_alive(pid_t pid)
+{
+	return (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+/**
+ * @func add_entry -- Add an entry to the state.
+ * @arg state - state
+ * @arg entry - entry to add
+ * @return: added entry, or NULL on failure
+ */
+static admission_entry *add_entry(admission_state *state, const admission_entry *entry)
+{
+	admission_entry *entries;
+
+	if (state->count == state->size) {
+		if ((entries = (admission_entry *)realloc(state->entries, ((state->size * 2) + 16) * sizeof(admission_entry))) == NULL)
+			return NULL;
+		state->entries = entries;
+		state->size = ((state->size * 2) + 16);
+	}
+
+	state->entries[state->count] = *entry;
+
+	return &state->entries[state->count++];
+}
+
+/**
+ * @func lock_and_read -- Lock the state file and read it, dropping the entries of processes that died.
+ * @arg fd    - state file
+ * @arg state - state to fill in, emptied first
+ * @return: 0 on success, -1 on failure (the file is left unlocked)
+ */
+static int lock_and_read(int fd, admission_state *state)
+{
+	int kind;
+	long pid;
+	char *buf, *line, *next;
+	char kind_word[16];
+	struct stat st;
+	ssize_t len;
+	admission_entry entry;
+
+	state->count = 0;
+	state->next_ticket = 1;
+	state->reaped = false;
+
+	while (flock(fd, LOCK_EX) == -1) {
+		if (errno != EINTR)
+			return -1;
+	}
+
+	if (fstat(fd, &st) != 0 || (buf = (char *)malloc(st.st_size + 1)) == NULL)
+		goto failure;
+
+	if ((len = pread(fd, buf, st.st_size, 0)) < 0) {
+		free(buf);
+		goto failure;
+	}
+	buf[len] = '\0';
+
+	for (line = buf; *line != '\0'; line = next) {
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+
+		memset(&entry, 0, sizeof(entry));
+		if (sscanf(line, "%15s %ld %llu %d %lu %254s", kind_word, &pid, &entry.ticket, &entry.jobs, &entry.kb, entry.tool) != 6)
+			continue;
+		for (kind = 0; kind < ENTRY_KINDS && strcmp(kind_word, entry_names[kind]) != 0; kind++)
+			;
+		entry.kind = kind;
+		entry.pid = (pid_t)pid;
+
+		if (kind == ENTRY_NEXT) {
+			state->next_ticket = entry.ticket;
+		} else if (kind == ENTRY_PEAK || ((kind == ENTRY_WAIT || kind == ENTRY_RUN) && process_alive(entry.pid))) {
+			if (add_entry(state, &entry) == NULL) {
+				free(buf);
+				goto failure;
+			}
+		} else if (kind == ENTRY_WAIT || kind == ENTRY_RUN) {
+			state->reaped = true;
+		}
+	}
+
+	free(buf);
+
+	return 0;
+
+failure:
+	flock(fd, LOCK_UN);
+
+	return -1;
+}
+
+/**
+ * @func write_and_unlock -- Write the state back to the state file and unlock it.
+ * @arg fd    - state file, locked by lock_and_read
+ * @arg state - state
+ * @return: 0 on success, -1 on failure
+ */
+static int write_and_unlock(int fd, const admission_state *state)
+{
+	int status = -1;
+	size_t i, len = 0;
+	char *buf;
+	size_t size = ((state->count + 1) * (NAME_MAX + 96));
+
+	if ((buf = (char *)malloc(size)) != NULL) {
+		len += snprintf(buf + len, size - len, "%s 0 %llu 0 0 -\n", entry_names[ENTRY_NEXT], state->next_ticket);
+		for (i = 0; i < state->count; i++) {
+			len += snprintf(buf + len, size - len, "%s %ld %llu %d %lu %s\n", entry_names[state->entries[i].kind], (long)state->entries[i].pid,
+			                state->entries[i].ticket, state->entries[i].jobs, state->entries[i].kb, state->entries[i].tool);
+		}
+
+		if (pwrite(fd, buf, len, 0) == (ssize_t)len && ftruncate(fd, len) == 0)
+			status = 0;
+
+		free(buf);
+	}
+
+	flock(fd, LOCK_UN);
+
+	return status;
+}
+
+/* helper function to find the entry of a kind for a tool (or a process, when pid isn't 0) */
+static admission_entry *find_entry(admission_state *state, int kind, const char *tool, pid_t pid)
+{
+	size_t i;
+
+	for (i = 0; i < state->count; i++) {
+		if (state->entries[i].kind == kind && (pid != 0 ? state->entries[i].pid == pid : strcmp(state->entries[i].tool, tool) == 0))
+			return &state->entries[i];
+	}
+
+	return NULL;
+}
+
+/* helper function to drop an entry of the state */
+static void remove_entry(admission_state *state, admission_entry *entry)
+{
+	*entry = state->entries[--state->count];
+}
+
+/**
+ * @func may_run -- Tell whether a waiting tool may start.
+ * @arg state  - state
+ * @arg self   - entry of the waiting tool
+ * @arg limits - limits of the tool
+ * @arg budget - memory admitted tools may use at once, in kilobytes
+ * @arg jobs   - set to the number of instances of the tool running
+ * @arg used   - set to the memory expected of the tools running, in kilobytes
+ * @return: true if it may start
+ */
+static bool may_run(const admission_state *state, const admission_entry *self, const xcrun_limits *limits, unsigned long budget, int *jobs, unsigned long *used)
+{
+	size_t i;
+	bool first = true;
+	int running = 0;
+
+	*jobs = 0;
+	*used = 0;
+
+	for (i = 0; i < state->count; i++) {
+		if (state->entries[i].kind == ENTRY_RUN) {
+			running++;
+			*used += state->entries[i].kb;
+			if (strcmp(state->entries[i].tool, self->tool) == 0)
+				*jobs += state->entries[i].jobs;
+		} else if (state->entries[i].kind == ENTRY_WAIT && state->entries[i].ticket < self->ticket) {
+			first = false;
+		}
+	}
+
+	/* Tools are let in in the order they asked, and a tool alone always runs, as does a fan-out wider than max_jobs. */
+	if (!first || (limits->max_jobs > 0 && *jobs > 0 && (*jobs + self->jobs) > limits->max_jobs))
+		return false;
+
+	return (running == 0 || (*used + self->kb) <= budget);
+}
+
+/**
+ * @func get_budget -- Get the memory admitted tools may use at once.
+ * @arg limits - limits of the tool
+ * @return: budget, in kilobytes
+ */
+static unsigned long get_budget(const xcrun_limits *limits)
+{
+	long pages, page_size;
+	unsigned long mb;
+	const char *value;
+
+	if ((value = getenv(ADMISSION_BUDGET_ENV)) != NULL && (mb = strtoul(value, NULL, 10)) > 0)
+		return (mb * 1024);
+
+	if (limits->budget > 0)
+		return limits->budget;
+
+	if ((pages = sysconf(_SC_PHYS_PAGES)) <= 0 || (page_size = sysconf(_SC_PAGESIZE)) <= 0)
+		return ULONG_MAX;
+
+	return (unsigned long)(((unsigned long long)pages * (page_size / 1024) / 4) * 3);
+}
+
+/**
+ * @func wait_turn -- Queue a tool up and wait until it may start.
+ * @arg fd      - state file
+ * @arg name    - name of the tool
+ * @arg count   - number of instances of the tool to start
+ * @arg limits  - limits of the tool
+ * @arg logging - show what is going on
+ * @return: 0 once the tool is admitted, -1 on failure
+ */
+static int wait_turn(int fd, const char *name, int count, const xcrun_limits *limits, int logging)
+{
+	int jobs;
+	bool told = false;
+	unsigned long used, budget = get_budget(limits);
+	bool changed = true;
+	admission_state state = { NULL, 0, 0, 0, false };
+	admission_entry self, *entry;
+	const admission_entry *peak;
+
+	memset(&self, 0, sizeof(self));
+	self.kind = ENTRY_WAIT;
+	self.pid = getpid();
+	snprintf(self.tool, sizeof(self.tool), "%s", name);
+
+	if (lock_and_read(fd, &state) != 0)
+		goto failure;
+
+	self.ticket = state.next_ticket++;
+	self.jobs = count;
+	self.kb = ((peak = find_entry(&state, ENTRY_PEAK, name, 0)) != NULL ? peak->kb : limits->memory) * count;
+
+	for (;;) {
+		/* Our entry may be gone if a process with our pid died before, put it back. */
+		if ((entry = find_entry(&state, ENTRY_WAIT, name, self.pid)) == NULL) {
+			if ((entry = add_entry(&state, &self)) == NULL) {
+				flock(fd, LOCK_UN);
+				goto failure;
+			}
+			changed = true;
+		}
+
+		if (may_run(&state, entry, limits, budget, &jobs, &used)) {
+			entry->kind = ENTRY_RUN;
+			if (write_and_unlock(fd, &state) != 0)
+				goto failure;
+			break;
+		}
+
+		/* Polling leaves the file alone, unless taking our place or reaping the dead changed it. */
+		if (changed || state.reaped) {
+			if (write_and_unlock(fd, &state) != 0)
+				goto failure;
+		} else {
+			flock(fd, LOCK_UN);
+		}
+		changed = false;
+
+		if (logging && !told) {
+			fprintf(stdout, "xcrun: info: waiting to run \'%s\' (%d running, %lu of %lu MB in use, %lu MB expected).\n",
+			        name, jobs, (used / 1024), (budget / 1024), (self.kb / 1024));
+			fflush(stdout);
+			told = true;
+		}
+
+		usleep(ADMISSION_POLL_MS * 1000);
+
+		if (lock_and_read(fd, &state) != 0)
+			goto failure;
+	}
+
+	free(state.entries);
+
+	return 0;
+
+failure:
+	free(state.entries);
+
+	return -1;
+}
+
+/* See documentation in header file. */
+int admission_enter(const char *name, int count, const xcrun_limits *limits, int logging)
+{
+	int fd;
+	char path[PATH_MAX];
+
+	if (get_state_path(path, sizeof(path)) != 0 || (fd = open(path, (O_RDWR | O_CREAT | O_CLOEXEC), 0600)) == -1)
+		return -1;
+
+	if (wait_turn(fd, name, count, limits, logging) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* See documentation in header file. */
+void admission_leave(int fd, const char *name, unsigned long maxrss)
+{
+	admission_state state = { NULL, 0, 0, 0, false };
+	admission_entry *entry, peak;
+
+	if (lock_and_read(fd, &state) != 0)
+		return;
+
+	if ((entry = find_entry(&state, ENTRY_RUN, name, getpid())) != NULL)
+		remove_entry(&state, entry);
+
+	/* A tool needing more counts right away, one needing less only slowly wears its peak down. */
+	if (maxrss > 0) {
+		if ((entry = find_entry(&state, ENTRY_PEAK, name, 0)) != NULL) {
+			entry->kb = (maxrss > entry->kb ? maxrss : ((entry->kb / 8) * 7) + (maxrss / 8));
+		} else {
+			memset(&peak, 0, sizeof(peak));
+			peak.kind = ENTRY_PEAK;
+			peak.kb = maxrss;
+			snprintf(peak.tool, sizeof(peak.tool), "%s", name);
+			add_entry(&state, &peak);
+		}
+	}
+
+	write_and_unlock(fd, &state);
+	free(state.entries);
+	close(fd);
+}
+
+/* See documentation in header file. */
+int admission_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[], const xcrun_limits *limits, int logging)
+{
+	int fd, status;
+	unsigned long long wall;
+	unsigned long maxrss = 0;
+	struct rusage usage;
+
+	/* Without a queue to share, the tool runs as it always did. */
+	if ((fd = admission_enter(name, 1, limits, logging)) == -1)
+		return profile_run(name, tool, envp, argv);
+
+	/* Compiles answered (or run) by the compile cache go uncounted. */
+	if (profile_enabled() || (status = compcache_run(name, tool, envp, argv, logging)) == -1) {
+		if ((status = profile_spawn(tool, envp, argv, &usage, &wall)) != -1) {
+			profile_record(name, tool, argv, status, wall, &usage);
+			maxrss = (unsigned long)usage.ru_maxrss;
+#ifdef __APPLE__
+			maxrss /= 1024;
+#endif
+		}
+		admission_leave(fd, name, maxrss);
+		return (status == -1 ? -1 : profile_exit_status(status));
+	}
+
+	admission_leave(fd, name, 0);
+
+	return status;
+}
@@ -0,0 +1,73 @@
+/* admission.h - memory-aware admission of heavy tools across xcrun processes
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ADMISSION_H__
+#define __ADMISSION_H__
+
+#include "libxcrun.h"
+
+/* Memory, in megabytes, that admitted tools may use at once, overriding the [ADMISSION] section of xcrun.ini */
+#define ADMISSION_BUDGET_ENV "XCRUN_MEMORY_BUDGET"
+
+/* How often a waiting tool looks for room, in milliseconds */
+#define ADMISSION_POLL_MS 100
+
+/**
+ * @func admission_enter -- wait until instances of a tool fit in its limits, and take their place
+ * @arg name    - name of the tool
+ * @arg count   - number of instances about to run at once (the slices of a fan-out), each counting as a job
+ * @arg limits  - limits of the tool (see xcrun_tool_limits)
+ * @arg logging - show what is going on
+ * @return: handle to pass to admission_leave, or -1 if there is no queue to wait in (the tool runs right away)
+ */
+int admission_enter(const char *name, int count, const xcrun_limits *limits, int logging);
+
+/**
+ * @func admission_leave -- give the place taken by admission_enter back
+ * @arg handle - handle returned by admission_enter
+ * @arg name   - name of the tool
+ * @arg maxrss - peak resident set size reached by a single instance, in kilobytes, 0 if it wasn't measured
+ */
+void admission_leave(int handle, const char *name, unsigned long maxrss);
+
+/**
+ * @func admission_run -- wait until a tool fits in its limits, then run it as a child process
+ * @arg name    - name of the tool
+ * @arg tool    - resolved tool
+ * @arg envp    - environment the tool runs with
+ * @arg argv    - arguments the tool runs with
+ * @arg limits  - limits of the tool (see xcrun_tool_limits)
+ * @arg logging - show what is going on
+ * @return: exit status of the tool, -1 if it couldn't be started (does not return if the tool was killed by a signal)
+ */
+int admission_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[], const xcrun_limits *limits, int logging);
+
+#endif /* __ADMISSION_H__ */
@@ -0,0 +1,734 @@
+/* batch.c - run many tools from one xcrun invocation
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A batch holds one argument vector per job. Normally that is one line per job, split on white
+ * space, where quotes and backslashes work as they do in the shell and lines starting with '#' are
+ * ignored. With null_separated set, every argument is terminated by a NUL byte instead, and an
+ * empty argument closes the job, which is what `find -print0` style generators can easily produce.
+ *
+ * Every tool is resolved once against the shared context, then the jobs are run in parallel, at
+ * most max_jobs at a time. When started from a GNU make recipe, the make jobserver advertised in
+ * MAKEFLAGS is honoured as well: the first job runs on the token make already gave us, every other
+ * one waits for a token from the jobserver and hands it back as soon as it is done.
+ *
+ * The output of a job is kept aside and printed in one piece once it has finished, so that the
+ * output of parallel jobs never interleaves. Failed jobs are always reported along with their exit
+ * status, successful ones only in verbose mode.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "batch.h"
+
+/* A tool resolved for the batch, shared by every job calling it */
+typedef struct {
+	char *name;
+	xcrun_tool tool;
+	char **envp;
+	char *error;			/* why the tool can't be run, NULL if it can */
+} batch_tool;
+
+/* A single job of the batch */
+typedef struct {
+	int argc;
+	char **argv;
+	batch_tool *tool;
+	pid_t pid;
+	int token;			/* jobserver token held while running, -1 for the token we were started with */
+	FILE *out;
+	FILE *err;
+} batch_job;
+
+static batch_job *jobs;
+static int njobs;
+static batch_tool *tools;
+static int ntools;
+
+/* Jobserver file descriptors, private to us */
+static int jobserver_rfd = -1;
+static int jobserver_wfd = -1;
+
+/* Set while nobody runs on the token we were started with */
+static int implicit_token_free = 1;
+
+/* Written to by the SIGCHLD handler, so that poll() wakes up when a job finishes */
+static int child_pipe[2] = { -1, -1 };
+
+/**
+ * @func verbose_printf -- Print output to fp when fp is set.
+ * @arg fp  - pointer to file (file, stderr, or stdio), may be NULL
+ * @arg str - string to print
+ * @arg ... - additional arguments used
+ */
+static void verbose_printf(FILE *fp, const char *str, ...)
+{
+	va_list args;
+
+	if (fp != NULL) {
+		va_start(args, str);
+		vfprintf(fp, str, args);
+		va_end(args);
+	}
+}
+
+/**
+ * @func add_arg -- Append an argument to a NULL terminated argument vector.
+ * @arg argv - argument vector, reallocated as needed
+ * @arg argc - number of arguments in argv
+ * @arg arg  - newly allocated argument, freed on failure
+ * @return: 0 on success, -1 if out of memory
+ */
+static int add_arg(char ***argv, int *argc, char *arg)
+{
+	char **new_argv;
+
+	if (arg == NULL || (new_argv = (char **)realloc(*argv, (*argc + 2) * sizeof(char *))) == NULL) {
+		free(arg);
+		return -1;
+	}
+
+	new_argv[(*argc)++] = arg;
+	new_argv[*argc] = NULL;
+	*argv = new_argv;
+
+	return 0;
+}
+
+/**
+ * @func free_argv -- Free an argument vector built by add_arg.
+ * @arg argv - argument vector (may be NULL)
+ */
+static void free_argv(char **argv)
+{
+	char **p;
+
+	if (argv == NULL)
+		return;
+
+	for (p = argv; *p != NULL; p++)
+		free(*p);
+	free(argv);
+}
+
+/**
+ * @func split_words -- Split a line of a batch into arguments, the way the shell would.
+ * @arg line - line to split
+ * @arg argv - argument vector the words are appended to
+ * @arg argc - number of arguments in argv
+ * @return: 0 on success, -1 on an unterminated quote (with errno set to EINVAL) or if out of memory
+ */
+static int split_words(const char *line, char ***argv, int *argc)
+{
+	char quote;
+	char *word, *w;
+	const char *p = line;
+
+	if ((word = (char *)malloc(strlen(line) + 1)) == NULL)
+		return -1;
+
+	for (;;) {
+		p += strspn(p, " \t\r\n");
+		if (*p == '\0')
+			break;
+
+		for (w = word, quote = '\0'; *p != '\0'; p++) {
+			if (quote == '\'') {
+				if (*p == '\'')
+					quote = '\0';
+				else
+					*w++ = *p;
+			} else if (*p == '\\' && p[1] != '\0' && (quote == '\0' || p[1] == '"' || p[1] == '\\')) {
+				*w++ = *++p;
+			} else if (*p == '"') {
+				quote = (quote == '\0' ? '"' : '\0');
+			} else if (*p == '\'' && quote == '\0') {
+				quote = '\'';
+			} else if (quote == '\0' && strchr(" \t\r\n", *p) != NULL) {
+				break;
+			} else {
+				*w++ = *p;
+			}
+		}
+
+		if (quote != '\0') {
+			free(word);
+			errno = EINVAL;
+			return -1;
+		}
+
+		*w = '\0';
+		if (add_arg(argv, argc, strdup(word)) != 0) {
+			free(word);
+			return -1;
+		}
+	}
+
+	free(word);
+
+	return 0;
+}
+
+/**
+ * @func add_job -- Append a job to the batch.
+ * @arg argv - argument vector of the job, owned by the batch from now on
+ * @arg argc - number of arguments in argv
+ * @return: 0 on success, -1 if out of memory
+ */
+static int add_job(char **argv, int argc)
+{
+	batch_job *new_jobs;
+
+	if ((new_jobs = (batch_job *)realloc(jobs, (njobs + 1) * sizeof(batch_job))) == NULL) {
+		free_argv(argv);
+		return -1;
+	}
+
+	jobs = new_jobs;
+	memset(&jobs[njobs], 0, sizeof(batch_job));
+	jobs[njobs].argc = argc;
+	jobs[njobs].argv = argv;
+	jobs[njobs].pid = -1;
+	jobs[njobs].token = -1;
+	njobs++;
+
+	return 0;
+}
+
+/**
+ * @func read_batch -- Read every job of a batch.
+ * @arg input   - batch to read
+ * @arg options - how to read the batch
+ * @return: 0 on success, -1 on failure
+ */
+static int read_batch(FILE *input, const batch_options *options)
+{
+	int argc = 0;
+	int lineno = 0;
+	char *line = NULL;
+	char **argv = NULL;
+	const char *p;
+	size_t size = 0;
+	ssize_t len;
+
+	while ((len = getdelim(&line, &size, (options->null_separated ? '\0' : '\n'), input)) != -1) {
+		lineno++;
+
+		if (options->null_separated) {
+			if (*line != '\0') {
+				if (add_arg(&argv, &argc, strdup(line)) != 0)
+					goto failure;
+				continue;
+			}
+			/* An empty argument closes the job. */
+			if (argc > 0 && add_job(argv, argc) != 0)
+				goto out_of_memory;
+		} else {
+			if (line[len - 1] == '\n')
+				line[len - 1] = '\0';
+
+			p = line + strspn(line, " \t\r");
+			if (*p == '\0' || *p == '#')
+				continue;
+
+			if (split_words(p, &argv, &argc) != 0) {
+				if (errno == EINVAL)
+					fprintf(stderr, "xcrun: error: unterminated quote on line %d of the batch.\n", lineno);
+				goto failure;
+			}
+			if (argc > 0 && add_job(argv, argc) != 0)
+				goto out_of_memory;
+		}
+
+		argv = NULL;
+		argc = 0;
+	}
+
+	if (ferror(input)) {
+		fprintf(stderr, "xcrun: error: failed to read the batch. (%s)\n", strerror(errno));
+		goto failure;
+	}
+
+	/* The last job of a NUL separated batch doesn't have to be closed. */
+	if (argc > 0 && add_job(argv, argc) != 0)
+		goto out_of_memory;
+
+	free(line);
+
+	return 0;
+
+out_of_memory:
+	argv = NULL;
+	errno = ENOMEM;
+failure:
+	if (errno == ENOMEM)
+		fprintf(stderr, "xcrun: error: failed to read the batch. (%s)\n", strerror(errno));
+	free_argv(argv);
+	free(line);
+
+	return -1;
+}
+
+/**
+ * @func resolve_tools -- Resolve the tool of every job, once per distinct tool name.
+ * @arg ctx - context every tool is resolved against
+ * @return: 0 on success, -1 if out of memory
+ */
+static int resolve_tools(xcrun_ctx *ctx)
+{
+	int i, j;
+	const char *name;
+	batch_tool *tool;
+
+	if ((tools = (batch_tool *)calloc(njobs, sizeof(batch_tool))) == NULL)
+		return -1;
+
+	for (i = 0; i < njobs; i++) {
+		/* Tools are looked up by their name, like they are on the command line. */
+		name = ((name = strrchr(jobs[i].argv[0], '/')) != NULL ? name + 1 : jobs[i].argv[0]);
+
+		for (j = 0; j < ntools; j++) {
+			if (strcmp(tools[j].name, name) == 0)
+				break;
+		}
+
+		tool = &tools[j];
+		if (j == ntools) {
+			if ((tool->name = strdup(name)) == NULL)
+				return -1;
+			ntools++;
+
+			if (xcrun_resolve_tool(ctx, name, &tool->tool) != 0 || (tool->envp = xcrun_build_env(ctx, &tool->tool)) == NULL)
+				tool->error = strdup(xcrun_error(ctx) != NULL ? xcrun_error(ctx) : strerror(errno));
+		}
+
+		jobs[i].tool = tool;
+	}
+
+	return 0;
+}
+
+/**
+ * @func open_jobserver -- Join the GNU make jobserver advertised in MAKEFLAGS, if there is one.
+ * @return: 1 if the jobserver is used, 0 if there is none, -1 if there is one that we can't use
+ */
+static int open_jobserver(void)
+{
+	int rfd, wfd;
+	size_t len;
+	char path[PATH_MAX];
+	const char *flags, *auth, *p;
+
+	if ((flags = getenv("MAKEFLAGS")) == NULL)
+		return 0;
+
+	/* The last jobserver option is the one that counts, make >= 4.2 calls it --jobserver-auth. */
+	for (auth = NULL, p = flags; (p = strstr(p, "--jobserver-")) != NULL; p++) {
+		if (strncmp(p, "--jobserver-auth=", 17) == 0)
+			auth = p + 17;
+		else if (strncmp(p, "--jobserver-fds=", 16) == 0)
+			auth = p + 16;
+	}
+
+	if (auth == NULL)
+		return 0;
+
+	/* make >= 4.4 hands out a named pipe, */
+	if (strncmp(auth, "fifo:", 5) == 0) {
+		auth += 5;
+		if ((len = strcspn(auth, " ")) >= sizeof(path))
+			return -1;
+		snprintf(path, sizeof(path), "%.*s", (int)len, auth);
+
+		if ((jobserver_rfd = open(path, (O_RDONLY | O_NONBLOCK | O_CLOEXEC))) == -1)
+			return -1;
+		if ((jobserver_wfd = open(path, (O_WRONLY | O_CLOEXEC))) == -1)
+			return -1;
+
+		return 1;
+	}
+
+	/* older ones a pipe, which is only passed on to rules that are marked as recursive. */
+	if (sscanf(auth, "%d,%d", &rfd, &wfd) != 2 || rfd < 0 || wfd < 0 || fcntl(rfd, F_GETFD) == -1 || fcntl(wfd, F_GETFD) == -1)
+		return -1;
+
+	/*
+	 * Reading the pipe through an open file of our own lets us make it non-blocking without
+	 * pulling the rug from under make. Where that isn't possible, a token grabbed by somebody
+	 * else between poll() and read() only keeps us waiting until the next token comes back.
+	 */
+	snprintf(path, sizeof(path), "/dev/fd/%d", rfd);
+	if ((jobserver_rfd = open(path, (O_RDONLY | O_NONBLOCK | O_CLOEXEC))) == -1 && (jobserver_rfd = fcntl(rfd, F_DUPFD_CLOEXEC, 0)) == -1)
+		return -1;
+	if ((jobserver_wfd = fcntl(wfd, F_DUPFD_CLOEXEC, 0)) == -1)
+		return -1;
+
+	return 1;
+}
+
+/**
+ * @func close_jobserver -- Close our end of the jobserver.
+ */
+static void close_jobserver(void)
+{
+	if (jobserver_rfd != -1)
+		close(jobserver_rfd);
+	if (jobserver_wfd != -1)
+		close(jobserver_wfd);
+
+	jobserver_rfd = jobserver_wfd = -1;
+}
+
+/**
+ * @func acquire_token -- Take a token from the jobserver, without waiting for one.
+ * @return: token, or -1 if there is none available right now
+ */
+static int acquire_token(void)
+{
+	unsigned char token;
+
+	if (read(jobserver_rfd, &token, 1) == 1)
+		return token;
+
+	return -1;
+}
+
+/**
+ * @func release_token -- Give back the token a job ran on.
+ * @arg job - job that is done
+ */
+static void release_token(batch_job *job)
+{
+	unsigned char token;
+
+	if (job->token == -1) {
+		implicit_token_free = 1;
+		return;
+	}
+
+	token = (unsigned char)job->token;
+	while (write(jobserver_wfd, &token, 1) == -1 && errno == EINTR)
+		;
+	job->token = -1;
+}
+
+/**
+ * @func child_exited -- SIGCHLD handler, wakes up the main loop.
+ * @arg sig - signal number
+ */
+static void child_exited(int sig)
+{
+	int saved_errno = errno;
+	ssize_t len;
+
+	(void)sig;
+
+	/* If the pipe is full, the main loop has a wake up pending anyway. */
+	len = write(child_pipe[1], "", 1);
+	(void)len;
+
+	errno = saved_errno;
+}
+
+/**
+ * @func start_job -- Start a job in the background, with its output kept aside.
+ * @arg ctx     - context the tool was resolved against
+ * @arg job     - job to start
+ * @arg n       - number of the job, counting from 1
+ * @arg options - how to run the batch
+ * @return: 0 on success, -1 on failure (reported)
+ */
+static int start_job(xcrun_ctx *ctx, batch_job *job, int n, const batch_options *options)
+{
+	int i, fd;
+	char **argv;
+	const batch_tool *tool = job->tool;
+
+	if (tool->error != NULL) {
+		fprintf(stderr, "xcrun: error: job %d (\'%s\'): %s\n", n, tool->name, tool->error);
+		return -1;
+	}
+
+	if ((argv = xcrun_build_argv(ctx, &tool->tool, job->argc, job->argv)) == NULL) {
+		fprintf(stderr, "xcrun: error: job %d (\'%s\'): %s\n", n, tool->name, xcrun_error(ctx));
+		return -1;
+	}
+
+	if ((job->out = tmpfile()) == NULL || (job->err = tmpfile()) == NULL) {
+		fprintf(stderr, "xcrun: error: job %d (\'%s\'): failed to create output file. (%s)\n", n, tool->name, strerror(errno));
+		xcrun_free_vector(argv);
+		return -1;
+	}
+
+	if (options->logging) {
+		fprintf(stdout, "xcrun: info: invoking command:\n\t\"%s", tool->tool.path);
+		for (i = 1; argv[i] != NULL; i++)
+			fprintf(stdout, " %s", argv[i]);
+		fprintf(stdout, "\"\n");
+	}
+
+	/* Don't hand buffered output down to the job. */
+	fflush(stdout);
+	fflush(stderr);
+
+	if ((job->pid = fork()) == -1) {
+		fprintf(stderr, "xcrun: error: job %d (\'%s\'): failed to fork. (%s)\n", n, tool->name, strerror(errno));
+		xcrun_free_vector(argv);
+		return -1;
+	}
+
+	if (job->pid == 0) {
+		/* The batch may well have been read from stdin, jobs get nothing to read. */
+		if ((fd = open("/dev/null", O_RDONLY)) != -1)
+			dup2(fd, STDIN_FILENO);
+		dup2(fileno(job->out), STDOUT_FILENO);
+		dup2(fileno(job->err), STDERR_FILENO);
+
+		execve(tool->tool.path, argv, tool->envp);
+		fprintf(stderr, "xcrun: error: can't exec \'%s\' (%s)\n", tool->tool.path, strerror(errno));
+		_exit(127);
+	}
+
+	xcrun_free_vector(argv);
+
+	return 0;
+}
+
+/**
+ * @func copy_output -- Copy the output a job has kept aside, then close it.
+ * @arg from - output of the job
+ * @arg to   - where the output goes
+ */
+static void copy_output(FILE *from, FILE *to)
+{
+	char buf[BUFSIZ];
+	size_t len;
+
+	rewind(from);
+	while ((len = fread(buf, 1, sizeof(buf), from)) > 0)
+		fwrite(buf, 1, len, to);
+
+	fclose(from);
+	fflush(to);
+}
+
+/**
+ * @func finish_job -- Print the output and exit status of a job that is done.
+ * @arg job     - job that is done
+ * @arg n       - number of the job, counting from 1
+ * @arg status  - status returned by waitpid()
+ * @arg options - how to run the batch
+ * @return: 0 if the job succeeded, -1 if it failed
+ */
+static int finish_job(batch_job *job, int n, int status, const batch_options *options)
+{
+	copy_output(job->out, stdout);
+	copy_output(job->err, stderr);
+	job->out = job->err = NULL;
+	job->pid = -1;
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+		verbose_printf(options->verbose, "xcrun: info: job %d (\'%s\') exited with status 0.\n", n, job->tool->name);
+		return 0;
+	}
+
+	if (WIFSIGNALED(status))
+		fprintf(stderr, "xcrun: error: job %d (\'%s\') was killed by signal %d (%s).\n", n, job->tool->name, WTERMSIG(status), strsignal(WTERMSIG(status)));
+	else
+		fprintf(stderr, "xcrun: error: job %d (\'%s\') exited with status %d.\n", n, job->tool->name, WEXITSTATUS(status));
+
+	return -1;
+}
+
+/**
+ * @func free_batch -- Throw away the batch and everything allocated for it.
+ */
+static void free_batch(void)
+{
+	int i;
+
+	for (i = 0; i < njobs; i++)
+		free_argv(jobs[i].argv);
+	free(jobs);
+
+	for (i = 0; i < ntools; i++) {
+		free(tools[i].name);
+		xcrun_free_vector(tools[i].envp);
+		free(tools[i].error);
+	}
+	free(tools);
+
+	jobs = NULL;
+	tools = NULL;
+	njobs = ntools = 0;
+}
+
+/* See documentation in header file. */
+int batch_run(xcrun_ctx *ctx, FILE *input, const batch_options *options)
+{
+	int i, status, jobserver;
+	int next = 0;
+	int running = 0;
+	int failed = 0;
+	int max_jobs = options->max_jobs;
+	char buf[64];
+	pid_t pid;
+	batch_job *job;
+	struct pollfd fds[2];
+	struct sigaction sa, old_sa;
+
+	if (read_batch(input, options) != 0) {
+		free_batch();
+		return -1;
+	}
+
+	if (resolve_tools(ctx) != 0) {
+		fprintf(stderr, "xcrun: error: failed to resolve the batch. (%s)\n", strerror(errno));
+		free_batch();
+		return -1;
+	}
+
+	if (max_jobs <= 0 && (max_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+		max_jobs = 1;
+
+	/* Within make, the jobserver sets the pace unless we have been given an explicit limit. */
+	if ((jobserver = open_jobserver()) == -1) {
+		fprintf(stderr, "xcrun: warning: make jobserver unavailable, running jobs one at a time. (add '+' to the parent make rule)\n");
+		close_jobserver();
+		max_jobs = 1;
+	} else if (jobserver == 1 && options->max_jobs <= 0) {
+		max_jobs = njobs;
+	}
+
+	verbose_printf(options->verbose, "xcrun: info: running %d jobs, at most %d at a time%s.\n", njobs, max_jobs, (jobserver == 1 ? " (through the make jobserver)" : ""));
+
+	if (pipe(child_pipe) == -1 || fcntl(child_pipe[0], F_SETFL, O_NONBLOCK) == -1 || fcntl(child_pipe[1], F_SETFL, O_NONBLOCK) == -1 ||
+	    fcntl(child_pipe[0], F_SETFD, FD_CLOEXEC) == -1 || fcntl(child_pipe[1], F_SETFD, FD_CLOEXEC) == -1) {
+		fprintf(stderr, "xcrun: error: failed to create pipe. (%s)\n", strerror(errno));
+		close_jobserver();
+		free_batch();
+		return -1;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = child_exited;
+	sa.sa_flags = (SA_RESTART | SA_NOCLDSTOP);
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, &old_sa);
+
+	implicit_token_free = 1;
+
+	for (;;) {
+		/* Report the jobs that are done. */
+		while (running > 0 && (pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			for (i = 0; i < next && jobs[i].pid != pid; i++)
+				;
+			if (i == next)
+				continue;
+
+			if (finish_job(&jobs[i], i + 1, status, options) != 0)
+				failed++;
+			release_token(&jobs[i]);
+			running--;
+		}
+
+		/* Start as many jobs as we may. */
+		while (next < njobs && running < max_jobs) {
+			job = &jobs[next];
+			job->token = -1;
+
+			if (jobserver == 1) {
+				if (implicit_token_free)
+					implicit_token_free = 0;
+				else if ((job->token = acquire_token()) == -1)
+					break;
+			}
+
+			next++;
+			if (start_job(ctx, job, next, options) == 0) {
+				running++;
+			} else {
+				release_token(job);
+				failed++;
+			}
+		}
+
+		if (next == njobs && running == 0)
+			break;
+
+		/* Sleep until a job finishes, or the jobserver has a token for the next one. */
+		fds[0].fd = child_pipe[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = jobserver_rfd;
+		fds[1].events = POLLIN;
+
+		if (poll(fds, ((jobserver == 1 && next < njobs && running < max_jobs) ? 2 : 1), -1) == -1 && errno != EINTR) {
+			fprintf(stderr, "xcrun: error: poll failed. (%s)\n", strerror(errno));
+			break;
+		}
+
+		while (read(child_pipe[0], buf, sizeof(buf)) > 0)
+			;
+	}
+
+	/* Only reached early if poll() failed, don't leave anything behind. */
+	failed += (njobs - next);
+	for (i = 0; i < next; i++) {
+		if (jobs[i].pid > 0 && waitpid(jobs[i].pid, &status, 0) == jobs[i].pid) {
+			if (finish_job(&jobs[i], i + 1, status, options) != 0)
+				failed++;
+			release_token(&jobs[i]);
+		}
+	}
+
+	sigaction(SIGCHLD, &old_sa, NULL);
+	close(child_pipe[0]);
+	close(child_pipe[1]);
+	child_pipe[0] = child_pipe[1] = -1;
+	close_jobserver();
+
+	if (failed > 0)
+		fprintf(stderr, "xcrun: error: %d of %d jobs failed.\n", failed, njobs);
+
+	free_batch();
+
+	return failed;
+}
@@ -0,0 +1,56 @@
+/* batch.h - run many tools from one xcrun invocation
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdio.h>
+
+#include "libxcrun.h"
+
+/* How a batch is read and run */
+typedef struct {
+	int null_separated;			/* arguments end with a NUL byte, jobs with an empty argument */
+	int max_jobs;				/* most jobs run at once, 0 for the number of online processors */
+	int logging;				/* show every command before it is started */
+	FILE *verbose;				/* where to describe what is going on, may be NULL */
+} batch_options;
+
+/**
+ * @func batch_run -- resolve and run every job of a batch, a bounded number at a time
+ * @arg ctx     - context every tool is resolved against
+ * @arg input   - batch to read, one argument vector per job
+ * @arg options - how to read and run the batch
+ * @return: number of failed jobs, or -1 if the batch couldn't be read or started
+ */
+int batch_run(xcrun_ctx *ctx, FILE *input, const batch_options *options);
+
+#endif /* __BATCH_H__ */
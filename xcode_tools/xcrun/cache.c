@@ -0,0 +1,404 @@
+/* cache.c - persistent tool lookup cache for xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The cache is a plain text file living in $HOME. The first line holds
+ * XCRUN_CACHE_MAGIC, every following line holds one tab separated entry:
+ *
+ *   key, tool path, tool profile arguments, tool profile flag,
+ *   sdk path, toolchain path, target triple,
+ *   deployment target variable, deployment target, stamp count,
+ *   (path, inode, mtime sec, mtime nsec) for every stamp, and the admission flag.
+ *
+ * An entry is only used if every stamp still matches what is on disk, so
+ * a warm lookup costs one read of the cache file plus a stat() per input.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cache.h"
+
+#ifdef __APPLE__
+#define ST_MTIM(st) ((st).st_mtimespec)
+#else
+#define ST_MTIM(st) ((st).st_mtim)
+#endif
+
+/* helper function to build the absolute path of the cache file */
+static int get_cache_path(char *buf, size_t size)
+{
+	char *home_path;
+
+	if ((home_path = getenv("HOME")) == NULL)
+		return -1;
+
+	if (snprintf(buf, size, "%s/%s", home_path, XCRUN_CACHE_FILE) >= (int)size)
+		return -1;
+
+	return 0;
+}
+
+/* helper function to read the whole cache file into a nul terminated buffer */
+static char *read_cache_file(const char *path)
+{
+	int fd;
+	char *buf;
+	ssize_t n;
+	size_t len = 0;
+	struct stat st;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return NULL;
+
+	if (fstat(fd, &st) != 0 || (buf = (char *)malloc(st.st_size + 1)) == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	while (len < (size_t)st.st_size && (n = read(fd, buf + len, st.st_size - len)) > 0)
+		len += n;
+
+	close(fd);
+	buf[len] = '\0';
+
+	/* Refuse files written by an incompatible version of xcrun. */
+	if (strncmp(buf, XCRUN_CACHE_MAGIC "\n", strlen(XCRUN_CACHE_MAGIC) + 1) != 0) {
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/* helper function to split off the next tab separated field (empty fields are kept) */
+static char *next_field(char **line)
+{
+	char *field = *line;
+	char *end;
+
+	if (field == NULL)
+		return NULL;
+
+	if ((end = strchr(field, '\t')) != NULL) {
+		*end = '\0';
+		*line = end + 1;
+	} else {
+		*line = NULL;
+	}
+
+	return field;
+}
+
+/* helper function to copy a field into a fixed size buffer */
+static int copy_field(char *dst, size_t size, const char *src)
+{
+	if (src == NULL || strlen(src) >= size)
+		return -1;
+
+	strcpy(dst, src);
+
+	return 0;
+}
+
+/* helper function to test whether a stamp still matches the file system */
+static int stamp_is_current(const cache_stamp *stamp)
+{
+	struct stat st;
+
+	if (stat(stamp->path, &st) != 0)
+		return (stamp->ino == 0 && stamp->sec == 0 && stamp->nsec == 0);
+
+	return ((unsigned long long)st.st_ino == stamp->ino &&
+		(long long)ST_MTIM(st).tv_sec == stamp->sec &&
+		(long)ST_MTIM(st).tv_nsec == stamp->nsec);
+}
+
+/* helper function to parse an entry line (modifies line) */
+static int parse_entry(char *line, cache_entry *entry)
+{
+	int i;
+	char *field, *ino, *sec, *nsec;
+
+	if (copy_field(entry->key, sizeof(entry->key), next_field(&line)) != 0 ||
+	    copy_field(entry->tool_path, sizeof(entry->tool_path), next_field(&line)) != 0 ||
+	    copy_field(entry->tool_args, sizeof(entry->tool_args), next_field(&line)) != 0 ||
+	    (field = next_field(&line)) == NULL ||
+	    copy_field(entry->sdk_path, sizeof(entry->sdk_path), next_field(&line)) != 0 ||
+	    copy_field(entry->toolchain_path, sizeof(entry->toolchain_path), next_field(&line)) != 0 ||
+	    copy_field(entry->target_triple, sizeof(entry->target_triple), next_field(&line)) != 0 ||
+	    copy_field(entry->deployment_target_var, sizeof(entry->deployment_target_var), next_field(&line)) != 0 ||
+	    copy_field(entry->deployment_target, sizeof(entry->deployment_target), next_field(&line)) != 0 ||
+	    line == NULL)
+		return -1;
+
+	entry->profile = atoi(field);
+	entry->nstamps = atoi(next_field(&line));
+	if (entry->nstamps < 0 || entry->nstamps > XCRUN_CACHE_MAX_STAMPS)
+		return -1;
+
+	for (i = 0; i < entry->nstamps; i++) {
+		if (copy_field(entry->stamps[i].path, sizeof(entry->stamps[i].path), next_field(&line)) != 0)
+			return -1;
+		if ((ino = next_field(&line)) == NULL || (sec = next_field(&line)) == NULL || (nsec = next_field(&line)) == NULL)
+			return -1;
+		entry->stamps[i].ino = strtoull(ino, NULL, 10);
+		entry->stamps[i].sec = strtoll(sec, NULL, 10);
+		entry->stamps[i].nsec = strtol(nsec, NULL, 10);
+	}
+
+	/* Last, so that lines of older versions never parse. */
+	if ((field = next_field(&line)) == NULL)
+		return -1;
+	entry->admission = atoi(field);
+
+	return 0;
+}
+
+/* helper function to test whether a string may be stored in a cache field */
+static int field_is_valid(const char *s)
+{
+	return (strpbrk(s, "\t\n") == NULL);
+}
+
+/* helper function to test whether every field of an entry may be serialized */
+static int entry_is_valid(const cache_entry *entry)
+{
+	int i;
+
+	if (!field_is_valid(entry->key) || !field_is_valid(entry->tool_path) || !field_is_valid(entry->tool_args) ||
+	    !field_is_valid(entry->sdk_path) || !field_is_valid(entry->toolchain_path) ||
+	    !field_is_valid(entry->target_triple) || !field_is_valid(entry->deployment_target))
+		return 0;
+
+	for (i = 0; i < entry->nstamps; i++) {
+		if (!field_is_valid(entry->stamps[i].path))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* helper function to serialize an entry as a single line */
+static int write_entry(FILE *fp, const cache_entry *entry)
+{
+	int i;
+
+	fprintf(fp, "%s\t%s\t%s\t%d\t%s\t%s\t%s\t%s\t%s\t%d",
+		entry->key, entry->tool_path, entry->tool_args, entry->profile, entry->sdk_path, entry->toolchain_path,
+		entry->target_triple, entry->deployment_target_var, entry->deployment_target,
+		entry->nstamps);
+
+	for (i = 0; i < entry->nstamps; i++)
+		fprintf(fp, "\t%s\t%llu\t%lld\t%ld", entry->stamps[i].path,
+			entry->stamps[i].ino, entry->stamps[i].sec, entry->stamps[i].nsec);
+
+	fprintf(fp, "\t%d", entry->admission);
+
+	return fputc('\n', fp);
+}
+
+/* See documentation in header file. */
+int cache_add_stamp(cache_entry *entry, const char *path)
+{
+	struct stat st;
+	cache_stamp *stamp;
+
+	if (entry->nstamps >= XCRUN_CACHE_MAX_STAMPS || strlen(path) >= PATH_MAX)
+		return -1;
+
+	stamp = &entry->stamps[entry->nstamps++];
+	strcpy(stamp->path, path);
+
+	if (stat(path, &st) == 0) {
+		stamp->ino = (unsigned long long)st.st_ino;
+		stamp->sec = (long long)ST_MTIM(st).tv_sec;
+		stamp->nsec = (long)ST_MTIM(st).tv_nsec;
+	} else {
+		stamp->ino = 0;
+		stamp->sec = 0;
+		stamp->nsec = 0;
+	}
+
+	return 0;
+}
+
+/* See documentation in header file. */
+int cache_lookup(const char *key, cache_entry *entry)
+{
+	int status = -1;
+	size_t key_len = strlen(key);
+	char cache_path[PATH_MAX];
+	char *buf, *line, *end;
+
+	if (get_cache_path(cache_path, sizeof(cache_path)) != 0)
+		return -1;
+
+	if ((buf = read_cache_file(cache_path)) == NULL)
+		return -1;
+
+	/* Later lines win, but store() never leaves duplicate keys behind anyway. */
+	for (line = strchr(buf, '\n') + 1; *line != '\0'; line = end + 1) {
+		if ((end = strchr(line, '\n')) == NULL)
+			break;
+
+		if (strncmp(line, key, key_len) != 0 || line[key_len] != '\t')
+			continue;
+
+		*end = '\0';
+		if (parse_entry(line, entry) == 0 && cache_entry_is_current(entry))
+			status = 0;
+		break;
+	}
+
+	free(buf);
+
+	return status;
+}
+
+/* See documentation in header file. */
+int cache_store(const cache_entry *entry)
+{
+	int fd;
+	int nlines = 0;
+	FILE *fp;
+	size_t key_len = strlen(entry->key);
+	char cache_path[PATH_MAX];
+	char tmp_path[PATH_MAX + 8];
+	char *buf, *line, *end;
+
+	if (!entry_is_valid(entry))
+		return -1;
+
+	if (get_cache_path(cache_path, sizeof(cache_path)) != 0)
+		return -1;
+
+	sprintf(tmp_path, "%s.XXXXXX", cache_path);
+	if ((fd = mkstemp(tmp_path)) == -1)
+		return -1;
+
+	if ((fp = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		unlink(tmp_path);
+		return -1;
+	}
+
+	fprintf(fp, "%s\n", XCRUN_CACHE_MAGIC);
+
+	/* Carry over every other entry, dropping the oldest ones once we are full. */
+	if ((buf = read_cache_file(cache_path)) != NULL) {
+		for (line = strchr(buf, '\n') + 1; (end = strchr(line, '\n')) != NULL; line = end + 1)
+			nlines++;
+
+		for (line = strchr(buf, '\n') + 1; (end = strchr(line, '\n')) != NULL; line = end + 1) {
+			if (nlines-- >= XCRUN_CACHE_MAX_ENTRIES)
+				continue;
+			if (strncmp(line, entry->key, key_len) == 0 && line[key_len] == '\t')
+				continue;
+			fwrite(line, 1, (end - line) + 1, fp);
+		}
+
+		free(buf);
+	}
+
+	write_entry(fp, entry);
+
+	if (fclose(fp) != 0 || rename(tmp_path, cache_path) != 0) {
+		unlink(tmp_path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* See documentation in header file. */
+int cache_entry_is_current(const cache_entry *entry)
+{
+	int i;
+
+	for (i = 0; i < entry->nstamps; i++) {
+		if (!stamp_is_current(&entry->stamps[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* See documentation in header file. */
+char *cache_format_entry(const cache_entry *entry)
+{
+	FILE *fp;
+	char *buf = NULL;
+	size_t size = 0;
+
+	if (!entry_is_valid(entry) || (fp = open_memstream(&buf, &size)) == NULL)
+		return NULL;
+
+	write_entry(fp, entry);
+
+	if (fclose(fp) != 0) {
+		free(buf);
+		return NULL;
+	}
+
+	/* Drop the line terminator, callers frame the line themselves. */
+	buf[size - 1] = '\0';
+
+	return buf;
+}
+
+/* See documentation in header file. */
+int cache_parse_entry(char *line, cache_entry *entry)
+{
+	memset(entry, 0, sizeof(*entry));
+
+	return parse_entry(line, entry);
+}
+
+/* See documentation in header file. */
+int cache_kill(void)
+{
+	char cache_path[PATH_MAX];
+
+	if (get_cache_path(cache_path, sizeof(cache_path)) != 0)
+		return -1;
+
+	if (unlink(cache_path) != 0 && errno != ENOENT)
+		return -1;
+
+	return 0;
+}
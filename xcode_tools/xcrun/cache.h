@@ -0,0 +1,129 @@
+/* cache.h - persistent tool lookup cache for xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <limits.h>
+
+/* Name of the cache file, relative to $HOME */
+#define XCRUN_CACHE_FILE ".xcrun_cache"
+
+/* Version tag written as the first line of the cache file */
+#define XCRUN_CACHE_MAGIC "xcrun-cache 3"
+
+/* Oldest entries are dropped once the cache grows past this */
+#define XCRUN_CACHE_MAX_ENTRIES 256
+
+/* Maximum number of input files an entry may depend on */
+#define XCRUN_CACHE_MAX_STAMPS 12
+
+#define XCRUN_CACHE_MAX_KEY (PATH_MAX * 4)
+
+/* Modification stamp of a file or directory that a cache entry depends on */
+typedef struct {
+	char path[PATH_MAX];
+	unsigned long long ino;
+	long long sec;
+	long nsec;
+} cache_stamp;
+
+/*
+ * A resolved tool, along with the information needed to build its environment. Tools run through a
+ * tool profile have profile set, and tool_path and tool_args hold the unexpanded profile values.
+ */
+typedef struct {
+	char key[XCRUN_CACHE_MAX_KEY];
+	char tool_path[PATH_MAX];
+	char tool_args[PATH_MAX];
+	int profile;
+	int admission;		/* set if xcrun.ini had [ADMISSION] sections when the entry was built */
+	char sdk_path[PATH_MAX];
+	char toolchain_path[PATH_MAX];
+	char target_triple[NAME_MAX];
+	char deployment_target_var[NAME_MAX];
+	char deployment_target[NAME_MAX];
+	int nstamps;
+	cache_stamp stamps[XCRUN_CACHE_MAX_STAMPS];
+} cache_entry;
+
+/**
+ * @func cache_add_stamp -- record the current modification stamp of path in entry
+ * @arg entry - cache entry being built
+ * @arg path  - file or directory the entry depends on (a missing path is recorded as such)
+ * @return: 0 on success, -1 if the entry has no room left
+ */
+int cache_add_stamp(cache_entry *entry, const char *path);
+
+/**
+ * @func cache_lookup -- find a valid entry for key in the lookup cache
+ * @arg key   - lookup key
+ * @arg entry - entry to fill in on a hit
+ * @return: 0 on a hit, -1 on a miss or a stale entry
+ */
+int cache_lookup(const char *key, cache_entry *entry);
+
+/**
+ * @func cache_store -- add or replace an entry in the lookup cache
+ * @arg entry - entry to store
+ * @return: 0 on success, -1 on failure
+ */
+int cache_store(const cache_entry *entry);
+
+/**
+ * @func cache_entry_is_current -- test whether every stamp of an entry still matches the file system
+ * @arg entry - entry to test
+ * @return: 1 if the entry is still valid, 0 otherwise
+ */
+int cache_entry_is_current(const cache_entry *entry);
+
+/**
+ * @func cache_format_entry -- serialize an entry as a single line, in the format of the cache file
+ * @arg entry - entry to serialize
+ * @return: newly allocated line without its terminator, or NULL if the entry can't be represented
+ */
+char *cache_format_entry(const cache_entry *entry);
+
+/**
+ * @func cache_parse_entry -- parse a line produced by cache_format_entry
+ * @arg line  - line to parse (modified)
+ * @arg entry - entry to fill in
+ * @return: 0 on success, -1 on a malformed line
+ */
+int cache_parse_entry(char *line, cache_entry *entry);
+
+/**
+ * @func cache_kill -- invalidate all existing cache entries
+ * @return: 0 on success, -1 on failure
+ */
+int cache_kill(void);
+
+#endif /* __CACHE_H__ */
@@ -0,0 +1,975 @@
+/* compcache.c - compile and link result cache for the tools run through xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * When XCRUN_COMPILE_CACHE names a directory, compiles (-c, with a single -o output) run by the
+ * compiler drivers are looked up there before the compiler is run. The key of a compile is a hash
+ * of the compiler binary (path, inode, size and modification time), its arguments with the output
+ * left out, the working directory, the SDKROOT, target triple and deployment target it runs with,
+ * and the preprocessed source, which the compiler is asked for with -E.
+ *
+ * On a hit, the object file, the dependency file (-MF) and the diagnostics of the original compile
+ * are restored and the compiler isn't run at all. On a miss, the compiler runs as usual and its
+ * results are stored once it has succeeded. Every file is written under a temporary name and
+ * renamed into place, so that parallel builds sharing a cache never see half written entries.
+ * Failing to use the cache never fails the compile, the compiler is just run.
+ *
+ * XCRUN_LINK_CACHE does the same for links (a single -o output) run by the linker. Links have
+ * nothing like -E to lean on, so their key hashes the contents of every input instead: each
+ * argument naming a file, the files listed by -filelist, response files (@file, whose arguments are
+ * scanned as well), and every library or framework that -l or -framework could pick up from the
+ * -L and -F directories and the default ones under the sysroot. The linked output keeps its
+ * permissions, both in the cache and once restored.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "compcache.h"
+#include "hash.h"
+#include "util.h"
+
+/* Options that make the linker write more than its output, or print to stdout */
+#define LINK_EXTRA_OUTPUTS "-map -Map --Map -dependency_info -object_path_lto -save-temps -t --trace -why_load -why_live"
+
+/* Most -L or -F directories a link may search */
+#define LINK_MAX_DIRS 64
+
+/* Deepest nesting of response files */
+#define LINK_MAX_DEPTH 8
+
+/* What a compile or a link writes */
+typedef struct {
+	int output;		/* index of the -o value */
+	int depfile;		/* index of the -MF value, -1 without one */
+	bool depends;		/* -MD or -MMD, the dependency file names the output */
+	bool link;		/* a link, not a compile */
+} compile_args;
+
+/* Arguments of a link, with its response files expanded */
+typedef struct {
+	char **args;
+	int count;
+	int size;
+} link_args;
+
+/* Where the libraries and frameworks of a link are searched for */
+typedef struct {
+	int nlibdirs;
+	int nframeworkdirs;
+	const char *libdirs[LINK_MAX_DIRS + 2];
+	const char *frameworkdirs[LINK_MAX_DIRS + 2];
+	char defaults[4][PATH_MAX];
+} link_paths;
+
+/**
+ * @func parse_args -- Check whether a compile can be cached, and find what it writes.
+ * @arg name - name of the tool
+ * @arg argv - arguments the tool runs with
+ * @arg args - filled in with what the compile writes
+ * @return: true if the compile can be cached
+ */
+static bool parse_args(const char *name, char *const argv[], compile_args *args)
+{
+	int i;
+	bool compile = false;
+
+	args->output = args->depfile = -1;
+	args->depends = args->link = false;
+
+	if (!name_in_list(name, COMPCACHE_TOOLS))
+		return false;
+
+	for (i = 1; argv[i] != NULL; i++) {
+		if (strcmp(argv[i], "-c") == 0) {
+			compile = true;
+		} else if (strcmp(argv[i], "-o") == 0 && argv[i + 1] != NULL) {
+			if (args->output != -1)
+				return false;
+			args->output = ++i;
+		} else if (strcmp(argv[i], "-MF") == 0 && argv[i + 1] != NULL) {
+			args->depfile = ++i;
+		} else if (strcmp(argv[i], "-MD") == 0 || strcmp(argv[i], "-MMD") == 0) {
+			args->depends = true;
+		} else if (strcmp(argv[i], "-") == 0 || strcmp(argv[i], "-E") == 0 || strcmp(argv[i], "-S") == 0 || strcmp(argv[i], "-M") == 0 ||
+			   strcmp(argv[i], "-MM") == 0 || strcmp(argv[i], "--analyze") == 0 || strncmp(argv[i], "-save-temps", 11) == 0 ||
+			   (strncmp(argv[i], "-o", 2) == 0 && argv[i][2] != '\0') || (strncmp(argv[i], "-MF", 3) == 0 && argv[i][3] != '\0')) {
+			/* Reads stdin, writes more than an object, or names its outputs in ways we don't bother with. */
+			return false;
+		}
+	}
+
+	/* Without -MF, the compiler names the dependency file after the output itself. */
+	return (compile && args->output != -1 && strcmp(argv[args->output], "-") != 0 && args->depends == (args->depfile != -1));
+}
+
+/**
+ * @func hash_preprocessed -- Mix the preprocessed source of a compile into its key.
+ * @arg hash - key
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @arg argv - arguments the tool runs with
+ * @arg args - what the compile writes
+ * @return: 0 on success, -1 if the source couldn't be preprocessed
+ */
+static int hash_preprocessed(xcrun_hash *hash, const xcrun_tool *tool, char *const envp[], char *const argv[], const compile_args *args)
+{
+	int i, n = 0;
+	int fds[2], null;
+	char buf[BUFSIZ * 4];
+	char **pp_argv;
+	pid_t pid;
+	ssize_t len;
+
+	for (i = 0; argv[i] != NULL; i++)
+		;
+
+	if ((pp_argv = (char **)calloc(i + 1, sizeof(char *))) == NULL)
+		return -1;
+
+	/* Same compile, but stop after preprocessing, writing to stdout and no dependency file. */
+	for (i = 0; argv[i] != NULL; i++) {
+		if (i == args->output - 1 || i == args->output || (args->depfile != -1 && (i == args->depfile - 1 || i == args->depfile)))
+			continue;
+		if (strcmp(argv[i], "-MD") == 0 || strcmp(argv[i], "-MMD") == 0 || strcmp(argv[i], "-MP") == 0)
+			continue;
+		if ((strcmp(argv[i], "-MT") == 0 || strcmp(argv[i], "-MQ") == 0) && argv[i + 1] != NULL) {
+			i++;
+			continue;
+		}
+		pp_argv[n++] = (strcmp(argv[i], "-c") == 0 ? "-E" : argv[i]);
+	}
+
+	if (pipe(fds) == -1) {
+		free(pp_argv);
+		return -1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	if ((pid = fork()) == 0) {
+		/* Diagnostics are left to the real compile. */
+		if ((null = open("/dev/null", O_RDWR)) != -1) {
+			dup2(null, STDIN_FILENO);
+			dup2(null, STDERR_FILENO);
+		}
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execve(tool->path, pp_argv, envp);
+		_exit(127);
+	}
+
+	free(pp_argv);
+	close(fds[1]);
+
+	if (pid == -1) {
+		close(fds[0]);
+		return -1;
+	}
+
+	while ((len = read(fds[0], buf, sizeof(buf))) != 0) {
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		hash_update(hash, buf, len);
+	}
+
+	close(fds[0]);
+
+	return (wait_status(pid) == 0 && len == 0 ? 0 : -1);
+}
+
+/**
+ * @func hash_invocation -- Start the key of a compile or a link with what every step depends on.
+ * @arg hash - key
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @return: 0 on success, -1 on failure
+ */
+static int hash_invocation(xcrun_hash *hash, const xcrun_tool *tool, char *const envp[])
+{
+	int i;
+	char cwd[PATH_MAX];
+	struct stat st;
+
+	if (stat(tool->path, &st) != 0 || getcwd(cwd, sizeof(cwd)) == NULL)
+		return -1;
+
+	hash_init(hash);
+	hash_string(hash, COMPCACHE_MAGIC);
+
+	/* The tool binary, */
+	hash_string(hash, tool->path);
+	hash_update(hash, &st.st_ino, sizeof(st.st_ino));
+	hash_update(hash, &st.st_size, sizeof(st.st_size));
+	hash_update(hash, &st.st_mtime, sizeof(st.st_mtime));
+
+	/* where it runs (debug info records it), */
+	hash_string(hash, cwd);
+
+	/* and what it runs with. */
+	for (i = 0; envp[i] != NULL; i++) {
+		if (strncmp(envp[i], "SDKROOT=", 8) == 0 || strncmp(envp[i], "DEVELOPER_DIR=", 14) == 0 || strncmp(envp[i], "TARGET_TRIPLE=", 14) == 0 ||
+		    strstr(envp[i], "_DEPLOYMENT_TARGET=") != NULL)
+			hash_string(hash, envp[i]);
+	}
+
+	return 0;
+}
+
+/**
+ * @func compute_key -- Compute the key of a compile.
+ * @arg key  - buffer of HASH_HEX_SIZE bytes to hold the key
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @arg argv - arguments the tool runs with
+ * @arg args - what the compile writes
+ * @return: 0 on success, -1 on failure
+ */
+static int compute_key(char *key, const xcrun_tool *tool, char *const envp[], char *const argv[], const compile_args *args)
+{
+	int i;
+	xcrun_hash hash;
+
+	if (hash_invocation(&hash, tool, envp) != 0)
+		return -1;
+
+	/* The arguments, leaving out where the results go unless the dependency file names them, */
+	for (i = 1; argv[i] != NULL; i++) {
+		if ((i == args->output && !args->depends) || i == args->depfile)
+			hash_string(&hash, "");
+		else
+			hash_string(&hash, argv[i]);
+	}
+
+	/* and the source it compiles. */
+	if (hash_preprocessed(&hash, tool, envp, argv, args) != 0)
+		return -1;
+
+	hash_hex(&hash, key);
+
+	return 0;
+}
+
+/**
+ * @func link_writes_more -- Check whether a linker option writes more than the output, or prints to stdout.
+ * @arg arg - argument
+ * @return: true if it does
+ */
+static bool link_writes_more(const char *arg)
+{
+	char name[NAME_MAX];
+	size_t len = strcspn(arg, "=");
+
+	if (strcmp(arg, "-") == 0 || strncmp(arg, "--output", 8) == 0)
+		return true;
+
+	if (len >= sizeof(name))
+		return false;
+
+	memcpy(name, arg, len);
+	name[len] = '\0';
+
+	return name_in_list(name, LINK_EXTRA_OUTPUTS);
+}
+
+/**
+ * @func parse_link_args -- Check whether a link can be cached, and find what it writes.
+ * @arg name - name of the tool
+ * @arg argv - arguments the tool runs with
+ * @arg args - filled in with what the link writes
+ * @return: true if the link can be cached
+ */
+static bool parse_link_args(const char *name, char *const argv[], compile_args *args)
+{
+	int i;
+
+	args->output = args->depfile = -1;
+	args->depends = false;
+	args->link = true;
+
+	if (!name_in_list(name, COMPCACHE_LINK_TOOLS))
+		return false;
+
+	for (i = 1; argv[i] != NULL; i++) {
+		if (strcmp(argv[i], "-o") == 0 && argv[i + 1] != NULL) {
+			if (args->output != -1)
+				return false;
+			args->output = ++i;
+		} else if (link_writes_more(argv[i])) {
+			return false;
+		}
+	}
+
+	return (args->output != -1 && strcmp(argv[args->output], "-") != 0);
+}
+
+/**
+ * @func hash_file -- Mix the name and contents of a file into a key.
+ * @arg hash - key
+ * @arg path - file
+ * @return: 0 on success, or if path isn't a regular file, -1 if it couldn't be read
+ */
+static int hash_file(xcrun_hash *hash, const char *path)
+{
+	int fd;
+	char buf[BUFSIZ * 4];
+	struct stat st;
+	ssize_t len;
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		return 0;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return -1;
+
+	hash_string(hash, path);
+
+	while ((len = read(fd, buf, sizeof(buf))) != 0) {
+		if (len == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		hash_update(hash, buf, len);
+	}
+
+	close(fd);
+
+	return (len == 0 ? 0 : -1);
+}
+
+/**
+ * @func read_file -- Read a whole file into memory.
+ * @arg path - file
+ * @return: newly allocated, NUL terminated contents of the file, or NULL on failure
+ */
+static char *read_file(const char *path)
+{
+	FILE *fp;
+	char *buf = NULL, *tmp;
+	size_t len = 0, size = 0, n;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return NULL;
+
+	do {
+		if (len + BUFSIZ + 1 > size) {
+			size = (size * 2) + BUFSIZ + 1;
+			if ((tmp = (char *)realloc(buf, size)) == NULL) {
+				free(buf);
+				fclose(fp);
+				return NULL;
+			}
+			buf = tmp;
+		}
+		len += (n = fread(buf + len, 1, BUFSIZ, fp));
+	} while (n > 0);
+
+	fclose(fp);
+	buf[len] = '\0';
+
+	return buf;
+}
+
+/**
+ * @func link_args_add -- Append a copy of an argument to the arguments of a link.
+ * @arg list - arguments of the link
+ * @arg arg  - argument to append
+ * @return: 0 on success, -1 on failure
+ */
+static int link_args_add(link_args *list, const char *arg)
+{
+	char **args;
+
+	if (list->count + 1 >= list->size) {
+		if ((args = (char **)realloc(list->args, ((list->size * 2) + 16) * sizeof(char *))) == NULL)
+			return -1;
+		list->args = args;
+		list->size = (list->size * 2) + 16;
+	}
+
+	if ((list->args[list->count] = strdup(arg)) == NULL)
+		return -1;
+	list->args[++list->count] = NULL;
+
+	return 0;
+}
+
+/**
+ * @func link_args_free -- Free the arguments of a link.
+ * @arg list - arguments of the link
+ */
+static void link_args_free(link_args *list)
+{
+	int i;
+
+	for (i = 0; i < list->count; i++)
+		free(list->args[i]);
+	free(list->args);
+}
+
+/**
+ * @func expand_arg -- Append an argument of a link, expanding it if it names a response file.
+ * @arg list  - arguments of the link
+ * @arg hash  - key, which gets the contents of response files
+ * @arg arg   - argument
+ * @arg depth - nesting of response files arg comes from
+ * @return: 0 on success, -1 if the link can't be cached
+ */
+static int expand_arg(link_args *list, xcrun_hash *hash, const char *arg, int depth)
+{
+	int status = 0;
+	char *buf, *p, *q, *token;
+	char end, quote;
+
+	/* Response files only hold arguments, they can't pick another output. */
+	if (depth > 0 && (strcmp(arg, "-o") == 0 || link_writes_more(arg)))
+		return -1;
+
+	if (arg[0] != '@' || access(arg + 1, F_OK) != 0)
+		return link_args_add(list, arg);
+
+	if (depth >= LINK_MAX_DEPTH || hash_file(hash, arg + 1) != 0 || (buf = read_file(arg + 1)) == NULL)
+		return -1;
+
+	/* Arguments are separated by white space, with quotes and backslashes like the shell. */
+	for (p = buf; status == 0; ) {
+		while (isspace((unsigned char)*p))
+			p++;
+		if (*p == '\0')
+			break;
+
+		for (q = token = p, quote = '\0'; *p != '\0' && (quote != '\0' || !isspace((unsigned char)*p)); p++) {
+			if (quote != '\0' && *p == quote)
+				quote = '\0';
+			else if (quote == '\0' && (*p == '\"' || *p == '\''))
+				quote = *p;
+			else if (*p == '\\' && p[1] != '\0')
+				*q++ = *++p;
+			else
+				*q++ = *p;
+		}
+
+		end = *p;
+		*q = '\0';
+		if (end != '\0')
+			p++;
+
+		status = expand_arg(list, hash, token, depth + 1);
+	}
+
+	free(buf);
+
+	return status;
+}
+
+/**
+ * @func add_dir -- Add a directory to the directories a link searches.
+ * @arg dirs  - directories
+ * @arg count - number of directories
+ * @arg dir   - directory to add
+ * @return: 0 on success, -1 if there are too many of them
+ */
+static int add_dir(const char **dirs, int *count, const char *dir)
+{
+	if (*count >= LINK_MAX_DIRS)
+		return -1;
+
+	dirs[(*count)++] = dir;
+
+	return 0;
+}
+
+/**
+ * @func find_link_paths -- Find the directories a link searches for libraries and frameworks.
+ * @arg paths - filled in with the directories
+ * @arg args  - arguments of the link, response files expanded
+ * @arg envp  - environment the tool runs with
+ * @return: 0 on success, -1 if the link can't be cached
+ */
+static int find_link_paths(link_paths *paths, char *const args[], char *const envp[])
+{
+	int i;
+	const char *sysroot = "";
+
+	paths->nlibdirs = paths->nframeworkdirs = 0;
+
+	for (i = 0; envp[i] != NULL; i++) {
+		if (strncmp(envp[i], "SDKROOT=", 8) == 0)
+			sysroot = envp[i] + 8;
+	}
+
+	for (i = 0; args[i] != NULL; i++) {
+		if (strcmp(args[i], "-L") == 0 && args[i + 1] != NULL) {
+			if (add_dir(paths->libdirs, &paths->nlibdirs, args[++i]) != 0)
+				return -1;
+		} else if (strncmp(args[i], "-L", 2) == 0) {
+			if (add_dir(paths->libdirs, &paths->nlibdirs, args[i] + 2) != 0)
+				return -1;
+		} else if (strcmp(args[i], "-F") == 0 && args[i + 1] != NULL) {
+			if (add_dir(paths->frameworkdirs, &paths->nframeworkdirs, args[++i]) != 0)
+				return -1;
+		} else if (strncmp(args[i], "-F", 2) == 0) {
+			if (add_dir(paths->frameworkdirs, &paths->nframeworkdirs, args[i] + 2) != 0)
+				return -1;
+		} else if ((strcmp(args[i], "-syslibroot") == 0 || strcmp(args[i], "--sysroot") == 0) && args[i + 1] != NULL) {
+			sysroot = args[++i];
+		} else if (strncmp(args[i], "--sysroot=", 10) == 0) {
+			sysroot = args[i] + 10;
+		}
+	}
+
+	/* The default directories come last, under the sysroot if there is one. */
+	snprintf(paths->defaults[0], PATH_MAX, "%s/usr/lib", sysroot);
+	snprintf(paths->defaults[1], PATH_MAX, "%s/usr/local/lib", sysroot);
+	snprintf(paths->defaults[2], PATH_MAX, "%s/System/Library/Frameworks", sysroot);
+	snprintf(paths->defaults[3], PATH_MAX, "%s/Library/Frameworks", sysroot);
+
+	paths->libdirs[paths->nlibdirs++] = paths->defaults[0];
+	paths->libdirs[paths->nlibdirs++] = paths->defaults[1];
+	paths->frameworkdirs[paths->nframeworkdirs++] = paths->defaults[2];
+	paths->frameworkdirs[paths->nframeworkdirs++] = paths->defaults[3];
+
+	return 0;
+}
+
+/**
+ * @func hash_library -- Mix every file a -l option could pick up into a key.
+ * @arg hash  - key
+ * @arg paths - directories the link searches
+ * @arg name  - name of the library, as given to -l
+ * @return: 0 on success, -1 on failure
+ *
+ * Every candidate is hashed, not just the one the linker would pick, so the key doesn't depend
+ * on the search order of a particular linker.
+ */
+static int hash_library(xcrun_hash *hash, const link_paths *paths, const char *name)
+{
+	int i, j;
+	char path[PATH_MAX];
+	static const char *const suffixes[] = { ".tbd", ".dylib", ".so", ".a" };
+
+	for (i = 0; i < paths->nlibdirs; i++) {
+		/* -l:file names the file itself. */
+		if (name[0] == ':') {
+			if (snprintf(path, sizeof(path), "%s/%s", paths->libdirs[i], name + 1) >= (int)sizeof(path) || hash_file(hash, path) != 0)
+				return -1;
+			continue;
+		}
+
+		for (j = 0; j < (int)(sizeof(suffixes) / sizeof(suffixes[0])); j++) {
+			if (snprintf(path, sizeof(path), "%s/lib%s%s", paths->libdirs[i], name, suffixes[j]) >= (int)sizeof(path) || hash_file(hash, path) != 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @func hash_framework -- Mix every file a -framework option could pick up into a key.
+ * @arg hash  - key
+ * @arg paths - directories the link searches
+ * @arg name  - name of the framework, with an optional ,suffix
+ * @return: 0 on success, -1 on failure
+ */
+static int hash_framework(xcrun_hash *hash, const link_paths *paths, const char *name)
+{
+	int i;
+	int len = (int)strcspn(name, ",");
+	char path[PATH_MAX];
+
+	for (i = 0; i < paths->nframeworkdirs; i++) {
+		if (snprintf(path, sizeof(path), "%s/%.*s.framework/%.*s", paths->frameworkdirs[i], len, name, len, name) >= (int)sizeof(path) - 4 ||
+		    hash_file(hash, path) != 0)
+			return -1;
+		strcat(path, ".tbd");
+		if (hash_file(hash, path) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @func hash_filelist -- Mix a -filelist file and every file it lists into a key.
+ * @arg hash  - key
+ * @arg value - value of -filelist, a file with an optional ,directory the listed files are relative to
+ * @return: 0 on success, -1 on failure
+ */
+static int hash_filelist(xcrun_hash *hash, const char *value)
+{
+	int status = 0;
+	char list[PATH_MAX];
+	char path[PATH_MAX];
+	char *buf, *line, *dir;
+
+	if (snprintf(list, sizeof(list), "%s", value) >= (int)sizeof(list))
+		return -1;
+
+	if ((dir = strchr(list, ',')) != NULL)
+		*dir++ = '\0';
+
+	if (hash_file(hash, list) != 0 || (buf = read_file(list)) == NULL)
+		return -1;
+
+	for (line = strtok(buf, "\r\n"); line != NULL && status == 0; line = strtok(NULL, "\r\n")) {
+		if (dir != NULL)
+			status = (snprintf(path, sizeof(path), "%s/%s", dir, line) < (int)sizeof(path) ? hash_file(hash, path) : -1);
+		else
+			status = hash_file(hash, line);
+	}
+
+	free(buf);
+
+	return status;
+}
+
+/**
+ * @func hash_link_inputs -- Mix the contents of every input of a link into its key.
+ * @arg hash - key
+ * @arg args - arguments of the link, response files expanded
+ * @arg envp - environment the tool runs with
+ * @return: 0 on success, -1 on failure
+ */
+static int hash_link_inputs(xcrun_hash *hash, char *const args[], char *const envp[])
+{
+	int i, j;
+	int status = 0;
+	const char *value;
+	link_paths paths;
+	static const char *const frameworks[] = { "-framework", "-weak_framework", "-reexport_framework", "-lazy_framework", "-upward_framework", "-needed_framework" };
+	static const char *const libraries[] = { "-weak-l", "-reexport-l", "-lazy-l", "-upward-l", "-needed-l", "--library=", "-l" };
+
+	if (find_link_paths(&paths, args, envp) != 0)
+		return -1;
+
+	for (i = 0; args[i] != NULL && status == 0; i++) {
+		value = NULL;
+
+		if (strcmp(args[i], "-filelist") == 0 && args[i + 1] != NULL) {
+			status = hash_filelist(hash, args[++i]);
+			continue;
+		}
+
+		for (j = 0; j < (int)(sizeof(frameworks) / sizeof(frameworks[0])) && value == NULL; j++) {
+			if (strcmp(args[i], frameworks[j]) == 0 && args[i + 1] != NULL) {
+				status = hash_framework(hash, &paths, args[++i]);
+				value = args[i];
+			}
+		}
+
+		if (value != NULL)
+			continue;
+
+		if ((strcmp(args[i], "-l") == 0 || strcmp(args[i], "--library") == 0) && args[i + 1] != NULL) {
+			status = hash_library(hash, &paths, args[++i]);
+			continue;
+		}
+
+		for (j = 0; j < (int)(sizeof(libraries) / sizeof(libraries[0])) && value == NULL; j++) {
+			if (strncmp(args[i], libraries[j], strlen(libraries[j])) == 0 && args[i][strlen(libraries[j])] != '\0') {
+				value = args[i] + strlen(libraries[j]);
+				status = hash_library(hash, &paths, value);
+			}
+		}
+
+		if (value != NULL)
+			continue;
+
+		/* Anything else naming a file is an input, objects and archives along with order files, export lists and the like. */
+		status = hash_file(hash, args[i]);
+		if (status == 0 && args[i][0] == '-' && (value = strchr(args[i], '=')) != NULL)
+			status = hash_file(hash, value + 1);
+	}
+
+	return status;
+}
+
+/**
+ * @func compute_link_key -- Compute the key of a link.
+ * @arg key  - buffer of HASH_HEX_SIZE bytes to hold the key
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @arg argv - arguments the tool runs with
+ * @arg args - what the link writes
+ * @return: 0 on success, -1 on failure
+ */
+static int compute_link_key(char *key, const xcrun_tool *tool, char *const envp[], char *const argv[], const compile_args *args)
+{
+	int i;
+	int status = 0;
+	link_args list = { NULL, 0, 0 };
+	xcrun_hash hash;
+
+	if (hash_invocation(&hash, tool, envp) != 0)
+		return -1;
+
+	/* The arguments, leaving out where the output goes, */
+	hash_string(&hash, "link");
+	for (i = 1; argv[i] != NULL; i++)
+		hash_string(&hash, (i == args->output ? "" : argv[i]));
+
+	/* the response files they name, */
+	for (i = 1; argv[i] != NULL && status == 0; i++) {
+		if (i != args->output)
+			status = expand_arg(&list, &hash, argv[i], 0);
+	}
+
+	/* and every input they lead to. */
+	if (status == 0 && list.args != NULL)
+		status = hash_link_inputs(&hash, list.args, envp);
+
+	link_args_free(&list);
+
+	if (status != 0)
+		return -1;
+
+	hash_hex(&hash, key);
+
+	return 0;
+}
+
+/**
+ * @func entry_path -- Build the path of one of the files of a cache entry.
+ * @arg buf    - buffer to hold the path
+ * @arg size   - size of buffer
+ * @arg dir    - cache directory
+ * @arg key    - key of the entry
+ * @arg suffix - file of the entry
+ * @return: 0 on success, -1 if the path doesn't fit
+ */
+static int entry_path(char *buf, size_t size, const char *dir, const char *key, const char *suffix)
+{
+	/* Entries are spread over 256 subdirectories. */
+	return (snprintf(buf, size, "%s/%.2s/%s%s", dir, key, key + 2, suffix) < (int)size ? 0 : -1);
+}
+
+/**
+ * @func copy_file -- Copy a file and its permissions, through a temporary file renamed into place.
+ * @arg from - file to copy
+ * @arg to   - where to copy it
+ * @return: 0 on success, -1 on failure
+ */
+static int copy_file(const char *from, const char *to)
+{
+	int in, out;
+	char tmp[PATH_MAX];
+	char buf[BUFSIZ * 4];
+	struct stat st;
+	ssize_t len;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.xcrun-tmp.%ld", to, (long)getpid()) >= (int)sizeof(tmp))
+		return -1;
+
+	if ((in = open(from, O_RDONLY)) == -1)
+		return -1;
+
+	if (fstat(in, &st) != 0 || (out = open(tmp, (O_WRONLY | O_CREAT | O_TRUNC), 0666)) == -1) {
+		close(in);
+		return -1;
+	}
+
+	/* Linked executables have to stay executable. */
+	fchmod(out, (st.st_mode & 0777));
+
+	while ((len = read(in, buf, sizeof(buf))) > 0) {
+		if (write(out, buf, len) != len) {
+			len = -1;
+			break;
+		}
+	}
+
+	close(in);
+
+	if (close(out) == 0 && len == 0 && rename(tmp, to) == 0)
+		return 0;
+
+	unlink(tmp);
+
+	return -1;
+}
+
+/**
+ * @func print_file -- Copy the contents of a file to a stream.
+ * @arg path - file to print
+ * @arg fp   - stream to print to
+ */
+static void print_file(const char *path, FILE *fp)
+{
+	FILE *in;
+	char buf[BUFSIZ];
+	size_t len;
+
+	if ((in = fopen(path, "r")) == NULL)
+		return;
+
+	while ((len = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, len, fp);
+
+	fclose(in);
+	fflush(fp);
+}
+
+/**
+ * @func restore_entry -- Restore the results of a compile or a link from the cache.
+ * @arg dir  - cache directory
+ * @arg key  - key of the step
+ * @arg argv - arguments the tool runs with
+ * @arg args - what the step writes
+ * @return: 0 on a hit, -1 on a miss
+ */
+static int restore_entry(const char *dir, const char *key, char *const argv[], const compile_args *args)
+{
+	char path[PATH_MAX];
+
+	if (entry_path(path, sizeof(path), dir, key, (args->link ? ".out" : ".o")) != 0 || copy_file(path, argv[args->output]) != 0)
+		return -1;
+
+	if (args->depfile != -1 && (entry_path(path, sizeof(path), dir, key, ".d") != 0 || copy_file(path, argv[args->depfile]) != 0)) {
+		unlink(argv[args->output]);
+		return -1;
+	}
+
+	/* Warnings are part of the result. */
+	if (entry_path(path, sizeof(path), dir, key, ".stderr") == 0)
+		print_file(path, stderr);
+
+	return 0;
+}
+
+/**
+ * @func store_entry -- Store the results of a successful compile or link in the cache.
+ * @arg dir    - cache directory
+ * @arg key    - key of the step
+ * @arg argv   - arguments the tool ran with
+ * @arg args   - what the step wrote
+ * @arg errors - file holding the diagnostics of the step
+ */
+static void store_entry(const char *dir, const char *key, char *const argv[], const compile_args *args, const char *errors)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%.2s", dir, key) >= (int)sizeof(path))
+		return;
+
+	mkdir(dir, 0777);
+	if (mkdir(path, 0777) != 0 && errno != EEXIST)
+		return;
+
+	/* The object (or linked output) goes in last, it is what marks the entry as complete. */
+	if (entry_path(path, sizeof(path), dir, key, ".stderr") != 0 || copy_file(errors, path) != 0)
+		return;
+	if (args->depfile != -1 && (entry_path(path, sizeof(path), dir, key, ".d") != 0 || copy_file(argv[args->depfile], path) != 0))
+		return;
+	if (entry_path(path, sizeof(path), dir, key, (args->link ? ".out" : ".o")) == 0)
+		copy_file(argv[args->output], path);
+}
+
+/* See documentation in header file. */
+int compcache_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[], int logging)
+{
+	int fd, status;
+	char key[HASH_HEX_SIZE];
+	char errors[PATH_MAX];
+	const char *dir, *step;
+	pid_t pid;
+	compile_args args;
+
+	if ((dir = getenv(COMPCACHE_DIR_ENV)) != NULL && *dir != '\0' && parse_args(name, argv, &args))
+		step = "compile";
+	else if ((dir = getenv(COMPCACHE_LINK_DIR_ENV)) != NULL && *dir != '\0' && parse_link_args(name, argv, &args))
+		step = "link";
+	else
+		return -1;
+
+	if ((args.link ? compute_link_key(key, tool, envp, argv, &args) : compute_key(key, tool, envp, argv, &args)) != 0) {
+		if (logging)
+			fprintf(stdout, "xcrun: info: %s of \'%s\' can't be cached, running it.\n", step, argv[args.output]);
+		return -1;
+	}
+
+	if (restore_entry(dir, key, argv, &args) == 0) {
+		if (logging)
+			fprintf(stdout, "xcrun: info: restored \'%s\' from the %s cache (%s).\n", argv[args.output], step, key);
+		return 0;
+	}
+
+	if (logging)
+		fprintf(stdout, "xcrun: info: \'%s\' is not in the %s cache (%s), running it.\n", argv[args.output], step, key);
+
+	/* Keep the diagnostics, they are part of the result. */
+	snprintf(errors, sizeof(errors), "%s/xcrun-diagnostics.XXXXXX", (getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp"));
+	if ((fd = mkstemp(errors)) == -1)
+		return -1;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	if ((pid = fork()) == 0) {
+		dup2(fd, STDERR_FILENO);
+		close(fd);
+		execve(tool->path, argv, envp);
+		fprintf(stderr, "xcrun: error: can't exec \'%s\' (%s)\n", tool->path, strerror(errno));
+		_exit(127);
+	}
+
+	close(fd);
+
+	if (pid == -1) {
+		unlink(errors);
+		return -1;
+	}
+
+	status = wait_status(pid);
+	print_file(errors, stderr);
+
+	if (status == 0)
+		store_entry(dir, key, argv, &args, errors);
+
+	unlink(errors);
+
+	return status;
+}
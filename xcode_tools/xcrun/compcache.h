@@ -0,0 +1,63 @@
+/* compcache.h - compile and link result cache for the tools run through xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __COMPCACHE_H__
+#define __COMPCACHE_H__
+
+#include "libxcrun.h"
+
+/* Environment variable naming the compile cache directory, the compile cache is off unless it is set */
+#define COMPCACHE_DIR_ENV "XCRUN_COMPILE_CACHE"
+
+/* Environment variable naming the link cache directory, the link cache is off unless it is set */
+#define COMPCACHE_LINK_DIR_ENV "XCRUN_LINK_CACHE"
+
+/* Compiler drivers whose results are cached */
+#define COMPCACHE_TOOLS "cc c++ clang clang++ gcc g++"
+
+/* Linkers whose results are cached */
+#define COMPCACHE_LINK_TOOLS "ld"
+
+/* Version tag mixed into every key, bump it whenever the key or the stored files change */
+#define COMPCACHE_MAGIC "xcrun-compile-cache 1"
+
+/**
+ * @func compcache_run -- run a compile or a link through the compile or link cache
+ * @arg name    - name of the tool
+ * @arg tool    - resolved tool
+ * @arg envp    - environment the tool runs with (see xcrun_build_env)
+ * @arg argv    - arguments the tool runs with (see xcrun_build_argv)
+ * @arg logging - show what the cache is doing
+ * @return: exit status of the tool, or -1 if the step can't be cached (and nothing was run)
+ */
+int compcache_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[], int logging);
+
+#endif /* __COMPCACHE_H__ */
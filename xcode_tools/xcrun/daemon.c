@@ -0,0 +1,549 @@
+/* daemon.c - xcrund, the xcrun resolution daemon
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * xcrund answers resolution requests from xcrun clients over a UNIX socket. A client connects,
+ * writes a single request line and reads back a single reply line, either "OK" followed by a tab
+ * and the resolved entry (in the format of the lookup cache), or "NO" when the client should
+ * resolve the tool itself. The connection is closed after every request.
+ *
+ * Clients execute whatever path a reply names, so the socket lives in a directory only its user can
+ * get into, under $XDG_RUNTIME_DIR or $TMPDIR. Both ends still check that the other one runs as the
+ * same user before trusting anything it says.
+ *
+ * Replies are kept in memory, keyed by the request line. Requests the daemon hasn't seen yet are
+ * resolved in-process, sharing whatever configuration the daemon has already loaded. On Linux,
+ * everything is thrown away as soon as inotify reports a change in the developer folder or one of
+ * the configuration files. Elsewhere, the stamps of an entry are checked before it is handed out.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE	/* struct ucred */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "cache.h"
+#include "daemon.h"
+#include "util.h"
+
+/* Longest reply a resolution may produce */
+#define XCRUND_MAX_REPLY (XCRUN_CACHE_MAX_KEY + PATH_MAX * (XCRUN_CACHE_MAX_STAMPS + 8))
+
+/* A request the daemon has already answered */
+typedef struct {
+	char *request;
+	char *reply;
+} daemon_entry;
+
+static daemon_entry *entries;
+static int nentries;
+
+/* helper function to write a whole buffer to a file descriptor */
+static int write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(fd, buf, len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* helper function to read a file descriptor up to end of file into a nul terminated buffer */
+static char *read_all(int fd, size_t max)
+{
+	ssize_t n;
+	size_t len = 0, size = 4096;
+	char *buf, *tmp;
+
+	if ((buf = (char *)malloc(size)) == NULL)
+		return NULL;
+
+	for (;;) {
+		if (len + 1 == size) {
+			if (size > max || (tmp = (char *)realloc(buf, size * 2)) == NULL)
+				break;
+			buf = tmp;
+			size *= 2;
+		}
+		if ((n = read(fd, buf + len, size - len - 1)) == 0) {
+			buf[len] = '\0';
+			return buf;
+		}
+		if (n == -1 && errno != EINTR)
+			break;
+		if (n > 0)
+			len += n;
+	}
+
+	free(buf);
+
+	return NULL;
+}
+
+/* helper function to bound how long a socket may block us */
+static void set_timeout(int fd)
+{
+	struct timeval tv;
+
+	tv.tv_sec = XCRUND_TIMEOUT_MS / 1000;
+	tv.tv_usec = (XCRUND_TIMEOUT_MS % 1000) * 1000;
+
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/* helper function to fill in the address of the daemon's socket */
+static int get_socket_address(struct sockaddr_un *addr, int create)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+
+	return daemon_socket_path(addr->sun_path, sizeof(addr->sun_path), create);
+}
+
+/* helper function to tell whether the other end of a connection runs as our user */
+static bool peer_is_us(int fd)
+{
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	return (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid());
+#else
+	uid_t uid;
+	gid_t gid;
+
+	return (getpeereid(fd, &uid, &gid) == 0 && uid == getuid());
+#endif
+}
+
+/* helper function to connect to the daemon's socket */
+static int connect_socket(const struct sockaddr_un *addr)
+{
+	int fd;
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		return -1;
+
+	set_timeout(fd);
+
+	if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* See documentation in header file. */
+int daemon_socket_path(char *buf, size_t size, int create)
+{
+	int len;
+	char *path;
+	char dir[PATH_MAX];
+
+	if ((path = getenv(XCRUND_SOCKET_ENV)) != NULL)
+		len = snprintf(buf, size, "%s", path);
+	else if (private_dir(dir, sizeof(dir), getenv("XDG_RUNTIME_DIR"), XCRUND_SOCKET_DIR, create) == 0)
+		len = snprintf(buf, size, "%s/socket", dir);
+	else
+		return -1;
+
+	return ((len > 0 && (size_t)len < size) ? 0 : -1);
+}
+
+/* See documentation in header file. */
+char *daemon_request(const char *request)
+{
+	int fd;
+	char *reply;
+	struct stat st;
+	struct sockaddr_un addr;
+
+	/* A socket somebody else left for us, let alone a daemon of theirs, must never be asked anything. */
+	if (get_socket_address(&addr, 0) != 0 || lstat(addr.sun_path, &st) != 0 || !S_ISSOCK(st.st_mode) || st.st_uid != getuid())
+		return NULL;
+
+	if ((fd = connect_socket(&addr)) == -1)
+		return NULL;
+
+	if (!peer_is_us(fd)) {
+		close(fd);
+		return NULL;
+	}
+
+	if (write_all(fd, request, strlen(request)) != 0 || write_all(fd, "\n", 1) != 0 || shutdown(fd, SHUT_WR) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	reply = read_all(fd, XCRUND_MAX_REPLY);
+	close(fd);
+
+	if (reply == NULL)
+		return NULL;
+
+	if (strncmp(reply, "OK\t", 3) != 0 || strchr(reply, '\n') == NULL) {
+		free(reply);
+		return NULL;
+	}
+
+	*strchr(reply, '\n') = '\0';
+	memmove(reply, reply + 3, strlen(reply + 3) + 1);
+
+	return reply;
+}
+
+/* helper function to forget every answered request */
+static void flush_entries(void)
+{
+	int i;
+
+	for (i = 0; i < nentries; i++) {
+		free(entries[i].request);
+		free(entries[i].reply);
+	}
+
+	free(entries);
+	entries = NULL;
+	nentries = 0;
+}
+
+/* helper function to find the entry of a request */
+static daemon_entry *find_entry(const char *request)
+{
+	int i;
+
+	for (i = 0; i < nentries; i++) {
+		if (strcmp(entries[i].request, request) == 0)
+			return &entries[i];
+	}
+
+	return NULL;
+}
+
+/* helper function to remember the reply to a request (takes ownership of reply) */
+static const char *add_entry(const char *request, char *reply)
+{
+	daemon_entry *tmp;
+
+	if (nentries >= XCRUND_MAX_ENTRIES)
+		flush_entries();
+
+	if ((tmp = (daemon_entry *)realloc(entries, (nentries + 1) * sizeof(daemon_entry))) == NULL)
+		return reply;
+
+	entries = tmp;
+	entries[nentries].request = strdup(request);
+	entries[nentries].reply = reply;
+
+	return entries[nentries++].reply;
+}
+
+/* helper function to drop everything the daemon knows after a change */
+static void invalidate(const daemon_ops *ops)
+{
+	flush_entries();
+	ops->unload();
+	ops->load();
+}
+
+#ifdef __linux__
+/* helper function to watch a directory and, optionally, the usr/bin folder beneath it */
+static void watch_dir(int ifd, const char *dir, const char *sub)
+{
+	char path[PATH_MAX];
+	const uint32_t mask = (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+
+	if (sub != NULL) {
+		if (snprintf(path, sizeof(path), "%s/%s", dir, sub) >= (int)sizeof(path))
+			return;
+		dir = path;
+	}
+
+	inotify_add_watch(ifd, dir, mask);
+}
+
+/* helper function to watch every bundle (SDK or Toolchain) of a developer folder */
+static void watch_bundles(int ifd, const char *developer_dir, const char *folder)
+{
+	DIR *dp;
+	struct dirent *ent;
+	char path[PATH_MAX], bundle[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s", developer_dir, folder) >= (int)sizeof(path))
+		return;
+
+	watch_dir(ifd, path, NULL);
+
+	if ((dp = opendir(path)) == NULL)
+		return;
+
+	while ((ent = readdir(dp)) != NULL) {
+		if (*ent->d_name == '.' || snprintf(bundle, sizeof(bundle), "%s/%s", path, ent->d_name) >= (int)sizeof(bundle))
+			continue;
+		watch_dir(ifd, bundle, NULL);
+		watch_dir(ifd, bundle, "usr/bin");
+	}
+
+	closedir(dp);
+}
+
+/* helper function to set up inotify on everything a resolution may depend on */
+static int open_watches(const daemon_ops *ops)
+{
+	int ifd;
+	const char **file;
+
+	if ((ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+		return -1;
+
+	watch_dir(ifd, ops->developer_dir, NULL);
+	watch_dir(ifd, ops->developer_dir, "usr/bin");
+	watch_bundles(ifd, ops->developer_dir, "SDKs");
+	watch_bundles(ifd, ops->developer_dir, "Toolchains");
+
+	for (file = ops->config_files; file != NULL && *file != NULL; file++)
+		watch_dir(ifd, *file, NULL);
+
+	return ifd;
+}
+
+/* helper function to drain pending inotify events */
+static void drain_watches(int ifd)
+{
+	char buf[4096];
+
+	while (read(ifd, buf, sizeof(buf)) > 0)
+		;
+}
+#endif
+
+/* helper function to test whether a reply still matches the file system */
+static int reply_is_current(const char *reply)
+{
+#ifdef __linux__
+	/* inotify already took care of it. */
+	(void)reply;
+	return 1;
+#else
+	int status;
+	char *line;
+	cache_entry *entry;
+
+	if ((line = strdup(reply)) == NULL || (entry = (cache_entry *)malloc(sizeof(cache_entry))) == NULL) {
+		free(line);
+		return 0;
+	}
+
+	status = (cache_parse_entry(line, entry) == 0 && cache_entry_is_current(entry));
+
+	free(entry);
+	free(line);
+
+	return status;
+#endif
+}
+
+/* helper function to answer a single client */
+static void serve_client(const daemon_ops *ops, int fd)
+{
+	char *request, *end, *reply;
+	char *copy = NULL;
+	const char *answer = NULL;
+	daemon_entry *entry;
+
+	set_timeout(fd);
+
+	if ((request = read_all(fd, XCRUND_MAX_REQUEST)) == NULL)
+		return;
+
+	if ((end = strchr(request, '\n')) != NULL && end[1] == '\0' && strncmp(request, XCRUND_PROTOCOL "\t", strlen(XCRUND_PROTOCOL) + 1) == 0) {
+		*end = '\0';
+
+		if ((entry = find_entry(request)) != NULL && !reply_is_current(entry->reply)) {
+			invalidate(ops);
+			entry = NULL;
+		}
+
+		if (entry != NULL)
+			answer = entry->reply;
+		else if ((copy = strdup(request)) != NULL && (reply = ops->resolve(copy)) != NULL)
+			answer = add_entry(request, reply);
+
+		free(copy);
+	}
+
+	if (answer != NULL) {
+		write_all(fd, "OK\t", 3);
+		write_all(fd, answer, strlen(answer));
+		write_all(fd, "\n", 1);
+	} else {
+		write_all(fd, "NO\n", 3);
+	}
+
+	free(request);
+}
+
+/* helper function to bind the daemon's socket, replacing a stale one */
+static int open_socket(void)
+{
+	int fd, other, status;
+	mode_t mask;
+	struct sockaddr_un addr;
+
+	if (get_socket_address(&addr, 1) != 0) {
+		fprintf(stderr, "xcrund: error: no private directory to put the socket in, or its path is too long.\n");
+		return -1;
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		fprintf(stderr, "xcrund: error: failed to create socket. (%s)\n", strerror(errno));
+		return -1;
+	}
+
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	/* Only our own user may talk to us. */
+	mask = umask(077);
+
+	if ((status = bind(fd, (struct sockaddr *)&addr, sizeof(addr))) != 0 && errno == EADDRINUSE) {
+		if ((other = connect_socket(&addr)) != -1) {
+			close(other);
+			umask(mask);
+			close(fd);
+			fprintf(stderr, "xcrund: error: another daemon is already listening on \'%s\'.\n", addr.sun_path);
+			return -1;
+		}
+		unlink(addr.sun_path);
+		status = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	}
+
+	umask(mask);
+
+	if (status != 0 || listen(fd, SOMAXCONN) != 0) {
+		fprintf(stderr, "xcrund: error: failed to listen on \'%s\'. (%s)\n", addr.sun_path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* See documentation in header file. */
+int daemon_serve(const daemon_ops *ops)
+{
+	int lfd, cfd;
+	int ifd = -1;
+	struct pollfd fds[2];
+
+	/* Clients may hang up on us at any time. */
+	signal(SIGPIPE, SIG_IGN);
+
+	if ((lfd = open_socket()) == -1)
+		return -1;
+
+	ops->load();
+
+#ifdef __linux__
+	if ((ifd = open_watches(ops)) == -1) {
+		fprintf(stderr, "xcrund: error: failed to set up inotify. (%s)\n", strerror(errno));
+		close(lfd);
+		return -1;
+	}
+#endif
+
+	for (;;) {
+		fds[0].fd = lfd;
+		fds[0].events = POLLIN;
+		fds[1].fd = ifd;
+		fds[1].events = POLLIN;
+
+		if (poll(fds, (ifd != -1 ? 2 : 1), -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "xcrund: error: poll failed. (%s)\n", strerror(errno));
+			break;
+		}
+
+#ifdef __linux__
+		/* Something changed: start over, and pick up any SDK or Toolchain that appeared. */
+		if (fds[1].revents & POLLIN) {
+			drain_watches(ifd);
+			close(ifd);
+			invalidate(ops);
+			if ((ifd = open_watches(ops)) == -1) {
+				fprintf(stderr, "xcrund: error: failed to set up inotify. (%s)\n", strerror(errno));
+				break;
+			}
+		}
+#endif
+
+		if (fds[0].revents & POLLIN) {
+			if ((cfd = accept(lfd, NULL, NULL)) == -1)
+				continue;
+			if (peer_is_us(cfd))
+				serve_client(ops, cfd);
+			close(cfd);
+		}
+	}
+
+	close(lfd);
+
+	return -1;
+}
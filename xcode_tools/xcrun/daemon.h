@@ -0,0 +1,88 @@
+/* daemon.h - xcrund, the xcrun resolution daemon
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DAEMON_H__
+#define __DAEMON_H__
+
+#include <stddef.h>
+#include <limits.h>
+
+/* Environment variable naming the daemon's socket */
+#define XCRUND_SOCKET_ENV "XCRUND_SOCKET"
+
+/* Private directory holding the socket, under $XDG_RUNTIME_DIR or $TMPDIR, the user id is appended */
+#define XCRUND_SOCKET_DIR "xcrund"
+
+/* Version tag starting every request line */
+#define XCRUND_PROTOCOL "xcrund 2"
+
+/* Longest request line accepted by the daemon */
+#define XCRUND_MAX_REQUEST (PATH_MAX * 8)
+
+/* Resolved requests kept in memory before the table is flushed */
+#define XCRUND_MAX_ENTRIES 4096
+
+/* How long a client waits on the daemon before falling back to resolving in-process */
+#define XCRUND_TIMEOUT_MS 1000
+
+/* Hooks used by the daemon to resolve requests it hasn't seen yet */
+typedef struct {
+	const char *developer_dir;			/* developer folder watched for changes */
+	const char **config_files;			/* extra files watched for changes, NULL terminated */
+	void (*load)(void);				/* load the state used by resolve() ahead of the first request */
+	void (*unload)(void);				/* drop that state once something has changed */
+	char *(*resolve)(char *request);		/* resolve a request (modified) into a newly allocated reply (see cache_format_entry) */
+} daemon_ops;
+
+/**
+ * @func daemon_socket_path -- build the path of the daemon's socket
+ * @arg buf    - buffer to hold the path
+ * @arg size   - size of buffer
+ * @arg create - create the private directory holding the socket if it is missing
+ * @return: 0 on success, -1 if the directory is missing or not private, or the path doesn't fit
+ */
+int daemon_socket_path(char *buf, size_t size, int create);
+
+/**
+ * @func daemon_request -- ask a running daemon to resolve a request
+ * @arg request - request line, without terminator
+ * @return: newly allocated reply (see cache_format_entry), or NULL if there is no daemon or it can't answer
+ */
+char *daemon_request(const char *request);
+
+/**
+ * @func daemon_serve -- answer requests until killed
+ * @arg ops - resolution hooks
+ * @return: -1 on failure, otherwise no return
+ */
+int daemon_serve(const daemon_ops *ops);
+
+#endif /* __DAEMON_H__ */
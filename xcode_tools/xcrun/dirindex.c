@@ -0,0 +1,208 @@
+/* dirindex.c - in-memory index of the search directories of xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Finding a tool takes an access() call for every search directory until one of them holds it,
+ * which mostly means paying for misses in the developer folder's usr/bin. Contexts resolving more
+ * than one tool (batches, library users and the daemon) read each search directory once instead,
+ * into a sorted table of names fronted by a bloom filter, and probe it in memory from then on. A
+ * single lookup would pay more for reading the directory than it saves, so it never gets an index.
+ * An index is tied to the stamp (inode and modification time) of its directory, which resolving a
+ * tool records anyway, so adding or removing a tool rebuilds it on the next lookup without costing
+ * a system call of its own. Indexes live as long as their context.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "dirindex.h"
+#include "hash.h"
+
+/* helper function to hash a name for the bloom filter */
+static unsigned long long hash_name(const char *name)
+{
+	xcrun_hash hash;
+	unsigned char key[HASH_SIZE];
+	unsigned long long value;
+
+	hash_init(&hash);
+	hash_update(&hash, name, strlen(name));
+	hash_digest(&hash, key);
+	memcpy(&value, key, sizeof(value));
+
+	return value;
+}
+
+/* helper function to set, or test, the two bits of a name in a bloom filter */
+static int bloom_bits(unsigned long long *bloom, const char *name, int set)
+{
+	unsigned long long hash = hash_name(name);
+	unsigned int bits = (DIRINDEX_BLOOM_WORDS * 64);
+	unsigned int a = (unsigned int)(hash % bits);
+	unsigned int b = (unsigned int)((hash >> 32) % bits);
+
+	if (set) {
+		bloom[a / 64] |= (1ULL << (a % 64));
+		bloom[b / 64] |= (1ULL << (b % 64));
+		return 1;
+	}
+
+	return ((bloom[a / 64] & (1ULL << (a % 64))) != 0 && (bloom[b / 64] & (1ULL << (b % 64))) != 0);
+}
+
+/* helper function to compare two names for qsort and bsearch */
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* helper function to drop the names of an index */
+static void free_index(dir_index *index)
+{
+	int i;
+
+	for (i = 0; i < index->count; i++)
+		free(index->names[i]);
+	free(index->names);
+
+	index->names = NULL;
+	index->count = 0;
+}
+
+/**
+ * @func build_index -- Read the names of a directory into an index.
+ * @arg index - index to fill in, empty
+ * @arg stamp - stamp of the directory
+ * @return: 0 on success, -1 on failure
+ */
+static int build_index(dir_index *index, const cache_stamp *stamp)
+{
+	int size = 0;
+	char **names;
+	DIR *dir;
+	struct dirent *ent;
+
+	if ((dir = opendir(stamp->path)) == NULL)
+		return -1;
+
+	memset(index->bloom, 0, sizeof(index->bloom));
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+			continue;
+
+		if (index->count == size) {
+			size = (size * 2) + 64;
+			if ((names = (char **)realloc(index->names, size * sizeof(char *))) == NULL)
+				goto failure;
+			index->names = names;
+		}
+
+		if ((index->names[index->count] = strdup(ent->d_name)) == NULL)
+			goto failure;
+
+		bloom_bits(index->bloom, index->names[index->count++], 1);
+	}
+
+	closedir(dir);
+
+	if (index->count > 0)
+		qsort(index->names, index->count, sizeof(char *), compare_names);
+
+	index->stamp = *stamp;
+
+	return 0;
+
+failure:
+	closedir(dir);
+	free_index(index);
+
+	return -1;
+}
+
+/* See documentation in header file. */
+int dirindex_lookup(dir_index_set *set, const cache_stamp *stamp, const char *name)
+{
+	int i;
+	dir_index *index = NULL;
+
+	/* A directory that doesn't exist holds nothing. */
+	if (stamp->ino == 0 && stamp->sec == 0 && stamp->nsec == 0)
+		return 0;
+
+	for (i = 0; i < set->count && index == NULL; i++) {
+		if (strcmp(set->indexes[i].stamp.path, stamp->path) == 0)
+			index = &set->indexes[i];
+	}
+
+	/* Make room for a new index, dropping the one used least recently. */
+	if (index == NULL && set->count < DIRINDEX_MAX_DIRS) {
+		index = &set->indexes[set->count++];
+		memset(index, 0, sizeof(*index));
+	} else if (index == NULL) {
+		index = &set->indexes[0];
+		for (i = 1; i < set->count; i++) {
+			if (set->indexes[i].last_used < index->last_used)
+				index = &set->indexes[i];
+		}
+		free_index(index);
+		memset(index, 0, sizeof(*index));
+	}
+
+	/* The directory changed since it was read, read it again. */
+	if (index->stamp.ino != stamp->ino || index->stamp.sec != stamp->sec || index->stamp.nsec != stamp->nsec ||
+	    strcmp(index->stamp.path, stamp->path) != 0) {
+		free_index(index);
+		memset(&index->stamp, 0, sizeof(index->stamp));
+		if (build_index(index, stamp) != 0)
+			return -1;
+	}
+
+	index->last_used = ++set->clock;
+
+	if (!bloom_bits(index->bloom, name, 0))
+		return 0;
+
+	return (bsearch(&name, index->names, index->count, sizeof(char *), compare_names) != NULL);
+}
+
+/* See documentation in header file. */
+void dirindex_free(dir_index_set *set)
+{
+	int i;
+
+	for (i = 0; i < set->count; i++)
+		free_index(&set->indexes[i]);
+
+	set->count = 0;
+}
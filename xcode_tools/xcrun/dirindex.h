@@ -0,0 +1,74 @@
+/* dirindex.h - in-memory index of the search directories of xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DIRINDEX_H__
+#define __DIRINDEX_H__
+
+#include "cache.h"
+
+/* Most directories indexed at once, the oldest index is dropped to make room for another */
+#define DIRINDEX_MAX_DIRS 16
+
+/* Size of the bloom filter of an index, in 64 bit words */
+#define DIRINDEX_BLOOM_WORDS 4
+
+/* Names found in a directory, valid as long as the directory keeps its stamp */
+typedef struct {
+	cache_stamp stamp;
+	unsigned long long bloom[DIRINDEX_BLOOM_WORDS];
+	char **names;
+	int count;
+	unsigned long long last_used;
+} dir_index;
+
+/* The directories indexed by a context */
+typedef struct {
+	dir_index indexes[DIRINDEX_MAX_DIRS];
+	int count;
+	unsigned long long clock;
+} dir_index_set;
+
+/**
+ * @func dirindex_lookup -- test whether a directory holds an entry of a given name
+ * @arg set   - indexes to look in (and update)
+ * @arg stamp - current stamp of the directory (see cache_add_stamp)
+ * @arg name  - name to look for
+ * @return: 1 if the directory holds name, 0 if it doesn't, -1 if the directory can't be indexed
+ */
+int dirindex_lookup(dir_index_set *set, const cache_stamp *stamp, const char *name);
+
+/**
+ * @func dirindex_free -- drop every index of a set
+ * @arg set - indexes to drop
+ */
+void dirindex_free(dir_index_set *set);
+
+#endif /* __DIRINDEX_H__ */
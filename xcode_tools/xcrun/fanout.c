@@ -0,0 +1,441 @@
+/* fanout.c - build every architecture slice of a compile or link step in parallel
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A fat compile or link step is split into one process per architecture. Every slice runs the
+ * same tool with the same arguments, except that it builds for its own target triple (-target,
+ * or -arch for ld) and writes its output next to the requested one, as <output>.xcrun-<arch>.
+ * The slices run in parallel, and once all of them have succeeded, the toolchain's lipo merges
+ * them into the requested output.
+ *
+ * Only steps writing a single output file (-o) are split up. Steps that pick an architecture
+ * themselves, or produce something lipo can't merge (preprocessed source, assembly, dependency
+ * lists), run once, as they always have. A dependency file named with -MF is written by the first
+ * slice only, with the requested output as its target, the others write theirs next to it, where
+ * it is thrown away.
+ *
+ * A tool with an [ADMISSION] section waits for its turn once, for all of its slices at once, each
+ * of them counting as an instance of the tool, and keeps its place until lipo is done. The most
+ * memory a slice needed is what the tool is remembered to need.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "admission.h"
+#include "fanout.h"
+#include "util.h"
+
+/* A single architecture slice of the step */
+typedef struct {
+	const char *arch;
+	char output[PATH_MAX];
+	char depfile[PATH_MAX];		/* scratch dependency file, empty if the slice doesn't write one */
+	pid_t pid;
+} fanout_slice;
+
+/* Everything a split step needs, on the heap so that unsplit steps don't pay for it in stack */
+typedef struct {
+	char list[PATH_MAX];
+	const char *arch_list[FANOUT_MAX_ARCHS];
+	fanout_slice slices[FANOUT_MAX_ARCHS];
+	xcrun_tool tool;
+	xcrun_tool lipo;
+} fanout_job;
+
+/**
+ * @func split_archs -- Split a list of architectures.
+ * @arg list  - architectures separated by white space or commas (modified)
+ * @arg archs - set to the architectures found
+ * @arg max   - size of archs
+ * @return: number of architectures found, or -1 if there are more than max
+ */
+static int split_archs(char *list, const char *archs[], int max)
+{
+	int n = 0;
+	char *arch, *save;
+
+	for (arch = strtok_r(list, " \t,", &save); arch != NULL; arch = strtok_r(NULL, " \t,", &save)) {
+		if (n == max)
+			return -1;
+		archs[n++] = arch;
+	}
+
+	return n;
+}
+
+/**
+ * @func find_value -- Check whether an argument is a given option, with its value either attached or following it.
+ * @arg argc   - number of arguments
+ * @arg argv   - arguments
+ * @arg i      - index of the argument to check, moved onto the value if it follows
+ * @arg option - option to look for
+ * @return: true if the argument is the option and has a value
+ */
+static bool find_value(int argc, char *argv[], int *i, const char *option)
+{
+	size_t len = strlen(option);
+
+	if (strcmp(argv[*i], option) == 0 && *i + 1 < argc) {
+		++*i;
+		return true;
+	}
+
+	return (strncmp(argv[*i], option, len) == 0 && argv[*i][len] != '\0');
+}
+
+/**
+ * @func can_split -- Check whether a step can be split up per architecture, and find what it writes.
+ * @arg argc    - number of arguments
+ * @arg argv    - arguments
+ * @arg output  - set to the index of the argument naming the output
+ * @arg depfile - set to the index of the argument naming the dependency file, or -1
+ * @return: true if the step can be split up
+ */
+static bool can_split(int argc, char *argv[], int *output, int *depfile)
+{
+	int i;
+	bool depends = false;
+
+	*output = *depfile = -1;
+
+	for (i = 1; i < argc; i++) {
+		if (find_value(argc, argv, &i, "-o"))
+			*output = i;
+		else if (find_value(argc, argv, &i, "-MF"))
+			*depfile = i;
+		else if (strcmp(argv[i], "-MD") == 0 || strcmp(argv[i], "-MMD") == 0)
+			depends = true;
+		else if (strcmp(argv[i], "-E") == 0 || strcmp(argv[i], "-S") == 0 || strcmp(argv[i], "-M") == 0 || strcmp(argv[i], "-MM") == 0 ||
+		    strcmp(argv[i], "-arch") == 0 || strcmp(argv[i], "-target") == 0 || strncmp(argv[i], "--target=", 9) == 0)
+			return false;
+	}
+
+	/* Without -MF, every slice would name its dependency file after its own output. */
+	return (*output != -1 && (!depends || *depfile != -1));
+}
+
+/* helper function to tell whether the value found by find_value is attached to its option */
+static bool value_is_attached(char *argv[], int i, const char *option)
+{
+	return (strcmp(argv[i - 1], option) != 0);
+}
+
+/* helper function to return the value found by find_value */
+static const char *option_value(char *argv[], int i, const char *option)
+{
+	return (value_is_attached(argv, i, option) ? argv[i] + strlen(option) : argv[i]);
+}
+
+/**
+ * @func replace_value -- Build an argument with the value found by find_value replaced.
+ * @arg argv   - arguments
+ * @arg i      - index of the value
+ * @arg option - option the value belongs to
+ * @arg value  - new value
+ * @return: newly allocated argument, NULL if out of memory
+ */
+static char *replace_value(char *argv[], int i, const char *option, const char *value)
+{
+	char *arg;
+	const char *prefix = (value_is_attached(argv, i, option) ? option : "");
+
+	if ((arg = (char *)malloc(strlen(prefix) + strlen(value) + 1)) != NULL)
+		sprintf(arg, "%s%s", prefix, value);
+
+	return arg;
+}
+
+/**
+ * @func log_command -- Show a command about to be executed.
+ * @arg path - binary to execute
+ * @arg argv - arguments passed along
+ */
+static void log_command(const char *path, char *const argv[])
+{
+	int i;
+
+	fprintf(stdout, "xcrun: info: invoking command:\n\t\"%s", path);
+	for (i = 1; argv[i] != NULL; i++)
+		fprintf(stdout, " %s", argv[i]);
+	fprintf(stdout, "\"\n");
+}
+
+/**
+ * @func spawn -- Start a resolved tool in the background.
+ * @arg ctx     - context the tool was resolved against
+ * @arg tool    - tool to run
+ * @arg argc    - number of arguments
+ * @arg argv    - arguments, argv[0] being the name the tool was called by
+ * @arg logging - show the command before it is started
+ * @return: process id, or -1 on failure (reported)
+ */
+static pid_t spawn(xcrun_ctx *ctx, const xcrun_tool *tool, int argc, char *argv[], int logging)
+{
+	pid_t pid = -1;
+	char **envp, **new_argv = NULL;
+
+	if ((envp = xcrun_build_env(ctx, tool)) == NULL || (new_argv = xcrun_build_argv(ctx, tool, argc, argv)) == NULL) {
+		fprintf(stderr, "xcrun: error: %s\n", xcrun_error(ctx));
+		goto out;
+	}
+
+	if (logging)
+		log_command(tool->path, new_argv);
+
+	/* Don't hand buffered output down to the tool. */
+	fflush(stdout);
+	fflush(stderr);
+
+	if ((pid = fork()) == -1) {
+		fprintf(stderr, "xcrun: error: failed to fork. (%s)\n", strerror(errno));
+	} else if (pid == 0) {
+		execve(tool->path, new_argv, envp);
+		fprintf(stderr, "xcrun: error: can't exec \'%s\' (%s)\n", tool->path, strerror(errno));
+		_exit(127);
+	}
+
+out:
+	xcrun_free_vector(envp);
+	xcrun_free_vector(new_argv);
+
+	return pid;
+}
+
+/**
+ * @func wait_slice -- Wait for a slice to finish.
+ * @arg pid    - process id of the slice
+ * @arg maxrss - raised to the peak resident set size of the slice, in kilobytes
+ * @return: exit status of the slice, 128 + the signal number if it was killed
+ */
+static int wait_slice(pid_t pid, unsigned long *maxrss)
+{
+	int status;
+	unsigned long kb;
+	struct rusage usage;
+
+	while (wait4(pid, &status, 0, &usage) == -1) {
+		if (errno != EINTR)
+			return 1;
+	}
+
+	kb = (unsigned long)usage.ru_maxrss;
+#ifdef __APPLE__
+	kb /= 1024;
+#endif
+	if (kb > *maxrss)
+		*maxrss = kb;
+
+	if (WIFSIGNALED(status))
+		return (128 + WTERMSIG(status));
+
+	return WEXITSTATUS(status);
+}
+
+/**
+ * @func start_slice -- Start the slice of a step that builds one architecture.
+ * @arg ctx      - context the tool was resolved against
+ * @arg resolved - tool the step runs
+ * @arg name     - name of the tool
+ * @arg slice    - slice to start, with its arch set
+ * @arg first    - set for the slice that writes the real dependency file
+ * @arg argc     - number of arguments
+ * @arg argv     - arguments of the step
+ * @arg output   - index of the argument naming the output
+ * @arg depfile  - index of the argument naming the dependency file, or -1
+ * @arg logging  - show the command before it is started
+ * @return: 0 on success, -1 on failure (reported)
+ */
+static int start_slice(xcrun_ctx *ctx, const xcrun_tool *resolved, const char *name, fanout_slice *slice, bool first,
+		       int argc, char *argv[], int output, int depfile, int logging)
+{
+	int i, n = 0;
+	int status = -1;
+	bool named_target = false;
+	char **slice_argv;
+	xcrun_tool tool = *resolved;
+
+	if (xcrun_set_tool_arch(ctx, &tool, slice->arch) != 0) {
+		fprintf(stderr, "xcrun: error: %s\n", xcrun_error(ctx));
+		return -1;
+	}
+
+	snprintf(slice->output, sizeof(slice->output), "%s.xcrun-%s", option_value(argv, output, "-o"), slice->arch);
+
+	if ((slice_argv = (char **)calloc(argc + 5, sizeof(char *))) == NULL)
+		return -1;
+
+	slice_argv[n++] = strdup(argv[0]);
+
+	/* Profiles passing ${TARGET_TRIPLE} along pick up the slice's triple by themselves. */
+	if (!tool.profile || strstr(tool.args, "${TARGET_TRIPLE}") == NULL) {
+		slice_argv[n++] = strdup(strcmp(name, "ld") == 0 ? "-arch" : "-target");
+		slice_argv[n++] = strdup(strcmp(name, "ld") == 0 ? tool.arch : tool.target_triple);
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (i == output) {
+			slice_argv[n++] = replace_value(argv, i, "-o", slice->output);
+		} else if (i == depfile && !first) {
+			snprintf(slice->depfile, sizeof(slice->depfile), "%s.xcrun-%s", option_value(argv, i, "-MF"), slice->arch);
+			slice_argv[n++] = replace_value(argv, i, "-MF", slice->depfile);
+		} else {
+			if (strncmp(argv[i], "-MT", 3) == 0 || strncmp(argv[i], "-MQ", 3) == 0)
+				named_target = true;
+			slice_argv[n++] = strdup(argv[i]);
+		}
+	}
+
+	/* The real dependency file has to name the merged output, not the slice. */
+	if (first && depfile != -1 && !named_target) {
+		slice_argv[n++] = strdup("-MT");
+		slice_argv[n++] = strdup(option_value(argv, output, "-o"));
+	}
+
+	/* Check that we didn't run out of memory along the way. */
+	for (i = 0; i < n && slice_argv[i] != NULL; i++)
+		;
+
+	if (i == n && (slice->pid = spawn(ctx, &tool, n, slice_argv, logging)) != -1)
+		status = 0;
+
+	for (i = 0; i < n; i++)
+		free(slice_argv[i]);
+	free(slice_argv);
+
+	return status;
+}
+
+/* See documentation in header file. */
+int fanout_run(xcrun_ctx *ctx, const char *name, const char *archs, int argc, char *argv[], int logging)
+{
+	int i, n, narchs, output, depfile;
+	int status = 0;
+	int slice_status, admission = -1;
+	unsigned long maxrss = 0;
+	pid_t pid;
+	xcrun_limits limits;
+	char **lipo_argv;
+	fanout_job *job;
+	fanout_slice *slices;
+
+	if (argc < 2 || !name_in_list(name, FANOUT_TOOLS) || !can_split(argc, argv, &output, &depfile))
+		return -1;
+
+	/* Only now is the SDK's info.ini worth reading, most invocations never get this far. */
+	if (archs == NULL && (archs = xcrun_sdk_archs(ctx)) == NULL)
+		return -1;
+
+	if ((job = (fanout_job *)calloc(1, sizeof(fanout_job))) == NULL)
+		return -1;
+	slices = job->slices;
+
+	if (snprintf(job->list, sizeof(job->list), "%s", archs) >= (int)sizeof(job->list) ||
+	    (narchs = split_archs(job->list, job->arch_list, FANOUT_MAX_ARCHS)) < 2) {
+		free(job);
+		return -1;
+	}
+
+	if (xcrun_resolve_tool(ctx, name, &job->tool) != 0 || xcrun_resolve_tool(ctx, "lipo", &job->lipo) != 0) {
+		fprintf(stderr, "xcrun: error: %s\n", xcrun_error(ctx));
+		free(job);
+		return 1;
+	}
+
+	/* Heavy tools only start once there is room for every slice. */
+	switch (xcrun_tool_limits(ctx, name, &job->tool, &limits)) {
+		case -1:
+			fprintf(stderr, "xcrun: error: %s\n", xcrun_error(ctx));
+			free(job);
+			return 1;
+		case 1:
+			admission = admission_enter(name, narchs, &limits, logging);
+			break;
+	}
+
+	/* Start every slice, */
+	for (n = 0; n < narchs; n++) {
+		slices[n].arch = job->arch_list[n];
+		if (start_slice(ctx, &job->tool, name, &slices[n], (n == 0), argc, argv, output, depfile, logging) != 0) {
+			status = 1;
+			break;
+		}
+	}
+
+	/* wait for all of them, */
+	for (i = 0; i < n; i++) {
+		if ((slice_status = wait_slice(slices[i].pid, &maxrss)) != 0 && status == 0)
+			status = slice_status;
+	}
+
+	/* and merge them into the requested output. */
+	if (status == 0) {
+		if ((lipo_argv = (char **)calloc(narchs + 5, sizeof(char *))) == NULL) {
+			status = 1;
+		} else {
+			i = 0;
+			lipo_argv[i++] = "lipo";
+			lipo_argv[i++] = "-create";
+			for (n = 0; n < narchs; n++)
+				lipo_argv[i++] = slices[n].output;
+			lipo_argv[i++] = "-output";
+			lipo_argv[i++] = (char *)option_value(argv, output, "-o");
+
+			if ((pid = spawn(ctx, &job->lipo, i, lipo_argv, logging)) == -1)
+				status = 1;
+			else
+				status = wait_status(pid);
+			free(lipo_argv);
+		}
+	}
+
+	if (admission != -1)
+		admission_leave(admission, name, (status == 0 ? maxrss : 0));
+
+	for (i = 0; i < narchs; i++) {
+		if (*slices[i].output != '\0')
+			unlink(slices[i].output);
+		if (*slices[i].depfile != '\0')
+			unlink(slices[i].depfile);
+	}
+
+	free(job);
+
+	return status;
+}
@@ -0,0 +1,55 @@
+/* fanout.h - build every architecture slice of a compile or link step in parallel
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FANOUT_H__
+#define __FANOUT_H__
+
+#include "libxcrun.h"
+
+/* Compile and link drivers whose invocations are split up per architecture */
+#define FANOUT_TOOLS "cc c++ clang clang++ ld"
+
+/* Most architectures a single invocation is split into */
+#define FANOUT_MAX_ARCHS 16
+
+/**
+ * @func fanout_run -- run a compile or link step once per architecture, in parallel, then merge the slices with lipo
+ * @arg ctx     - resolution context
+ * @arg name    - name of the tool
+ * @arg archs   - architectures to build, separated by white space or commas, NULL for those of the SDK
+ * @arg argc    - number of arguments
+ * @arg argv    - arguments, argv[0] being the name the tool was called by
+ * @arg logging - show every command before it is started
+ * @return: exit status of the step, or -1 if it can't be split up (and nothing was run)
+ */
+int fanout_run(xcrun_ctx *ctx, const char *name, const char *archs, int argc, char *argv[], int logging);
+
+#endif /* __FANOUT_H__ */
@@ -0,0 +1,315 @@
+/* flight.c - coalesce identical tool invocations running at the same time
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * With XCRUN_SINGLE_FLIGHT set, identical invocations of a compile or link driver (same tool
+ * binary, arguments, working directory and environment) running at the same time are coalesced:
+ * the first one runs the tool, the others wait for it and reuse its exit status and output.
+ *
+ * Invocations meet through a lock file named after the hash of the invocation, in a private
+ * directory under $TMPDIR. The first one holds an exclusive flock() on it while the tool runs,
+ * then writes the exit status and the captured output into the file, unlinks it so that later
+ * invocations start a flight of their own, and lets go of the lock. The others wait for a shared
+ * lock on the same file and read the results from it. Should the first one die before writing
+ * any, they run the tool themselves.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+
+#include "flight.h"
+#include "hash.h"
+#include "trace.h"
+#include "util.h"
+
+/**
+ * @func compute_key -- Compute the key of an invocation.
+ * @arg key  - buffer of HASH_HEX_SIZE bytes to hold the key
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @arg argv - arguments the tool runs with
+ * @return: 0 on success, -1 on failure
+ */
+static int compute_key(char *key, const xcrun_tool *tool, char *const envp[], char *const argv[])
+{
+	int i;
+	char cwd[PATH_MAX];
+	struct stat st;
+	xcrun_hash hash;
+
+	if (stat(tool->path, &st) != 0 || getcwd(cwd, sizeof(cwd)) == NULL)
+		return -1;
+
+	hash_init(&hash);
+	hash_string(&hash, FLIGHT_MAGIC);
+	hash_string(&hash, tool->path);
+	hash_update(&hash, &st.st_ino, sizeof(st.st_ino));
+	hash_update(&hash, &st.st_mtime, sizeof(st.st_mtime));
+	hash_string(&hash, cwd);
+
+	for (i = 0; argv[i] != NULL; i++)
+		hash_string(&hash, argv[i]);
+
+	/* Separate the arguments from the environment. */
+	hash_update(&hash, "", 1);
+
+	/* Every traced invocation gets a parent span of its own, which would keep them all apart. */
+	for (i = 0; envp[i] != NULL; i++) {
+		if (strncmp(envp[i], TRACE_PARENT_ENV "=", sizeof(TRACE_PARENT_ENV)) != 0)
+			hash_string(&hash, envp[i]);
+	}
+
+	hash_hex(&hash, key);
+
+	return 0;
+}
+
+/**
+ * @func get_lock_path -- Build the path of the lock file of an invocation.
+ * @arg buf  - buffer to hold the path
+ * @arg size - size of buffer
+ * @arg key  - key of the invocation
+ * @return: 0 on success, -1 on failure
+ */
+static int get_lock_path(char *buf, size_t size, const char *key)
+{
+	char dir[PATH_MAX];
+
+	/* Nobody else gets to plant lock files on us. */
+	if (private_dir(dir, sizeof(dir), NULL, "xcrun-flight", 1) != 0)
+		return -1;
+
+	return (snprintf(buf, size, "%s/%s.lock", dir, key) < (int)size ? 0 : -1);
+}
+
+/**
+ * @func copy_stream -- Copy part of one stream to another.
+ * @arg from - stream to copy from
+ * @arg to   - stream to copy to
+ * @arg len  - number of bytes to copy, -1 for everything left
+ * @return: 0 on success, -1 on a short copy
+ */
+static int copy_stream(FILE *from, FILE *to, long len)
+{
+	char buf[BUFSIZ];
+	size_t n, chunk;
+
+	while (len != 0) {
+		chunk = ((len < 0 || len > (long)sizeof(buf)) ? sizeof(buf) : (size_t)len);
+		if ((n = fread(buf, 1, chunk, from)) == 0)
+			break;
+		if (fwrite(buf, 1, n, to) != n)
+			return -1;
+		if (len > 0)
+			len -= n;
+	}
+
+	fflush(to);
+
+	return (len > 0 ? -1 : 0);
+}
+
+/**
+ * @func read_results -- Reuse the results another invocation has left in the lock file.
+ * @arg fd - lock file
+ * @return: exit status of the tool, or -1 if there are no results
+ */
+static int read_results(int fd)
+{
+	int rfd, status;
+	long out_len, err_len;
+	char magic[32];
+	FILE *fp;
+
+	if ((rfd = dup(fd)) == -1)
+		return -1;
+
+	if ((fp = fdopen(rfd, "r")) == NULL) {
+		close(rfd);
+		return -1;
+	}
+
+	rewind(fp);
+
+	if (fscanf(fp, "%31[^\n]\n%d %ld %ld\n", magic, &status, &out_len, &err_len) != 4 || strcmp(magic, FLIGHT_MAGIC) != 0 ||
+	    copy_stream(fp, stdout, out_len) != 0 || copy_stream(fp, stderr, err_len) != 0)
+		status = -1;
+
+	fclose(fp);
+
+	return status;
+}
+
+/**
+ * @func lead -- Run the tool for every identical invocation, and hand the results over to them.
+ * @arg fd   - lock file, locked exclusively
+ * @arg path - path of the lock file
+ * @arg name - name of the tool
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @arg argv - arguments the tool runs with
+ * @arg run  - runs the tool
+ * @return: exit status of the tool, or -1 if it couldn't be started
+ */
+static int lead(int fd, const char *path, const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[], flight_runner run)
+{
+	int status;
+	long out_len, err_len;
+	pid_t pid;
+	FILE *out = NULL, *err = NULL, *results = NULL;
+
+	/* A crashed flight may have left half its results behind. */
+	if (ftruncate(fd, 0) != 0 || (out = tmpfile()) == NULL || (err = tmpfile()) == NULL || (results = fdopen(fd, "w+")) == NULL)
+		goto failure;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	if ((pid = fork()) == 0) {
+		dup2(fileno(out), STDOUT_FILENO);
+		dup2(fileno(err), STDERR_FILENO);
+		status = run(name, tool, envp, argv);
+		fflush(NULL);
+		_exit(status == -1 ? 127 : status);
+	}
+
+	if (pid == -1)
+		goto failure;
+
+	status = wait_status(pid);
+
+	fseek(out, 0, SEEK_END);
+	out_len = ftell(out);
+	fseek(err, 0, SEEK_END);
+	err_len = ftell(err);
+
+	/* Hand the results over, then make sure later invocations start over. */
+	fprintf(results, "%s\n%d %ld %ld\n", FLIGHT_MAGIC, status, out_len, err_len);
+	rewind(out);
+	rewind(err);
+	copy_stream(out, results, -1);
+	copy_stream(err, results, -1);
+	unlink(path);
+
+	/* Closing the lock file lets the others in. */
+	fclose(results);
+
+	rewind(out);
+	rewind(err);
+	copy_stream(out, stdout, -1);
+	copy_stream(err, stderr, -1);
+	fclose(out);
+	fclose(err);
+
+	return status;
+
+failure:
+	unlink(path);
+	if (results != NULL)
+		fclose(results);
+	else
+		close(fd);
+	if (out != NULL)
+		fclose(out);
+	if (err != NULL)
+		fclose(err);
+
+	return -1;
+}
+
+/* See documentation in header file. */
+int flight_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[], int logging, flight_runner run)
+{
+	int i, fd, status;
+	char key[HASH_HEX_SIZE];
+	char path[PATH_MAX];
+	struct stat st, path_st;
+
+	if (getenv(FLIGHT_ENV) == NULL || !name_in_list(name, FLIGHT_TOOLS))
+		return -1;
+
+	/* Tools reading stdin can't share a run. */
+	for (i = 1; argv[i] != NULL; i++) {
+		if (strcmp(argv[i], "-") == 0)
+			return -1;
+	}
+
+	if (compute_key(key, tool, envp, argv) != 0 || get_lock_path(path, sizeof(path), key) != 0)
+		return -1;
+
+	for (;;) {
+		if ((fd = open(path, (O_RDWR | O_CREAT | O_CLOEXEC), 0600)) == -1)
+			return -1;
+
+		if (flock(fd, (LOCK_EX | LOCK_NB)) == 0) {
+			/* The flight we locked may have landed (and its file been unlinked) since we opened it. */
+			if (fstat(fd, &st) != 0 || stat(path, &path_st) != 0 || st.st_ino != path_st.st_ino || st.st_dev != path_st.st_dev) {
+				close(fd);
+				continue;
+			}
+
+			if (logging)
+				fprintf(stdout, "xcrun: info: running \'%s\' on behalf of identical invocations (%s).\n", name, key);
+
+			return lead(fd, path, name, tool, envp, argv, run);
+		}
+
+		if (errno != EWOULDBLOCK) {
+			close(fd);
+			return -1;
+		}
+
+		if (logging)
+			fprintf(stdout, "xcrun: info: waiting for an identical invocation of \'%s\' (%s).\n", name, key);
+
+		while (flock(fd, LOCK_SH) == -1) {
+			if (errno != EINTR) {
+				close(fd);
+				return -1;
+			}
+		}
+
+		/* Without results, the first invocation died on us: run the tool ourselves. */
+		status = read_results(fd);
+		close(fd);
+
+		return status;
+	}
+}
@@ -0,0 +1,61 @@
+/* flight.h - coalesce identical tool invocations running at the same time
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FLIGHT_H__
+#define __FLIGHT_H__
+
+#include "libxcrun.h"
+
+/* Environment variable turning coalescing on */
+#define FLIGHT_ENV "XCRUN_SINGLE_FLIGHT"
+
+/* Compile and link drivers whose identical invocations are coalesced */
+#define FLIGHT_TOOLS "cc c++ clang clang++ gcc g++ ld"
+
+/* Version tag of the results handed from the first invocation to the others */
+#define FLIGHT_MAGIC "xcrun-flight 1"
+
+/* Runs a resolved tool in the calling process, returns its exit status or doesn't return at all (-1 on failure) */
+typedef int (*flight_runner)(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[]);
+
+/**
+ * @func flight_run -- run a tool, unless an identical invocation is already running, in which case its results are reused
+ * @arg name    - name of the tool
+ * @arg tool    - resolved tool
+ * @arg envp    - environment the tool runs with (see xcrun_build_env)
+ * @arg argv    - arguments the tool runs with (see xcrun_build_argv)
+ * @arg logging - show what is going on
+ * @arg run     - runs the tool
+ * @return: exit status of the tool, or -1 if the invocation can't be coalesced (and nothing was run)
+ */
+int flight_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[], int logging, flight_runner run);
+
+#endif /* __FLIGHT_H__ */
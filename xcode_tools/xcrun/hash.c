@@ -0,0 +1,203 @@
+/* hash.c - hashing used to key cached and coalesced tool runs
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Keys name the outputs of cached compiles and links, so two inputs that share a key would hand one
+ * of them the other's object file. They are BLAKE2b hashes, which unlike FNV-1a and its kin also
+ * hold up against inputs crafted to collide, cut down to 128 bits: a collision still takes on the
+ * order of 2^64 tries.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hash.h"
+
+/* Size of a block, in bytes */
+#define BLOCK_SIZE 128
+
+static const uint64_t blake2b_iv[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const unsigned char blake2b_sigma[12][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+	{ 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+	{ 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+	{ 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+	{ 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+	{ 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+	{ 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+	{ 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+	{ 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 }
+};
+
+/* helper function to rotate a word right */
+static inline uint64_t rotr64(uint64_t x, int n)
+{
+	return ((x >> n) | (x << (64 - n)));
+}
+
+/* helper function to read a little endian word */
+static inline uint64_t load64(const unsigned char *p)
+{
+	return ((uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+	        ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56));
+}
+
+#define G(a, b, c, d, x, y) do { \
+	v[a] = v[a] + v[b] + (x); v[d] = rotr64(v[d] ^ v[a], 32); \
+	v[c] = v[c] + v[d]; v[b] = rotr64(v[b] ^ v[c], 24); \
+	v[a] = v[a] + v[b] + (y); v[d] = rotr64(v[d] ^ v[a], 16); \
+	v[c] = v[c] + v[d]; v[b] = rotr64(v[b] ^ v[c], 63); \
+} while (0)
+
+/**
+ * @func compress -- Mix one block into the chain value.
+ * @arg hash  - key
+ * @arg block - block of BLOCK_SIZE bytes, already counted in hash->t
+ * @arg last  - whether this is the final block
+ */
+static void compress(xcrun_hash *hash, const unsigned char *block, int last)
+{
+	int i;
+	uint64_t m[16], v[16];
+	const unsigned char *s;
+
+	for (i = 0; i < 16; i++)
+		m[i] = load64(block + i * 8);
+
+	for (i = 0; i < 8; i++) {
+		v[i] = hash->h[i];
+		v[i + 8] = blake2b_iv[i];
+	}
+	v[12] ^= hash->t[0];
+	v[13] ^= hash->t[1];
+	if (last)
+		v[14] = ~v[14];
+
+	for (i = 0; i < 12; i++) {
+		s = blake2b_sigma[i];
+		G(0, 4, 8, 12, m[s[0]], m[s[1]]);
+		G(1, 5, 9, 13, m[s[2]], m[s[3]]);
+		G(2, 6, 10, 14, m[s[4]], m[s[5]]);
+		G(3, 7, 11, 15, m[s[6]], m[s[7]]);
+		G(0, 5, 10, 15, m[s[8]], m[s[9]]);
+		G(1, 6, 11, 12, m[s[10]], m[s[11]]);
+		G(2, 7, 8, 13, m[s[12]], m[s[13]]);
+		G(3, 4, 9, 14, m[s[14]], m[s[15]]);
+	}
+
+	for (i = 0; i < 8; i++)
+		hash->h[i] ^= v[i] ^ v[i + 8];
+}
+
+/* helper function to count bytes about to be compressed */
+static void add_count(xcrun_hash *hash, size_t len)
+{
+	hash->t[0] += len;
+	if (hash->t[0] < len)
+		hash->t[1]++;
+}
+
+/* See documentation in header file. */
+void hash_init(xcrun_hash *hash)
+{
+	memset(hash, 0, sizeof(*hash));
+	memcpy(hash->h, blake2b_iv, sizeof(hash->h));
+
+	/* Parameter block: digest length, no key, fanout and depth of 1. */
+	hash->h[0] ^= 0x01010000ULL | HASH_SIZE;
+}
+
+/* See documentation in header file. */
+void hash_update(xcrun_hash *hash, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	size_t n;
+
+	/* The last block is compressed differently, so a full buffer waits until more data comes. */
+	if (len > BLOCK_SIZE - hash->len) {
+		n = BLOCK_SIZE - hash->len;
+		memcpy(hash->buf + hash->len, p, n);
+		add_count(hash, BLOCK_SIZE);
+		compress(hash, hash->buf, 0);
+		hash->len = 0;
+		p += n;
+		len -= n;
+
+		while (len > BLOCK_SIZE) {
+			add_count(hash, BLOCK_SIZE);
+			compress(hash, p, 0);
+			p += BLOCK_SIZE;
+			len -= BLOCK_SIZE;
+		}
+	}
+
+	memcpy(hash->buf + hash->len, p, len);
+	hash->len += len;
+}
+
+/* See documentation in header file. */
+void hash_string(xcrun_hash *hash, const char *str)
+{
+	hash_update(hash, str, strlen(str) + 1);
+}
+
+/* See documentation in header file. */
+void hash_digest(const xcrun_hash *hash, unsigned char *out)
+{
+	int i;
+	xcrun_hash last = *hash;
+
+	memset(last.buf + last.len, 0, BLOCK_SIZE - last.len);
+	add_count(&last, last.len);
+	compress(&last, last.buf, 1);
+
+	for (i = 0; i < HASH_SIZE; i++)
+		out[i] = (unsigned char)(last.h[i / 8] >> (8 * (i % 8)));
+}
+
+/* See documentation in header file. */
+void hash_hex(const xcrun_hash *hash, char *buf)
+{
+	int i;
+	unsigned char digest[HASH_SIZE];
+
+	hash_digest(hash, digest);
+
+	for (i = 0; i < HASH_SIZE; i++)
+		snprintf(buf + i * 2, 3, "%02x", digest[i]);
+}
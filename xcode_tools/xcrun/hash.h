@@ -0,0 +1,87 @@
+/* hash.h - hashing used to key cached and coalesced tool runs
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of a key, in bytes */
+#define HASH_SIZE 16
+
+/* Size of a key printed with hash_hex, including the terminator */
+#define HASH_HEX_SIZE (HASH_SIZE * 2 + 1)
+
+/* Key being computed, a BLAKE2b hash truncated to 128 bits (RFC 7693) */
+typedef struct {
+	uint64_t h[8];			/* chain value */
+	uint64_t t[2];			/* number of bytes compressed so far */
+	unsigned char buf[128];		/* pending block, not compressed until more data follows */
+	size_t len;			/* number of bytes in buf */
+} xcrun_hash;
+
+/**
+ * @func hash_init -- start a new key
+ * @arg hash - key to start
+ */
+void hash_init(xcrun_hash *hash);
+
+/**
+ * @func hash_update -- mix data into a key
+ * @arg hash - key
+ * @arg data - data to mix in
+ * @arg len  - length of data
+ */
+void hash_update(xcrun_hash *hash, const void *data, size_t len);
+
+/**
+ * @func hash_string -- mix a string, along with its terminator, into a key
+ * @arg hash - key
+ * @arg str  - string to mix in
+ */
+void hash_string(xcrun_hash *hash, const char *str);
+
+/**
+ * @func hash_digest -- finish a key, leaving it free to be updated further
+ * @arg hash - key
+ * @arg out  - buffer of HASH_SIZE bytes to hold the key
+ */
+void hash_digest(const xcrun_hash *hash, unsigned char *out);
+
+/**
+ * @func hash_hex -- finish a key and print it as hex digits
+ * @arg hash - key
+ * @arg buf  - buffer of at least HASH_HEX_SIZE bytes
+ */
+void hash_hex(const xcrun_hash *hash, char *buf);
+
+#endif /* __HASH_H__ */
@@ -0,0 +1,339 @@
+/* hotcache.c - lookup cache shared in memory by concurrent xcruns
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The lookup cache is a file, so every process that hits it still reads and parses the whole thing,
+ * and every process that misses rewrites it whole. A parallel build starts hundreds of xcruns
+ * resolving the same handful of tools, so they share their most recent answers in a segment of
+ * shared memory as well, one per user, that they consult before the file.
+ *
+ * The segment is a header followed by a fixed table of slots, each holding one entry serialized the
+ * way the lookup cache writes it. An entry lives in the first slot of a short run of probes starting
+ * from the hash of its key. Nobody ever waits on anybody else:
+ *
+ *  - a slot has a sequence number that is odd while it is being written. A writer claims a slot by
+ *    swapping its pid in with a compare and swap, and gives up if another writer got there first,
+ *    since the entry will be stored again by the next process that misses. A writer that died
+ *    halfway leaves its pid behind, and the slot is taken over from it.
+ *  - a reader copies a slot out and only trusts the copy if the sequence number was even and
+ *    unchanged around it. A slot that keeps changing under it is a miss, never a wait.
+ *  - the header holds a generation, which an entry must match to be used. Killing the lookup cache
+ *    or reindexing the developer folder bumps it, which invalidates every entry at once.
+ *
+ * Entries still carry their stamps and are checked against the file system like any other, so a
+ * hit costs a stat() per input and no read, open or lock of anything but the inputs themselves.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "hash.h"
+#include "hotcache.h"
+
+typedef struct {
+	char magic[8];		/* HOTCACHE_MAGIC */
+	uint64_t generation;	/* entries of other generations are stale */
+	uint64_t clock;		/* incremented on every store, to age slots */
+	char pad[40];		/* keep slots off the cache line of the header */
+} hotcache_header;
+
+typedef struct {
+	uint64_t seq;		/* odd while the slot is being written */
+	uint64_t hash;		/* hash of the key of the entry, 0 if the slot was never used */
+	uint64_t generation;	/* generation the entry was stored in */
+	uint64_t stored;	/* clock of the header when the entry was stored */
+	uint32_t writer;	/* pid of the process writing the slot, 0 if none */
+	uint32_t len;		/* length of the serialized entry */
+	char data[HOTCACHE_SLOT_SIZE - 40];	/* serialized entry, not terminated */
+} hotcache_slot;
+
+typedef struct {
+	hotcache_header header;
+	hotcache_slot slots[HOTCACHE_SLOTS];
+} hotcache_segment;
+
+/* Number of times a reader copies a slot that changes under it before calling it a miss */
+#define HOTCACHE_READ_TRIES 4
+
+/* Segment of this process, mapped on first use and kept until exit */
+static hotcache_segment *segment = NULL;
+static int tried_segment = 0;
+
+/* helper function to hash a key, 0 being kept for unused slots */
+static uint64_t hash_key(const char *key)
+{
+	uint64_t value;
+	xcrun_hash hash;
+	unsigned char digest[HASH_SIZE];
+
+	hash_init(&hash);
+	hash_string(&hash, key);
+	hash_digest(&hash, digest);
+	memcpy(&value, digest, sizeof(value));
+
+	return (value == 0 ? 1 : value);
+}
+
+/**
+ * @func open_segment -- Map the shared segment of the current user, creating it if needed.
+ * @arg create - create a missing segment, rather than doing without
+ * @return: mapped segment, or NULL if there is none or it can't be trusted
+ */
+static hotcache_segment *open_segment(int create)
+{
+	int fd;
+	char name[64];
+	struct stat st;
+	void *map;
+
+	if (segment != NULL || (tried_segment && !create))
+		return segment;
+	tried_segment = 1;
+
+	snprintf(name, sizeof(name), "%s.%u", HOTCACHE_NAME, (unsigned int)getuid());
+
+	if ((fd = shm_open(name, O_RDWR | (create ? O_CREAT : 0), 0600)) == -1)
+		return NULL;
+
+	/* Another user could have made the segment ours to read, but not ours to trust. */
+	if (fstat(fd, &st) != 0 || st.st_uid != getuid() || (st.st_mode & 077) != 0)
+		goto failure;
+
+	/* A new segment is empty; zero filled, it is a valid one with every slot unused. */
+	if (st.st_size == 0) {
+		if (ftruncate(fd, sizeof(hotcache_segment)) != 0)
+			goto failure;
+	} else if (st.st_size != (off_t)sizeof(hotcache_segment))
+		goto failure;
+
+	if ((map = mmap(NULL, sizeof(hotcache_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		goto failure;
+	close(fd);
+
+	segment = (hotcache_segment *)map;
+
+	/* Everyone writes the same magic, so racing to do it is harmless. Anything else is another layout. */
+	if (segment->header.magic[0] == '\0')
+		memcpy(segment->header.magic, HOTCACHE_MAGIC, sizeof(segment->header.magic));
+	if (memcmp(segment->header.magic, HOTCACHE_MAGIC, sizeof(segment->header.magic)) != 0) {
+		munmap(map, sizeof(hotcache_segment));
+		segment = NULL;
+	}
+
+	return segment;
+
+failure:
+	close(fd);
+
+	return NULL;
+}
+
+/**
+ * @func read_slot -- Copy the entry of a slot out, if it is stable and belongs to a key.
+ * @arg slot - slot to read
+ * @arg hash - hash of the key looked for
+ * @arg buf  - buffer of HOTCACHE_SLOT_SIZE bytes to copy the entry to, terminated
+ * @arg generation - set to the generation of the entry
+ * @return: 1 if buf holds an entry with the hash, 0 if the slot holds something else, -1 if it kept changing
+ */
+static int read_slot(const hotcache_slot *slot, uint64_t hash, char *buf, uint64_t *generation)
+{
+	int tries;
+	uint64_t before, after;
+	uint32_t len;
+
+	for (tries = 0; tries < HOTCACHE_READ_TRIES; tries++) {
+		if ((before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE)) & 1)
+			continue;
+
+		if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) != hash)
+			return 0;
+
+		*generation = __atomic_load_n(&slot->generation, __ATOMIC_RELAXED);
+		len = __atomic_load_n(&slot->len, __ATOMIC_RELAXED);
+
+		/*
+		 * The copy may race with a writer that started since, so nothing in it is looked at before
+		 * the sequence number has proven it whole.
+		 */
+		if (len < sizeof(slot->data))
+			memcpy(buf, slot->data, len);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+
+		if (before == after && len < sizeof(slot->data)) {
+			buf[len] = '\0';
+			return 1;
+		}
+	}
+
+	return -1;
+}
+
+/* See documentation in header file. */
+int hotcache_lookup(const char *key, cache_entry *entry)
+{
+	int i;
+	size_t key_len = strlen(key);
+	uint64_t hash = hash_key(key);
+	uint64_t current, generation;
+	hotcache_segment *seg;
+	char buf[HOTCACHE_SLOT_SIZE];
+
+	if ((seg = open_segment(0)) == NULL)
+		return -1;
+
+	current = __atomic_load_n(&seg->header.generation, __ATOMIC_ACQUIRE);
+
+	for (i = 0; i < HOTCACHE_PROBES; i++) {
+		switch (read_slot(&seg->slots[(hash + i) % HOTCACHE_SLOTS], hash, buf, &generation)) {
+			case 0:
+				continue;
+			case -1:
+				return -1;
+		}
+
+		/* Two keys may share a hash. */
+		if (strncmp(buf, key, key_len) != 0 || buf[key_len] != '\t')
+			continue;
+
+		if (generation != current)
+			return -1;
+
+		return ((cache_parse_entry(buf, entry) == 0 && cache_entry_is_current(entry)) ? 0 : -1);
+	}
+
+	return -1;
+}
+
+/**
+ * @func claim_slot -- Become the writer of a slot, unless someone else is already writing it.
+ * @arg slot - slot to claim
+ * @return: 1 if the slot is ours to write, 0 otherwise
+ */
+static int claim_slot(hotcache_slot *slot)
+{
+	uint32_t self = (uint32_t)getpid();
+	uint32_t writer = 0;
+
+	if (__atomic_compare_exchange_n(&slot->writer, &writer, self, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return 1;
+
+	/* A writer that died halfway would hold the slot forever; only one of us gets to take it over. */
+	if (kill((pid_t)writer, 0) != 0 && errno == ESRCH)
+		return __atomic_compare_exchange_n(&slot->writer, &writer, self, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+/* See documentation in header file. */
+void hotcache_store(const cache_entry *entry)
+{
+	int i;
+	size_t len;
+	uint64_t hash = hash_key(entry->key);
+	uint64_t current, seq, slot_hash;
+	hotcache_segment *seg;
+	hotcache_slot *slot, *victim = NULL, *oldest = NULL;
+	char *line;
+
+	if ((line = cache_format_entry(entry)) == NULL)
+		return;
+
+	if ((len = strlen(line)) >= sizeof(slot->data) || (seg = open_segment(1)) == NULL) {
+		free(line);
+		return;
+	}
+
+	current = __atomic_load_n(&seg->header.generation, __ATOMIC_ACQUIRE);
+
+	/* Replace the entry of the key, otherwise take an unused or stale slot, otherwise the oldest one. */
+	for (i = 0; i < HOTCACHE_PROBES; i++) {
+		slot = &seg->slots[(hash + i) % HOTCACHE_SLOTS];
+		slot_hash = __atomic_load_n(&slot->hash, __ATOMIC_RELAXED);
+
+		if (slot_hash == hash) {
+			victim = slot;
+			break;
+		}
+
+		if (victim == NULL && (slot_hash == 0 || __atomic_load_n(&slot->generation, __ATOMIC_RELAXED) != current))
+			victim = slot;
+
+		if (oldest == NULL || __atomic_load_n(&slot->stored, __ATOMIC_RELAXED) < __atomic_load_n(&oldest->stored, __ATOMIC_RELAXED))
+			oldest = slot;
+	}
+
+	slot = (victim != NULL ? victim : oldest);
+
+	/* Whoever is writing the slot stores an entry as good as ours. */
+	if (!claim_slot(slot)) {
+		free(line);
+		return;
+	}
+
+	/* Make the sequence number odd (it already is if the last writer died) before touching anything. */
+	seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+	seq += ((seq & 1) ? 2 : 1);
+	__atomic_store_n(&slot->seq, seq, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&slot->hash, hash, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->generation, current, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->stored, __atomic_add_fetch(&seg->header.clock, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->len, (uint32_t)len, __ATOMIC_RELAXED);
+	memcpy(slot->data, line, len);
+
+	/* Publish the entry: readers that see the new sequence number see all of the above. */
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&slot->writer, 0, __ATOMIC_RELEASE);
+
+	free(line);
+}
+
+/* See documentation in header file. */
+void hotcache_invalidate(void)
+{
+	hotcache_segment *seg;
+
+	if ((seg = open_segment(0)) != NULL)
+		__atomic_add_fetch(&seg->header.generation, 1, __ATOMIC_ACQ_REL);
+}
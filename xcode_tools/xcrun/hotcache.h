@@ -0,0 +1,71 @@
+/* hotcache.h - lookup cache shared in memory by concurrent xcruns
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __HOTCACHE_H__
+#define __HOTCACHE_H__
+
+#include "cache.h"
+
+/* Name of the shared memory segment, followed by the uid */
+#define HOTCACHE_NAME "/xcrun-hotcache"
+
+/* Tag at the start of the segment, bump it whenever the layout changes */
+#define HOTCACHE_MAGIC "xcrunhc1"
+
+/* Number of entries the segment holds */
+#define HOTCACHE_SLOTS 256
+
+/* Size of an entry, serialized entries that don't fit in one are not shared */
+#define HOTCACHE_SLOT_SIZE 4096
+
+/* Number of slots an entry may land in, starting from the one its key hashes to */
+#define HOTCACHE_PROBES 8
+
+/**
+ * @func hotcache_lookup -- find a valid entry for key in the shared cache
+ * @arg key   - lookup key
+ * @arg entry - entry to fill in on a hit
+ * @return: 0 on a hit, -1 on a miss or a stale entry
+ */
+int hotcache_lookup(const char *key, cache_entry *entry);
+
+/**
+ * @func hotcache_store -- add or replace an entry in the shared cache, unless another process is writing its slot
+ * @arg entry - entry to store
+ */
+void hotcache_store(const cache_entry *entry);
+
+/**
+ * @func hotcache_invalidate -- invalidate every entry of the shared cache
+ */
+void hotcache_invalidate(void);
+
+#endif /* __HOTCACHE_H__ */
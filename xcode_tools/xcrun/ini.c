@@ -1,202 +1,744 @@
-/* inih -- simple .INI file parser
-Revision: 28
-
-Go to the project home page for more info:
-
-http://code.google.com/p/inih/
-
-The "inih" library is distributed under the New BSD license:
-
-Copyright (c) 2009, Brush Technology
-All rights reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-    * Redistributions of source code must retain the above copyright
-      notice, this list of conditions and the following disclaimer.
-    * Redistributions in binary form must reproduce the above copyright
-      notice, this list of conditions and the following disclaimer in the
-      documentation and/or other materials provided with the distribution.
-    * Neither the name of Brush Technology nor the names of its contributors
-      may be used to endorse or promote products derived from this software
-      without specific prior written permission.
-
-THIS SOFTWARE IS PROVIDED BY BRUSH TECHNOLOGY ''AS IS'' AND ANY
-EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL BRUSH TECHNOLOGY BE LIABLE FOR ANY
-DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*/
-
-#include <stdio.h>
-#include <ctype.h>
-#include <string.h>
-
-#include "ini.h"
-
-#if !INI_USE_STACK
-#include <stdlib.h>
-#endif
-
-#define MAX_SECTION 50
-#define MAX_NAME 50
-
-/* Strip whitespace chars off end of given string, in place. Return s. */
-static char* rstrip(char* s)
-{
-    char* p = s + strlen(s);
-    while (p > s && isspace((unsigned char)(*--p)))
-        *p = '\0';
-    return s;
-}
-
-/* Return pointer to first non-whitespace char in given string. */
-static char* lskip(const char* s)
-{
-    while (*s && isspace((unsigned char)(*s)))
-        s++;
-    return (char*)s;
-}
-
-/* Return pointer to first char c or ';' comment in given string, or pointer to
-   null at end of string if neither found. ';' must be prefixed by a whitespace
-   character to register as a comment. */
-static char* find_char_or_comment(const char* s, char c)
-{
-    int was_whitespace = 0;
-    while (*s && *s != c && !(was_whitespace && *s == ';')) {
-        was_whitespace = isspace((unsigned char)(*s));
-        s++;
-    }
-    return (char*)s;
-}
-
-/* Version of strncpy that ensures dest (size bytes) is null-terminated. */
-static char* strncpy0(char* dest, const char* src, size_t size)
-{
-    strncpy(dest, src, size);
-    dest[size - 1] = '\0';
-    return dest;
-}
-
-/* See documentation in header file. */
-int ini_parse_file(FILE* file,
-                   int (*handler)(void*, const char*, const char*,
-                                  const char*),
-                   void* user)
-{
-    /* Uses a fair bit of stack (use heap instead if you need to) */
-#if INI_USE_STACK
-    char line[INI_MAX_LINE];
-#else
-    char* line = NULL;
-#endif
-    char section[MAX_SECTION] = "";
-    char prev_name[MAX_NAME] = "";
-
-    char* start = NULL;
-    char* end = NULL;
-    char* name = NULL;
-    char* value = NULL;
-    int lineno = 0;
-    int error = 0;
-
-#if !INI_USE_STACK
-    line = (char*)malloc(INI_MAX_LINE);
-    if (!line) {
-        return -2;
-    }
-#endif
-
-    /* Scan through file line by line */
-    while (fgets(line, INI_MAX_LINE, file) != NULL) {
-        lineno++;
-
-        start = line;
-#if INI_ALLOW_BOM
-        if (lineno == 1 && (unsigned char)start[0] == 0xEF &&
-                           (unsigned char)start[1] == 0xBB &&
-                           (unsigned char)start[2] == 0xBF) {
-            start += 3;
-        }
-#endif
-        start = lskip(rstrip(start));
-
-        if (*start == ';' || *start == '#') {
-            /* Per Python ConfigParser, allow '#' comments at start of line */
-        }
-#if INI_ALLOW_MULTILINE
-        else if (*prev_name && *start && start > line) {
-            /* Non-black line with leading whitespace, treat as continuation
-               of previous name's value (as per Python ConfigParser). */
-            if (!handler(user, section, prev_name, start) && !error)
-                error = lineno;
-        }
-#endif
-        else if (*start == '[') {
-            /* A "[section]" line */
-            end = find_char_or_comment(start + 1, ']');
-            if (*end == ']') {
-                *end = '\0';
-                strncpy0(section, start + 1, sizeof(section));
-                *prev_name = '\0';
-            }
-            else if (!error) {
-                /* No ']' found on section line */
-                error = lineno;
-            }
-        }
-        else if (*start && *start != ';') {
-            /* Not a comment, must be a name[=:]value pair */
-            end = find_char_or_comment(start, '=');
-            if (*end != '=') {
-                end = find_char_or_comment(start, ':');
-            }
-            if (*end == '=' || *end == ':') {
-                *end = '\0';
-                name = rstrip(start);
-                value = lskip(end + 1);
-                end = find_char_or_comment(value, '\0');
-                if (*end == ';')
-                    *end = '\0';
-                rstrip(value);
-
-                /* Valid name[=:]value pair found, call handler */
-                strncpy0(prev_name, name, sizeof(prev_name));
-                if (!handler(user, section, name, value) && !error)
-                    error = lineno;
-            }
-            else if (!error) {
-                /* No '=' or ':' found on name[=:]value line */
-                error = lineno;
-            }
-        }
-    }
-
-#if !INI_USE_STACK
-    free(line);
-#endif
-
-    return error;
-}
-
-/* See documentation in header file. */
-int ini_parse(const char* filename,
-              int (*handler)(void*, const char*, const char*, const char*),
-              void* user)
-{
-    FILE* file;
-    int error;
-
-    file = fopen(filename, "r");
-    if (!file)
-        return -1;
-    error = ini_parse_file(file, handler, user);
-    fclose(file);
-    return error;
-}
+/* inih -- simple .INI file parser
+Revision: 28
+
+Go to the project home page for more info:
+
+http://code.google.com/p/inih/
+
+The "inih" library is distributed under the New BSD license:
+
+Copyright (c) 2009, Brush Technology
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Brush Technology nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY BRUSH TECHNOLOGY ''AS IS'' AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL BRUSH TECHNOLOGY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ini.h"
+
+#if INI_USE_SIMD && defined(__GNUC__) && defined(__SSE2__)
+#include <immintrin.h>
+#define INI_SIMD_X86 1
+#elif INI_USE_SIMD && defined(__GNUC__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define INI_SIMD_NEON 1
+#endif
+
+/* Returns pointer to first char c or ';' in [s, end), or end. */
+typedef const char* (*ini_scanner)(const char* s, const char* end, char c);
+
+/* Byte at a time scanner, also used for the tail of the vector scanners. */
+static const char* scan_scalar(const char* s, const char* end, char c)
+{
+    while (s < end && *s != c && *s != ';')
+        s++;
+    return s;
+}
+
+#if INI_SIMD_X86
+static const char* scan_sse2(const char* s, const char* end, char c)
+{
+    const __m128i want = _mm_set1_epi8(c);
+    const __m128i semi = _mm_set1_epi8(';');
+    __m128i block;
+    int mask;
+
+    while (end - s >= 16) {
+        block = _mm_loadu_si128((const __m128i*)s);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, want),
+                                              _mm_cmpeq_epi8(block, semi)));
+        if (mask)
+            return s + __builtin_ctz((unsigned)mask);
+        s += 16;
+    }
+    return scan_scalar(s, end, c);
+}
+
+__attribute__((target("avx2")))
+static const char* scan_avx2(const char* s, const char* end, char c)
+{
+    const __m256i want = _mm256_set1_epi8(c);
+    const __m256i semi = _mm256_set1_epi8(';');
+    __m256i block;
+    unsigned mask;
+
+    while (end - s >= 32) {
+        block = _mm256_loadu_si256((const __m256i*)s);
+        mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, want),
+                            _mm256_cmpeq_epi8(block, semi)));
+        if (mask)
+            return s + __builtin_ctz(mask);
+        s += 32;
+    }
+    return scan_sse2(s, end, c);
+}
+#endif
+
+#if INI_SIMD_NEON
+static const char* scan_neon(const char* s, const char* end, char c)
+{
+    const uint8x16_t want = vdupq_n_u8((uint8_t)c);
+    const uint8x16_t semi = vdupq_n_u8((uint8_t)';');
+    uint8x16_t block;
+    uint64_t mask;
+
+    while (end - s >= 16) {
+        block = vld1q_u8((const uint8_t*)s);
+        block = vorrq_u8(vceqq_u8(block, want), vceqq_u8(block, semi));
+        /* Narrow each byte of the compare result to a nibble */
+        mask = vget_lane_u64(vreinterpret_u64_u8(
+                   vshrn_n_u16(vreinterpretq_u16_u8(block), 4)), 0);
+        if (mask)
+            return s + (__builtin_ctzll(mask) >> 2);
+        s += 16;
+    }
+    return scan_scalar(s, end, c);
+}
+#endif
+
+/* Pick the widest scanner the running CPU supports. */
+static ini_scanner select_scanner(void)
+{
+#if INI_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return scan_avx2;
+    return scan_sse2;
+#elif INI_SIMD_NEON
+    return scan_neon;
+#else
+    return scan_scalar;
+#endif
+}
+
+/* Selected on first use; every thread selects the same one. */
+static ini_scanner scan = NULL;
+
+/* Return end of given view, with whitespace chars stripped off. */
+static const char* rstrip(const char* s, const char* end)
+{
+    while (end > s && isspace((unsigned char)(end[-1])))
+        end--;
+    return end;
+}
+
+/* Return pointer to first non-whitespace char in given view. */
+static const char* lskip(const char* s, const char* end)
+{
+    while (s < end && isspace((unsigned char)(*s)))
+        s++;
+    return s;
+}
+
+/* Return pointer to first char c or ';' comment in given view, or end if
+   neither found. ';' must be prefixed by a whitespace character to register
+   as a comment. */
+static const char* find_char_or_comment(const char* s, const char* end,
+                                        char c)
+{
+    const char* p = s;
+
+    while ((p = scan(p, end, c)) < end && *p != c) {
+        if (p > s && isspace((unsigned char)(p[-1])))
+            break;
+        p++;
+    }
+    return p;
+}
+
+/* Make a view of [start, end). */
+static ini_view make_view(const char* start, const char* end)
+{
+    ini_view view;
+    view.ptr = start;
+    view.len = (size_t)(end - start);
+    return view;
+}
+
+/* See documentation in header file. */
+int ini_parse_buffer(const char* buf, size_t len, ini_view_handler handler,
+                     ini_section_filter filter, void* user)
+{
+    const char* end = buf + len;
+    const char* line = buf;
+    const char* next = NULL;
+    const char* start = NULL;
+    const char* stop = NULL;
+    const char* p = NULL;
+    const char* value = NULL;
+    ini_view section = make_view("", "");
+    ini_view prev_name = make_view("", "");
+    int wanted = 1;
+    int lineno = 0;
+    int error = 0;
+
+    if (scan == NULL)
+        scan = select_scanner();
+
+    /* Scan through buffer line by line */
+    for (; line < end; line = next) {
+        lineno++;
+
+        if ((next = (const char*)memchr(line, '\n', end - line)) == NULL)
+            next = end;
+        stop = next;
+        if (next < end)
+            next++;
+
+        start = line;
+#if INI_ALLOW_BOM
+        if (lineno == 1 && stop - start >= 3 &&
+                           (unsigned char)start[0] == 0xEF &&
+                           (unsigned char)start[1] == 0xBB &&
+                           (unsigned char)start[2] == 0xBF) {
+            start += 3;
+        }
+#endif
+        stop = rstrip(start, stop);
+        start = lskip(start, stop);
+
+        if (start == stop) {
+            /* Blank line */
+        }
+        else if (*start == ';' || *start == '#') {
+            /* Per Python ConfigParser, allow '#' comments at start of line */
+        }
+#if INI_ALLOW_MULTILINE
+        else if (prev_name.len && start > line) {
+            /* Non-black line with leading whitespace, treat as continuation
+               of previous name's value (as per Python ConfigParser). */
+            if (wanted && !handler(user, section, prev_name,
+                                   make_view(start, stop)) && !error)
+                error = lineno;
+        }
+#endif
+        else if (*start == '[') {
+            /* A "[section]" line */
+            p = find_char_or_comment(start + 1, stop, ']');
+            if (p < stop && *p == ']') {
+                section = make_view(start + 1, p);
+                prev_name = make_view("", "");
+                wanted = (filter == NULL || filter(user, section));
+            }
+            else if (!error) {
+                /* No ']' found on section line */
+                error = lineno;
+            }
+        }
+        else {
+            /* Not a comment, must be a name[=:]value pair */
+            p = find_char_or_comment(start, stop, '=');
+            if (p == stop || *p != '=') {
+                p = find_char_or_comment(start, stop, ':');
+            }
+            if (p < stop && (*p == '=' || *p == ':')) {
+                prev_name = make_view(start, rstrip(start, p));
+                value = lskip(p + 1, stop);
+                p = rstrip(value, find_char_or_comment(value, stop, '\0'));
+
+                /* Valid name[=:]value pair found, call handler */
+                if (wanted && !handler(user, section, prev_name,
+                                       make_view(value, p)) && !error)
+                    error = lineno;
+            }
+            else if (!error) {
+                /* No '=' or ':' found on name[=:]value line */
+                error = lineno;
+            }
+        }
+    }
+
+    return error;
+}
+
+/* See documentation in header file. */
+int ini_parse_mapped(const char* filename, ini_view_handler handler,
+                     ini_section_filter filter, void* user)
+{
+    int fd;
+    int error;
+    void* map;
+    struct stat st;
+
+    fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* An empty file can't be mapped, and has nothing to parse anyway. */
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    error = ini_parse_buffer((const char*)map, (size_t)st.st_size, handler,
+                             filter, user);
+    munmap(map, (size_t)st.st_size);
+    return error;
+}
+
+/* Turns views back into null-terminated strings for the classic API. */
+typedef struct {
+    int (*handler)(void*, const char*, const char*, const char*);
+    void* user;
+    char* buf;
+    size_t size;
+    int nomem;
+} string_adapter;
+
+/* View handler calling the classic handler of a string_adapter. */
+static int adapt_strings(void* user, ini_view section, ini_view name,
+                         ini_view value)
+{
+    string_adapter* adapter = (string_adapter*)user;
+    size_t size = section.len + name.len + value.len + 3;
+    char* buf;
+
+    if (size > adapter->size) {
+        buf = (char*)realloc(adapter->buf, size);
+        if (!buf) {
+            adapter->nomem = 1;
+            return 0;
+        }
+        adapter->buf = buf;
+        adapter->size = size;
+    }
+
+    buf = adapter->buf;
+    memcpy(buf, section.ptr, section.len);
+    buf[section.len] = '\0';
+    memcpy(buf + section.len + 1, name.ptr, name.len);
+    buf[section.len + 1 + name.len] = '\0';
+    memcpy(buf + section.len + name.len + 2, value.ptr, value.len);
+    buf[section.len + name.len + 2 + value.len] = '\0';
+
+    return adapter->handler(adapter->user, buf, buf + section.len + 1,
+                            buf + section.len + name.len + 2);
+}
+
+/* See documentation in header file. */
+int ini_parse_file(FILE* file,
+                   int (*handler)(void*, const char*, const char*,
+                                  const char*),
+                   void* user)
+{
+    string_adapter adapter = { handler, user, NULL, 0, 0 };
+    char* buf = NULL;
+    char* tmp;
+    size_t len = 0;
+    size_t size = 0;
+    size_t n;
+    int error;
+
+    /* Read the whole stream, then parse it in place */
+    do {
+        if (len + BUFSIZ > size) {
+            tmp = (char*)realloc(buf, size * 2 + BUFSIZ);
+            if (!tmp) {
+                free(buf);
+                return -2;
+            }
+            buf = tmp;
+            size = size * 2 + BUFSIZ;
+        }
+        n = fread(buf + len, 1, BUFSIZ, file);
+        len += n;
+    } while (n > 0);
+
+    error = ini_parse_buffer(buf, len, adapt_strings, NULL, &adapter);
+    free(adapter.buf);
+    free(buf);
+    return (adapter.nomem ? -2 : error);
+}
+
+/* See documentation in header file. */
+int ini_parse(const char* filename,
+              int (*handler)(void*, const char*, const char*, const char*),
+              void* user)
+{
+    string_adapter adapter = { handler, user, NULL, 0, 0 };
+    int error;
+
+    error = ini_parse_mapped(filename, adapt_strings, NULL, &adapter);
+    free(adapter.buf);
+    return (adapter.nomem ? -2 : error);
+}
+
+/* Strings of a document are carved out of chunks, which never move. */
+#define INI_CHUNK_SIZE 4096
+
+typedef struct ini_chunk {
+    struct ini_chunk* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ini_chunk;
+
+typedef struct {
+    const char* section;
+    const char* name;
+    const char* value;
+    size_t hash;
+} ini_entry;
+
+struct ini_document {
+    ini_chunk* chunks;
+    ini_entry* entries;
+    size_t nentries;
+    size_t max_entries;
+    size_t* slots;          /* index + 1 of an entry, 0 if free */
+    size_t nslots;          /* power of two, at least twice nentries */
+    const char** sections;
+    size_t nsections;
+    size_t max_sections;
+    const char* last_name;  /* name of the previous pair, while loading */
+    size_t last_entry;
+    int nomem;
+};
+
+/* Allocate size bytes from the arena of doc. */
+static char* doc_alloc(ini_document* doc, size_t size)
+{
+    ini_chunk* chunk = doc->chunks;
+    char* p;
+
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        chunk = (ini_chunk*)malloc(sizeof(ini_chunk) +
+                                   (size > INI_CHUNK_SIZE ? size : INI_CHUNK_SIZE));
+        if (!chunk)
+            return NULL;
+        chunk->size = (size > INI_CHUNK_SIZE ? size : INI_CHUNK_SIZE);
+        chunk->used = 0;
+        chunk->next = doc->chunks;
+        doc->chunks = chunk;
+    }
+
+    p = chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+/* Copy a view into the arena of doc as a null-terminated string. */
+static const char* doc_strdup(ini_document* doc, ini_view view)
+{
+    char* p = doc_alloc(doc, view.len + 1);
+
+    if (!p)
+        return NULL;
+    memcpy(p, view.ptr, view.len);
+    p[view.len] = '\0';
+    return p;
+}
+
+/* FNV-1a hash of a (section, name) pair. */
+static size_t hash_key(ini_view section, ini_view name)
+{
+    size_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < section.len; i++)
+        hash = (hash ^ (unsigned char)section.ptr[i]) * 16777619u;
+    hash = (hash ^ 0xff) * 16777619u;
+    for (i = 0; i < name.len; i++)
+        hash = (hash ^ (unsigned char)name.ptr[i]) * 16777619u;
+    return hash;
+}
+
+/* Test whether a view holds the same characters as a string. */
+static int view_equals(ini_view view, const char* s)
+{
+    return strlen(s) == view.len && memcmp(s, view.ptr, view.len) == 0;
+}
+
+/* Return the slot of a (section, name) pair: either the one holding it, or
+   the free one it would go in. */
+static size_t* find_slot(const ini_document* doc, ini_view section,
+                         ini_view name, size_t hash)
+{
+    size_t i = hash & (doc->nslots - 1);
+    const ini_entry* entry;
+
+    for (;; i = (i + 1) & (doc->nslots - 1)) {
+        if (doc->slots[i] == 0)
+            return &doc->slots[i];
+        entry = &doc->entries[doc->slots[i] - 1];
+        if (entry->hash == hash && view_equals(section, entry->section) &&
+                                   view_equals(name, entry->name))
+            return &doc->slots[i];
+    }
+}
+
+/* Double the hash index of doc, and the room for entries. */
+static int grow(ini_document* doc)
+{
+    size_t nslots = (doc->nslots ? doc->nslots * 2 : 16);
+    size_t* slots;
+    size_t* slot;
+    ini_entry* entries;
+    size_t i;
+
+    entries = (ini_entry*)realloc(doc->entries,
+                                  nslots / 2 * sizeof(ini_entry));
+    if (!entries)
+        return -1;
+    doc->entries = entries;
+    doc->max_entries = nslots / 2;
+
+    if ((slots = (size_t*)calloc(nslots, sizeof(size_t))) == NULL)
+        return -1;
+    free(doc->slots);
+    doc->slots = slots;
+    doc->nslots = nslots;
+
+    for (i = 0; i < doc->nentries; i++) {
+        ini_view section = { doc->entries[i].section,
+                             strlen(doc->entries[i].section) };
+        ini_view name = { doc->entries[i].name, strlen(doc->entries[i].name) };
+        slot = find_slot(doc, section, name, doc->entries[i].hash);
+        *slot = i + 1;
+    }
+    return 0;
+}
+
+/* Return the copy of a section name held by doc, adding it if needed. */
+static const char* intern_section(ini_document* doc, ini_view section)
+{
+    const char** sections;
+    size_t i;
+
+    /* Pairs of a section mostly come one after the other */
+    for (i = doc->nsections; i > 0; i--) {
+        if (view_equals(section, doc->sections[i - 1]))
+            return doc->sections[i - 1];
+    }
+
+    if (doc->nsections == doc->max_sections) {
+        sections = (const char**)realloc(doc->sections,
+                                         (doc->max_sections * 2 + 8) *
+                                         sizeof(const char*));
+        if (!sections)
+            return NULL;
+        doc->sections = sections;
+        doc->max_sections = doc->max_sections * 2 + 8;
+    }
+
+    if ((doc->sections[doc->nsections] = doc_strdup(doc, section)) == NULL)
+        return NULL;
+    return doc->sections[doc->nsections++];
+}
+
+/* Set a (section, name) pair of doc to a copy of value. Returns the entry,
+   or NULL on memory allocation error. */
+static ini_entry* doc_set(ini_document* doc, ini_view section, ini_view name,
+                          ini_view value)
+{
+    size_t hash = hash_key(section, name);
+    size_t* slot;
+    ini_entry* entry;
+
+    if (doc->nentries == doc->max_entries && grow(doc) != 0)
+        return NULL;
+
+    slot = find_slot(doc, section, name, hash);
+    if (*slot == 0) {
+        entry = &doc->entries[doc->nentries];
+        if ((entry->section = intern_section(doc, section)) == NULL ||
+            (entry->name = doc_strdup(doc, name)) == NULL)
+            return NULL;
+        entry->hash = hash;
+        *slot = ++doc->nentries;
+    }
+
+    entry = &doc->entries[*slot - 1];
+    if ((entry->value = doc_strdup(doc, value)) == NULL)
+        return NULL;
+    return entry;
+}
+
+/* Section filter of ini_load(), so that empty sections are known too. */
+static int document_section(void* user, ini_view section)
+{
+    ini_document* doc = (ini_document*)user;
+
+    if (intern_section(doc, section) == NULL)
+        doc->nomem = 1;
+    return 1;
+}
+
+/* View handler of ini_load(), adding each pair to the document. */
+static int document_handler(void* user, ini_view section, ini_view name,
+                            ini_view value)
+{
+    ini_document* doc = (ini_document*)user;
+    ini_entry* entry;
+    const char* prev;
+    char* joined;
+    size_t len;
+
+    if (doc->nomem)
+        return 0;
+
+    /* A continuation line comes with the very same name view */
+    if (name.ptr == doc->last_name && doc->last_entry < doc->nentries) {
+        entry = &doc->entries[doc->last_entry];
+        prev = entry->value;
+        len = strlen(prev);
+        if ((joined = doc_alloc(doc, len + value.len + 2)) == NULL) {
+            doc->nomem = 1;
+            return 0;
+        }
+        memcpy(joined, prev, len);
+        joined[len] = ' ';
+        memcpy(joined + len + 1, value.ptr, value.len);
+        joined[len + value.len + 1] = '\0';
+        entry->value = joined;
+        return 1;
+    }
+
+    if ((entry = doc_set(doc, section, name, value)) == NULL) {
+        doc->nomem = 1;
+        return 0;
+    }
+    doc->last_name = name.ptr;
+    doc->last_entry = (size_t)(entry - doc->entries);
+    return 1;
+}
+
+/* See documentation in header file. */
+ini_document* ini_new(void)
+{
+    return (ini_document*)calloc(1, sizeof(ini_document));
+}
+
+/* Finish loading a document, after ini_parse_buffer() returned error. */
+static ini_document* finish_load(ini_document* doc, int error)
+{
+    if (error == -1 || doc->nomem) {
+        ini_free(doc);
+        if (error != -1)
+            errno = ENOMEM;
+        return NULL;
+    }
+    doc->last_name = NULL;
+    return doc;
+}
+
+/* See documentation in header file. */
+ini_document* ini_load(const char* filename)
+{
+    ini_document* doc = ini_new();
+
+    if (!doc)
+        return NULL;
+    return finish_load(doc, ini_parse_mapped(filename, document_handler,
+                                             document_section, doc));
+}
+
+/* See documentation in header file. */
+ini_document* ini_load_buffer(const char* buf, size_t len)
+{
+    ini_document* doc = ini_new();
+
+    if (!doc)
+        return NULL;
+    return finish_load(doc, ini_parse_buffer(buf, len, document_handler,
+                                             document_section, doc));
+}
+
+/* See documentation in header file. */
+const char* ini_get(const ini_document* doc, const char* section,
+                    const char* name)
+{
+    ini_view s = { section, strlen(section) };
+    ini_view n = { name, strlen(name) };
+    size_t slot;
+
+    if (doc->nentries == 0)
+        return NULL;
+    slot = *find_slot(doc, s, n, hash_key(s, n));
+    return (slot ? doc->entries[slot - 1].value : NULL);
+}
+
+/* See documentation in header file. */
+const char* ini_set(ini_document* doc, const char* section, const char* name,
+                    const char* value)
+{
+    ini_view s = { section, strlen(section) };
+    ini_view n = { name, strlen(name) };
+    ini_view v;
+    ini_entry* entry;
+
+    if (!value)
+        return NULL;
+    v.ptr = value;
+    v.len = strlen(value);
+    entry = doc_set(doc, s, n, v);
+    return (entry ? entry->value : NULL);
+}
+
+/* See documentation in header file. */
+size_t ini_section_count(const ini_document* doc)
+{
+    return doc->nsections;
+}
+
+/* See documentation in header file. */
+const char* ini_section_name(const ini_document* doc, size_t index)
+{
+    return (index < doc->nsections ? doc->sections[index] : NULL);
+}
+
+/* See documentation in header file. */
+void ini_free(ini_document* doc)
+{
+    ini_chunk* chunk;
+
+    if (!doc)
+        return;
+    while ((chunk = doc->chunks) != NULL) {
+        doc->chunks = chunk->next;
+        free(chunk);
+    }
+    free(doc->entries);
+    free(doc->slots);
+    free(doc->sections);
+    free(doc);
+}
@@ -1,101 +1,161 @@
-/* inih -- simple .INI file parser
-Revision: 28
-
-Go to the project home page for more info:
-
-http://code.google.com/p/inih/
-
-The "inih" library is distributed under the New BSD license:
-
-Copyright (c) 2009, Brush Technology
-All rights reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-    * Redistributions of source code must retain the above copyright
-      notice, this list of conditions and the following disclaimer.
-    * Redistributions in binary form must reproduce the above copyright
-      notice, this list of conditions and the following disclaimer in the
-      documentation and/or other materials provided with the distribution.
-    * Neither the name of Brush Technology nor the names of its contributors
-      may be used to endorse or promote products derived from this software
-      without specific prior written permission.
-
-THIS SOFTWARE IS PROVIDED BY BRUSH TECHNOLOGY ''AS IS'' AND ANY
-EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL BRUSH TECHNOLOGY BE LIABLE FOR ANY
-DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-*/
-
-#ifndef __INI_H__
-#define __INI_H__
-
-/* Make this header file easier to include in C++ code */
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <stdio.h>
-
-/* Useful macro taken from example/ini_example.c */
-#define MATCH_INI_STON(s, n) strcmp(section, s) == 0 && strcmp(name, n) == 0
-
-/* Parse given INI-style file. May have [section]s, name=value pairs
-   (whitespace stripped), and comments starting with ';' (semicolon). Section
-   is "" if name=value pair parsed before any section heading. name:value
-   pairs are also supported as a concession to Python's ConfigParser.
-
-   For each name=value pair parsed, call handler function with given user
-   pointer as well as section, name, and value (data only valid for duration
-   of handler call). Handler should return nonzero on success, zero on error.
-
-   Returns 0 on success, line number of first error on parse error (doesn't
-   stop on first error), -1 on file open error, or -2 on memory allocation
-   error (only when INI_USE_STACK is zero).
-*/
-int ini_parse(const char* filename,
-              int (*handler)(void* user, const char* section,
-                             const char* name, const char* value),
-              void* user);
-
-/* Same as ini_parse(), but takes a FILE* instead of filename. This doesn't
-   close the file when it's finished -- the caller must do that. */
-int ini_parse_file(FILE* file,
-                   int (*handler)(void* user, const char* section,
-                                  const char* name, const char* value),
-                   void* user);
-
-/* Nonzero to allow multi-line value parsing, in the style of Python's
-   ConfigParser. If allowed, ini_parse() will call the handler with the same
-   name for each subsequent line parsed. */
-#ifndef INI_ALLOW_MULTILINE
-#define INI_ALLOW_MULTILINE 1
-#endif
-
-/* Nonzero to allow a UTF-8 BOM sequence (0xEF 0xBB 0xBF) at the start of
-   the file. See http://code.google.com/p/inih/issues/detail?id=21 */
-#ifndef INI_ALLOW_BOM
-#define INI_ALLOW_BOM 1
-#endif
-
-/* Nonzero to use stack, zero to use heap (malloc/free). */
-#ifndef INI_USE_STACK
-#define INI_USE_STACK 1
-#endif
-
-/* Maximum line length for any line in INI file. */
-#ifndef INI_MAX_LINE
-#define INI_MAX_LINE 200
-#endif
-
-#ifdef __cplusplus
-}
-#endif
-
-#endif /* __INI_H__ */
+/* inih -- simple .INI file parser
+Revision: 28
+
+Go to the project home page for more info:
+
+http://code.google.com/p/inih/
+
+The "inih" library is distributed under the New BSD license:
+
+Copyright (c) 2009, Brush Technology
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Brush Technology nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY BRUSH TECHNOLOGY ''AS IS'' AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL BRUSH TECHNOLOGY BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __INI_H__
+#define __INI_H__
+
+/* Make this header file easier to include in C++ code */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+/* Parse given INI-style file. May have [section]s, name=value pairs
+   (whitespace stripped), and comments starting with ';' (semicolon). Section
+   is "" if name=value pair parsed before any section heading. name:value
+   pairs are also supported as a concession to Python's ConfigParser.
+
+   For each name=value pair parsed, call handler function with given user
+   pointer as well as section, name, and value (data only valid for duration
+   of handler call). Handler should return nonzero on success, zero on error.
+
+   Returns 0 on success, line number of first error on parse error (doesn't
+   stop on first error), -1 on file open error, or -2 on memory allocation
+   error.
+*/
+int ini_parse(const char* filename,
+              int (*handler)(void* user, const char* section,
+                             const char* name, const char* value),
+              void* user);
+
+/* Same as ini_parse(), but takes a FILE* instead of filename. This doesn't
+   close the file when it's finished -- the caller must do that. */
+int ini_parse_file(FILE* file,
+                   int (*handler)(void* user, const char* section,
+                                  const char* name, const char* value),
+                   void* user);
+
+/* A piece of the buffer being parsed. It is NOT null-terminated. */
+typedef struct {
+    const char* ptr;
+    size_t len;
+} ini_view;
+
+/* Handler of ini_parse_buffer(), called with views into the buffer, which
+   stay valid for as long as the buffer does. Should return nonzero on
+   success, zero on error. */
+typedef int (*ini_view_handler)(void* user, ini_view section, ini_view name,
+                                ini_view value);
+
+/* Section filter of ini_parse_buffer(), called for each "[section]" line.
+   Returns nonzero if the name=value pairs of the section should be passed
+   to the handler, zero to skip them. Pairs before any section heading are
+   always passed. */
+typedef int (*ini_section_filter)(void* user, ini_view section);
+
+/* Same as ini_parse(), but parses len bytes of memory in place: there is no
+   copying and no limit on the length of a line. filter may be NULL to get
+   every section. Returns 0 on success or the line number of the first
+   error. */
+int ini_parse_buffer(const char* buf, size_t len, ini_view_handler handler,
+                     ini_section_filter filter, void* user);
+
+/* Same as ini_parse_buffer(), over a file mapped into memory. Returns -1 on
+   file open error. */
+int ini_parse_mapped(const char* filename, ini_view_handler handler,
+                     ini_section_filter filter, void* user);
+
+/* A parsed INI file. Every string of a document lives in its arena, and
+   (section, name) pairs are found through a hash index. */
+typedef struct ini_document ini_document;
+
+/* Create an empty document, or NULL on memory allocation error. */
+ini_document* ini_new(void);
+
+/* Parse given INI file into a new document. Lines that don't parse are
+   skipped. When a name appears twice in a section the last value wins, and
+   continuation lines are joined to their value with a space. Returns NULL
+   on file open error or memory allocation error (errno tells which). */
+ini_document* ini_load(const char* filename);
+
+/* Same as ini_load(), but parses len bytes of memory. */
+ini_document* ini_load_buffer(const char* buf, size_t len);
+
+/* Return the value of name in section, or NULL if there is none. The value
+   stays valid until the document is freed. */
+const char* ini_get(const ini_document* doc, const char* section,
+                    const char* name);
+
+/* Set name in section to a copy of value, replacing any previous value.
+   Returns the copy, which stays valid until the document is freed, or NULL
+   if value is NULL (nothing is set) or on memory allocation error. */
+const char* ini_set(ini_document* doc, const char* section, const char* name,
+                    const char* value);
+
+/* Number of sections in the document, including ones with no pairs. */
+size_t ini_section_count(const ini_document* doc);
+
+/* Name of the index-th section, in order of first appearance. */
+const char* ini_section_name(const ini_document* doc, size_t index);
+
+/* Free a document and all of its strings. doc may be NULL. */
+void ini_free(ini_document* doc);
+
+/* Nonzero to allow multi-line value parsing, in the style of Python's
+   ConfigParser. If allowed, ini_parse() will call the handler with the same
+   name for each subsequent line parsed. */
+#ifndef INI_ALLOW_MULTILINE
+#define INI_ALLOW_MULTILINE 1
+#endif
+
+/* Nonzero to allow a UTF-8 BOM sequence (0xEF 0xBB 0xBF) at the start of
+   the file. See http://code.google.com/p/inih/issues/detail?id=21 */
+#ifndef INI_ALLOW_BOM
+#define INI_ALLOW_BOM 1
+#endif
+
+/* Nonzero to scan for delimiters 16 or 32 bytes at a time with SSE2/AVX2 or
+   NEON where available. The widest implementation the CPU supports is picked
+   at runtime; zero always uses the byte at a time scanner. */
+#ifndef INI_USE_SIMD
+#define INI_USE_SIMD 1
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INI_H__ */
@@ -0,0 +1,2634 @@
+/* libxcrun.c - in-process tool resolution for the Developer folder
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "ini.h"
+#include "cache.h"
+#include "daemon.h"
+#include "dirindex.h"
+#include "hotcache.h"
+#include "manifest.h"
+#include "trace.h"
+#include "util.h"
+#include "libxcrun.h"
+
+/* General stuff */
+#define SDK_CFG ".xcdev.dat"
+#define XCRUN_DEFAULT_CFG "/etc/xcrun.ini"
+#define XCRUN_CONTEXT_ENV "XCRUN_CONTEXT"
+#define XCRUN_CONTEXT_VERSION "2"
+
+/* Tool profile struct ([TOOL <name>] section of a toolchain's info.ini) */
+typedef struct {
+	const char *name;
+	const char *path;
+	const char *args;
+	const char *aliases;
+} tool_profile;
+
+/* Toolchain configuration struct, its strings all live in doc */
+typedef struct {
+	ini_document *doc;
+	const char *name;
+	const char *version;
+	int ntools;
+	tool_profile *tools;
+} toolchain_config;
+
+/* SDK configuration struct, its strings all live in doc */
+typedef struct {
+	ini_document *doc;
+	const char *name;
+	const char *version;
+	const char *toolchain;
+	const char *default_arch;
+	const char *archs;
+	const char *deployment_target;
+	const char *deployment_target_var;
+	const char *target_triple;	/* precomputed, only when read from the manifest */
+} sdk_config;
+
+/* xcrun default configuration struct, its strings all live in doc */
+typedef struct {
+	ini_document *doc;
+	const char *sdk;
+	const char *toolchain;
+	bool admission;		/* xcrun.ini has [ADMISSION] sections */
+	bool complete;		/* doc holds all of xcrun.ini, not just the defaults kept in the manifest */
+} default_config;
+
+/*
+ * Resolution context. Everything that requires touching the developer folder is loaded lazily
+ * through the context_* accessors, and at most once per context.
+ */
+typedef struct {
+	bool have_default_cfg;
+	bool have_sdk_cfg;
+	bool have_toolchain_cfg;
+	bool have_target_triple;
+	char *sdk_path;
+	char *toolchain_path;
+	char *target_triple;
+	default_config default_cfg;
+	sdk_config sdk_cfg;
+	toolchain_config toolchain_cfg;
+} resolution_context;
+
+/* Fields of XCRUN_CONTEXT_ENV, in the order they are written (see export_context) */
+enum {
+	CONTEXT_VERSION,
+	CONTEXT_DEVELOPER_DIR,
+	CONTEXT_SDK_PATH,
+	CONTEXT_TOOLCHAIN_PATH,
+	CONTEXT_TARGET_TRIPLE,
+	CONTEXT_DEPLOYMENT_TARGET_VAR,
+	CONTEXT_DEPLOYMENT_TARGET,
+	CONTEXT_SDK_NAME,
+	CONTEXT_SDK_VERSION,
+	CONTEXT_SDK_TOOLCHAIN,
+	CONTEXT_SDK_DEFAULT_ARCH,
+	CONTEXT_SDK_ARCHS,
+	CONTEXT_NFIELDS
+};
+
+/* Resolution context handed down by a parent xcrun (see import_context) */
+typedef struct {
+	bool valid;
+	char *env;
+	char sdk[PATH_MAX];
+	char toolchain[PATH_MAX];
+	char *fields[CONTEXT_NFIELDS];
+} inherited_context;
+
+/* Fields of a request sent to xcrund, in the order they are written (see get_daemon_request) */
+enum {
+	REQUEST_PROTOCOL,
+	REQUEST_DEVELOPER_DIR,
+	REQUEST_GENERATION,
+	REQUEST_SDK,
+	REQUEST_TOOLCHAIN,
+	REQUEST_SDKROOT,
+	REQUEST_TOOLCHAINS,
+	REQUEST_CONTEXT,
+	REQUEST_MODE,
+	REQUEST_NAME,
+	REQUEST_NFIELDS
+};
+
+struct xcrun_ctx {
+	/* Options */
+	FILE *verbose;
+	int flags;
+	char *const *envp;
+
+	/* Errors (see begin) */
+	const char *error;
+	char error_buf[PATH_MAX * 2];
+	char fatal_buf[PATH_MAX * 2];
+
+	/* What was asked for */
+	char developer_dir[PATH_MAX];
+	unsigned long long generation;	/* of the xcode-select selection developer_dir comes from, 0 otherwise */
+	char sdk[PATH_MAX];
+	char toolchain[PATH_MAX];
+	char *alternate_sdk_path;
+	char *alternate_toolchain_path;
+	int explicit_sdk_mode;
+	int explicit_toolchain_mode;
+	int finding_mode;
+
+	/* What was resolved */
+	char current_sdk[PATH_MAX];
+	char current_toolchain[PATH_MAX];
+	resolution_context context;
+	inherited_context inherited;
+	toolchain_config other_cfg;
+	ini_document *admission_cfg;	/* all of xcrun.ini, for xcrun_tool_limits when the defaults came from the manifest */
+	bool have_admission_cfg;
+	cache_entry entry;
+	int source;	/* where entry came from (XCRUN_SOURCE_*) */
+	dir_index_set indexes;
+	int searches;	/* searches done so far, only later ones use the indexes */
+	bool tried_manifest;
+	manifest manifest;
+};
+
+/* A context of the daemon, one per distinct client environment (see daemon_get_context) */
+typedef struct {
+	char *key;
+	char **env;		/* environment of ctx, NULL terminated, on the heap as ctx keeps pointing at it */
+	xcrun_ctx *ctx;
+} daemon_context;
+
+/* State of xcrun_daemon, which never returns */
+static xcrun_ctx *daemon_owner;
+static daemon_context *daemon_contexts;
+static int ndaemon_contexts;
+
+/* helper function to describe what is going on, when asked to */
+static void verbose_printf(const xcrun_ctx *ctx, const char *str, ...)
+{
+	va_list args;
+
+	if (ctx->verbose != NULL) {
+		va_start(args, str);
+		vfprintf(ctx->verbose, str, args);
+		va_end(args);
+	}
+}
+
+/* helper function to record why the current call failed */
+static void set_error(xcrun_ctx *ctx, const char *str, ...)
+{
+	va_list args;
+
+	va_start(args, str);
+	vsnprintf(ctx->error_buf, sizeof(ctx->error_buf), str, args);
+	va_end(args);
+
+	ctx->error = ctx->error_buf;
+}
+
+/* helper function to start a public call, failing it right away if the context is unusable */
+static int begin(xcrun_ctx *ctx)
+{
+	if (*ctx->fatal_buf != '\0') {
+		ctx->error = ctx->fatal_buf;
+		return -1;
+	}
+
+	ctx->error = NULL;
+
+	return 0;
+}
+
+/* helper function to read a variable from the context's environment */
+static const char *ctx_getenv(const xcrun_ctx *ctx, const char *name)
+{
+	char *const *env;
+	size_t len = strlen(name);
+
+	if (ctx->envp == NULL)
+		return getenv(name);
+
+	for (env = ctx->envp; *env != NULL; env++) {
+		if (strncmp(*env, name, len) == 0 && (*env)[len] == '=')
+			return (*env + len + 1);
+	}
+
+	return NULL;
+}
+
+/* helper function to format a newly allocated string of exactly the size needed */
+static char *format_string(const char *fmt, ...)
+{
+	va_list args;
+	char *str;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	if (len < 0 || (str = (char *)malloc(len + 1)) == NULL)
+		return NULL;
+
+	va_start(args, fmt);
+	vsnprintf(str, len + 1, fmt, args);
+	va_end(args);
+
+	return str;
+}
+
+/* helper function to append "<dir>/usr/bin" to a colon separated search string, growing it to the exact size needed */
+static int append_search_dir(char **dirs, const char *dir)
+{
+	char *buf;
+	size_t len = (*dirs != NULL ? strlen(*dirs) : 0);
+
+	if ((buf = (char *)realloc(*dirs, len + strlen(dir) + sizeof(":/usr/bin"))) == NULL)
+		return -1;
+
+	sprintf(buf + len, "%s%s/usr/bin", (len > 0 ? ":" : ""), dir);
+	*dirs = buf;
+
+	return 0;
+}
+
+/* helper function to turn a path or name into a bare SDK/Toolchain name (no directories, no extension) */
+static void get_bundle_name(char *dst, size_t size, const char *path)
+{
+	size_t len = strlen(path);
+	const char *start;
+
+	while (len > 1 && path[len - 1] == '/')
+		len--;
+
+	for (start = path + len; start > path && start[-1] != '/'; start--)
+		;
+
+	len -= (start - path);
+	if (memchr(start, '.', len) != NULL)
+		len = ((const char *)memchr(start, '.', len) - start);
+	if (len >= size)
+		len = size - 1;
+
+	memcpy(dst, start, len);
+	dst[len] = '\0';
+}
+
+/* helper function to test for the authenticity of an sdk */
+static int test_sdk_authenticity(const char *path)
+{
+	char fname[PATH_MAX];
+
+	if (snprintf(fname, sizeof(fname), "%s/info.ini", path) >= (int)sizeof(fname))
+		return 0;
+
+	return (access(fname, F_OK) != (-1));
+}
+
+/**
+ * @func validate_directory_path -- validate if requested directory path exists
+ * @arg ctx - context
+ * @arg dir - directory to validate
+ * @return: 0 on success, -1 on failure
+ */
+static int validate_directory_path(xcrun_ctx *ctx, const char *dir)
+{
+	struct stat fstat;
+
+	if (stat(dir, &fstat) != 0) {
+		set_error(ctx, "unable to validate path \'%s\' (%s)", dir, strerror(errno));
+		return -1;
+	}
+
+	if (S_ISDIR(fstat.st_mode) == 0) {
+		set_error(ctx, "\'%s\' is not a valid path", dir);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @func fill_toolchain_config -- fill in a toolchain config from its info.ini document
+ * @arg config - toolchain config, with doc loaded
+ * @return: 0 on success, -1 on failure
+ */
+static int fill_toolchain_config(toolchain_config *config)
+{
+	size_t i, nsections = ini_section_count(config->doc);
+	const char *section;
+	tool_profile *profile;
+
+	config->name = ini_get(config->doc, "TOOLCHAIN", "name");
+	config->version = ini_get(config->doc, "TOOLCHAIN", "version");
+
+	if (nsections > 0 && (config->tools = (tool_profile *)calloc(nsections, sizeof(tool_profile))) == NULL)
+		return -1;
+
+	for (i = 0; i < nsections; i++) {
+		section = ini_section_name(config->doc, i);
+		if (strncmp(section, "TOOL ", 5) != 0)
+			continue;
+
+		profile = &config->tools[config->ntools++];
+		for (profile->name = section + 5; *profile->name == ' ' || *profile->name == '\t'; profile->name++)
+			;
+		profile->path = ini_get(config->doc, section, "path");
+		profile->args = ini_get(config->doc, section, "args");
+		profile->aliases = ini_get(config->doc, section, "aliases");
+	}
+
+	return 0;
+}
+
+/**
+ * @func fill_sdk_config -- fill in an sdk config from its info.ini document
+ * @arg config - sdk config, with doc loaded
+ */
+static void fill_sdk_config(sdk_config *config)
+{
+	config->name = ini_get(config->doc, "SDK", "name");
+	config->version = ini_get(config->doc, "SDK", "version");
+	config->toolchain = ini_get(config->doc, "SDK", "toolchain");
+	config->default_arch = ini_get(config->doc, "SDK", "default_arch");
+	config->archs = ini_get(config->doc, "SDK", "archs");
+
+	if ((config->deployment_target = ini_get(config->doc, "SDK", "iphoneos_deployment_target")) != NULL)
+		config->deployment_target_var = "IPHONEOS_DEPLOYMENT_TARGET";
+	else if ((config->deployment_target = ini_get(config->doc, "SDK", "macosx_deployment_target")) != NULL)
+		config->deployment_target_var = "MACOSX_DEPLOYMENT_TARGET";
+}
+
+/* helper function to free the contents of a toolchain config */
+static void free_toolchain_config(toolchain_config *config)
+{
+	free(config->tools);
+	ini_free(config->doc);
+	memset(config, 0, sizeof(*config));
+}
+
+/* helper function to free the contents of an sdk config */
+static void free_sdk_config(sdk_config *config)
+{
+	ini_free(config->doc);
+	memset(config, 0, sizeof(*config));
+}
+
+/* helper function to free the contents of a default config */
+static void free_default_config(default_config *config)
+{
+	ini_free(config->doc);
+	memset(config, 0, sizeof(*config));
+}
+
+/**
+ * @func context_get_manifest -- Return the manifest of the developer folder, mapping it on first use.
+ * @arg ctx - context
+ * @return: manifest, or NULL if there is no usable one
+ */
+static const manifest *context_get_manifest(xcrun_ctx *ctx)
+{
+	const char *home_path;
+	char path[PATH_MAX];
+
+	if (!ctx->tried_manifest) {
+		ctx->tried_manifest = true;
+
+		if ((ctx->flags & XCRUN_NO_CACHE) != 0 || (home_path = ctx_getenv(ctx, "HOME")) == NULL ||
+		    snprintf(path, sizeof(path), "%s/%s", home_path, MANIFEST_FILE) >= (int)sizeof(path) || manifest_open(&ctx->manifest, path) != 0)
+			return NULL;
+
+		/* A manifest of another developer folder is of no use. */
+		if (strcmp(manifest_str(&ctx->manifest, ctx->manifest.header->developer_dir), ctx->developer_dir) != 0) {
+			verbose_printf(ctx, "xcrun: info: ignoring manifest '%s' of another developer folder.\n", path);
+			manifest_close(&ctx->manifest);
+			return NULL;
+		}
+
+		verbose_printf(ctx, "xcrun: info: using manifest '%s'.\n", path);
+	}
+
+	return (ctx->manifest.map != NULL ? &ctx->manifest : NULL);
+}
+
+/**
+ * @func read_toolchain_info -- parse a toolchain's info.ini
+ * @arg ctx    - context
+ * @arg path   - path to toolchain
+ * @arg config - struct to fill with toolchain config info
+ * @return: 0 on success, -1 on failure
+ */
+static int read_toolchain_info(xcrun_ctx *ctx, const char *path, toolchain_config *config)
+{
+	char info_path[PATH_MAX] = { 0 };
+
+	memset(config, 0, sizeof(*config));
+	snprintf(info_path, sizeof(info_path), "%s/info.ini", path);
+
+	if ((config->doc = ini_load(info_path)) != NULL && fill_toolchain_config(config) == 0)
+		return 0;
+
+	set_error(ctx, "failed to retrieve toolchain info from \'%s\'. (%s)", info_path, strerror(errno));
+	free_toolchain_config(config);
+
+	return -1;
+}
+
+/**
+ * @func get_toolchain_info -- fetch config info of a toolchain, from the manifest or its info.ini
+ * @arg ctx    - context
+ * @arg path   - path to toolchain
+ * @arg config - struct to fill with toolchain config info
+ * @return: 0 on success, -1 on failure
+ */
+static int get_toolchain_info(xcrun_ctx *ctx, const char *path, toolchain_config *config)
+{
+	uint32_t i;
+	const char *name;
+	char section[PATH_MAX];
+	const manifest *m;
+	const manifest_toolchain *record;
+	const manifest_profile *profile;
+	tool_profile *tool;
+	trace_span span;
+	int status;
+
+	trace_begin(&span, "toolchain config");
+	if ((m = context_get_manifest(ctx)) == NULL || (record = manifest_find_toolchain(m, path)) == NULL) {
+		status = read_toolchain_info(ctx, path, config);
+		trace_end(&span);
+		return status;
+	}
+
+	/* Copy the record into a document of its own, the manifest may be remapped while the config is in use. */
+	memset(config, 0, sizeof(*config));
+	if ((config->doc = ini_new()) == NULL ||
+	    (record->nprofiles > 0 && (config->tools = (tool_profile *)calloc(record->nprofiles, sizeof(tool_profile))) == NULL))
+		goto nomem;
+
+	config->name = ini_set(config->doc, "TOOLCHAIN", "name", manifest_str(m, record->name));
+	config->version = ini_set(config->doc, "TOOLCHAIN", "version", manifest_str(m, record->version));
+
+	for (i = 0; i < record->nprofiles; i++) {
+		profile = &m->profiles[record->first_profile + i];
+		tool = &config->tools[config->ntools++];
+		name = manifest_str(m, profile->name);
+		snprintf(section, sizeof(section), "TOOL %s", (name != NULL ? name : ""));
+		tool->path = ini_set(config->doc, section, "path", manifest_str(m, profile->path));
+		tool->args = ini_set(config->doc, section, "args", manifest_str(m, profile->args));
+		tool->aliases = ini_set(config->doc, section, "aliases", manifest_str(m, profile->aliases));
+		if ((tool->name = ini_set(config->doc, section, "name", (name != NULL ? name : ""))) == NULL)
+			goto nomem;
+	}
+
+	trace_end(&span);
+	return 0;
+
+nomem:
+	set_error(ctx, "out of memory.");
+	free_toolchain_config(config);
+	trace_end(&span);
+
+	return -1;
+}
+
+/**
+ * @func read_sdk_info -- parse an sdk's info.ini
+ * @arg ctx    - context
+ * @arg path   - path to sdk
+ * @arg config - struct to fill with sdk config info
+ * @return: 0 on success, -1 on failure
+ */
+static int read_sdk_info(xcrun_ctx *ctx, const char *path, sdk_config *config)
+{
+	char info_path[PATH_MAX] = { 0 };
+
+	memset(config, 0, sizeof(*config));
+	snprintf(info_path, sizeof(info_path), "%s/info.ini", path);
+
+	if ((config->doc = ini_load(info_path)) != NULL) {
+		fill_sdk_config(config);
+		return 0;
+	}
+
+	set_error(ctx, "failed to retrieve sdk info from \'%s\'. (%s)", info_path, strerror(errno));
+	free_sdk_config(config);
+
+	return -1;
+}
+
+/**
+ * @func get_sdk_info -- fetch config info of an sdk, from the manifest or its info.ini
+ * @arg ctx    - context
+ * @arg path   - path to sdk
+ * @arg config - struct to fill with sdk config info
+ * @return: 0 on success, -1 on failure
+ */
+static int get_sdk_info(xcrun_ctx *ctx, const char *path, sdk_config *config)
+{
+	const manifest *m;
+	const manifest_sdk *record;
+	trace_span span;
+	int status;
+
+	trace_begin(&span, "sdk config");
+	if ((m = context_get_manifest(ctx)) == NULL || (record = manifest_find_sdk(m, path)) == NULL) {
+		status = read_sdk_info(ctx, path, config);
+		trace_end(&span);
+		return status;
+	}
+
+	memset(config, 0, sizeof(*config));
+	if ((config->doc = ini_new()) == NULL) {
+		set_error(ctx, "out of memory.");
+		trace_end(&span);
+		return -1;
+	}
+
+	config->name = ini_set(config->doc, "SDK", "name", manifest_str(m, record->name));
+	config->version = ini_set(config->doc, "SDK", "version", manifest_str(m, record->version));
+	config->toolchain = ini_set(config->doc, "SDK", "toolchain", manifest_str(m, record->toolchain));
+	config->default_arch = ini_set(config->doc, "SDK", "default_arch", manifest_str(m, record->default_arch));
+	config->archs = ini_set(config->doc, "SDK", "archs", manifest_str(m, record->archs));
+	config->deployment_target = ini_set(config->doc, "SDK", "deployment_target", manifest_str(m, record->deployment_target));
+	config->deployment_target_var = ini_set(config->doc, "SDK", "deployment_target_var", manifest_str(m, record->deployment_target_var));
+	config->target_triple = ini_set(config->doc, "SDK", "target_triple", manifest_str(m, record->target_triple));
+	trace_end(&span);
+
+	return 0;
+}
+
+/* helper function to tell whether xcrun.ini holds admission settings (see xcrun_tool_limits) */
+static bool has_admission_sections(const ini_document *doc)
+{
+	size_t i, nsections = ini_section_count(doc);
+	const char *section;
+
+	for (i = 0; i < nsections; i++) {
+		section = ini_section_name(doc, i);
+		if (strncmp(section, "ADMISSION", 9) == 0 && (section[9] == '\0' || section[9] == ' '))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @func read_default_info -- parse xcrun's default configuration
+ * @arg ctx    - context
+ * @arg path   - path to xcrun.ini
+ * @arg config - struct to fill with default config info
+ * @return: 0 on success, -1 on failure
+ */
+static int read_default_info(xcrun_ctx *ctx, const char *path, default_config *config)
+{
+	memset(config, 0, sizeof(*config));
+
+	if ((config->doc = ini_load(path)) != NULL) {
+		config->sdk = ini_get(config->doc, "SDK", "name");
+		config->toolchain = ini_get(config->doc, "TOOLCHAIN", "name");
+		config->admission = has_admission_sections(config->doc);
+		config->complete = true;
+		return 0;
+	}
+
+	set_error(ctx, "failed to retrieve default info from \'%s\'. (%s)", path, strerror(errno));
+
+	return -1;
+}
+
+/**
+ * @func get_default_info -- fetch default configuration for xcrun, from the manifest or xcrun.ini
+ * @arg ctx    - context
+ * @arg path   - path to xcrun.ini
+ * @arg config - struct to fill with default config info
+ * @return: 0 on success, -1 on failure
+ */
+static int get_default_info(xcrun_ctx *ctx, const char *path, default_config *config)
+{
+	const manifest *m;
+	trace_span span;
+	int status = 0;
+
+	trace_begin(&span, "default config");
+	if ((m = context_get_manifest(ctx)) == NULL || (m->header->default_sdk == 0 && m->header->default_toolchain == 0) ||
+	    !manifest_stamp_is_current(&m->header->default_stamp, path)) {
+		status = read_default_info(ctx, path, config);
+	} else {
+		memset(config, 0, sizeof(*config));
+		if ((config->doc = ini_new()) == NULL) {
+			set_error(ctx, "out of memory.");
+			status = -1;
+		} else {
+			config->sdk = ini_set(config->doc, "SDK", "name", manifest_str(m, m->header->default_sdk));
+			config->toolchain = ini_set(config->doc, "TOOLCHAIN", "name", manifest_str(m, m->header->default_toolchain));
+			config->admission = (m->header->admission != 0);
+		}
+	}
+	trace_end(&span);
+
+	return status;
+}
+
+/**
+ * @func get_developer_path -- retrieve current developer path
+ * @arg ctx - context, its developer_dir is filled in
+ * @return: 0 on success, -1 on failure
+ */
+static int get_developer_path(xcrun_ctx *ctx)
+{
+	int fd;
+	ssize_t len;
+	char *end;
+	const char *home_path, *dev_path;
+	char cfg_path[PATH_MAX] = { 0 };
+	char buf[PATH_MAX + 128];
+
+	verbose_printf(ctx, "xcrun: info: attempting to retrieve developer path from DEVELOPER_DIR...\n");
+
+	if ((dev_path = ctx_getenv(ctx, "DEVELOPER_DIR")) != NULL) {
+		verbose_printf(ctx, "xcrun: info: using developer path \'%s\' from DEVELOPER_DIR.\n", dev_path);
+		if (snprintf(ctx->developer_dir, sizeof(ctx->developer_dir), "%s", dev_path) >= (int)sizeof(ctx->developer_dir) || *dev_path == '\0') {
+			set_error(ctx, "invalid DEVELOPER_DIR.");
+			return -1;
+		}
+		return 0;
+	}
+
+	verbose_printf(ctx, "xcrun: info: attempting to retrieve developer path from configuration cache...\n");
+	if ((home_path = ctx_getenv(ctx, "HOME")) == NULL) {
+		set_error(ctx, "failed to read HOME variable.");
+		return -1;
+	}
+
+	snprintf(cfg_path, sizeof(cfg_path), "%s/%s", home_path, SDK_CFG);
+
+	if ((fd = open(cfg_path, O_RDONLY)) == -1) {
+		set_error(ctx, "unable to read configuration cache. (%s)", strerror(errno));
+		return -1;
+	}
+
+	/* xcode-select renames a complete file into place, so one read always sees a whole selection. */
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	if (len <= 0) {
+		set_error(ctx, "unable to read configuration cache. (%s)", (len == 0 ? "empty file" : strerror(errno)));
+		return -1;
+	}
+
+	buf[len] = '\0';
+
+	/* The path may be followed by the generation of the selection. */
+	if ((end = strchr(buf, '\n')) != NULL) {
+		*end++ = '\0';
+		ctx->generation = strtoull(end, NULL, 10);
+	}
+
+	if (*buf == '\0' || snprintf(ctx->developer_dir, sizeof(ctx->developer_dir), "%s", buf) >= (int)sizeof(ctx->developer_dir)) {
+		set_error(ctx, "unable to read configuration cache. (%s)", "invalid path");
+		return -1;
+	}
+
+	verbose_printf(ctx, "xcrun: info: using developer path \'%s\' from configuration cache.\n", ctx->developer_dir);
+
+	return 0;
+}
+
+/**
+ * @func get_bundle_path -- Return the path of a named sdk or toolchain of the developer folder
+ * @arg ctx    - context
+ * @arg folder - folder of the developer dir holding the bundle ("SDKs" or "Toolchains")
+ * @arg name   - name of the bundle
+ * @arg ext    - extension of the bundle ("sdk" or "toolchain")
+ * @return: newly allocated absolute path on success, NULL on failure
+ */
+static char *get_bundle_path(xcrun_ctx *ctx, const char *folder, const char *name, const char *ext)
+{
+	char *path;
+
+	if ((path = format_string("%s/%s/%s.%s", ctx->developer_dir, folder, name, ext)) == NULL) {
+		set_error(ctx, "out of memory.");
+		return NULL;
+	}
+
+	if (validate_directory_path(ctx, path) != (-1))
+		return path;
+
+	set_error(ctx, "\'%s\' is not a valid %s path.", path, ext);
+	free(path);
+
+	return NULL;
+}
+
+/**
+ * @func get_toolchain_path -- Return the specified toolchain path
+ * @arg ctx  - context
+ * @arg name - name of the toolchain
+ * @return: newly allocated absolute path of toolchain on success, NULL on failure
+ */
+static char *get_toolchain_path(xcrun_ctx *ctx, const char *name)
+{
+	if (name == NULL) {
+		set_error(ctx, "no toolchain specified for sdk \'%s\'.", ctx->current_sdk);
+		return NULL;
+	}
+
+	return get_bundle_path(ctx, "Toolchains", name, "toolchain");
+}
+
+/**
+ * @func get_sdk_path -- Return the specified sdk path
+ * @arg ctx  - context
+ * @arg name - name of the sdk
+ * @return: newly allocated absolute path of sdk on success, NULL on failure
+ */
+static char *get_sdk_path(xcrun_ctx *ctx, const char *name)
+{
+	return get_bundle_path(ctx, "SDKs", name, "sdk");
+}
+
+/**
+ * @func parse_target_triple -- Generate target triple by parsing iOS/MacOSX version and cpu architecture
+ * @arg triple - buffer to place the target triple
+ * @arg ver    - macOS or iOS version
+ * @arg arch   - macOS or iOS cpu architecture
+ */
+static void parse_target_triple(char *triple, const char *ver, const char *arch)
+{
+	int where = 1;
+	bool is_macosx = false;
+	int xx, yy, zz, ch, kern_ver;
+
+	if (ver == NULL)
+		return;
+
+	/* For now, assume that any x86 target is macOS. */
+	if ((strcmp(arch, "x86_64") == 0) || (strcmp(arch, "i386") == 0))
+		is_macosx = true;
+
+	xx = yy = zz = 0;
+
+	do {
+		ch = (int)*ver;
+
+		switch (ch) {
+			case '9':
+			case '8':
+			case '7':
+			case '6':
+			case '5':
+			case '4':
+			case '3':
+			case '2':
+			case '1':
+			case '0':
+				{
+					switch (where) {
+						case 1: /* major */
+							xx *= 10;
+							xx += (ch - '0');
+							break;
+						case 2: /* minor */
+							yy *= 10;
+							yy += (ch - '0');
+							break;
+						case 3: /* patch */
+							zz *= 10;
+							zz += (ch - '0');
+						default:
+							break;
+					}
+					break;
+				}
+			case '.':
+			default:
+				where++;
+				break;
+		}
+	} while (*ver++ != '\0');
+
+	switch (xx) {
+		case 11:
+			kern_ver = 17;
+			break;
+		case 10:
+			{
+				if (is_macosx)
+					kern_ver = (yy + 4);
+				else
+					kern_ver = 16;
+				break;
+			}
+		case 9:
+			kern_ver = 15;
+			break;
+		case 8:
+		case 7:
+			kern_ver = 14;
+			break;
+		case 6:
+			kern_ver = 13;
+			break;
+		case 5:
+			kern_ver = 11;
+			break;
+		case 4:
+			{
+				if (yy <= 2)
+					kern_ver = 10;
+				else
+					kern_ver = 11;
+				break;
+			}
+		case 3:
+			kern_ver = 10;
+			break;
+		case 2:
+			kern_ver = 9;
+			break;
+		case 1:
+		default:
+			kern_ver = 9;
+			break;
+	}
+
+	sprintf(triple, "%s-apple-darwin%d", arch, kern_ver);
+
+	return;
+}
+
+/**
+ * @func import_context -- Pick up the resolution context exported by a parent xcrun, if it is usable.
+ * @arg ctx - context
+ *
+ * A parent xcrun exports everything it resolved from the developer folder in XCRUN_CONTEXT_ENV.
+ * As long as we are working on the same developer folder, the SDK and Toolchain described there
+ * are used as-is, which saves us from touching any configuration file in recursive calls.
+ */
+static void import_context(xcrun_ctx *ctx)
+{
+	int i;
+	char *field;
+	const char *env;
+	inherited_context *inherited = &ctx->inherited;
+
+	if ((env = ctx_getenv(ctx, XCRUN_CONTEXT_ENV)) == NULL || (inherited->env = strdup(env)) == NULL)
+		return;
+
+	for (i = 0, field = inherited->env; i < CONTEXT_NFIELDS && field != NULL; i++) {
+		inherited->fields[i] = field;
+		if ((field = strchr(field, '|')) != NULL)
+			*field++ = '\0';
+	}
+
+	if (i != CONTEXT_NFIELDS || field != NULL ||
+	    strcmp(inherited->fields[CONTEXT_VERSION], XCRUN_CONTEXT_VERSION) != 0 ||
+	    strcmp(inherited->fields[CONTEXT_DEVELOPER_DIR], ctx->developer_dir) != 0 ||
+	    *inherited->fields[CONTEXT_SDK_PATH] == '\0' || *inherited->fields[CONTEXT_TOOLCHAIN_PATH] == '\0') {
+		verbose_printf(ctx, "xcrun: info: ignoring stale or malformed %s.\n", XCRUN_CONTEXT_ENV);
+		free(inherited->env);
+		memset(inherited, 0, sizeof(*inherited));
+		return;
+	}
+
+	get_bundle_name(inherited->sdk, sizeof(inherited->sdk), inherited->fields[CONTEXT_SDK_PATH]);
+	get_bundle_name(inherited->toolchain, sizeof(inherited->toolchain), inherited->fields[CONTEXT_TOOLCHAIN_PATH]);
+
+	verbose_printf(ctx, "xcrun: info: using resolution context inherited from parent (sdk \'%s\', toolchain \'%s\').\n", inherited->sdk, inherited->toolchain);
+
+	inherited->valid = true;
+}
+
+/* helper function to turn an empty inherited field into a missing value */
+static const char *inherited_field(const xcrun_ctx *ctx, int field)
+{
+	return (*ctx->inherited.fields[field] != '\0' ? ctx->inherited.fields[field] : NULL);
+}
+
+/* helper function to test whether the inherited context describes the current sdk */
+static bool inherited_sdk_matches(const xcrun_ctx *ctx)
+{
+	return (ctx->inherited.valid && strcmp(ctx->current_sdk, ctx->inherited.sdk) == 0);
+}
+
+/* helper function to test whether the inherited context describes the current toolchain */
+static bool inherited_toolchain_matches(const xcrun_ctx *ctx)
+{
+	return (ctx->inherited.valid && strcmp(ctx->current_toolchain, ctx->inherited.toolchain) == 0);
+}
+
+/**
+ * @func context_get_default_config -- Return xcrun's default configuration, loading it on first use.
+ * @arg ctx - context
+ * @return: default config info, NULL on failure
+ */
+static const default_config *context_get_default_config(xcrun_ctx *ctx)
+{
+	if (!ctx->context.have_default_cfg) {
+		if (get_default_info(ctx, XCRUN_DEFAULT_CFG, &ctx->context.default_cfg) != 0)
+			return NULL;
+		ctx->context.have_default_cfg = true;
+	}
+
+	return &ctx->context.default_cfg;
+}
+
+/**
+ * @func resolve_sdk_and_toolchain -- Fall back to the environment or defaults for an unspecified SDK and/or Toolchain.
+ * @arg ctx - context
+ * @return: 0 on success, -1 on failure
+ */
+static int resolve_sdk_and_toolchain(xcrun_ctx *ctx)
+{
+	const char *sdk_env, *toolchain_env;
+	const default_config *config;
+
+	if (strlen(ctx->current_sdk) == 0) {
+		if ((sdk_env = ctx_getenv(ctx, "SDKROOT")) != NULL) {
+			get_bundle_name(ctx->current_sdk, sizeof(ctx->current_sdk), sdk_env);
+		} else if (ctx->inherited.valid) {
+			strcpy(ctx->current_sdk, ctx->inherited.sdk);
+		} else {
+			if ((config = context_get_default_config(ctx)) == NULL)
+				return -1;
+			if (config->sdk == NULL) {
+				set_error(ctx, "no default sdk in \'%s\'.", XCRUN_DEFAULT_CFG);
+				return -1;
+			}
+			snprintf(ctx->current_sdk, sizeof(ctx->current_sdk), "%s", config->sdk);
+		}
+	}
+
+	if (strlen(ctx->current_toolchain) == 0) {
+		if ((toolchain_env = ctx_getenv(ctx, "TOOLCHAINS")) != NULL) {
+			get_bundle_name(ctx->current_toolchain, sizeof(ctx->current_toolchain), toolchain_env);
+		} else if (ctx->inherited.valid) {
+			strcpy(ctx->current_toolchain, ctx->inherited.toolchain);
+		} else {
+			if ((config = context_get_default_config(ctx)) == NULL)
+				return -1;
+			if (config->toolchain == NULL) {
+				set_error(ctx, "no default toolchain in \'%s\'.", XCRUN_DEFAULT_CFG);
+				return -1;
+			}
+			snprintf(ctx->current_toolchain, sizeof(ctx->current_toolchain), "%s", config->toolchain);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @func context_get_sdk_path -- Return the path of the current sdk.
+ * @arg ctx - context
+ * @return: absolute path of sdk on success, NULL on failure
+ */
+static const char *context_get_sdk_path(xcrun_ctx *ctx)
+{
+	if (ctx->context.sdk_path == NULL) {
+		if (resolve_sdk_and_toolchain(ctx) != 0)
+			return NULL;
+		if (!inherited_sdk_matches(ctx))
+			ctx->context.sdk_path = get_sdk_path(ctx, ctx->current_sdk);
+		else if ((ctx->context.sdk_path = strdup(ctx->inherited.fields[CONTEXT_SDK_PATH])) == NULL)
+			set_error(ctx, "out of memory.");
+	}
+
+	return ctx->context.sdk_path;
+}
+
+/**
+ * @func context_get_sdk_config -- Return the info.ini contents of the current sdk.
+ * @arg ctx - context
+ * @return: sdk config info, NULL on failure
+ */
+static const sdk_config *context_get_sdk_config(xcrun_ctx *ctx)
+{
+	sdk_config *config = &ctx->context.sdk_cfg;
+
+	if (!ctx->context.have_sdk_cfg) {
+		if (context_get_sdk_path(ctx) == NULL)
+			return NULL;
+		if (inherited_sdk_matches(ctx) && inherited_field(ctx, CONTEXT_SDK_NAME) != NULL) {
+			/* The inherited fields outlive the config, there is no document to own them. */
+			config->name = inherited_field(ctx, CONTEXT_SDK_NAME);
+			config->version = inherited_field(ctx, CONTEXT_SDK_VERSION);
+			config->toolchain = inherited_field(ctx, CONTEXT_SDK_TOOLCHAIN);
+			config->default_arch = inherited_field(ctx, CONTEXT_SDK_DEFAULT_ARCH);
+			config->archs = inherited_field(ctx, CONTEXT_SDK_ARCHS);
+			config->deployment_target = inherited_field(ctx, CONTEXT_DEPLOYMENT_TARGET);
+			config->deployment_target_var = inherited_field(ctx, CONTEXT_DEPLOYMENT_TARGET_VAR);
+		} else if (get_sdk_info(ctx, ctx->context.sdk_path, config) != 0) {
+			return NULL;
+		}
+		ctx->context.have_sdk_cfg = true;
+	}
+
+	return config;
+}
+
+/**
+ * @func context_get_toolchain_path -- Return the path of the current toolchain.
+ * @arg ctx - context
+ * @return: absolute path of toolchain on success, NULL on failure
+ */
+static const char *context_get_toolchain_path(xcrun_ctx *ctx)
+{
+	if (ctx->context.toolchain_path == NULL) {
+		if (resolve_sdk_and_toolchain(ctx) != 0)
+			return NULL;
+		if (!inherited_toolchain_matches(ctx))
+			ctx->context.toolchain_path = get_toolchain_path(ctx, ctx->current_toolchain);
+		else if ((ctx->context.toolchain_path = strdup(ctx->inherited.fields[CONTEXT_TOOLCHAIN_PATH])) == NULL)
+			set_error(ctx, "out of memory.");
+	}
+
+	return ctx->context.toolchain_path;
+}
+
+/**
+ * @func context_get_toolchain_config -- Return the info.ini contents of the current toolchain.
+ * @arg ctx - context
+ * @return: toolchain config info, NULL on failure
+ */
+static const toolchain_config *context_get_toolchain_config(xcrun_ctx *ctx)
+{
+	const char *path;
+
+	if (!ctx->context.have_toolchain_cfg) {
+		if ((path = context_get_toolchain_path(ctx)) == NULL || get_toolchain_info(ctx, path, &ctx->context.toolchain_cfg) != 0)
+			return NULL;
+		ctx->context.have_toolchain_cfg = true;
+	}
+
+	return &ctx->context.toolchain_cfg;
+}
+
+/**
+ * @func context_get_sdk_target_triple -- Return the target triple described by the current sdk's info.ini.
+ * @arg ctx - context
+ * @return: target triple string, NULL on failure (with the error set) or if the sdk doesn't describe one
+ */
+static const char *context_get_sdk_target_triple(xcrun_ctx *ctx)
+{
+	const sdk_config *config;
+	const char *source = NULL;
+	char triple[NAME_MAX] = { 0 };
+	trace_span span;
+
+	if (!ctx->context.have_target_triple) {
+		if (context_get_sdk_path(ctx) == NULL)
+			return NULL;
+		if (inherited_sdk_matches(ctx) && inherited_field(ctx, CONTEXT_TARGET_TRIPLE) != NULL) {
+			source = ctx->inherited.fields[CONTEXT_TARGET_TRIPLE];
+		} else {
+			if ((config = context_get_sdk_config(ctx)) == NULL)
+				return NULL;
+			trace_begin(&span, "target triple");
+			if (config->target_triple != NULL) {
+				source = config->target_triple;
+			} else if (config->default_arch != NULL && config->deployment_target != NULL) {
+				parse_target_triple(triple, config->deployment_target, config->default_arch);
+				source = triple;
+			}
+			trace_end(&span);
+		}
+		if (source != NULL && (ctx->context.target_triple = strdup(source)) == NULL) {
+			set_error(ctx, "out of memory.");
+			return NULL;
+		}
+		ctx->context.have_target_triple = true;
+	}
+
+	return ctx->context.target_triple;
+}
+
+/**
+ * @func context_get_deployment_target -- Return the deployment target described by the current sdk's info.ini.
+ * @arg ctx - context
+ * @arg var - set to the name of the environment variable the deployment target belongs in (may be empty)
+ * @return: deployment target string, NULL on failure (with the error set) or if the sdk doesn't specify one
+ */
+static const char *context_get_deployment_target(xcrun_ctx *ctx, const char **var)
+{
+	const sdk_config *config;
+
+	*var = "";
+
+	if ((config = context_get_sdk_config(ctx)) == NULL)
+		return NULL;
+
+	if (config->deployment_target_var != NULL)
+		*var = config->deployment_target_var;
+
+	return config->deployment_target;
+}
+
+/**
+ * @func get_target_triple -- get the target triple for the current sdk.
+ * @arg ctx - context
+ * @return: target triple string or NULL on error (TARGET_TRIPLE env variable takes precedence)
+ */
+static const char *get_target_triple(xcrun_ctx *ctx)
+{
+	const char *triple;
+
+	if ((triple = ctx_getenv(ctx, "TARGET_TRIPLE")) != NULL)
+		return triple;
+
+	return context_get_sdk_target_triple(ctx);
+}
+
+/**
+ * @func get_exec_info -- Resolve the sdk information passed to the environment of an executed tool.
+ * @arg ctx   - context
+ * @arg entry - entry to fill in
+ * @return: 0 on success, -1 on failure
+ *
+ * Environment overrides (TARGET_TRIPLE, *_DEPLOYMENT_TARGET) are deliberately left out, so that
+ * the result only depends on the developer folder and may be kept in the lookup cache.
+ */
+static int get_exec_info(xcrun_ctx *ctx, cache_entry *entry)
+{
+	const char *sdk_path, *toolchain_path, *target_triple, *deployment_target, *deployment_target_var;
+
+	if ((sdk_path = context_get_sdk_path(ctx)) == NULL || (toolchain_path = context_get_toolchain_path(ctx)) == NULL)
+		return -1;
+
+	snprintf(entry->sdk_path, sizeof(entry->sdk_path), "%s", sdk_path);
+	snprintf(entry->toolchain_path, sizeof(entry->toolchain_path), "%s", toolchain_path);
+
+	if ((target_triple = context_get_sdk_target_triple(ctx)) != NULL)
+		snprintf(entry->target_triple, sizeof(entry->target_triple), "%s", target_triple);
+	else if (ctx->error != NULL)
+		return -1;
+
+	if ((deployment_target = context_get_deployment_target(ctx, &deployment_target_var)) != NULL) {
+		snprintf(entry->deployment_target_var, sizeof(entry->deployment_target_var), "%s", deployment_target_var);
+		snprintf(entry->deployment_target, sizeof(entry->deployment_target), "%s", deployment_target);
+	} else if (ctx->error != NULL) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @func get_tool_profile -- Find the tool profile for a program in a toolchain's info.ini.
+ * @arg ctx            - context
+ * @arg toolchain_path - toolchain to look in (may be NULL)
+ * @arg name           - name of program (matched against profile names and aliases)
+ * @arg profile        - set to the tool profile, or NULL if the toolchain has none for this program
+ * @return: 0 on success, -1 on failure
+ */
+static int get_tool_profile(xcrun_ctx *ctx, const char *toolchain_path, const char *name, const tool_profile **profile)
+{
+	int i;
+	const toolchain_config *config;
+
+	*profile = NULL;
+
+	if (toolchain_path == NULL || test_sdk_authenticity(toolchain_path) == 0)
+		return 0;
+
+	if (ctx->context.toolchain_path != NULL && strcmp(toolchain_path, ctx->context.toolchain_path) == 0) {
+		if ((config = context_get_toolchain_config(ctx)) == NULL)
+			return -1;
+	} else {
+		free_toolchain_config(&ctx->other_cfg);
+		if (get_toolchain_info(ctx, toolchain_path, &ctx->other_cfg) != 0)
+			return -1;
+		config = &ctx->other_cfg;
+	}
+
+	for (i = 0; i < config->ntools; i++) {
+		if (config->tools[i].path == NULL)
+			continue;
+		if (strcmp(config->tools[i].name, name) == 0 || name_in_list(name, config->tools[i].aliases)) {
+			*profile = &config->tools[i];
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @func expand_profile_word -- Substitute ${SDKROOT}, ${TARGET_TRIPLE}, ${TOOLCHAIN_DIR} and ${DEVELOPER_DIR} in a tool profile value.
+ * @arg ctx           - context
+ * @arg word          - start of the word to expand
+ * @arg len           - length of the word
+ * @arg tool          - resolved tool
+ * @arg target_triple - target triple passed to the tool
+ * @return: newly allocated expanded word
+ */
+static char *expand_profile_word(const xcrun_ctx *ctx, const char *word, size_t len, const xcrun_tool *tool, const char *target_triple)
+{
+	int i;
+	char *buf;
+	size_t n, out = 0, size = len + 1;
+	const char *names[4] = { "SDKROOT", "TARGET_TRIPLE", "TOOLCHAIN_DIR", "DEVELOPER_DIR" };
+	const char *values[4] = { tool->sdk_path, (target_triple != NULL ? target_triple : ""), tool->toolchain_path, ctx->developer_dir };
+
+	for (i = 0; i < 4; i++)
+		size += strlen(values[i]) * (len / 3);
+
+	if ((buf = (char *)calloc(size, sizeof(char))) == NULL)
+		return NULL;
+
+	while (len > 0) {
+		for (i = 0; i < 4; i++) {
+			n = strlen(names[i]);
+			if (len >= n + 3 && word[0] == '$' && word[1] == '{' && strncmp(word + 2, names[i], n) == 0 && word[n + 2] == '}')
+				break;
+		}
+
+		if (i < 4) {
+			strcpy(buf + out, values[i]);
+			out += strlen(values[i]);
+			word += strlen(names[i]) + 3;
+			len -= strlen(names[i]) + 3;
+		} else {
+			buf[out++] = *word++;
+			len--;
+		}
+	}
+
+	return buf;
+}
+
+/* helper function to pick the target triple a tool runs with */
+static const char *get_exec_target_triple(const xcrun_ctx *ctx, const xcrun_tool *tool)
+{
+	const char *target_triple;
+
+	/* An architecture picked for this one tool beats whatever the environment says. */
+	if (*tool->arch != '\0')
+		return tool->target_triple;
+
+	if ((target_triple = ctx_getenv(ctx, "TARGET_TRIPLE")) == NULL && *tool->target_triple != '\0')
+		target_triple = tool->target_triple;
+
+	return target_triple;
+}
+
+/* helper function to append a field to an exported context, refusing values that would break it */
+static int append_context_field(char *buf, size_t size, const char *value)
+{
+	size_t len = strlen(buf);
+
+	if (value == NULL)
+		value = "";
+
+	if (strchr(value, '|') != NULL || len + strlen(value) + 2 > size)
+		return -1;
+
+	sprintf(buf + len, "%s%s", (len > 0 && buf[len - 1] != '=' ? "|" : ""), value);
+
+	return 0;
+}
+
+/**
+ * @func export_context -- Build the XCRUN_CONTEXT_ENV environment string for a tool about to be executed.
+ * @arg ctx  - context
+ * @arg tool - resolved tool
+ * @return: environment string, or NULL if the context can't be represented
+ */
+static char *export_context(const xcrun_ctx *ctx, const xcrun_tool *tool)
+{
+	int status = 0;
+	size_t size = (PATH_MAX * 4);
+	char *buf = (char *)calloc(size, sizeof(char));
+	const sdk_config *config = (ctx->context.have_sdk_cfg ? &ctx->context.sdk_cfg : NULL);
+
+	if (buf == NULL)
+		return NULL;
+
+	sprintf(buf, "%s=", XCRUN_CONTEXT_ENV);
+
+	status |= append_context_field(buf, size, XCRUN_CONTEXT_VERSION);
+	status |= append_context_field(buf, size, ctx->developer_dir);
+	status |= append_context_field(buf, size, tool->sdk_path);
+	status |= append_context_field(buf, size, tool->toolchain_path);
+	status |= append_context_field(buf, size, tool->target_triple);
+	status |= append_context_field(buf, size, tool->deployment_target_var);
+	status |= append_context_field(buf, size, tool->deployment_target);
+	status |= append_context_field(buf, size, (config != NULL ? config->name : NULL));
+	status |= append_context_field(buf, size, (config != NULL ? config->version : NULL));
+	status |= append_context_field(buf, size, (config != NULL ? config->toolchain : NULL));
+	status |= append_context_field(buf, size, (config != NULL ? config->default_arch : NULL));
+	status |= append_context_field(buf, size, (config != NULL ? config->archs : NULL));
+
+	if (status != 0) {
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/* helper function to find the stamp a cache entry recorded for a directory */
+static const cache_stamp *find_stamp(const cache_entry *entry, const char *path)
+{
+	int i;
+
+	for (i = 0; i < entry->nstamps; i++) {
+		if (strcmp(entry->stamps[i].path, path) == 0)
+			return &entry->stamps[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * @func search_command -- Search a set of directories for a given command
+ * @arg ctx   - context
+ * @arg buf   - buffer to hold the absolute path to the command
+ * @arg name  - command name
+ * @arg dirs  - set of directories to search, seperated by colons
+ * @arg entry - cache entry holding the stamps of dirs (see add_search_stamps)
+ * @return: 0 on a successful search, -1 on failure
+ */
+static int search_command(xcrun_ctx *ctx, char *buf, const char *name, char *dirs, const cache_entry *entry)
+{
+	char *cmd_search_path, *state;
+	char cmd_absl_path[PATH_MAX] = { 0 };
+	const cache_stamp *stamp;
+	bool indexed;
+
+	/* Reading the directories only pays off for contexts that go on searching (batches, library users, the daemon). */
+	indexed = (ctx->searches++ > 0);
+
+	/* Search each path entry in dirs until we find our program. */
+	cmd_search_path = strtok_r(dirs, ":", &state);
+	while (cmd_search_path != NULL) {
+		verbose_printf(ctx, "xcrun: info: checking directory \'%s\' for command \'%s\'...\n", cmd_search_path, name);
+
+		/* Directories that don't hold the name at all are ruled out by their index, without touching the file system. */
+		if (indexed && (stamp = find_stamp(entry, cmd_search_path)) != NULL && dirindex_lookup(&ctx->indexes, stamp, name) == 0) {
+			errno = ENOENT;
+			cmd_search_path = strtok_r(NULL, ":", &state);
+			continue;
+		}
+
+		/* Construct our program's absolute path. */
+		snprintf(cmd_absl_path, sizeof(cmd_absl_path), "%s/%s", cmd_search_path, name);
+
+		/* Does it exist? Is it an executable? */
+		if (access(cmd_absl_path, (F_OK | X_OK)) == 0) {
+			verbose_printf(ctx, "xcrun: info: found command's absolute path: \'%s\'\n", cmd_absl_path);
+			strcpy(buf, cmd_absl_path);
+			return 0;
+		}
+
+		/* If not, move onto the next entry.. */
+		memset(cmd_absl_path, 0, PATH_MAX);
+		cmd_search_path = strtok_r(NULL, ":", &state);
+	}
+
+	return -1;
+}
+
+/**
+ * @func get_cache_key -- Build the lookup cache key for a program.
+ * @arg ctx  - context
+ * @arg key  - buffer to hold the key
+ * @arg size - size of key buffer
+ * @arg name - name of program
+ * @return: 0 on success, -1 if the key doesn't fit, in which case it must not be used
+ *
+ * The key covers every input that changes where a program is found or what environment it gets,
+ * short of the files themselves, which are covered by the stamps of the cache entry.
+ */
+static int get_cache_key(const xcrun_ctx *ctx, char *key, size_t size, const char *name)
+{
+	int len;
+	const char *sdk_env, *toolchain_env;
+
+	if (strlen(ctx->sdk) != 0)
+		sdk_env = "";
+	else if ((sdk_env = ctx_getenv(ctx, "SDKROOT")) == NULL)
+		sdk_env = (ctx->inherited.valid ? ctx->inherited.sdk : "");
+
+	if (strlen(ctx->toolchain) != 0)
+		toolchain_env = "";
+	else if ((toolchain_env = ctx_getenv(ctx, "TOOLCHAINS")) == NULL)
+		toolchain_env = (ctx->inherited.valid ? ctx->inherited.toolchain : "");
+
+	/* A switch, even back to the same folder, misses every entry of the previous selection right away. */
+	len = snprintf(key, size, "%s|%llu|%s|%s|%s|%s|%s|%s|%d%d%d|%s",
+		ctx->developer_dir, ctx->generation, ctx->sdk, sdk_env, ctx->toolchain, toolchain_env,
+		(ctx->alternate_sdk_path != NULL ? ctx->alternate_sdk_path : ""),
+		(ctx->alternate_toolchain_path != NULL ? ctx->alternate_toolchain_path : ""),
+		ctx->explicit_sdk_mode, ctx->explicit_toolchain_mode, ctx->finding_mode, name);
+
+	/* A truncated key could match the entry of a different selection that shares its beginning. */
+	return ((len < 0 || (size_t)len >= size) ? -1 : 0);
+}
+
+/**
+ * @func add_search_stamps -- Record each directory of a search string in a cache entry.
+ * @arg entry - cache entry being built
+ * @arg dirs  - set of directories to search, seperated by colons
+ */
+static void add_search_stamps(cache_entry *entry, const char *dirs)
+{
+	const char *end;
+	char dir[PATH_MAX];
+
+	for (; *dirs != '\0'; dirs = (*end == ':' ? end + 1 : end)) {
+		end = strchr(dirs, ':');
+		if (end == NULL)
+			end = dirs + strlen(dirs);
+		if (end == dirs || (end - dirs) >= PATH_MAX)
+			continue;
+		memcpy(dir, dirs, (end - dirs));
+		dir[end - dirs] = '\0';
+		cache_add_stamp(entry, dir);
+	}
+}
+
+/* helper function to append an environment variable to a daemon request ("-" if unset, "=value" otherwise) */
+static int append_request_env(const xcrun_ctx *ctx, char *buf, size_t size, const char *name)
+{
+	size_t len = strlen(buf);
+	const char *value = ctx_getenv(ctx, name);
+
+	if (value != NULL && strpbrk(value, "\t\n") != NULL)
+		return -1;
+
+	if (snprintf(buf + len, size - len, "\t%s%s", (value != NULL ? "=" : "-"), (value != NULL ? value : "")) >= (int)(size - len))
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @func get_daemon_request -- Build the request asking xcrund to resolve a program.
+ * @arg ctx  - context
+ * @arg buf  - buffer to hold the request
+ * @arg size - size of request buffer
+ * @arg name - name of program
+ * @return: 0 on success, -1 if the request can't be represented
+ *
+ * The request carries every input of get_cache_key, along with the environment variables that
+ * feed into it, so that the daemon can resolve the program exactly the way we would.
+ */
+static int get_daemon_request(const xcrun_ctx *ctx, char *buf, size_t size, const char *name)
+{
+	size_t len;
+
+	if (strpbrk(ctx->developer_dir, "\t\n") != NULL || strpbrk(ctx->sdk, "\t\n") != NULL ||
+	    strpbrk(ctx->toolchain, "\t\n") != NULL || strpbrk(name, "\t\n") != NULL)
+		return -1;
+
+	if (snprintf(buf, size, "%s\t%s\t%llu\t%s\t%s", XCRUND_PROTOCOL, ctx->developer_dir, ctx->generation, ctx->sdk, ctx->toolchain) >= (int)size)
+		return -1;
+
+	if (append_request_env(ctx, buf, size, "SDKROOT") != 0 || append_request_env(ctx, buf, size, "TOOLCHAINS") != 0 ||
+	    append_request_env(ctx, buf, size, XCRUN_CONTEXT_ENV) != 0)
+		return -1;
+
+	len = strlen(buf);
+	if (snprintf(buf + len, size - len, "\t%c\t%s", (ctx->finding_mode ? 'f' : 'r'), name) >= (int)(size - len))
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @func daemon_lookup -- Ask a running xcrund to resolve a program.
+ * @arg ctx   - context
+ * @arg entry - entry to fill in, its key must already be set
+ * @arg name  - name of program
+ * @return: 0 if the daemon answered, -1 otherwise
+ */
+static int daemon_lookup(const xcrun_ctx *ctx, cache_entry *entry, const char *name)
+{
+	int status;
+	char *reply;
+	char key[XCRUN_CACHE_MAX_KEY];
+	char request[XCRUND_MAX_REQUEST];
+
+	/* Alternate paths live outside of the developer folder, which is all the daemon keeps an eye on. */
+	if (ctx->alternate_sdk_path != NULL || ctx->alternate_toolchain_path != NULL)
+		return -1;
+
+	if (get_daemon_request(ctx, request, sizeof(request), name) != 0 || (reply = daemon_request(request)) == NULL)
+		return -1;
+
+	strcpy(key, entry->key);
+	status = cache_parse_entry(reply, entry);
+	free(reply);
+
+	/* Don't trust an answer to a different question. */
+	if (status != 0 || strcmp(entry->key, key) != 0) {
+		memset(entry, 0, sizeof(*entry));
+		strcpy(entry->key, key);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* helper function to record the stamp of a bundle's info.ini in a cache entry */
+static void add_info_stamp(cache_entry *entry, const char *bundle_path)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/info.ini", bundle_path) < (int)sizeof(path))
+		cache_add_stamp(entry, path);
+}
+
+/**
+ * @func resolve_command -- Locate a program, through the lookup cache if possible.
+ * @arg ctx  - context
+ * @arg name - name of program
+ * @return: resolved program (with its exec info unless in finding mode), or NULL on failure
+ */
+static const cache_entry *resolve_command(xcrun_ctx *ctx, const char *name)
+{
+	cache_entry *entry = &ctx->entry;
+	char *search_string = NULL;
+	trace_span span;
+	int status;
+	const char *sdk_path, *toolch_name, *profile_toolchain = NULL;
+	const sdk_config *config;
+	const default_config *defaults;
+	const tool_profile *profile = NULL;
+	sdk_config alternate_cfg;
+	int nocache_mode = ((ctx->flags & XCRUN_NO_CACHE) != 0);
+
+	memset(entry, 0, sizeof(*entry));
+	if (get_cache_key(ctx, entry->key, sizeof(entry->key), name) != 0) {
+		verbose_printf(ctx, "xcrun: info: lookup cache key for command \'%s\' is too long, not using the lookup cache.\n", name);
+		nocache_mode = 1;
+	}
+
+	/* A running xcrund lets us skip the developer folder entirely, without as much as a stat(). */
+	if (nocache_mode == 0 && (ctx->flags & XCRUN_NO_DAEMON) == 0 && daemon_lookup(ctx, entry, name) == 0) {
+		verbose_printf(ctx, "xcrun: info: found command's absolute path through xcrund: \'%s\'\n", entry->tool_path);
+		ctx->source = XCRUN_SOURCE_DAEMON;
+		return entry;
+	}
+
+	/* Otherwise, so does a valid entry in the lookup cache, which other xcruns may have just shared. */
+	if (nocache_mode == 0) {
+		if (hotcache_lookup(entry->key, entry) == 0) {
+			verbose_printf(ctx, "xcrun: info: found command's absolute path in shared lookup cache: \'%s\'\n", entry->tool_path);
+			ctx->source = XCRUN_SOURCE_SHARED;
+			return entry;
+		}
+
+		/* A miss may have left anything in the entry, its key included. */
+		memset(entry, 0, sizeof(*entry));
+		get_cache_key(ctx, entry->key, sizeof(entry->key), name);
+
+		if (cache_lookup(entry->key, entry) == 0) {
+			verbose_printf(ctx, "xcrun: info: found command's absolute path in lookup cache: \'%s\'\n", entry->tool_path);
+			hotcache_store(entry);
+			ctx->source = XCRUN_SOURCE_CACHE;
+			return entry;
+		}
+		verbose_printf(ctx, "xcrun: info: no valid lookup cache entry for command \'%s\'.\n", name);
+
+		/* Don't let a stale entry leak into the one we are about to build. */
+		memset(entry, 0, sizeof(*entry));
+		get_cache_key(ctx, entry->key, sizeof(entry->key), name);
+	}
+
+	/*
+	 * If xcrun was called in a multicall state, we still want to specify current_sdk for SDKROOT and
+	 * current_toolchain for PATH.
+	 */
+	if (resolve_sdk_and_toolchain(ctx) != 0)
+		return NULL;
+
+	/* No matter the circumstance, search the developer dir. */
+	if (append_search_dir(&search_string, ctx->developer_dir) != 0)
+		goto nomem;
+
+	/* If we explicitly specified an sdk, search the sdk and it's associated toolchain. */
+	if (ctx->explicit_sdk_mode == 1) {
+		if ((config = context_get_sdk_config(ctx)) == NULL)
+			goto failure;
+		toolch_name = config->toolchain;
+		if ((profile_toolchain = get_toolchain_path(ctx, toolch_name)) == NULL)
+			goto failure;
+		if (append_search_dir(&search_string, ctx->context.sdk_path) != 0 || append_search_dir(&search_string, profile_toolchain) != 0)
+			goto nomem;
+		goto do_search;
+	}
+
+	/* If we explicitly specified a toolchain, only search the toolchain. */
+	if (ctx->explicit_toolchain_mode == 1) {
+		if ((profile_toolchain = context_get_toolchain_path(ctx)) == NULL)
+			goto failure;
+		if (append_search_dir(&search_string, profile_toolchain) != 0)
+			goto nomem;
+		goto do_search;
+	}
+
+	/* If we explicitly specified an SDK, append it to the search string. */
+	if (ctx->alternate_sdk_path != NULL) {
+		if (append_search_dir(&search_string, ctx->alternate_sdk_path) != 0)
+			goto nomem;
+		/* We also want to append an associated toolchain if this is really an SDK folder. */
+		if (test_sdk_authenticity(ctx->alternate_sdk_path) == 1) {
+			if (get_sdk_info(ctx, ctx->alternate_sdk_path, &alternate_cfg) != 0)
+				goto failure;
+			profile_toolchain = get_toolchain_path(ctx, alternate_cfg.toolchain);
+			free_sdk_config(&alternate_cfg);
+			if (profile_toolchain == NULL)
+				goto failure;
+			if (append_search_dir(&search_string, profile_toolchain) != 0)
+				goto nomem;
+			/* We now have a toolchain, so skip to search. */
+			goto do_search;
+		}
+	}
+
+	/* If we explicitly specified a toolchain, append it to the search string. */
+	if (ctx->alternate_toolchain_path != NULL) {
+		profile_toolchain = ctx->alternate_toolchain_path;
+		if (append_search_dir(&search_string, ctx->alternate_toolchain_path) != 0)
+			goto nomem;
+	}
+
+	/* By default, we search our developer dir, our default sdk, and our default toolchain only. */
+	if (ctx->explicit_sdk_mode == 0 && ctx->explicit_toolchain_mode == 0 && ctx->alternate_toolchain_path == NULL && ctx->alternate_sdk_path == NULL) {
+		if ((profile_toolchain = context_get_toolchain_path(ctx)) == NULL || (sdk_path = context_get_sdk_path(ctx)) == NULL)
+			goto failure;
+		if (append_search_dir(&search_string, sdk_path) != 0 || append_search_dir(&search_string, profile_toolchain) != 0)
+			goto nomem;
+	}
+
+	/* Search each path entry in search_string until we find our program. */
+do_search:
+	entry->nstamps = 0;
+
+	/* When running a tool, a profile in the toolchain's info.ini takes precedence over any wrapper found by searching. */
+	if (ctx->finding_mode == 0 && get_tool_profile(ctx, profile_toolchain, name, &profile) != 0)
+		goto failure;
+
+	if (ctx->finding_mode == 0 && profile != NULL) {
+		verbose_printf(ctx, "xcrun: info: using tool profile \'%s\' from \'%s/info.ini\' for command \'%s\'\n", profile->name, profile_toolchain, name);
+		snprintf(entry->tool_path, sizeof(entry->tool_path), "%s", profile->path);
+		snprintf(entry->tool_args, sizeof(entry->tool_args), "%s", (profile->args != NULL ? profile->args : ""));
+		entry->profile = 1;
+	} else {
+		add_search_stamps(entry, search_string);
+
+		trace_begin(&span, "search");
+		status = search_command(ctx, entry->tool_path, name, search_string, entry);
+		trace_end(&span);
+		if (status != 0) {
+			/* We have searched everywhere, but we haven't found our program. State why. */
+			set_error(ctx, "can't stat \'%s\' (%s)", name, strerror(errno));
+			goto failure;
+		}
+
+		if (nocache_mode == 0)
+			cache_add_stamp(entry, entry->tool_path);
+	}
+
+	if (ctx->finding_mode == 0 && get_exec_info(ctx, entry) != 0)
+		goto failure;
+
+	/* Tools about to run remember whether xcrun.ini may hold them back, so that warm runs never read it to find out. */
+	if (ctx->finding_mode == 0) {
+		if ((defaults = context_get_default_config(ctx)) != NULL)
+			entry->admission = defaults->admission;
+		ctx->error = NULL;
+	}
+
+	if (nocache_mode == 0) {
+		cache_add_stamp(entry, XCRUN_DEFAULT_CFG);
+		if (ctx->finding_mode == 0 && profile_toolchain != NULL)
+			add_info_stamp(entry, profile_toolchain);
+		if ((ctx->explicit_sdk_mode == 1 || ctx->finding_mode == 0) && (sdk_path = context_get_sdk_path(ctx)) != NULL)
+			add_info_stamp(entry, sdk_path);
+		if (ctx->alternate_sdk_path != NULL)
+			add_info_stamp(entry, ctx->alternate_sdk_path);
+		if (cache_store(entry) != 0)
+			verbose_printf(ctx, "xcrun: info: failed to update lookup cache.\n");
+		hotcache_store(entry);
+	}
+
+	if (profile_toolchain != ctx->context.toolchain_path && profile_toolchain != ctx->alternate_toolchain_path)
+		free((char *)profile_toolchain);
+	free(search_string);
+	ctx->source = XCRUN_SOURCE_SEARCH;
+
+	return entry;
+
+nomem:
+	set_error(ctx, "out of memory.");
+failure:
+	if (profile_toolchain != ctx->context.toolchain_path && profile_toolchain != ctx->alternate_toolchain_path)
+		free((char *)profile_toolchain);
+	free(search_string);
+
+	return NULL;
+}
+
+/* helper function to copy a resolved program out to the caller */
+static void copy_tool(xcrun_ctx *ctx, const cache_entry *entry, xcrun_tool *tool)
+{
+	char *path;
+
+	memset(tool, 0, sizeof(*tool));
+	snprintf(tool->path, sizeof(tool->path), "%s", entry->tool_path);
+	snprintf(tool->args, sizeof(tool->args), "%s", entry->tool_args);
+	tool->profile = entry->profile;
+	tool->admission = entry->admission;
+	snprintf(tool->sdk_path, sizeof(tool->sdk_path), "%s", entry->sdk_path);
+	snprintf(tool->toolchain_path, sizeof(tool->toolchain_path), "%s", entry->toolchain_path);
+	snprintf(tool->target_triple, sizeof(tool->target_triple), "%s", entry->target_triple);
+	snprintf(tool->deployment_target_var, sizeof(tool->deployment_target_var), "%s", entry->deployment_target_var);
+	snprintf(tool->deployment_target, sizeof(tool->deployment_target), "%s", entry->deployment_target);
+	tool->source = ctx->source;
+
+	/* Profile paths may refer to the SDK, hand out the binary that actually runs. */
+	if (tool->profile && (path = expand_profile_word(ctx, tool->path, strlen(tool->path), tool, get_exec_target_triple(ctx, tool))) != NULL) {
+		snprintf(tool->path, sizeof(tool->path), "%s", path);
+		free(path);
+	}
+}
+
+/* helper function to free a context of the daemon */
+static void free_daemon_context(daemon_context *dctx)
+{
+	int i;
+
+	xcrun_free(dctx->ctx);
+	free(dctx->key);
+	if (dctx->env != NULL) {
+		for (i = 0; dctx->env[i] != NULL; i++)
+			free(dctx->env[i]);
+		free(dctx->env);
+	}
+}
+
+/**
+ * @func daemon_get_context -- Return the context resolving requests made from a given client environment.
+ * @arg fields - fields of the request (see get_daemon_request)
+ * @return: context, or NULL if the daemon can't serve this environment
+ *
+ * Clients agreeing on everything but the program to resolve share a context, along with everything
+ * it has loaded from the developer folder.
+ */
+static xcrun_ctx *daemon_get_context(char **fields)
+{
+	int i, n = 0;
+	size_t size = 1;
+	daemon_context dctx, *tmp;
+	xcrun_options options = { 0 };
+	const char *names[3] = { "SDKROOT", "TOOLCHAINS", XCRUN_CONTEXT_ENV };
+
+	if (strcmp(fields[REQUEST_DEVELOPER_DIR], daemon_owner->developer_dir) != 0)
+		return NULL;
+
+	for (i = REQUEST_PROTOCOL; i < REQUEST_MODE; i++)
+		size += strlen(fields[i]) + 1;
+
+	memset(&dctx, 0, sizeof(dctx));
+	if ((dctx.key = (char *)calloc(size, sizeof(char))) == NULL)
+		return NULL;
+
+	for (i = REQUEST_PROTOCOL; i < REQUEST_MODE; i++)
+		strcat(strcat(dctx.key, fields[i]), "\t");
+
+	for (i = 0; i < ndaemon_contexts; i++) {
+		if (strcmp(daemon_contexts[i].key, dctx.key) == 0) {
+			free(dctx.key);
+			return daemon_contexts[i].ctx;
+		}
+	}
+
+	/* The environment of the context holds exactly what the client sent over, and nothing of ours. */
+	if ((dctx.env = (char **)calloc(4, sizeof(char *))) == NULL)
+		goto failure;
+	for (i = 0; i < 3; i++) {
+		if (*fields[REQUEST_SDKROOT + i] != '=')
+			continue;
+		if ((dctx.env[n] = (char *)calloc(strlen(names[i]) + strlen(fields[REQUEST_SDKROOT + i]) + 1, sizeof(char))) == NULL)
+			goto failure;
+		sprintf(dctx.env[n++], "%s%s", names[i], fields[REQUEST_SDKROOT + i]);
+	}
+
+	options.developer_dir = daemon_owner->developer_dir;
+	options.sdk = (*fields[REQUEST_SDK] != '\0' ? fields[REQUEST_SDK] : NULL);
+	options.toolchain = (*fields[REQUEST_TOOLCHAIN] != '\0' ? fields[REQUEST_TOOLCHAIN] : NULL);
+	options.envp = dctx.env;
+	options.flags = (daemon_owner->flags | XCRUN_NO_DAEMON);
+
+	if ((dctx.ctx = xcrun_create(&options)) == NULL || xcrun_error(dctx.ctx) != NULL)
+		goto failure;
+
+	/* The developer folder came from us, its selection from the client, so that replies carry the client's lookup cache key. */
+	dctx.ctx->generation = strtoull(fields[REQUEST_GENERATION], NULL, 10);
+
+	if ((tmp = (daemon_context *)realloc(daemon_contexts, (ndaemon_contexts + 1) * sizeof(daemon_context))) == NULL)
+		goto failure;
+
+	daemon_contexts = tmp;
+	daemon_contexts[ndaemon_contexts] = dctx;
+
+	return daemon_contexts[ndaemon_contexts++].ctx;
+
+failure:
+	free_daemon_context(&dctx);
+
+	return NULL;
+}
+
+/**
+ * @func daemon_load -- Load the default SDK and Toolchain configuration, ahead of the first request.
+ */
+static void daemon_load(void)
+{
+	xcrun_ctx *ctx;
+	char generation[32];
+	char *fields[REQUEST_NFIELDS] = { XCRUND_PROTOCOL, daemon_owner->developer_dir, generation, "", "", "-", "-", "-", "r", "" };
+
+	snprintf(generation, sizeof(generation), "%llu", daemon_owner->generation);
+
+	/* Whatever fails here will fail again, and be reported, on request. */
+	if ((ctx = daemon_get_context(fields)) == NULL || xcrun_sdk_path(ctx) == NULL || xcrun_toolchain_version(ctx) == NULL)
+		return;
+
+	xcrun_target_triple(ctx);
+
+	verbose_printf(daemon_owner, "xcrund: info: loaded sdk \'%s\' and toolchain \'%s\'.\n", ctx->current_sdk, ctx->current_toolchain);
+}
+
+/**
+ * @func daemon_unload -- Drop every context of the daemon.
+ */
+static void daemon_unload(void)
+{
+	int i;
+
+	for (i = 0; i < ndaemon_contexts; i++)
+		free_daemon_context(&daemon_contexts[i]);
+
+	free(daemon_contexts);
+	daemon_contexts = NULL;
+	ndaemon_contexts = 0;
+
+	verbose_printf(daemon_owner, "xcrund: info: developer folder changed, dropping all resolutions.\n");
+}
+
+/**
+ * @func daemon_resolve -- Resolve a request sent by an xcrun client.
+ * @arg request - request line (see get_daemon_request)
+ * @return: resolved entry (see cache_format_entry), or NULL if the client has to resolve it itself
+ */
+static char *daemon_resolve(char *request)
+{
+	int i;
+	char *fields[REQUEST_NFIELDS];
+	xcrun_ctx *ctx;
+	const cache_entry *entry;
+
+	for (i = 0; i < REQUEST_NFIELDS && request != NULL; i++) {
+		fields[i] = request;
+		if ((request = strchr(request, '\t')) != NULL)
+			*request++ = '\0';
+	}
+
+	if (i != REQUEST_NFIELDS || request != NULL || strcmp(fields[REQUEST_PROTOCOL], XCRUND_PROTOCOL) != 0 ||
+	    (strcmp(fields[REQUEST_MODE], "f") != 0 && strcmp(fields[REQUEST_MODE], "r") != 0))
+		return NULL;
+
+	if ((ctx = daemon_get_context(fields)) == NULL || begin(ctx) != 0)
+		return NULL;
+
+	ctx->finding_mode = (*fields[REQUEST_MODE] == 'f');
+	entry = resolve_command(ctx, fields[REQUEST_NAME]);
+	ctx->finding_mode = 0;
+
+	if (entry == NULL) {
+		verbose_printf(daemon_owner, "xcrund: info: failed to resolve \'%s\': %s\n", fields[REQUEST_NAME], ctx->error);
+		return NULL;
+	}
+
+	return cache_format_entry(entry);
+}
+
+/* See documentation in header file. */
+xcrun_ctx *xcrun_create(const xcrun_options *options)
+{
+	xcrun_ctx *ctx;
+	const xcrun_options defaults = { 0 };
+	trace_span span;
+
+	if (options == NULL)
+		options = &defaults;
+
+	if ((ctx = (xcrun_ctx *)calloc(1, sizeof(xcrun_ctx))) == NULL)
+		return NULL;
+
+	ctx->verbose = options->verbose;
+	ctx->flags = options->flags;
+	ctx->envp = options->envp;
+
+	if (options->developer_dir != NULL) {
+		if (snprintf(ctx->developer_dir, sizeof(ctx->developer_dir), "%s", options->developer_dir) >= (int)sizeof(ctx->developer_dir))
+			set_error(ctx, "developer path \'%s\' is too long.", options->developer_dir);
+	} else {
+		trace_begin(&span, "developer path");
+		get_developer_path(ctx);
+		trace_end(&span);
+	}
+
+	/* We support absolute paths and short names for both the SDK and the Toolchain. */
+	if (ctx->error == NULL && options->sdk != NULL) {
+		if (*options->sdk == '/') {
+			if (validate_directory_path(ctx, options->sdk) == 0 && (ctx->alternate_sdk_path = strdup(options->sdk)) == NULL)
+				set_error(ctx, "out of memory.");
+		} else {
+			ctx->explicit_sdk_mode = 1;
+			get_bundle_name(ctx->sdk, sizeof(ctx->sdk), options->sdk);
+			strcpy(ctx->current_sdk, ctx->sdk);
+		}
+	}
+
+	if (ctx->error == NULL && options->toolchain != NULL) {
+		if (*options->toolchain == '/') {
+			if (validate_directory_path(ctx, options->toolchain) == 0 && (ctx->alternate_toolchain_path = strdup(options->toolchain)) == NULL)
+				set_error(ctx, "out of memory.");
+		} else {
+			ctx->explicit_toolchain_mode = 1;
+			get_bundle_name(ctx->toolchain, sizeof(ctx->toolchain), options->toolchain);
+			strcpy(ctx->current_toolchain, ctx->toolchain);
+		}
+	}
+
+	/* A context that failed to set up fails every call (see begin). */
+	if (ctx->error != NULL) {
+		strcpy(ctx->fatal_buf, ctx->error);
+		return ctx;
+	}
+
+	/* Reuse whatever a parent xcrun has already resolved. */
+	import_context(ctx);
+
+	return ctx;
+}
+
+/* See documentation in header file. */
+void xcrun_free(xcrun_ctx *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	free_default_config(&ctx->context.default_cfg);
+	free_sdk_config(&ctx->context.sdk_cfg);
+	free_toolchain_config(&ctx->context.toolchain_cfg);
+	free_toolchain_config(&ctx->other_cfg);
+	ini_free(ctx->admission_cfg);
+	free(ctx->context.sdk_path);
+	free(ctx->context.toolchain_path);
+	free(ctx->context.target_triple);
+	free(ctx->inherited.env);
+	free(ctx->alternate_sdk_path);
+	free(ctx->alternate_toolchain_path);
+	dirindex_free(&ctx->indexes);
+	manifest_close(&ctx->manifest);
+	free(ctx);
+}
+
+/* See documentation in header file. */
+const char *xcrun_error(const xcrun_ctx *ctx)
+{
+	return ctx->error;
+}
+
+/* See documentation in header file. */
+const char *xcrun_developer_dir(xcrun_ctx *ctx)
+{
+	if (begin(ctx) != 0)
+		return NULL;
+
+	return ctx->developer_dir;
+}
+
+/* See documentation in header file. */
+const char *xcrun_sdk_path(xcrun_ctx *ctx)
+{
+	if (begin(ctx) != 0)
+		return NULL;
+
+	return (ctx->alternate_sdk_path != NULL ? ctx->alternate_sdk_path : context_get_sdk_path(ctx));
+}
+
+/* See documentation in header file. */
+const char *xcrun_sdk_name(xcrun_ctx *ctx)
+{
+	const sdk_config *config;
+
+	if (begin(ctx) != 0 || (config = context_get_sdk_config(ctx)) == NULL)
+		return NULL;
+
+	return config->name;
+}
+
+/* See documentation in header file. */
+const char *xcrun_sdk_version(xcrun_ctx *ctx)
+{
+	const sdk_config *config;
+
+	if (begin(ctx) != 0 || (config = context_get_sdk_config(ctx)) == NULL)
+		return NULL;
+
+	return config->version;
+}
+
+/* See documentation in header file. */
+const char *xcrun_target_triple(xcrun_ctx *ctx)
+{
+	if (begin(ctx) != 0)
+		return NULL;
+
+	return get_target_triple(ctx);
+}
+
+/* See documentation in header file. */
+const char *xcrun_sdk_archs(xcrun_ctx *ctx)
+{
+	const sdk_config *config;
+
+	if (begin(ctx) != 0 || (config = context_get_sdk_config(ctx)) == NULL)
+		return NULL;
+
+	return (config->archs != NULL ? config->archs : config->default_arch);
+}
+
+/* See documentation in header file. */
+const char *xcrun_deployment_target(xcrun_ctx *ctx, const char **var)
+{
+	const char *dummy;
+
+	if (begin(ctx) != 0)
+		return NULL;
+
+	return context_get_deployment_target(ctx, (var != NULL ? var : &dummy));
+}
+
+/* See documentation in header file. */
+const char *xcrun_toolchain_path(xcrun_ctx *ctx)
+{
+	if (begin(ctx) != 0)
+		return NULL;
+
+	return (ctx->alternate_toolchain_path != NULL ? ctx->alternate_toolchain_path : context_get_toolchain_path(ctx));
+}
+
+/* See documentation in header file. */
+const char *xcrun_toolchain_name(xcrun_ctx *ctx)
+{
+	const toolchain_config *config;
+
+	if (begin(ctx) != 0 || (config = context_get_toolchain_config(ctx)) == NULL)
+		return NULL;
+
+	return config->name;
+}
+
+/* See documentation in header file. */
+const char *xcrun_toolchain_version(xcrun_ctx *ctx)
+{
+	const toolchain_config *config;
+
+	if (begin(ctx) != 0 || (config = context_get_toolchain_config(ctx)) == NULL)
+		return NULL;
+
+	return config->version;
+}
+
+/* See documentation in header file. */
+int xcrun_find_tool(xcrun_ctx *ctx, const char *name, xcrun_tool *tool)
+{
+	const cache_entry *entry;
+
+	if (begin(ctx) != 0)
+		return -1;
+
+	ctx->finding_mode = 1;
+	entry = resolve_command(ctx, name);
+	ctx->finding_mode = 0;
+
+	if (entry == NULL)
+		return -1;
+
+	copy_tool(ctx, entry, tool);
+
+	return 0;
+}
+
+/* See documentation in header file. */
+int xcrun_resolve_tool(xcrun_ctx *ctx, const char *name, xcrun_tool *tool)
+{
+	const cache_entry *entry;
+
+	if (begin(ctx) != 0 || (entry = resolve_command(ctx, name)) == NULL)
+		return -1;
+
+	copy_tool(ctx, entry, tool);
+
+	return 0;
+}
+
+/* helper function to read a size in megabytes from xcrun.ini, in kilobytes (0 if unset or invalid) */
+static unsigned long get_megabytes(const ini_document *doc, const char *section, const char *name)
+{
+	char *end;
+	unsigned long mb;
+	const char *value = ini_get(doc, section, name);
+
+	if (value == NULL || (mb = strtoul(value, &end, 10)) == 0 || *end != '\0')
+		return 0;
+
+	return (mb * 1024);
+}
+
+/* See documentation in header file. */
+int xcrun_tool_limits(xcrun_ctx *ctx, const char *name, const xcrun_tool *tool, xcrun_limits *limits)
+{
+	char section[NAME_MAX + 16];
+	const char *value;
+	const ini_document *doc;
+	trace_span span;
+
+	memset(limits, 0, sizeof(*limits));
+
+	if (begin(ctx) != 0)
+		return -1;
+
+	/* Most setups hold nothing back, which resolving the tool already found out. */
+	if (!tool->admission)
+		return 0;
+
+	/* The manifest only keeps the defaults of xcrun.ini, the rest is read from the file itself. */
+	if (ctx->context.have_default_cfg && ctx->context.default_cfg.complete) {
+		doc = ctx->context.default_cfg.doc;
+	} else {
+		if (!ctx->have_admission_cfg) {
+			trace_begin(&span, "admission config");
+			ctx->admission_cfg = ini_load(XCRUN_DEFAULT_CFG);
+			trace_end(&span);
+			if (ctx->admission_cfg == NULL && errno == ENOMEM) {
+				set_error(ctx, "out of memory.");
+				return -1;
+			}
+			ctx->have_admission_cfg = true;
+		}
+		doc = ctx->admission_cfg;
+	}
+
+	if (doc == NULL)
+		return 0;
+
+	snprintf(section, sizeof(section), "ADMISSION %s", name);
+	if ((value = ini_get(doc, section, "max_jobs")) != NULL)
+		limits->max_jobs = atoi(value);
+	limits->memory = get_megabytes(doc, section, "memory");
+	limits->budget = get_megabytes(doc, "ADMISSION", "memory");
+
+	if (limits->max_jobs < 0)
+		limits->max_jobs = 0;
+
+	return (limits->max_jobs > 0 || limits->memory > 0);
+}
+
+/* See documentation in header file. */
+int xcrun_set_tool_arch(xcrun_ctx *ctx, xcrun_tool *tool, const char *arch)
+{
+	if (begin(ctx) != 0)
+		return -1;
+
+	/* Leave room for the "-apple-darwinNN" parse_target_triple() appends. */
+	if (*arch == '\0' || strlen(arch) + 32 > sizeof(tool->arch) || strpbrk(arch, "/| \t") != NULL) {
+		set_error(ctx, "invalid architecture '%s'.", arch);
+		return -1;
+	}
+
+	if (*tool->deployment_target == '\0') {
+		set_error(ctx, "failed to retrieve deployment target information for %s.", tool->sdk_path);
+		return -1;
+	}
+
+	snprintf(tool->arch, sizeof(tool->arch), "%s", arch);
+	parse_target_triple(tool->target_triple, tool->deployment_target, arch);
+
+	return 0;
+}
+
+/* See documentation in header file. */
+char **xcrun_build_env(xcrun_ctx *ctx, const xcrun_tool *tool)
+{
+	int i, n = 0;
+	char **envp;
+	const char *target_triple, *deployment_target, *path, *home;
+	trace_span span;
+
+	if (begin(ctx) != 0)
+		return NULL;
+
+	/*
+	 * Pass useful variables to the enviroment of the program to be executed.
+	 *
+	 *  * SDKROOT is used for when programs such as clang need to know the location of the sdk.
+	 *
+	 *  * PATH is used for when programs such as clang need to call on another program (such as the linker).
+	 *
+	 *  * HOME is used for recursive calls to xcrun (such as when xcrun calls a script calling xcrun ect).
+	 *
+	 *  * LD_LIBRARY_PATH is used for when tools needs to access libraries that are specific to the toolchain.
+	 *
+	 *  * TARGET_TRIPLE is used for clang/clang++ cross compilation when building on a foreign host.
+	 *
+	 *  * {MACOSX|IPHONEOS}_DEPLOYMENT_TARGET is used for tools like ld that need to set the minimum compatibility
+	 *    version number for a linked binary.
+	 *
+	 *  * DEVELOPER_DIR is used as a performance optimization when making recursive calls to xcrun.
+	 *
+	 *  * XCRUN_CONTEXT carries everything resolved from the developer folder, so that recursive calls
+	 *    to xcrun don't have to read any configuration file again.
+	 *
+	 *  * XCRUN_TRACE and XCRUN_TRACE_PARENT let recursive calls to xcrun join the trace of this one (see trace.h).
+	 */
+
+	if ((envp = (char **)calloc(11, sizeof(char *))) == NULL) {
+		set_error(ctx, "out of memory.");
+		return NULL;
+	}
+
+	trace_begin(&span, "env");
+
+	path = ctx_getenv(ctx, "PATH");
+	home = ctx_getenv(ctx, "HOME");
+
+	envp[n++] = format_string("SDKROOT=%s", tool->sdk_path);
+	envp[n++] = format_string("PATH=%s/usr/bin:%s/usr/bin:%s", ctx->developer_dir, tool->toolchain_path, (path != NULL ? path : ""));
+	envp[n++] = format_string("LD_LIBRARY_PATH=%s/usr/lib", tool->toolchain_path);
+	envp[n++] = format_string("HOME=%s", (home != NULL ? home : ""));
+	envp[n++] = format_string("DEVELOPER_DIR=%s", ctx->developer_dir);
+
+	if ((target_triple = get_exec_target_triple(ctx, tool)) != NULL)
+		envp[n++] = format_string("TARGET_TRIPLE=%s", target_triple);
+
+	if ((deployment_target = ctx_getenv(ctx, "IPHONEOS_DEPLOYMENT_TARGET")) != NULL) {
+		envp[n++] = format_string("IPHONEOS_DEPLOYMENT_TARGET=%s", deployment_target);
+	} else if ((deployment_target = ctx_getenv(ctx, "MACOSX_DEPLOYMENT_TARGET")) != NULL) {
+		envp[n++] = format_string("MACOSX_DEPLOYMENT_TARGET=%s", deployment_target);
+	} else if (*tool->deployment_target != '\0') {
+		/* Use the deployment target info that is provided by the SDK. */
+		if (*tool->deployment_target_var != '\0')
+			envp[n++] = format_string("%s=%s", tool->deployment_target_var, tool->deployment_target);
+	} else {
+		set_error(ctx, "failed to retrieve deployment target information for %s.", tool->sdk_path);
+		xcrun_free_vector(envp);
+		trace_end(&span);
+		return NULL;
+	}
+
+	/* A vector with a hole would be cut short, so fail as a whole if any variable couldn't be built. */
+	for (i = 0; i < n && envp[i] != NULL; i++)
+		;
+	if (i < n) {
+		set_error(ctx, "out of memory.");
+		while (n > 0)
+			free(envp[--n]);
+		free(envp);
+		trace_end(&span);
+		return NULL;
+	}
+
+	if ((envp[n] = export_context(ctx, tool)) != NULL)
+		n++;
+
+	n += trace_child_env(&envp[n]);
+	trace_end(&span);
+
+	return envp;
+}
+
+/* See documentation in header file. */
+char **xcrun_build_argv(xcrun_ctx *ctx, const xcrun_tool *tool, int argc, char *const argv[])
+{
+	int n = 0;
+	int i;
+	size_t len;
+	char **new_argv;
+	const char *p, *target_triple;
+
+	if (begin(ctx) != 0)
+		return NULL;
+
+	if ((new_argv = (char **)calloc(strlen(tool->args) + argc + 2, sizeof(char *))) == NULL) {
+		set_error(ctx, "out of memory.");
+		return NULL;
+	}
+
+	/* Tools with a profile run their real binary directly, with the profile's arguments injected. */
+	if (tool->profile) {
+		target_triple = get_exec_target_triple(ctx, tool);
+		new_argv[n++] = strdup(tool->path);
+
+		/* Words are expanded one at a time, so a substituted path may safely contain spaces. */
+		for (p = tool->args; *(p += strspn(p, " \t")) != '\0'; p += len) {
+			len = strcspn(p, " \t");
+			new_argv[n++] = expand_profile_word(ctx, p, len, tool, target_triple);
+		}
+	} else if (argc > 0) {
+		new_argv[n++] = strdup(argv[0]);
+	}
+
+	for (i = 1; i < argc; i++)
+		new_argv[n++] = strdup(argv[i]);
+
+	/* Same as for the environment, a hole would cut the arguments short. */
+	for (i = 0; i < n && new_argv[i] != NULL; i++)
+		;
+	if (i < n) {
+		set_error(ctx, "out of memory.");
+		while (n > 0)
+			free(new_argv[--n]);
+		free(new_argv);
+		return NULL;
+	}
+
+	return new_argv;
+}
+
+/* See documentation in header file. */
+void xcrun_free_vector(char **vec)
+{
+	char **p;
+
+	if (vec == NULL)
+		return;
+
+	for (p = vec; *p != NULL; p++)
+		free(*p);
+
+	free(vec);
+}
+
+/* helper function to return the tool name following "<triple>-" in name, or NULL if name doesn't start with it */
+static const char *skip_triple_prefix(const char *name, const char *triple)
+{
+	size_t len = strlen(triple);
+
+	if (len > 0 && strncmp(name, triple, len) == 0 && name[len] == '-' && name[len + 1] != '\0')
+		return (name + len + 1);
+
+	return NULL;
+}
+
+/* See documentation in header file. */
+const char *xcrun_strip_target_triple(xcrun_ctx *ctx, const char *name)
+{
+	const char *tool, *triple, *os;
+
+	if (begin(ctx) != 0)
+		return name;
+
+	/* The triple we are building for, if it is known without touching the developer folder. */
+	if ((triple = ctx_getenv(ctx, "TARGET_TRIPLE")) != NULL && (tool = skip_triple_prefix(name, triple)) != NULL)
+		return tool;
+
+	if (ctx->inherited.valid && (triple = inherited_field(ctx, CONTEXT_TARGET_TRIPLE)) != NULL && (tool = skip_triple_prefix(name, triple)) != NULL)
+		return tool;
+
+	/* Any <arch>-apple-<os>-<tool> name. */
+	if ((triple = strstr(name, "-apple-")) != NULL && triple != name && memchr(name, '-', (triple - name)) == NULL) {
+		os = triple + strlen("-apple-");
+		if ((tool = strchr(os, '-')) != NULL && tool != os && tool[1] != '\0')
+			return (tool + 1);
+	}
+
+	/* Finally, the triple of the current sdk, which costs us reading its info.ini. */
+	if (strchr(name, '-') != NULL && (triple = context_get_sdk_target_triple(ctx)) != NULL && (tool = skip_triple_prefix(name, triple)) != NULL)
+		return tool;
+
+	/* Not having an sdk to compare against just means that this isn't a cross tool. */
+	ctx->error = NULL;
+
+	return name;
+}
+
+/* See documentation in header file. */
+int xcrun_kill_cache(void)
+{
+	hotcache_invalidate();
+
+	return cache_kill();
+}
+
+/**
+ * @func index_bundles -- Add every SDK or Toolchain of a folder of the developer folder to a manifest.
+ * @arg ctx     - context
+ * @arg builder - manifest being built
+ * @arg folder  - folder of the developer dir holding the bundles ("SDKs" or "Toolchains")
+ * @arg ext     - extension of the bundles ("sdk" or "toolchain")
+ * @return: number of bundles added
+ */
+static int index_bundles(xcrun_ctx *ctx, manifest_builder *builder, const char *folder, const char *ext)
+{
+	int i, count = 0;
+	size_t len;
+	DIR *dir;
+	struct dirent *ent;
+	char path[PATH_MAX];
+	char triple[NAME_MAX];
+	sdk_config sdk;
+	toolchain_config toolchain;
+	manifest_sdk sdk_record;
+	manifest_toolchain toolchain_record;
+	manifest_profile profile_record;
+
+	if (snprintf(path, sizeof(path), "%s/%s", ctx->developer_dir, folder) >= (int)sizeof(path) || (dir = opendir(path)) == NULL)
+		return 0;
+
+	while ((ent = readdir(dir)) != NULL) {
+		len = strlen(ent->d_name);
+		if (len <= strlen(ext) + 1 || ent->d_name[len - strlen(ext) - 1] != '.' || strcmp(ent->d_name + len - strlen(ext), ext) != 0)
+			continue;
+
+		/* Same path as get_bundle_path builds, so that lookups match it. The stamp is taken first, a change while reading outdates the record. */
+		if (snprintf(path, sizeof(path), "%s/%s/%s/info.ini", ctx->developer_dir, folder, ent->d_name) >= (int)sizeof(path))
+			continue;
+
+		memset(&sdk_record, 0, sizeof(sdk_record));
+		memset(&toolchain_record, 0, sizeof(toolchain_record));
+		manifest_stamp_file(&sdk_record.stamp, path);
+		toolchain_record.stamp = sdk_record.stamp;
+		path[strlen(path) - strlen("/info.ini")] = '\0';
+
+		if (strcmp(ext, "sdk") == 0) {
+			if (read_sdk_info(ctx, path, &sdk) != 0)
+				continue;
+
+			*triple = '\0';
+			if (sdk.default_arch != NULL && sdk.deployment_target != NULL)
+				parse_target_triple(triple, sdk.deployment_target, sdk.default_arch);
+
+			sdk_record.path = manifest_string(builder, path);
+			sdk_record.name = manifest_string(builder, sdk.name);
+			sdk_record.version = manifest_string(builder, sdk.version);
+			sdk_record.toolchain = manifest_string(builder, sdk.toolchain);
+			sdk_record.default_arch = manifest_string(builder, sdk.default_arch);
+			sdk_record.archs = manifest_string(builder, sdk.archs);
+			sdk_record.deployment_target = manifest_string(builder, sdk.deployment_target);
+			sdk_record.deployment_target_var = manifest_string(builder, sdk.deployment_target_var);
+			sdk_record.target_triple = manifest_string(builder, (*triple != '\0' ? triple : NULL));
+			manifest_add_sdk(builder, &sdk_record);
+			free_sdk_config(&sdk);
+		} else {
+			if (read_toolchain_info(ctx, path, &toolchain) != 0)
+				continue;
+
+			for (i = 0; i < toolchain.ntools; i++) {
+				profile_record.name = manifest_string(builder, toolchain.tools[i].name);
+				profile_record.path = manifest_string(builder, toolchain.tools[i].path);
+				profile_record.args = manifest_string(builder, toolchain.tools[i].args);
+				profile_record.aliases = manifest_string(builder, toolchain.tools[i].aliases);
+				manifest_add_profile(builder, &profile_record);
+			}
+
+			toolchain_record.path = manifest_string(builder, path);
+			toolchain_record.name = manifest_string(builder, toolchain.name);
+			toolchain_record.version = manifest_string(builder, toolchain.version);
+			manifest_add_toolchain(builder, &toolchain_record);
+			free_toolchain_config(&toolchain);
+		}
+
+		verbose_printf(ctx, "xcrun: info: indexed '%s'.\n", path);
+		count++;
+	}
+
+	closedir(dir);
+
+	/* Bundles that couldn't be read are simply left out, they are read from the developer folder when used. */
+	ctx->error = NULL;
+
+	return count;
+}
+
+/* See documentation in header file. */
+int xcrun_reindex(xcrun_ctx *ctx)
+{
+	const char *home_path;
+	char path[PATH_MAX];
+	default_config defaults;
+	manifest_builder builder;
+
+	if (begin(ctx) != 0)
+		return -1;
+
+	if ((home_path = ctx_getenv(ctx, "HOME")) == NULL) {
+		set_error(ctx, "failed to read HOME variable.");
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", home_path, MANIFEST_FILE);
+
+	manifest_init(&builder, ctx->developer_dir);
+
+	manifest_stamp_file(&builder.header.default_stamp, XCRUN_DEFAULT_CFG);
+	if (read_default_info(ctx, XCRUN_DEFAULT_CFG, &defaults) == 0) {
+		builder.header.default_sdk = manifest_string(&builder, defaults.sdk);
+		builder.header.default_toolchain = manifest_string(&builder, defaults.toolchain);
+		builder.header.admission = defaults.admission;
+		free_default_config(&defaults);
+	}
+
+	index_bundles(ctx, &builder, "SDKs", "sdk");
+	index_bundles(ctx, &builder, "Toolchains", "toolchain");
+
+	if (manifest_write(&builder, path) != 0) {
+		set_error(ctx, "unable to write manifest '%s'. (%s)", path, strerror(errno));
+		return -1;
+	}
+
+	/* Pick up the new manifest on next use. */
+	manifest_close(&ctx->manifest);
+	ctx->tried_manifest = false;
+
+	/* Entries shared by running xcruns predate the new manifest. */
+	hotcache_invalidate();
+
+	return 0;
+}
+
+/* See documentation in header file. */
+int xcrun_daemon(xcrun_ctx *ctx)
+{
+	char path[PATH_MAX] = "";
+	static const char *config_files[] = { XCRUN_DEFAULT_CFG, NULL };
+	daemon_ops ops = { NULL, config_files, daemon_load, daemon_unload, daemon_resolve };
+
+	if (begin(ctx) != 0)
+		return -1;
+
+	daemon_owner = ctx;
+	ops.developer_dir = ctx->developer_dir;
+
+	if (daemon_socket_path(path, sizeof(path), 1) == 0)
+		verbose_printf(ctx, "xcrund: info: serving developer dir \'%s\' on \'%s\'.\n", ctx->developer_dir, path);
+
+	if (daemon_serve(&ops) != 0) {
+		set_error(ctx, "failed to serve resolutions on \'%s\'.", path);
+		return -1;
+	}
+
+	return 0;
+}
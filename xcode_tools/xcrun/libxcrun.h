@@ -0,0 +1,279 @@
+/* libxcrun.h - in-process tool resolution for the Developer folder
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBXCRUN_H__
+#define __LIBXCRUN_H__
+
+#include <stdio.h>
+#include <limits.h>
+
+/*
+ * libxcrun resolves tools, SDKs and Toolchains of a developer folder exactly like xcrun does,
+ * without spawning it. Everything lives in an xcrun_ctx: contexts don't share any state, and no
+ * function ever exits the calling process. A context is not meant to be used by several threads
+ * at the same time.
+ *
+ * Functions returning a pointer or an int report failures as NULL or -1, in which case
+ * xcrun_error() describes what went wrong. Strings returned by a context stay valid until it is
+ * freed.
+ */
+
+/* Context creation flags */
+#define XCRUN_NO_CACHE	(1 << 0)	/* don't use the lookup cache */
+#define XCRUN_NO_DAEMON	(1 << 1)	/* don't ask xcrund */
+
+/* Where a tool was resolved from */
+#define XCRUN_SOURCE_SEARCH	0	/* searched for in the developer folder */
+#define XCRUN_SOURCE_CACHE	1	/* found in the lookup cache */
+#define XCRUN_SOURCE_DAEMON	2	/* answered by xcrund */
+#define XCRUN_SOURCE_SHARED	3	/* found in the lookup cache shared in memory */
+
+typedef struct xcrun_ctx xcrun_ctx;
+
+/* Options for xcrun_create, a zeroed struct picks everything up from the environment */
+typedef struct {
+	const char *developer_dir;	/* developer folder, NULL for DEVELOPER_DIR or the one chosen with xcode-select */
+	const char *sdk;		/* SDK name or absolute path, NULL for SDKROOT or the default SDK */
+	const char *toolchain;		/* Toolchain name or absolute path, NULL for TOOLCHAINS or the default Toolchain */
+	char *const *envp;		/* environment to read instead of the process's own, must outlive the context */
+	FILE *verbose;			/* where to describe what is going on, NULL to stay quiet */
+	int flags;			/* XCRUN_NO_CACHE, XCRUN_NO_DAEMON */
+} xcrun_options;
+
+/* A resolved tool */
+typedef struct {
+	char path[PATH_MAX];			/* binary to execute */
+	char args[PATH_MAX];			/* arguments injected by the tool profile, unexpanded (see xcrun_build_argv) */
+	int profile;				/* set if the tool runs through a [TOOL <name>] profile */
+	char sdk_path[PATH_MAX];		/* SDK the tool runs with (unset for xcrun_find_tool) */
+	char toolchain_path[PATH_MAX];		/* Toolchain the tool runs with (unset for xcrun_find_tool) */
+	char target_triple[NAME_MAX];		/* target triple of the SDK, may be empty */
+	char deployment_target_var[NAME_MAX];	/* environment variable holding the deployment target, may be empty */
+	char deployment_target[NAME_MAX];	/* deployment target of the SDK, may be empty */
+	char arch[NAME_MAX];			/* architecture picked with xcrun_set_tool_arch, empty for the SDK's own */
+	int source;				/* where the tool was resolved from (XCRUN_SOURCE_*) */
+	int admission;				/* set if xcrun.ini has [ADMISSION] sections (see xcrun_tool_limits) */
+} xcrun_tool;
+
+/* Admission limits of a tool ([ADMISSION <name>] and [ADMISSION] sections of xcrun.ini), 0 standing for none */
+typedef struct {
+	int max_jobs;				/* most instances of the tool running at once */
+	unsigned long memory;			/* peak memory expected of the tool until it has been measured, in KB */
+	unsigned long budget;			/* memory every admitted tool may use at once, in KB */
+} xcrun_limits;
+
+/**
+ * @func xcrun_create -- create a resolution context
+ * @arg options - where and how to resolve tools (NULL for the defaults)
+ * @return: new context, or NULL if out of memory (other failures are reported by xcrun_error)
+ */
+xcrun_ctx *xcrun_create(const xcrun_options *options);
+
+/**
+ * @func xcrun_free -- free a resolution context and everything it returned
+ * @arg ctx - context to free (may be NULL)
+ */
+void xcrun_free(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_error -- describe the last failure of a context
+ * @arg ctx - context
+ * @return: error message, or NULL if the last call succeeded
+ */
+const char *xcrun_error(const xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_developer_dir -- return the developer folder of a context
+ * @arg ctx - context
+ * @return: absolute path, or NULL on failure
+ */
+const char *xcrun_developer_dir(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_sdk_path -- return the path of the selected SDK
+ * @arg ctx - context
+ * @return: absolute path, or NULL on failure
+ */
+const char *xcrun_sdk_path(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_sdk_name -- return the name of the selected SDK, from its info.ini
+ * @arg ctx - context
+ * @return: SDK name, or NULL on failure or if info.ini has none
+ */
+const char *xcrun_sdk_name(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_sdk_version -- return the version of the selected SDK, from its info.ini
+ * @arg ctx - context
+ * @return: SDK version, or NULL on failure or if info.ini has none
+ */
+const char *xcrun_sdk_version(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_target_triple -- return the target triple of the selected SDK (TARGET_TRIPLE takes precedence)
+ * @arg ctx - context
+ * @return: target triple, or NULL on failure or if the SDK doesn't describe one
+ */
+const char *xcrun_target_triple(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_sdk_archs -- return the architectures the selected SDK builds for (archs, or default_arch, in info.ini)
+ * @arg ctx - context
+ * @return: architectures separated by white space or commas, or NULL on failure or if the SDK lists none
+ */
+const char *xcrun_sdk_archs(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_deployment_target -- return the deployment target of the selected SDK
+ * @arg ctx - context
+ * @arg var - set to the environment variable the deployment target belongs in (may be NULL)
+ * @return: deployment target, or NULL on failure or if the SDK doesn't describe one
+ */
+const char *xcrun_deployment_target(xcrun_ctx *ctx, const char **var);
+
+/**
+ * @func xcrun_toolchain_path -- return the path of the selected Toolchain
+ * @arg ctx - context
+ * @return: absolute path, or NULL on failure
+ */
+const char *xcrun_toolchain_path(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_toolchain_name -- return the name of the selected Toolchain, from its info.ini
+ * @arg ctx - context
+ * @return: Toolchain name, or NULL on failure or if info.ini has none
+ */
+const char *xcrun_toolchain_name(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_toolchain_version -- return the version of the selected Toolchain, from its info.ini
+ * @arg ctx - context
+ * @return: Toolchain version, or NULL on failure or if info.ini has none
+ */
+const char *xcrun_toolchain_version(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_find_tool -- locate a tool, like xcrun --find
+ * @arg ctx  - context
+ * @arg name - name of the tool
+ * @arg tool - filled in with the tool's path
+ * @return: 0 on success, -1 on failure
+ */
+int xcrun_find_tool(xcrun_ctx *ctx, const char *name, xcrun_tool *tool);
+
+/**
+ * @func xcrun_resolve_tool -- resolve a tool for execution, through its tool profile if it has one
+ * @arg ctx  - context
+ * @arg name - name of the tool
+ * @arg tool - filled in with the tool and the SDK it runs with
+ * @return: 0 on success, -1 on failure
+ */
+int xcrun_resolve_tool(xcrun_ctx *ctx, const char *name, xcrun_tool *tool);
+
+/**
+ * @func xcrun_set_tool_arch -- run a resolved tool for one architecture, with the matching target triple
+ * @arg ctx  - context
+ * @arg tool - tool resolved by xcrun_resolve_tool, updated in place
+ * @arg arch - architecture (e.g. armv7)
+ * @return: 0 on success, -1 on failure
+ */
+int xcrun_set_tool_arch(xcrun_ctx *ctx, xcrun_tool *tool, const char *arch);
+
+/**
+ * @func xcrun_build_env -- build the environment a resolved tool runs with
+ * @arg ctx  - context
+ * @arg tool - tool resolved by xcrun_resolve_tool
+ * @return: NULL terminated environment (see xcrun_free_vector), or NULL on failure
+ */
+char **xcrun_build_env(xcrun_ctx *ctx, const xcrun_tool *tool);
+
+/**
+ * @func xcrun_build_argv -- build the argument vector a resolved tool runs with
+ * @arg ctx  - context
+ * @arg tool - tool resolved by xcrun_resolve_tool
+ * @arg argc - number of arguments
+ * @arg argv - arguments, argv[0] being the name the tool was called by
+ * @return: NULL terminated vector to pass along with tool->path to execve (see xcrun_free_vector), or NULL on failure
+ */
+char **xcrun_build_argv(xcrun_ctx *ctx, const xcrun_tool *tool, int argc, char *const argv[]);
+
+/*
+ * Every string handed out by libxcrun is a separate exact-size allocation that the caller owns
+ * and may free on its own, so that callers can keep or replace single elements. Allocating them
+ * from an arena instead would tie them to the context and change that for every caller.
+ */
+
+/**
+ * @func xcrun_free_vector -- free a vector returned by xcrun_build_env or xcrun_build_argv
+ * @arg vec - vector to free (may be NULL)
+ */
+void xcrun_free_vector(char **vec);
+
+/**
+ * @func xcrun_tool_limits -- return how many instances of a tool may run at once, and how much memory they may use
+ * @arg ctx    - context
+ * @arg name   - name of the tool
+ * @arg tool   - the tool, as resolved (xcrun.ini is only read if it has [ADMISSION] sections)
+ * @arg limits - filled in with the limits of the tool
+ * @return: 1 if the tool is admission controlled, 0 if it runs freely, -1 on failure
+ */
+int xcrun_tool_limits(xcrun_ctx *ctx, const char *name, const xcrun_tool *tool, xcrun_limits *limits);
+
+/**
+ * @func xcrun_strip_target_triple -- strip a target triple prefix (e.g. arm-apple-darwin11-ld) off a tool name
+ * @arg ctx  - context
+ * @arg name - tool name
+ * @return: the tool name without its triple prefix (pointing into name), or name if it doesn't carry one
+ */
+const char *xcrun_strip_target_triple(xcrun_ctx *ctx, const char *name);
+
+/**
+ * @func xcrun_kill_cache -- invalidate all existing lookup cache entries
+ * @return: 0 on success, -1 on failure
+ */
+int xcrun_kill_cache(void);
+
+/**
+ * @func xcrun_reindex -- scan every SDK and Toolchain of the developer folder of a context into the manifest (~/.xcdev.manifest)
+ * @arg ctx - context
+ * @return: 0 on success, -1 on failure
+ */
+int xcrun_reindex(xcrun_ctx *ctx);
+
+/**
+ * @func xcrun_daemon -- serve resolutions for the developer folder of a context to xcrun clients, as xcrund
+ * @arg ctx - context
+ * @return: -1 on failure, otherwise no return
+ */
+int xcrun_daemon(xcrun_ctx *ctx);
+
+#endif /* __LIBXCRUN_H__ */
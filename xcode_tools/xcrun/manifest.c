@@ -0,0 +1,310 @@
+/* manifest.c - precomputed description of a developer folder
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Resolving an SDK or a Toolchain means reading and parsing its info.ini. The manifest holds the
+ * outcome for every SDK and Toolchain of a developer folder, along with the defaults of xcrun.ini,
+ * so that xcrun can answer from a single mapped file. It is written by xcode-select --switch and
+ * xcrun --reindex. Every record carries the stamp of the info.ini it was built from and is only
+ * used while that file is unchanged, anything else is read from the developer folder as usual.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "manifest.h"
+
+#ifdef __APPLE__
+#define ST_MTIM(st) ((st).st_mtimespec)
+#else
+#define ST_MTIM(st) ((st).st_mtim)
+#endif
+
+/* helper function to grow an array of records by one, returning the new record */
+static void *grow(manifest_builder *builder, void **array, uint32_t count, size_t size)
+{
+	void *tmp;
+
+	if (builder->failed || (tmp = realloc(*array, (count + 1) * size)) == NULL) {
+		builder->failed = 1;
+		return NULL;
+	}
+
+	*array = tmp;
+
+	return ((char *)tmp + (count * size));
+}
+
+/* See documentation in header file. */
+void manifest_stamp_file(manifest_stamp *stamp, const char *path)
+{
+	struct stat st;
+
+	memset(stamp, 0, sizeof(*stamp));
+
+	if (stat(path, &st) == 0) {
+		stamp->ino = (uint64_t)st.st_ino;
+		stamp->sec = (int64_t)ST_MTIM(st).tv_sec;
+		stamp->nsec = (int64_t)ST_MTIM(st).tv_nsec;
+	}
+}
+
+/* See documentation in header file. */
+int manifest_stamp_is_current(const manifest_stamp *stamp, const char *path)
+{
+	manifest_stamp now;
+
+	manifest_stamp_file(&now, path);
+
+	return (now.ino == stamp->ino && now.sec == stamp->sec && now.nsec == stamp->nsec);
+}
+
+/* See documentation in header file. */
+void manifest_init(manifest_builder *builder, const char *developer_dir)
+{
+	memset(builder, 0, sizeof(*builder));
+	memcpy(builder->header.magic, MANIFEST_MAGIC, sizeof(builder->header.magic));
+
+	/* Offset 0 is the missing string. */
+	manifest_string(builder, "");
+	builder->header.developer_dir = manifest_string(builder, developer_dir);
+}
+
+/* See documentation in header file. */
+uint32_t manifest_string(manifest_builder *builder, const char *str)
+{
+	char *tmp;
+	size_t len;
+	uint32_t offset = (uint32_t)builder->strings_len;
+
+	if (str == NULL || builder->failed)
+		return 0;
+
+	len = strlen(str) + 1;
+
+	if (builder->strings_len + len > builder->strings_size) {
+		if ((tmp = (char *)realloc(builder->strings, (builder->strings_size * 2) + len + BUFSIZ)) == NULL) {
+			builder->failed = 1;
+			return 0;
+		}
+		builder->strings = tmp;
+		builder->strings_size = (builder->strings_size * 2) + len + BUFSIZ;
+	}
+
+	memcpy(builder->strings + builder->strings_len, str, len);
+	builder->strings_len += len;
+
+	return offset;
+}
+
+/* See documentation in header file. */
+void manifest_add_sdk(manifest_builder *builder, const manifest_sdk *sdk)
+{
+	manifest_sdk *record;
+
+	if ((record = (manifest_sdk *)grow(builder, (void **)&builder->sdks, builder->header.nsdks, sizeof(*sdk))) != NULL) {
+		*record = *sdk;
+		builder->header.nsdks++;
+	}
+}
+
+/* See documentation in header file. */
+void manifest_add_toolchain(manifest_builder *builder, const manifest_toolchain *toolchain)
+{
+	uint32_t first = 0;
+	manifest_toolchain *record;
+
+	if (builder->header.ntoolchains > 0)
+		first = builder->toolchains[builder->header.ntoolchains - 1].first_profile + builder->toolchains[builder->header.ntoolchains - 1].nprofiles;
+
+	if ((record = (manifest_toolchain *)grow(builder, (void **)&builder->toolchains, builder->header.ntoolchains, sizeof(*toolchain))) != NULL) {
+		*record = *toolchain;
+		record->first_profile = first;
+		record->nprofiles = builder->header.nprofiles - first;
+		builder->header.ntoolchains++;
+	}
+}
+
+/* See documentation in header file. */
+void manifest_add_profile(manifest_builder *builder, const manifest_profile *profile)
+{
+	manifest_profile *record;
+
+	if ((record = (manifest_profile *)grow(builder, (void **)&builder->profiles, builder->header.nprofiles, sizeof(*profile))) != NULL) {
+		*record = *profile;
+		builder->header.nprofiles++;
+	}
+}
+
+/* See documentation in header file. */
+int manifest_write(manifest_builder *builder, const char *path)
+{
+	int status = -1;
+	FILE *fp;
+	char tmp[PATH_MAX];
+	manifest_header *header = &builder->header;
+
+	header->strings = (uint32_t)(sizeof(*header) + (header->nsdks * sizeof(manifest_sdk)) + (header->ntoolchains * sizeof(manifest_toolchain)) +
+				     (header->nprofiles * sizeof(manifest_profile)));
+	header->size = (uint32_t)(header->strings + builder->strings_len);
+
+	if (!builder->failed && snprintf(tmp, sizeof(tmp), "%s.tmp.%ld", path, (long)getpid()) < (int)sizeof(tmp) && (fp = fopen(tmp, "w")) != NULL) {
+		fwrite(header, sizeof(*header), 1, fp);
+		fwrite(builder->sdks, sizeof(manifest_sdk), header->nsdks, fp);
+		fwrite(builder->toolchains, sizeof(manifest_toolchain), header->ntoolchains, fp);
+		fwrite(builder->profiles, sizeof(manifest_profile), header->nprofiles, fp);
+		fwrite(builder->strings, 1, builder->strings_len, fp);
+
+		if (ferror(fp) == 0 && fclose(fp) == 0 && rename(tmp, path) == 0)
+			status = 0;
+		else
+			unlink(tmp);
+	}
+
+	free(builder->sdks);
+	free(builder->toolchains);
+	free(builder->profiles);
+	free(builder->strings);
+	memset(builder, 0, sizeof(*builder));
+
+	return status;
+}
+
+/* See documentation in header file. */
+int manifest_open(manifest *m, const char *path)
+{
+	int fd;
+	size_t records;
+	struct stat st;
+	const manifest_header *header;
+
+	memset(m, 0, sizeof(*m));
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return -1;
+
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(manifest_header) || st.st_size > UINT32_MAX) {
+		close(fd);
+		return -1;
+	}
+
+	m->size = (size_t)st.st_size;
+	m->map = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (m->map == MAP_FAILED) {
+		memset(m, 0, sizeof(*m));
+		return -1;
+	}
+
+	/* Everything has to fit in the file, and the string table has to end with a terminator. */
+	header = (const manifest_header *)m->map;
+	records = sizeof(*header) + ((size_t)header->nsdks * sizeof(manifest_sdk)) + ((size_t)header->ntoolchains * sizeof(manifest_toolchain)) +
+		  ((size_t)header->nprofiles * sizeof(manifest_profile));
+
+	if (memcmp(header->magic, MANIFEST_MAGIC, sizeof(header->magic)) != 0 || header->size != m->size || header->strings != records ||
+	    records >= m->size || ((const char *)m->map)[m->size - 1] != '\0') {
+		manifest_close(m);
+		return -1;
+	}
+
+	m->header = header;
+	m->sdks = (const manifest_sdk *)(header + 1);
+	m->toolchains = (const manifest_toolchain *)(m->sdks + header->nsdks);
+	m->profiles = (const manifest_profile *)(m->toolchains + header->ntoolchains);
+	m->strings = (const char *)m->map + header->strings;
+	m->strings_len = m->size - header->strings;
+
+	return 0;
+}
+
+/* See documentation in header file. */
+void manifest_close(manifest *m)
+{
+	if (m->map != NULL)
+		munmap(m->map, m->size);
+
+	memset(m, 0, sizeof(*m));
+}
+
+/* See documentation in header file. */
+const char *manifest_str(const manifest *m, uint32_t offset)
+{
+	return ((offset != 0 && offset < m->strings_len) ? m->strings + offset : NULL);
+}
+
+/* helper function to test a record's path and the stamp of its info.ini */
+static int record_is_current(const manifest *m, uint32_t record_path, const manifest_stamp *stamp, const char *path)
+{
+	char info_path[PATH_MAX];
+	const char *str = manifest_str(m, record_path);
+
+	if (str == NULL || strcmp(str, path) != 0)
+		return 0;
+
+	return (snprintf(info_path, sizeof(info_path), "%s/info.ini", path) < (int)sizeof(info_path) && manifest_stamp_is_current(stamp, info_path));
+}
+
+/* See documentation in header file. */
+const manifest_sdk *manifest_find_sdk(const manifest *m, const char *path)
+{
+	uint32_t i;
+
+	for (i = 0; i < m->header->nsdks; i++) {
+		if (record_is_current(m, m->sdks[i].path, &m->sdks[i].stamp, path))
+			return &m->sdks[i];
+	}
+
+	return NULL;
+}
+
+/* See documentation in header file. */
+const manifest_toolchain *manifest_find_toolchain(const manifest *m, const char *path)
+{
+	uint32_t i;
+
+	for (i = 0; i < m->header->ntoolchains; i++) {
+		/* Profiles out of range make the record unusable. */
+		if (m->toolchains[i].first_profile > m->header->nprofiles || m->toolchains[i].nprofiles > m->header->nprofiles - m->toolchains[i].first_profile)
+			continue;
+		if (record_is_current(m, m->toolchains[i].path, &m->toolchains[i].stamp, path))
+			return &m->toolchains[i];
+	}
+
+	return NULL;
+}
@@ -0,0 +1,226 @@
+/* manifest.h - precomputed description of a developer folder
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MANIFEST_H__
+#define __MANIFEST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Name of the manifest file, relative to $HOME */
+#define MANIFEST_FILE ".xcdev.manifest"
+
+/* Tag at the start of the manifest file, bump it whenever the layout changes */
+#define MANIFEST_MAGIC "xcrunmf2"
+
+/*
+ * The manifest is written in the byte order of the machine and mapped as-is: a header, the SDK,
+ * Toolchain and tool profile records, then the string table. Strings are offsets into the string
+ * table, 0 standing for a missing value.
+ */
+
+/* Modification stamp of an info.ini, all zeroes for a missing file */
+typedef struct {
+	uint64_t ino;
+	int64_t sec;
+	int64_t nsec;
+} manifest_stamp;
+
+typedef struct {
+	char magic[8];
+	manifest_stamp default_stamp;	/* stamp of xcrun.ini */
+	uint32_t size;			/* size of the whole file */
+	uint32_t developer_dir;		/* developer folder described */
+	uint32_t default_sdk;		/* default sdk of xcrun.ini */
+	uint32_t default_toolchain;	/* default toolchain of xcrun.ini */
+	uint32_t admission;		/* set if xcrun.ini has [ADMISSION] sections */
+	uint32_t nsdks;
+	uint32_t ntoolchains;
+	uint32_t nprofiles;
+	uint32_t strings;		/* offset of the string table */
+} manifest_header;
+
+/* An SDK, with its info.ini and target triple */
+typedef struct {
+	manifest_stamp stamp;
+	uint32_t path;
+	uint32_t name;
+	uint32_t version;
+	uint32_t toolchain;
+	uint32_t default_arch;
+	uint32_t archs;
+	uint32_t deployment_target;
+	uint32_t deployment_target_var;
+	uint32_t target_triple;
+	uint32_t reserved;
+} manifest_sdk;
+
+/* A Toolchain, with its info.ini */
+typedef struct {
+	manifest_stamp stamp;
+	uint32_t path;
+	uint32_t name;
+	uint32_t version;
+	uint32_t first_profile;
+	uint32_t nprofiles;
+	uint32_t reserved;
+} manifest_toolchain;
+
+/* A [TOOL <name>] profile of a Toolchain */
+typedef struct {
+	uint32_t name;
+	uint32_t path;
+	uint32_t args;
+	uint32_t aliases;
+} manifest_profile;
+
+/* A manifest being built */
+typedef struct {
+	manifest_header header;
+	manifest_sdk *sdks;
+	manifest_toolchain *toolchains;
+	manifest_profile *profiles;
+	char *strings;
+	size_t strings_len;
+	size_t strings_size;
+	int failed;
+} manifest_builder;
+
+/* A manifest mapped from its file */
+typedef struct {
+	void *map;
+	size_t size;
+	const manifest_header *header;
+	const manifest_sdk *sdks;
+	const manifest_toolchain *toolchains;
+	const manifest_profile *profiles;
+	const char *strings;
+	size_t strings_len;
+} manifest;
+
+/**
+ * @func manifest_stamp_file -- record the current modification stamp of a file
+ * @arg stamp - stamp to fill in
+ * @arg path  - file (a missing file is recorded as such)
+ */
+void manifest_stamp_file(manifest_stamp *stamp, const char *path);
+
+/**
+ * @func manifest_init -- start building a manifest
+ * @arg builder       - builder to set up
+ * @arg developer_dir - developer folder the manifest describes
+ */
+void manifest_init(manifest_builder *builder, const char *developer_dir);
+
+/**
+ * @func manifest_string -- add a string to the string table of a manifest being built
+ * @arg builder - builder
+ * @arg str     - string to add (may be NULL)
+ * @return: offset of the string, 0 for NULL
+ */
+uint32_t manifest_string(manifest_builder *builder, const char *str);
+
+/**
+ * @func manifest_add_sdk -- add an SDK record to a manifest being built
+ * @arg builder - builder
+ * @arg sdk     - record to add, its strings added with manifest_string
+ */
+void manifest_add_sdk(manifest_builder *builder, const manifest_sdk *sdk);
+
+/**
+ * @func manifest_add_toolchain -- add a Toolchain record to a manifest being built
+ * @arg builder   - builder
+ * @arg toolchain - record to add, its profiles are the ones added since the previous Toolchain
+ */
+void manifest_add_toolchain(manifest_builder *builder, const manifest_toolchain *toolchain);
+
+/**
+ * @func manifest_add_profile -- add a tool profile record to a manifest being built
+ * @arg builder - builder
+ * @arg profile - record to add
+ */
+void manifest_add_profile(manifest_builder *builder, const manifest_profile *profile);
+
+/**
+ * @func manifest_write -- write a manifest, through a temporary file renamed into place
+ * @arg builder - builder holding the manifest, freed whatever happens
+ * @arg path    - manifest file
+ * @return: 0 on success, -1 on failure
+ */
+int manifest_write(manifest_builder *builder, const char *path);
+
+/**
+ * @func manifest_open -- map a manifest file
+ * @arg m    - manifest to fill in
+ * @arg path - manifest file
+ * @return: 0 on success, -1 if the file is missing or malformed
+ */
+int manifest_open(manifest *m, const char *path);
+
+/**
+ * @func manifest_close -- unmap a manifest file
+ * @arg m - manifest (may be unmapped already)
+ */
+void manifest_close(manifest *m);
+
+/**
+ * @func manifest_str -- return a string of a mapped manifest
+ * @arg m      - manifest
+ * @arg offset - offset of the string
+ * @return: string, or NULL for a missing value
+ */
+const char *manifest_str(const manifest *m, uint32_t offset);
+
+/**
+ * @func manifest_find_sdk -- find the SDK record of a path, as long as its info.ini hasn't changed
+ * @arg m    - manifest
+ * @arg path - absolute path of the SDK
+ * @return: record, or NULL if the manifest has no current record of it
+ */
+const manifest_sdk *manifest_find_sdk(const manifest *m, const char *path);
+
+/**
+ * @func manifest_find_toolchain -- find the Toolchain record of a path, as long as its info.ini hasn't changed
+ * @arg m    - manifest
+ * @arg path - absolute path of the Toolchain
+ * @return: record, or NULL if the manifest has no current record of it
+ */
+const manifest_toolchain *manifest_find_toolchain(const manifest *m, const char *path);
+
+/**
+ * @func manifest_stamp_is_current -- test whether a file still has the stamp recorded in a manifest
+ * @arg stamp - recorded stamp
+ * @arg path  - file
+ * @return: 1 if it does, 0 otherwise
+ */
+int manifest_stamp_is_current(const manifest_stamp *stamp, const char *path);
+
+#endif /* __MANIFEST_H__ */
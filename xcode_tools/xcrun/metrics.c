@@ -0,0 +1,460 @@
+/* metrics.c - usage metrics of xcrun invocations
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * When METRICS_ENV is set, every invocation of xcrun appends one line to a metrics file in the
+ * user's cache folder, saying how it went, how its tool was resolved (through xcrund, the shared
+ * or file lookup cache, or a search), how long resolving took, and which tool, SDK and toolchain
+ * it was for:
+ *
+ *	1 run cache 412 clang MacOSX XcodeDefault
+ *
+ * Lines are written with a single write() to a file opened in append mode, so any number of
+ * concurrent xcruns add to it without a lock and without interleaving. Nothing is ever counted in
+ * place: metrics_report adds the lines up when asked, as a plain summary or in the Prometheus text
+ * format. The file only grows, removing it starts the counts over.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "metrics.h"
+
+/* Upper bounds of the latency histogram, in microseconds (anything slower lands in +Inf) */
+static const unsigned long long latency_bounds[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+#define LATENCY_BUCKETS (sizeof(latency_bounds) / sizeof(latency_bounds[0]))
+
+/* Names of the outcomes and resolution sources, as written in the metrics file */
+static const char *kind_names[METRICS_KINDS] = { "run", "find", "notfound", "execfail" };
+static const char *source_names[4] = { "search", "cache", "daemon", "shared" };
+
+/* Counts of one tool, SDK or toolchain */
+typedef struct {
+	char name[NAME_MAX];
+	unsigned long long count[METRICS_KINDS];
+} counter;
+
+/* Counters of every tool, SDK or toolchain seen */
+typedef struct {
+	counter *items;
+	size_t count;
+	size_t size;
+} counter_set;
+
+/* Everything counted from the metrics file */
+typedef struct {
+	counter_set tools;
+	counter_set sdks;
+	counter_set toolchains;
+	unsigned long long kinds[METRICS_KINDS];
+	unsigned long long sources[4];
+	unsigned long long buckets[LATENCY_BUCKETS + 1];
+	unsigned long long latency_sum;
+	unsigned long long latency_count;
+} metrics_totals;
+
+/* Start of this invocation, 0 until metrics_start */
+static unsigned long long start_us = 0;
+
+/* helper function to read the monotonic clock, in microseconds */
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL);
+}
+
+/**
+ * @func metrics_path -- Get the path of the metrics file.
+ * @arg path   - buffer filled with the path, PATH_MAX long
+ * @arg create - create the folders leading to the file
+ * @return: 0 on success, -1 on failure
+ */
+static int metrics_path(char *path, bool create)
+{
+	const char *dir;
+	char *p;
+
+	if ((dir = getenv("XDG_CACHE_HOME")) != NULL && *dir != '\0')
+		snprintf(path, PATH_MAX, "%s/xcrun/metrics", dir);
+	else if ((dir = getenv("HOME")) != NULL && *dir != '\0')
+		snprintf(path, PATH_MAX, "%s/.cache/xcrun/metrics", dir);
+	else
+		return -1;
+
+	if (create) {
+		for (p = strchr(path + 1, '/'); p != NULL; p = strchr(p + 1, '/')) {
+			*p = '\0';
+			if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+				*p = '/';
+				return -1;
+			}
+			*p = '/';
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @func metrics_name -- Turn a name into a single word of the metrics file.
+ * @arg dst       - buffer filled with the word, NAME_MAX long
+ * @arg src       - name, or path whose last component is used, may be NULL
+ * @arg strip_ext - drop the extension of the last component (MacOSX.sdk is MacOSX)
+ *
+ * Anything outside of [A-Za-z0-9._+-] becomes an underscore, and nothing at all is written as "-".
+ */
+static void metrics_name(char *dst, const char *src, bool strip_ext)
+{
+	const char *base, *end;
+	size_t i = 0;
+
+	if (src == NULL)
+		src = "";
+
+	base = ((base = strrchr(src, '/')) != NULL ? base + 1 : src);
+	end = base + strlen(base);
+	if (strip_ext && strrchr(base, '.') != NULL && strrchr(base, '.') != base)
+		end = strrchr(base, '.');
+
+	for (; base < end && i < (NAME_MAX - 1); base++) {
+		if ((*base >= 'a' && *base <= 'z') || (*base >= 'A' && *base <= 'Z') || (*base >= '0' && *base <= '9') ||
+		    *base == '.' || *base == '_' || *base == '+' || *base == '-')
+			dst[i++] = *base;
+		else
+			dst[i++] = '_';
+	}
+
+	if (i == 0)
+		dst[i++] = '-';
+	dst[i] = '\0';
+}
+
+/* See documentation in header file. */
+void metrics_start(void)
+{
+	start_us = now_us();
+}
+
+/* See documentation in header file. */
+void metrics_record(int kind, const char *name, const xcrun_tool *tool)
+{
+	int fd;
+	int len;
+	char path[PATH_MAX];
+	char tool_name[NAME_MAX], sdk[NAME_MAX], toolchain[NAME_MAX];
+	char line[(NAME_MAX * 3) + 64];
+	const char *value;
+
+	if (start_us == 0 || kind < 0 || kind >= METRICS_KINDS)
+		return;
+	if ((value = getenv(METRICS_ENV)) == NULL || *value == '\0')
+		return;
+
+	metrics_name(tool_name, name, false);
+	metrics_name(sdk, (tool != NULL ? tool->sdk_path : NULL), true);
+	metrics_name(toolchain, (tool != NULL ? tool->toolchain_path : NULL), true);
+
+	len = snprintf(line, sizeof(line), "%d %s %s %llu %s %s %s\n", METRICS_VERSION, kind_names[kind],
+	               ((tool != NULL && tool->source >= 0 && tool->source < 4) ? source_names[tool->source] : "-"),
+	               (now_us() - start_us), tool_name, sdk, toolchain);
+
+	if (metrics_path(path, true) != 0 || (fd = open(path, (O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC), 0644)) == -1)
+		return;
+
+	/* One write per record, so that concurrent records never interleave. */
+	if (write(fd, line, len) != len)
+		fprintf(stderr, "xcrun: warning: failed to record metrics in \'%s\'.\n", path);
+
+	close(fd);
+}
+
+/**
+ * @func count -- Add to the counter of a name, adding the counter if it's new.
+ * @arg set  - counters
+ * @arg name - name counted
+ * @arg kind - outcome counted
+ * @return: 0 on success, -1 on failure
+ */
+static int count(counter_set *set, const char *name, int kind)
+{
+	size_t i;
+	counter *items;
+
+	for (i = 0; i < set->count; i++) {
+		if (strcmp(set->items[i].name, name) == 0) {
+			set->items[i].count[kind]++;
+			return 0;
+		}
+	}
+
+	if (set->count == set->size) {
+		if ((items = (counter *)realloc(set->items, ((set->size * 2) + 16) * sizeof(counter))) == NULL)
+			return -1;
+		set->items = items;
+		set->size = ((set->size * 2) + 16);
+	}
+
+	memset(&set->items[set->count], 0, sizeof(counter));
+	snprintf(set->items[set->count].name, NAME_MAX, "%s", name);
+	set->items[set->count++].count[kind] = 1;
+
+	return 0;
+}
+
+/* helper function to compare two counters by name for qsort */
+static int compare_counters(const void *a, const void *b)
+{
+	return strcmp(((const counter *)a)->name, ((const counter *)b)->name);
+}
+
+/* helper function to look up a word of the metrics file in a table of names */
+static int find_name(const char *word, const char *names[], int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (strcmp(word, names[i]) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/**
+ * @func read_totals -- Add up the records of the metrics file.
+ * @arg totals - zeroed totals to fill in
+ * @return: 0 on success (a missing file holds nothing), -1 on failure
+ */
+static int read_totals(metrics_totals *totals)
+{
+	FILE *fp;
+	unsigned int version;
+	unsigned long long latency;
+	int kind, source, status = 0;
+	size_t i;
+	char path[PATH_MAX];
+	char line[(NAME_MAX * 3) + 64];
+	char kind_word[16], source_word[16];
+	char tool[NAME_MAX], sdk[NAME_MAX], toolchain[NAME_MAX];
+
+	if (metrics_path(path, false) != 0) {
+		fprintf(stderr, "xcrun: error: failed to find the metrics file, neither XDG_CACHE_HOME nor HOME are set.\n");
+		return -1;
+	}
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		if (errno == ENOENT)
+			return 0;
+		fprintf(stderr, "xcrun: error: unable to open metrics \'%s\' (%s)\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (status == 0 && fgets(line, sizeof(line), fp) != NULL) {
+		/* Records of other versions, or torn by a full disk, are skipped. */
+		if (sscanf(line, "%u %15s %15s %llu %254s %254s %254s", &version, kind_word, source_word, &latency, tool, sdk, toolchain) != 7 ||
+		    version != METRICS_VERSION || (kind = find_name(kind_word, kind_names, METRICS_KINDS)) == -1)
+			continue;
+
+		totals->kinds[kind]++;
+
+		if (count(&totals->tools, tool, kind) != 0)
+			status = -1;
+
+		/* A tool that failed to execute was already counted when it was about to run. */
+		if (kind == METRICS_EXEC_FAILURE)
+			continue;
+
+		/* Tools that were only found have no SDK or toolchain. */
+		if ((strcmp(sdk, "-") != 0 && count(&totals->sdks, sdk, kind) != 0) ||
+		    (strcmp(toolchain, "-") != 0 && count(&totals->toolchains, toolchain, kind) != 0))
+			status = -1;
+
+		if ((source = find_name(source_word, source_names, 4)) != -1)
+			totals->sources[source]++;
+
+		for (i = 0; i < LATENCY_BUCKETS && latency > latency_bounds[i]; i++)
+			;
+		totals->buckets[i]++;
+		totals->latency_sum += latency;
+		totals->latency_count++;
+	}
+
+	if (status != 0)
+		fprintf(stderr, "xcrun: error: failed to read metrics \'%s\' (%s)\n", path, strerror(errno));
+
+	fclose(fp);
+
+	qsort(totals->tools.items, totals->tools.count, sizeof(counter), compare_counters);
+	qsort(totals->sdks.items, totals->sdks.count, sizeof(counter), compare_counters);
+	qsort(totals->toolchains.items, totals->toolchains.count, sizeof(counter), compare_counters);
+
+	return status;
+}
+
+/* helper function to get the number of invocations of a counter, leaving out exec failures */
+static unsigned long long invocations(const unsigned long long count[METRICS_KINDS])
+{
+	return (count[METRICS_RUN] + count[METRICS_FIND] + count[METRICS_NOT_FOUND]);
+}
+
+/**
+ * @func print_plain -- Print totals as a human readable summary.
+ * @arg fp     - where to print
+ * @arg totals - totals
+ */
+static void print_plain(FILE *fp, const metrics_totals *totals)
+{
+	size_t i;
+	unsigned long long hits = totals->sources[XCRUN_SOURCE_CACHE] + totals->sources[XCRUN_SOURCE_DAEMON] +
+	                          totals->sources[XCRUN_SOURCE_SHARED];
+	unsigned long long lookups = hits + totals->sources[XCRUN_SOURCE_SEARCH];
+
+	fprintf(fp, "invocations: %llu (run %llu, find %llu, not found %llu)\n", invocations(totals->kinds),
+	        totals->kinds[METRICS_RUN], totals->kinds[METRICS_FIND], totals->kinds[METRICS_NOT_FOUND]);
+	fprintf(fp, "exec failures: %llu\n", totals->kinds[METRICS_EXEC_FAILURE]);
+	fprintf(fp, "lookups: %llu (xcrund %llu, shared %llu, cache %llu, search %llu, %.1f%% hits)\n", lookups,
+	        totals->sources[XCRUN_SOURCE_DAEMON], totals->sources[XCRUN_SOURCE_SHARED], totals->sources[XCRUN_SOURCE_CACHE],
+	        totals->sources[XCRUN_SOURCE_SEARCH],
+	        (lookups != 0 ? (100.0 * hits / lookups) : 0.0));
+
+	fprintf(fp, "resolution latency: mean %.3f ms\n",
+	        (totals->latency_count != 0 ? ((double)totals->latency_sum / totals->latency_count / 1000.0) : 0.0));
+	for (i = 0; i < LATENCY_BUCKETS; i++)
+		fprintf(fp, "  <= %7.2f ms  %llu\n", (latency_bounds[i] / 1000.0), totals->buckets[i]);
+	fprintf(fp, "   > %7.2f ms  %llu\n", (latency_bounds[LATENCY_BUCKETS - 1] / 1000.0), totals->buckets[LATENCY_BUCKETS]);
+
+	fprintf(fp, "tools:\n");
+	for (i = 0; i < totals->tools.count; i++) {
+		fprintf(fp, "  %-24s %llu (run %llu, find %llu, not found %llu, exec failures %llu)\n", totals->tools.items[i].name,
+		        invocations(totals->tools.items[i].count), totals->tools.items[i].count[METRICS_RUN],
+		        totals->tools.items[i].count[METRICS_FIND], totals->tools.items[i].count[METRICS_NOT_FOUND],
+		        totals->tools.items[i].count[METRICS_EXEC_FAILURE]);
+	}
+
+	fprintf(fp, "sdks:\n");
+	for (i = 0; i < totals->sdks.count; i++)
+		fprintf(fp, "  %-24s %llu\n", totals->sdks.items[i].name, invocations(totals->sdks.items[i].count));
+
+	fprintf(fp, "toolchains:\n");
+	for (i = 0; i < totals->toolchains.count; i++)
+		fprintf(fp, "  %-24s %llu\n", totals->toolchains.items[i].name, invocations(totals->toolchains.items[i].count));
+}
+
+/**
+ * @func print_prometheus -- Print totals in the Prometheus text exposition format.
+ * @arg fp     - where to print
+ * @arg totals - totals
+ *
+ * Names only ever hold [A-Za-z0-9._+-] (see metrics_name), so label values need no escaping.
+ */
+static void print_prometheus(FILE *fp, const metrics_totals *totals)
+{
+	int kind;
+	size_t i;
+	unsigned long long cumulative = 0;
+	static const char *result_labels[METRICS_KINDS - 1] = { "run", "find", "not_found" };
+
+	fprintf(fp, "# HELP xcrun_invocations_total Invocations of xcrun, by tool and result.\n");
+	fprintf(fp, "# TYPE xcrun_invocations_total counter\n");
+	for (i = 0; i < totals->tools.count; i++) {
+		for (kind = 0; kind < METRICS_EXEC_FAILURE; kind++) {
+			if (totals->tools.items[i].count[kind] != 0)
+				fprintf(fp, "xcrun_invocations_total{tool=\"%s\",result=\"%s\"} %llu\n", totals->tools.items[i].name,
+				        result_labels[kind], totals->tools.items[i].count[kind]);
+		}
+	}
+
+	fprintf(fp, "# HELP xcrun_sdk_invocations_total Invocations of xcrun, by SDK.\n");
+	fprintf(fp, "# TYPE xcrun_sdk_invocations_total counter\n");
+	for (i = 0; i < totals->sdks.count; i++)
+		fprintf(fp, "xcrun_sdk_invocations_total{sdk=\"%s\"} %llu\n", totals->sdks.items[i].name, invocations(totals->sdks.items[i].count));
+
+	fprintf(fp, "# HELP xcrun_toolchain_invocations_total Invocations of xcrun, by toolchain.\n");
+	fprintf(fp, "# TYPE xcrun_toolchain_invocations_total counter\n");
+	for (i = 0; i < totals->toolchains.count; i++)
+		fprintf(fp, "xcrun_toolchain_invocations_total{toolchain=\"%s\"} %llu\n", totals->toolchains.items[i].name,
+		        invocations(totals->toolchains.items[i].count));
+
+	fprintf(fp, "# HELP xcrun_lookups_total Tool lookups, by where the answer came from.\n");
+	fprintf(fp, "# TYPE xcrun_lookups_total counter\n");
+	for (i = 0; i < 4; i++)
+		fprintf(fp, "xcrun_lookups_total{source=\"%s\"} %llu\n", source_names[i], totals->sources[i]);
+
+	fprintf(fp, "# HELP xcrun_exec_failures_total Tools that were resolved but failed to execute, by tool.\n");
+	fprintf(fp, "# TYPE xcrun_exec_failures_total counter\n");
+	for (i = 0; i < totals->tools.count; i++) {
+		if (totals->tools.items[i].count[METRICS_EXEC_FAILURE] != 0)
+			fprintf(fp, "xcrun_exec_failures_total{tool=\"%s\"} %llu\n", totals->tools.items[i].name,
+			        totals->tools.items[i].count[METRICS_EXEC_FAILURE]);
+	}
+
+	fprintf(fp, "# HELP xcrun_resolve_seconds Time from the start of xcrun until its tool was resolved.\n");
+	fprintf(fp, "# TYPE xcrun_resolve_seconds histogram\n");
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		cumulative += totals->buckets[i];
+		fprintf(fp, "xcrun_resolve_seconds_bucket{le=\"%g\"} %llu\n", (latency_bounds[i] / 1000000.0), cumulative);
+	}
+	fprintf(fp, "xcrun_resolve_seconds_bucket{le=\"+Inf\"} %llu\n", totals->latency_count);
+	fprintf(fp, "xcrun_resolve_seconds_sum %.6f\n", (totals->latency_sum / 1000000.0));
+	fprintf(fp, "xcrun_resolve_seconds_count %llu\n", totals->latency_count);
+}
+
+/* See documentation in header file. */
+int metrics_report(FILE *fp, bool prometheus)
+{
+	int status;
+	metrics_totals totals;
+
+	memset(&totals, 0, sizeof(totals));
+
+	if ((status = read_totals(&totals)) == 0) {
+		if (prometheus)
+			print_prometheus(fp, &totals);
+		else
+			print_plain(fp, &totals);
+	}
+
+	free(totals.tools.items);
+	free(totals.sdks.items);
+	free(totals.toolchains.items);
+
+	return status;
+}
@@ -0,0 +1,76 @@
+/* metrics.h - usage metrics of xcrun invocations
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "libxcrun.h"
+
+/* Environment variable turning recording on */
+#define METRICS_ENV "XCRUN_METRICS"
+
+/* Version tag of the records of the metrics file */
+#define METRICS_VERSION 1
+
+/* Outcomes of an invocation */
+enum {
+	METRICS_RUN,		/* tool resolved and about to run */
+	METRICS_FIND,		/* tool found and printed (--find) */
+	METRICS_NOT_FOUND,	/* tool couldn't be resolved */
+	METRICS_EXEC_FAILURE,	/* tool resolved but couldn't be executed */
+	METRICS_KINDS
+};
+
+/**
+ * @func metrics_start -- start timing this invocation, records are only written once this is called
+ */
+void metrics_start(void);
+
+/**
+ * @func metrics_record -- record an invocation in the metrics file, if METRICS_ENV is set
+ * @arg kind - outcome of the invocation (METRICS_*)
+ * @arg name - name of the tool
+ * @arg tool - resolved tool, NULL if it wasn't resolved
+ */
+void metrics_record(int kind, const char *name, const xcrun_tool *tool);
+
+/**
+ * @func metrics_report -- summarize the metrics file
+ * @arg fp         - where to print the summary
+ * @arg prometheus - print in the Prometheus text exposition format instead of plain text
+ * @return: 0 on success, -1 on failure
+ */
+int metrics_report(FILE *fp, bool prometheus);
+
+#endif /* __METRICS_H__ */
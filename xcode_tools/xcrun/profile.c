@@ -0,0 +1,589 @@
+/* profile.c - resource usage of the tools run by xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * With PROFILE_ENV naming a log file, xcrun doesn't become the tool it runs. It starts the tool with
+ * posix_spawn() instead, waits for it with wait4() and appends what the tool cost to the log: wall
+ * time, user and system CPU time, peak resident set size, page faults and context switches, along
+ * with the name of the tool, its SDK, the architecture it built for and the source file it compiled
+ * (or the output it linked). Records are single lines written with a single write() to a file opened
+ * in append mode, so parallel builds can share a log.
+ *
+ * While the tool runs, xcrun ignores the keyboard signals, which reach the tool through the terminal
+ * anyway, and forwards SIGTERM and SIGHUP to it. Once it is done, its exit status is passed on, and
+ * a tool killed by a signal has xcrun killed by the same signal.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "profile.h"
+
+/* Extensions of the source files a compile is tagged with */
+static const char *source_extensions[] = { ".c", ".cc", ".cp", ".cpp", ".cxx", ".c++", ".C", ".m", ".mm", ".M", ".s", ".S", ".swift", ".i", ".ii", ".ll", ".bc", NULL };
+
+/* Fields of a record of the profile log, in order */
+enum {
+	FIELD_VERSION,
+	FIELD_STATUS,
+	FIELD_WALL,
+	FIELD_USER,
+	FIELD_SYS,
+	FIELD_MAXRSS,
+	FIELD_MINFLT,
+	FIELD_MAJFLT,
+	FIELD_NVCSW,
+	FIELD_NIVCSW,
+	FIELD_TOOL,
+	FIELD_SDK,
+	FIELD_ARCH,
+	FIELD_FILE,
+	FIELD_COUNT
+};
+
+/* A record of the profile log, its strings point into line */
+typedef struct {
+	char *line;
+	const char *tool;
+	const char *arch;
+	const char *file;
+	int status;
+	unsigned long long wall;
+	unsigned long long cpu;
+	unsigned long long maxrss;
+	unsigned long long majflt;
+	unsigned long long csw;
+} profile_entry;
+
+/* What a tool, or a source file, cost over all of its runs */
+typedef struct {
+	const char *tool;
+	const char *arch;
+	const char *file;
+	unsigned long long runs;
+	unsigned long long failures;
+	unsigned long long wall;
+	unsigned long long cpu;
+	unsigned long long maxrss;
+	unsigned long long majflt;
+	unsigned long long csw;
+} profile_total;
+
+/* Tool running, for the signal forwarder */
+static volatile pid_t child = -1;
+
+/* helper function to read the monotonic clock, in microseconds */
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL);
+}
+
+/* helper function to turn a timeval into microseconds */
+static unsigned long long timeval_us(const struct timeval *tv)
+{
+	return ((unsigned long long)tv->tv_sec * 1000000ULL + (unsigned long long)tv->tv_usec);
+}
+
+/* helper function to pass a signal on to the tool */
+static void forward_signal(int sig)
+{
+	if (child > 0)
+		kill(child, sig);
+}
+
+/**
+ * @func copy_field -- Copy a string into a field of a record.
+ * @arg dst       - buffer
+ * @arg size      - size of buffer
+ * @arg src       - string, may be NULL
+ * @arg basename  - only keep the last path component, without its extension
+ *
+ * Tabs and line breaks would break the record up, they become spaces. Nothing at all is written as "-".
+ */
+static void copy_field(char *dst, size_t size, const char *src, bool basename)
+{
+	const char *end;
+	size_t i = 0;
+
+	if (src == NULL)
+		src = "";
+
+	end = src + strlen(src);
+	if (basename) {
+		if (strrchr(src, '/') != NULL)
+			src = strrchr(src, '/') + 1;
+		if (strrchr(src, '.') != NULL && strrchr(src, '.') != src)
+			end = strrchr(src, '.');
+	}
+
+	for (; src < end && i < (size - 1); src++)
+		dst[i++] = ((*src == '\t' || *src == '\n' || *src == '\r') ? ' ' : *src);
+
+	if (i == 0)
+		dst[i++] = '-';
+	dst[i] = '\0';
+}
+
+/**
+ * @func find_file -- Find the source file a compile is for, or else the output it writes.
+ * @arg argv - arguments the tool runs with
+ * @return: source file or output, NULL if there is neither
+ */
+static const char *find_file(char *const argv[])
+{
+	int i, j;
+	size_t len, ext_len;
+	const char *output = NULL;
+
+	for (i = 1; argv[i] != NULL; i++) {
+		if (strcmp(argv[i], "-o") == 0 && argv[i + 1] != NULL) {
+			output = argv[++i];
+			continue;
+		}
+		if (*argv[i] == '-')
+			continue;
+		len = strlen(argv[i]);
+		for (j = 0; source_extensions[j] != NULL; j++) {
+			ext_len = strlen(source_extensions[j]);
+			if (len > ext_len && strcmp(argv[i] + len - ext_len, source_extensions[j]) == 0)
+				return argv[i];
+		}
+	}
+
+	return output;
+}
+
+/**
+ * @func find_arch -- Find the architecture a tool builds for.
+ * @arg tool - resolved tool
+ * @arg argv - arguments the tool runs with
+ * @arg arch - buffer filled with the architecture, NAME_MAX long
+ */
+static void find_arch(const xcrun_tool *tool, char *const argv[], char *arch)
+{
+	int i;
+
+	if (*tool->arch != '\0') {
+		copy_field(arch, NAME_MAX, tool->arch, false);
+		return;
+	}
+
+	for (i = 1; argv[i] != NULL; i++) {
+		if (strcmp(argv[i], "-arch") == 0 && argv[i + 1] != NULL) {
+			copy_field(arch, NAME_MAX, argv[i + 1], false);
+			return;
+		}
+	}
+
+	/* Otherwise it's the SDK's own, the first component of its target triple. */
+	copy_field(arch, NAME_MAX, tool->target_triple, false);
+	arch[strcspn(arch, "-")] = '\0';
+	if (*arch == '\0')
+		strcpy(arch, "-");
+}
+
+/**
+ * @func append_record -- Append the resource usage of a tool to the profile log.
+ * @arg path   - profile log
+ * @arg name   - name of the tool
+ * @arg tool   - resolved tool
+ * @arg argv   - arguments the tool ran with
+ * @arg status - exit status of the tool, 128 plus the signal number if it was killed
+ * @arg wall   - wall time, in microseconds
+ * @arg usage  - resource usage of the tool
+ */
+static void append_record(const char *path, const char *name, const xcrun_tool *tool, char *const argv[], int status, unsigned long long wall, const struct rusage *usage)
+{
+	int fd;
+	int len;
+	long maxrss = usage->ru_maxrss;
+	char tool_name[NAME_MAX], sdk[NAME_MAX], arch[NAME_MAX], file[PATH_MAX];
+	char line[PATH_MAX + (NAME_MAX * 3) + 256];
+
+#ifdef __APPLE__
+	/* Darwin counts the peak resident set size in bytes, everyone else in kilobytes. */
+	maxrss /= 1024;
+#endif
+
+	copy_field(tool_name, sizeof(tool_name), name, false);
+	copy_field(sdk, sizeof(sdk), tool->sdk_path, true);
+	copy_field(file, sizeof(file), find_file(argv), false);
+	find_arch(tool, argv, arch);
+
+	len = snprintf(line, sizeof(line), "%d\t%d\t%llu\t%llu\t%llu\t%ld\t%ld\t%ld\t%ld\t%ld\t%s\t%s\t%s\t%s\n", PROFILE_VERSION, status,
+	               wall, timeval_us(&usage->ru_utime), timeval_us(&usage->ru_stime), maxrss, usage->ru_minflt, usage->ru_majflt,
+	               usage->ru_nvcsw, usage->ru_nivcsw, tool_name, sdk, arch, file);
+	if (len >= (int)sizeof(line))
+		return;
+
+	if ((fd = open(path, (O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC), 0644)) == -1) {
+		fprintf(stderr, "xcrun: warning: unable to open profile log \'%s\' (%s)\n", path, strerror(errno));
+		return;
+	}
+
+	/* One write per record, so that concurrent records never interleave. */
+	if (write(fd, line, len) != len)
+		fprintf(stderr, "xcrun: warning: failed to record the profile of \'%s\' in \'%s\'.\n", name, path);
+
+	close(fd);
+}
+
+/* See documentation in header file. */
+bool profile_enabled(void)
+{
+	const char *path = getenv(PROFILE_ENV);
+
+	return (path != NULL && *path != '\0');
+}
+
+/* See documentation in header file. */
+int profile_spawn(const xcrun_tool *tool, char *const envp[], char *const argv[], struct rusage *usage, unsigned long long *wall)
+{
+	int i, error, status;
+	unsigned long long start = 0;
+	pid_t pid;
+	sigset_t forwarded, saved_mask, defaults;
+	struct sigaction ignore, forward, saved[4];
+	posix_spawnattr_t attr;
+	static const int signals[4] = { SIGINT, SIGQUIT, SIGTERM, SIGHUP };
+
+	memset(&ignore, 0, sizeof(ignore));
+	ignore.sa_handler = SIG_IGN;
+	sigemptyset(&ignore.sa_mask);
+	memset(&forward, 0, sizeof(forward));
+	forward.sa_handler = forward_signal;
+	sigemptyset(&forward.sa_mask);
+
+	/* Hold forwarded signals back until there is a tool to forward them to. */
+	sigemptyset(&forwarded);
+	sigaddset(&forwarded, SIGTERM);
+	sigaddset(&forwarded, SIGHUP);
+	sigprocmask(SIG_BLOCK, &forwarded, &saved_mask);
+
+	/* The tool gets the signal mask and dispositions xcrun had, not the ones it waits with. */
+	sigemptyset(&defaults);
+	for (i = 0; i < 4; i++) {
+		sigaction(signals[i], (i < 2 ? &ignore : &forward), &saved[i]);
+		if (saved[i].sa_handler != SIG_IGN)
+			sigaddset(&defaults, signals[i]);
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	if ((error = posix_spawnattr_init(&attr)) == 0) {
+		posix_spawnattr_setsigmask(&attr, &saved_mask);
+		posix_spawnattr_setsigdefault(&attr, &defaults);
+		posix_spawnattr_setflags(&attr, (POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF));
+
+		start = now_us();
+		error = posix_spawn(&pid, tool->path, NULL, &attr, argv, envp);
+		posix_spawnattr_destroy(&attr);
+	}
+
+	if (error != 0) {
+		for (i = 0; i < 4; i++)
+			sigaction(signals[i], &saved[i], NULL);
+		sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+		fprintf(stderr, "xcrun: error: can't spawn \'%s\' (%s)\n", tool->path, strerror(error));
+		return -1;
+	}
+
+	child = pid;
+	sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+
+	while (wait4(pid, &status, 0, usage) == -1) {
+		if (errno != EINTR) {
+			memset(usage, 0, sizeof(*usage));
+			status = (1 << 8);
+			break;
+		}
+	}
+
+	*wall = (now_us() - start);
+
+	child = -1;
+	for (i = 0; i < 4; i++)
+		sigaction(signals[i], &saved[i], NULL);
+
+	return status;
+}
+
+/* See documentation in header file. */
+void profile_record(const char *name, const xcrun_tool *tool, char *const argv[], int status, unsigned long long wall, const struct rusage *usage)
+{
+	if (profile_enabled())
+		append_record(getenv(PROFILE_ENV), name, tool, argv, (WIFSIGNALED(status) ? (128 + WTERMSIG(status)) : WEXITSTATUS(status)), wall, usage);
+}
+
+/* See documentation in header file. */
+int profile_exit_status(int status)
+{
+	struct rlimit no_core = { 0, 0 };
+
+	if (!WIFSIGNALED(status))
+		return WEXITSTATUS(status);
+
+	/* Die the way the tool did, the tool already left a core behind if it was going to. */
+	fflush(NULL);
+	setrlimit(RLIMIT_CORE, &no_core);
+	signal(WTERMSIG(status), SIG_DFL);
+	raise(WTERMSIG(status));
+
+	return (128 + WTERMSIG(status));
+}
+
+/* See documentation in header file. */
+int profile_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[])
+{
+	int status;
+	unsigned long long wall;
+	struct rusage usage;
+
+	if ((status = profile_spawn(tool, envp, argv, &usage, &wall)) == -1)
+		return -1;
+
+	profile_record(name, tool, argv, status, wall, &usage);
+
+	return profile_exit_status(status);
+}
+
+/**
+ * @func parse_record -- Split a line of the profile log into a record.
+ * @arg line   - line, split in place
+ * @arg record - record to fill in
+ * @return: 0 on success, -1 if the line isn't a record of this version
+ */
+static int parse_record(char *line, profile_entry *record)
+{
+	int n = 0;
+	char *fields[FIELD_COUNT];
+	char *p = line;
+
+	line[strcspn(line, "\n")] = '\0';
+
+	while (n < FIELD_COUNT) {
+		fields[n++] = p;
+		if ((p = strchr(p, '\t')) == NULL)
+			break;
+		*p++ = '\0';
+	}
+
+	if (n != FIELD_COUNT || p != NULL || atoi(fields[FIELD_VERSION]) != PROFILE_VERSION)
+		return -1;
+
+	record->status = atoi(fields[FIELD_STATUS]);
+	record->wall = strtoull(fields[FIELD_WALL], NULL, 10);
+	record->cpu = strtoull(fields[FIELD_USER], NULL, 10) + strtoull(fields[FIELD_SYS], NULL, 10);
+	record->maxrss = strtoull(fields[FIELD_MAXRSS], NULL, 10);
+	record->majflt = strtoull(fields[FIELD_MAJFLT], NULL, 10);
+	record->csw = strtoull(fields[FIELD_NVCSW], NULL, 10) + strtoull(fields[FIELD_NIVCSW], NULL, 10);
+	record->tool = fields[FIELD_TOOL];
+	record->arch = fields[FIELD_ARCH];
+	record->file = fields[FIELD_FILE];
+
+	return 0;
+}
+
+/* helper function to order records by tool for qsort */
+static int compare_tools(const void *a, const void *b)
+{
+	return strcmp(((const profile_entry *)a)->tool, ((const profile_entry *)b)->tool);
+}
+
+/* helper function to order records by file, then architecture, for qsort */
+static int compare_files(const void *a, const void *b)
+{
+	const profile_entry *ra = (const profile_entry *)a;
+	const profile_entry *rb = (const profile_entry *)b;
+	int diff = strcmp(ra->file, rb->file);
+
+	return (diff != 0 ? diff : strcmp(ra->arch, rb->arch));
+}
+
+/* helper function to order totals by CPU time, most first, for qsort */
+static int compare_cpu(const void *a, const void *b)
+{
+	const profile_total *ta = (const profile_total *)a;
+	const profile_total *tb = (const profile_total *)b;
+
+	return (ta->cpu < tb->cpu) - (ta->cpu > tb->cpu);
+}
+
+/* helper function to order totals by peak resident set size, most first, for qsort */
+static int compare_maxrss(const void *a, const void *b)
+{
+	const profile_total *ta = (const profile_total *)a;
+	const profile_total *tb = (const profile_total *)b;
+
+	return (ta->maxrss < tb->maxrss) - (ta->maxrss > tb->maxrss);
+}
+
+/**
+ * @func add_up -- Add up sorted records into one total per run of equal records.
+ * @arg records - records, sorted with compare
+ * @arg count   - number of records
+ * @arg totals  - totals to fill in, count long
+ * @arg compare - tells which records belong to the same total
+ * @return: number of totals
+ */
+static size_t add_up(const profile_entry *records, size_t count, profile_total *totals, int (*compare)(const void *, const void *))
+{
+	size_t i, n = 0;
+	profile_total *total = NULL;
+
+	for (i = 0; i < count; i++) {
+		if (total == NULL || compare(&records[i - 1], &records[i]) != 0) {
+			total = &totals[n++];
+			memset(total, 0, sizeof(*total));
+			total->tool = records[i].tool;
+			total->arch = records[i].arch;
+			total->file = records[i].file;
+		}
+
+		total->runs++;
+		total->failures += (records[i].status != 0);
+		total->wall += records[i].wall;
+		total->cpu += records[i].cpu;
+		total->majflt += records[i].majflt;
+		total->csw += records[i].csw;
+		if (records[i].maxrss > total->maxrss)
+			total->maxrss = records[i].maxrss;
+	}
+
+	return n;
+}
+
+/* helper function to print a list of source files */
+static void print_files(FILE *fp, const char *title, const profile_total *totals, size_t count)
+{
+	size_t i;
+
+	fprintf(fp, "\n%s:\n", title);
+	fprintf(fp, "  %11s %10s %10s  %-16s %-8s %s\n", "peak RSS MB", "cpu s", "wall s", "tool", "arch", "file");
+	for (i = 0; i < count && i < PROFILE_TOP_FILES; i++) {
+		fprintf(fp, "  %11.1f %10.3f %10.3f  %-16s %-8s %s\n", (totals[i].maxrss / 1024.0), (totals[i].cpu / 1e6), (totals[i].wall / 1e6),
+		        totals[i].tool, totals[i].arch, totals[i].file);
+	}
+}
+
+/* See documentation in header file. */
+int profile_report(const char *path, FILE *fp)
+{
+	int status = -1;
+	size_t i, count = 0, size = 0, n, files;
+	char line[PATH_MAX + (NAME_MAX * 3) + 256];
+	FILE *log;
+	profile_entry *records = NULL, *grown, swapped;
+	profile_total *totals = NULL;
+
+	if ((log = fopen(path, "r")) == NULL) {
+		fprintf(stderr, "xcrun: error: unable to open profile log \'%s\' (%s)\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), log) != NULL) {
+		if (count == size) {
+			if ((grown = (profile_entry *)realloc(records, ((size * 2) + 64) * sizeof(profile_entry))) == NULL)
+				goto done;
+			records = grown;
+			size = ((size * 2) + 64);
+		}
+		if ((records[count].line = strdup(line)) == NULL)
+			goto done;
+		if (parse_record(records[count].line, &records[count]) != 0) {
+			free(records[count].line);
+			continue;
+		}
+		count++;
+	}
+
+	if (count > 0 && (totals = (profile_total *)calloc(count, sizeof(profile_total))) == NULL)
+		goto done;
+
+	/* Tools, by the CPU time of all of their runs. */
+	qsort(records, count, sizeof(profile_entry), compare_tools);
+	n = add_up(records, count, totals, compare_tools);
+	qsort(totals, n, sizeof(profile_total), compare_cpu);
+
+	fprintf(fp, "tools by CPU time (%zu runs):\n", count);
+	fprintf(fp, "  %-16s %8s %8s %12s %12s %11s %12s %12s\n", "tool", "runs", "failed", "cpu s", "wall s", "peak RSS MB", "major faults", "ctx switches");
+	for (i = 0; i < n; i++) {
+		fprintf(fp, "  %-16s %8llu %8llu %12.3f %12.3f %11.1f %12llu %12llu\n", totals[i].tool, totals[i].runs, totals[i].failures,
+		        (totals[i].cpu / 1e6), (totals[i].wall / 1e6), (totals[i].maxrss / 1024.0), totals[i].majflt, totals[i].csw);
+	}
+
+	/* Source files (and link outputs), for each architecture they were built for. */
+	for (i = 0, files = 0; i < count; i++) {
+		if (strcmp(records[i].file, "-") != 0) {
+			swapped = records[files];
+			records[files++] = records[i];
+			records[i] = swapped;
+		}
+	}
+	qsort(records, files, sizeof(profile_entry), compare_files);
+	n = add_up(records, files, totals, compare_files);
+
+	qsort(totals, n, sizeof(profile_total), compare_maxrss);
+	print_files(fp, "source files by peak RSS", totals, n);
+	qsort(totals, n, sizeof(profile_total), compare_cpu);
+	print_files(fp, "source files by CPU time", totals, n);
+
+	status = 0;
+
+done:
+	if (status != 0)
+		fprintf(stderr, "xcrun: error: failed to read profile log \'%s\' (%s)\n", path, strerror(errno));
+
+	fclose(log);
+	for (i = 0; i < count; i++)
+		free(records[i].line);
+	free(records);
+	free(totals);
+
+	return status;
+}
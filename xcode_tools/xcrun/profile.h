@@ -0,0 +1,104 @@
+/* profile.h - resource usage of the tools run by xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "libxcrun.h"
+
+/* Log that the resource usage of every tool run is appended to, profiling is off unless it is set */
+#define PROFILE_ENV "XCRUN_PROFILE"
+
+/* Version tag of the records of the profile log */
+#define PROFILE_VERSION 1
+
+/* Number of source files listed by profile_report */
+#define PROFILE_TOP_FILES 25
+
+/**
+ * @func profile_enabled -- tell whether tools are to be profiled
+ * @return: true if PROFILE_ENV is set
+ */
+bool profile_enabled(void);
+
+/**
+ * @func profile_spawn -- run a tool as a child process and wait for it, passing on SIGTERM and SIGHUP
+ * @arg tool  - resolved tool
+ * @arg envp  - environment the tool runs with
+ * @arg argv  - arguments the tool runs with
+ * @arg usage - filled in with the resource usage of the tool
+ * @arg wall  - filled in with the wall time of the tool, in microseconds
+ * @return: wait status of the tool, -1 if it couldn't be started
+ */
+int profile_spawn(const xcrun_tool *tool, char *const envp[], char *const argv[], struct rusage *usage, unsigned long long *wall);
+
+/**
+ * @func profile_record -- append the resource usage of a tool run by profile_spawn to the profile log, if PROFILE_ENV is set
+ * @arg name   - name of the tool
+ * @arg tool   - resolved tool
+ * @arg argv   - arguments the tool ran with
+ * @arg status - wait status of the tool
+ * @arg wall   - wall time of the tool, in microseconds
+ * @arg usage  - resource usage of the tool
+ */
+void profile_record(const char *name, const xcrun_tool *tool, char *const argv[], int status, unsigned long long wall, const struct rusage *usage);
+
+/**
+ * @func profile_exit_status -- pass the fate of a tool on to xcrun
+ * @arg status - wait status of the tool
+ * @return: exit status of the tool (does not return if the tool was killed by a signal)
+ */
+int profile_exit_status(int status);
+
+/**
+ * @func profile_run -- run a tool with profile_spawn, record it with profile_record and pass its fate on
+ * @arg name - name of the tool
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @arg argv - arguments the tool runs with
+ * @return: exit status of the tool, -1 if it couldn't be started (does not return if the tool was killed by a signal)
+ */
+int profile_run(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[]);
+
+/**
+ * @func profile_report -- rank the tools and source files of a profile log by what they cost
+ * @arg path - profile log
+ * @arg fp   - where to print the report
+ * @return: 0 on success, -1 on failure
+ */
+int profile_report(const char *path, FILE *fp);
+
+#endif /* __PROFILE_H__ */
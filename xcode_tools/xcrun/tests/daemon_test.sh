@@ -0,0 +1,54 @@
+#!/bin/bash
+
+##
+# Checks that xcrun clients get their answers from a running xcrund.
+##
+
+. `dirname ${0}`/scratch.sh
+
+T=daemon_test
+SOCKET=${TMPDIR}/xcrund.`id -u`/socket
+
+# xcrund is xcrun called by another name.
+ln -s ${XCRUN} ${SCRATCH}/xcrund
+${SCRATCH}/xcrund 2> ${SCRATCH}/xcrund.log &
+DAEMON=${!}
+trap 'kill ${DAEMON} 2> /dev/null; rm -rf "${SCRATCH}"' EXIT
+
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	[ -S ${SOCKET} ] && break
+	sleep 0.1
+done
+
+# helper function to check where a lookup was answered from: expect_source <message> <pattern> <xcrun arguments>
+expect_source() {
+	CHECKS=$((CHECKS + 1))
+	MESSAGE=${1}
+	PATTERN=${2}
+	shift 2
+	${XCRUN} -v "${@}" > ${SCRATCH}/out 2>&1
+	grep -q "${PATTERN}" ${SCRATCH}/out || fail ${T} "${MESSAGE}:
+`cat ${SCRATCH}/out ${SCRATCH}/xcrund.log`"
+}
+
+CHECKS=$((CHECKS + 1))
+[ -S ${SOCKET} ] || fail ${T} "xcrund never listened on ${SOCKET}:
+`cat ${SCRATCH}/xcrund.log`"
+CHECKS=$((CHECKS + 1))
+[ "`ls -ld ${TMPDIR}/xcrund.\`id -u\` | cut -c1-10`" = drwx------ ] || fail ${T} "the socket directory is open to others"
+
+expect_source "xcrun -f tool was not answered by xcrund" "through xcrund" -f tool
+expect_source "xcrun -f tool was not answered by xcrund the second time" "through xcrund" -f tool
+
+# A selection made with xcode-select, switched a few times over, is served all the same.
+printf '%s\n3\n' ${DEVELOPER_DIR} > ${HOME}/.xcdev.dat
+unset DEVELOPER_DIR
+expect_source "xcrun -f tool with a switched selection was not answered by xcrund" "through xcrund" -f tool
+export DEVELOPER_DIR=${SCRATCH}/dev
+
+# Without the daemon, clients quietly resolve tools themselves.
+kill ${DAEMON}
+wait ${DAEMON} 2> /dev/null
+expect_source "xcrun -f tool failed without xcrund" "found command's absolute path" -f tool
+
+finish ${T}
@@ -0,0 +1,110 @@
+/* hash_test.c - known answers for the keys of cached and coalesced tool runs
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Keys are BLAKE2b hashes cut down to 128 bits, and must match what any other implementation
+ * (e.g. b2sum -l 128) computes for the same bytes. Each input is fed in whole, and then in every
+ * split into two updates, so that the buffering of the last block gets exercised around the block
+ * size.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../hash.h"
+
+/* An input made of the first len bytes of the counting pattern, and its key */
+typedef struct {
+	size_t len;
+	const char *hex;
+} pattern_vector;
+
+static const pattern_vector vectors[] = {
+	{ 0, "cae66941d9efbd404e4d88758ea67670" },
+	{ 128, "a74787004ef589e31149183900d0294a" },
+	{ 129, "aaf1b0371f6d4ee49ee4fb5ddd9c49ef" },
+	{ 1000, "bca120dfd89cd95d82898473a5b01c90" },
+};
+
+static int checks;
+static int failures;
+
+/* helper function to compare a key with the one expected */
+static void check_key(const char *what, const xcrun_hash *hash, const char *want)
+{
+	char got[HASH_HEX_SIZE];
+
+	checks++;
+	hash_hex(hash, got);
+	if (strcmp(got, want) != 0 && failures++ < 10)
+		fprintf(stderr, "hash_test: %s: got %s, want %s\n", what, got, want);
+}
+
+int main(void)
+{
+	size_t i, split;
+	unsigned char data[1000];
+	char what[64];
+	xcrun_hash hash;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (unsigned char)(i % 251);
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		for (split = 0; split <= vectors[i].len; split++) {
+			snprintf(what, sizeof(what), "%zu bytes split at %zu", vectors[i].len, split);
+			hash_init(&hash);
+			hash_update(&hash, data, split);
+			hash_update(&hash, data + split, vectors[i].len - split);
+			check_key(what, &hash, vectors[i].hex);
+		}
+	}
+
+	hash_init(&hash);
+	hash_update(&hash, "abc", 3);
+	check_key("abc", &hash, "cf4ab791c62b8d2b2109c90275287816");
+
+	/* Strings go in along with their terminator, and a finished key can still be added to. */
+	hash_init(&hash);
+	hash_string(&hash, "clang");
+	check_key("string", &hash, "f494f51aa6d565da565e85dfc6b85ed3");
+	hash_update(&hash, "", 0);
+	check_key("string, updated after hash_hex", &hash, "f494f51aa6d565da565e85dfc6b85ed3");
+
+	if (failures > 0) {
+		fprintf(stderr, "hash_test: %d of %d checks failed\n", failures, checks);
+		return 1;
+	}
+
+	fprintf(stdout, "hash_test: %d checks passed\n", checks);
+
+	return 0;
+}
@@ -0,0 +1,292 @@
+/* ini_scan_test.c - differential test of the vector INI scanners against the scalar one
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Every vector scanner the running CPU supports is run against scan_scalar() on the same input,
+ * and must stop on the same byte. Inputs are random buffers heavy in the bytes the scanners look
+ * for, single matches at every position around the 16 and 32 byte block boundaries, and buffers
+ * ending right before an unmapped page, so that reading past the end faults. Whole files are
+ * then parsed with each scanner in turn, and must produce the same handler calls.
+ *
+ * The scanners are private to ini.c, which is why it is included rather than linked.
+ */
+
+#include "../ini.c"
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+typedef struct {
+	const char *name;
+	ini_scanner fn;
+} named_scanner;
+
+static named_scanner scanners[4];
+static int nscanners;
+static unsigned long long checks;
+static int failures;
+
+/* Bytes the inputs are made of, the scanners must tell apart those that merely look alike */
+static const char alphabet[] = { 'a', '=', ':', ';', ']', '[', '\n', '\r', ' ', '\t', '#', '\0', (char)0x80, (char)0xbb, (char)0xff };
+
+/* Characters the parser scans for, along with some it never does */
+static const char targets[] = { '=', ':', ']', '\n', ';', '\0', (char)0x80, (char)0xff };
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+/* helper function to draw a pseudo random number (xorshift64*), the same sequence on every run */
+static uint64_t next_random(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+
+	return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+/* helper function to register the scanners the running CPU supports */
+static void find_scanners(void)
+{
+	scanners[nscanners].name = "scalar";
+	scanners[nscanners++].fn = scan_scalar;
+#if INI_SIMD_X86
+	scanners[nscanners].name = "sse2";
+	scanners[nscanners++].fn = scan_sse2;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		scanners[nscanners].name = "avx2";
+		scanners[nscanners++].fn = scan_avx2;
+	}
+#elif INI_SIMD_NEON
+	scanners[nscanners].name = "neon";
+	scanners[nscanners++].fn = scan_neon;
+#endif
+}
+
+/**
+ * @func compare_scan -- Run every scanner over a range and check that they agree with the scalar one.
+ * @arg what - description of the input, for failures
+ * @arg s    - start of the range
+ * @arg end  - end of the range
+ * @arg c    - character to scan for
+ */
+static void compare_scan(const char *what, const char *s, const char *end, char c)
+{
+	int i;
+	const char *want = scan_scalar(s, end, c);
+	const char *got;
+
+	for (i = 1; i < nscanners; i++) {
+		checks++;
+		if ((got = scanners[i].fn(s, end, c)) != want) {
+			if (failures++ < 10)
+				fprintf(stderr, "ini_scan_test: %s: %s scanning %zd bytes for 0x%02x stopped at %zd, scalar at %zd\n",
+				        what, scanners[i].name, (end - s), (unsigned char)c, (got - s), (want - s));
+		}
+	}
+}
+
+/* Random buffers, scanned from every alignment */
+static void test_random(void)
+{
+	int round, len, offset;
+	size_t i, t;
+	char buf[256 + 64];
+
+	for (round = 0; round < 4000; round++) {
+		len = (int)(next_random() % 257);
+		for (i = 0; i < sizeof(buf); i++) {
+			/* Mostly plain bytes, so that matches land anywhere in a block, not just at its start. */
+			buf[i] = ((next_random() % 4) == 0 ? alphabet[next_random() % sizeof(alphabet)] : 'a');
+		}
+		offset = (int)(next_random() % 64);
+		for (t = 0; t < sizeof(targets); t++)
+			compare_scan("random", buf + offset, buf + offset + len, targets[t]);
+	}
+}
+
+/* A single match (or none at all) at every position of buffers around the block sizes */
+static void test_single_match(void)
+{
+	int len, pos, offset;
+	size_t t;
+	char buf[128 + 32];
+
+	for (len = 0; len <= 100; len++) {
+		for (offset = 0; offset < 32; offset += 7) {
+			for (t = 0; t < sizeof(targets); t++) {
+				memset(buf, 'a', sizeof(buf));
+				compare_scan("no match", buf + offset, buf + offset + len, targets[t]);
+
+				for (pos = 0; pos < len; pos++) {
+					buf[offset + pos] = targets[t];
+					compare_scan("single match", buf + offset, buf + offset + len, targets[t]);
+					buf[offset + pos] = ';';
+					compare_scan("single comment", buf + offset, buf + offset + len, targets[t]);
+					buf[offset + pos] = 'a';
+				}
+
+				/* A match just past the end must not be seen. */
+				buf[offset + len] = targets[t];
+				compare_scan("match past end", buf + offset, buf + offset + len, targets[t]);
+				buf[offset + len] = 'a';
+			}
+		}
+	}
+}
+
+/* Buffers ending right before an unmapped page */
+static void test_page_end(void)
+{
+	int len;
+	size_t t;
+	long page = sysconf(_SC_PAGESIZE);
+	char *map, *end;
+
+	if ((map = (char *)mmap(NULL, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		fprintf(stderr, "ini_scan_test: mmap failed, skipping page end checks\n");
+		return;
+	}
+
+	memset(map, 'a', page);
+	mprotect(map + page, page, PROT_NONE);
+	end = map + page;
+
+	for (len = 0; len <= 100; len++) {
+		for (t = 0; t < sizeof(targets); t++)
+			compare_scan("page end", end - len, end, targets[t]);
+	}
+
+	munmap(map, page * 2);
+}
+
+/* Growable string the handler calls of a parse are written to */
+typedef struct {
+	char *buf;
+	size_t len;
+	size_t size;
+} transcript;
+
+/* helper function to append a view to a transcript */
+static void append(transcript *out, const char *tag, ini_view view)
+{
+	size_t need = out->len + strlen(tag) + view.len + 2;
+
+	if (need > out->size) {
+		out->size = need * 2;
+		if ((out->buf = (char *)realloc(out->buf, out->size)) == NULL) {
+			fprintf(stderr, "ini_scan_test: out of memory\n");
+			exit(1);
+		}
+	}
+
+	out->len += sprintf(out->buf + out->len, "%s", tag);
+	memcpy(out->buf + out->len, view.ptr, view.len);
+	out->len += view.len;
+	out->buf[out->len++] = '|';
+	out->buf[out->len] = '\0';
+}
+
+/* handler of ini_parse_buffer, recording every call */
+static int record(void *user, ini_view section, ini_view name, ini_view value)
+{
+	append((transcript *)user, "S", section);
+	append((transcript *)user, "N", name);
+	append((transcript *)user, "V", value);
+
+	return 1;
+}
+
+/* Random files, parsed with each scanner in turn */
+static void test_parse(void)
+{
+	static const char *pieces[] = {
+		"[SDK]\n", "[TOOL clang]\n", "[ADMISSION ld]\n", "name = DarwinARM\n", "args=-target ${TARGET_TRIPLE}\n",
+		"path: /usr/bin/clang ; comment\n", "; just a comment\n", "# hash comment\n", "\n", "   \n",
+		"  continued value\n", "key=value;not a comment\n", "broken line\n", "[unterminated\n",
+		"x=\xef\xbb\xbf\x80\xff\n", "empty=\n", "=no name\n", "long_name_to_cross_a_block_boundary = some longer value here\r\n",
+	};
+	int round, i, n, error, want_error;
+	size_t len;
+	char *text;
+	transcript want, got;
+
+	for (round = 0; round < 500; round++) {
+		text = NULL;
+		len = 0;
+		n = (int)(next_random() % 40);
+		for (i = 0; i < n; i++) {
+			const char *piece = pieces[next_random() % (sizeof(pieces) / sizeof(pieces[0]))];
+			text = (char *)realloc(text, len + strlen(piece) + 1);
+			strcpy(text + len, piece);
+			len += strlen(piece);
+		}
+
+		memset(&want, 0, sizeof(want));
+		scan = scan_scalar;
+		want_error = ini_parse_buffer(text, len, record, NULL, &want);
+
+		for (i = 1; i < nscanners; i++) {
+			memset(&got, 0, sizeof(got));
+			scan = scanners[i].fn;
+			error = ini_parse_buffer(text, len, record, NULL, &got);
+			checks++;
+			if (error != want_error || got.len != want.len || (want.len > 0 && memcmp(got.buf, want.buf, want.len) != 0)) {
+				if (failures++ < 10)
+					fprintf(stderr, "ini_scan_test: parse: %s disagrees with scalar on a %zu byte file\n", scanners[i].name, len);
+			}
+			free(got.buf);
+		}
+
+		free(want.buf);
+		free(text);
+	}
+}
+
+int main(void)
+{
+	find_scanners();
+
+	test_random();
+	test_single_match();
+	test_page_end();
+	test_parse();
+
+	if (failures > 0) {
+		fprintf(stderr, "ini_scan_test: %d of %llu checks failed\n", failures, checks);
+		return 1;
+	}
+
+	fprintf(stdout, "ini_scan_test: %llu checks passed (%d scanners)\n", checks, nscanners);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#!/bin/bash
+
+##
+# Checks the profile log written with XCRUN_PROFILE set, the exit statuses passed through, and --profile-summary.
+##
+
+. `dirname ${0}`/scratch.sh
+
+T=profile_test
+LOG=${SCRATCH}/profile.log
+
+# A compiler and a linker that write their output, the compiler using some 40 MB more for big.c.
+cat > ${TOOLS}/cc <<'TOOL'
+#!/bin/sh
+out=a.out; prev=
+for arg in "$@"; do
+	[ "${prev}" = -o ] && out=${arg}
+	[ "${arg}" = big.c ] && dd if=/dev/zero of=/dev/null bs=40000000 count=1 2> /dev/null
+	prev=${arg}
+done
+echo built > ${out}
+TOOL
+cp ${TOOLS}/cc ${TOOLS}/ld
+printf '#!/bin/sh\nexit ${1}\n' > ${TOOLS}/status
+printf '#!/bin/sh\nkill -TERM $$\n' > ${TOOLS}/selfkill
+chmod +x ${TOOLS}/cc ${TOOLS}/ld ${TOOLS}/status ${TOOLS}/selfkill
+
+cd ${SCRATCH}
+export XCRUN_PROFILE=${LOG}
+${XCRUN} cc -c small.c -o small.o || fail ${T} "xcrun cc -c small.c failed"
+${XCRUN} cc -c big.c -o big.o || fail ${T} "xcrun cc -c big.c failed"
+${XCRUN} ld small.o big.o -o app || fail ${T} "xcrun ld failed"
+${XCRUN} status 3
+STATUS=${?}
+SIGNALED=`sh -c '"${0}" selfkill 2> /dev/null; echo ${?}' ${XCRUN}`
+unset XCRUN_PROFILE
+
+# Exit statuses and signals make it through, and so do the outputs.
+CHECKS=$((CHECKS + 1))
+[ ${STATUS} -eq 3 ] || fail ${T} "xcrun status 3 exited with ${STATUS}"
+CHECKS=$((CHECKS + 1))
+[ ${SIGNALED} -eq 143 ] || fail ${T} "xcrun selfkill exited with ${SIGNALED}, not killed by SIGTERM"
+CHECKS=$((CHECKS + 1))
+[ -f small.o -a -f big.o -a -f app ] || fail ${T} "outputs missing"
+
+# One line per run: version, status, wall, user and system time, peak RSS, minor and major faults,
+# voluntary and involuntary context switches, then tool, SDK, architecture and file.
+TAB=`printf '\t'`
+N="[0-9]+${TAB}"
+CHECKS=$((CHECKS + 1))
+[ `wc -l < ${LOG}` -eq 5 ] || fail ${T} "expected 5 profile lines, got:
+`cat ${LOG}`"
+expect_all ${T} ${LOG} "^1${TAB}${N}${N}${N}${N}${N}${N}${N}${N}${N}[^${TAB}]+${TAB}[^${TAB}]+${TAB}[^${TAB}]+${TAB}[^${TAB}]+\$"
+expect_line ${T} ${LOG} "^1${TAB}0${TAB}(${N}){8}cc${TAB}Test${TAB}arm${TAB}small.c\$"
+expect_line ${T} ${LOG} "^1${TAB}0${TAB}(${N}){8}ld${TAB}Test${TAB}arm${TAB}app\$"
+expect_line ${T} ${LOG} "^1${TAB}3${TAB}(${N}){8}status${TAB}Test${TAB}arm${TAB}-\$"
+expect_line ${T} ${LOG} "^1${TAB}143${TAB}(${N}){8}selfkill${TAB}Test${TAB}arm${TAB}-\$"
+
+CHECKS=$((CHECKS + 1))
+RSS=`awk -F '\t' '$14 == "small.c" { small = $6 } $14 == "big.c" { big = $6 } END { print big - small }' ${LOG}`
+[ "${RSS}" -gt 30000 ] || fail ${T} "big.c peaked only ${RSS} KB above small.c"
+
+# Lines of other versions, or torn ones, are left out of the summary.
+printf '2\t0\t1\t1\t1\t1\t1\t1\t1\t1\tcc\tTest\tarm\tnew.c\ntruncated\n' >> ${LOG}
+
+${XCRUN} --profile-summary ${LOG} > ${SCRATCH}/summary || fail ${T} "xcrun --profile-summary failed"
+expect_line ${T} ${SCRATCH}/summary '^tools by CPU time \(5 runs\):$'
+expect_line ${T} ${SCRATCH}/summary '^  tool +runs +failed +cpu s +wall s +peak RSS MB +major faults +ctx switches$'
+expect_line ${T} ${SCRATCH}/summary '^  cc +2 +0 +[0-9]+\.[0-9]{3} +[0-9]+\.[0-9]{3} +[0-9]+\.[0-9] +[0-9]+ +[0-9]+$'
+expect_line ${T} ${SCRATCH}/summary '^  status +1 +1 '
+expect_line ${T} ${SCRATCH}/summary '^  selfkill +1 +1 '
+expect_line ${T} ${SCRATCH}/summary '^source files by peak RSS:$'
+expect_line ${T} ${SCRATCH}/summary '^source files by CPU time:$'
+
+# The heaviest file comes first, and new.c never shows up.
+CHECKS=$((CHECKS + 1))
+FIRST=`sed -n '/^source files by peak RSS:$/{n;n;p;}' ${SCRATCH}/summary | awk '{ print $NF }'`
+[ "${FIRST}" = big.c ] || fail ${T} "expected big.c to top the files by peak RSS, got '${FIRST}'"
+CHECKS=$((CHECKS + 1))
+grep -q 'new\.c' ${SCRATCH}/summary && fail ${T} "a record of another version was summarized"
+
+finish ${T}
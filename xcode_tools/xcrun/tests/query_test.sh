@@ -0,0 +1,43 @@
+#!/bin/bash
+
+##
+# Checks the --show-sdk-* and --find queries: every value comes from one call, and a failed query prints nothing but its error.
+##
+
+. `dirname ${0}`/scratch.sh
+
+T=query_test
+OUT=${SCRATCH}/out
+ERR=${SCRATCH}/err
+
+# All values at once, in the sh format.
+${XCRUN} --format sh --show-sdk-path --show-sdk-version --show-sdk-toolchain-path -f tool > ${OUT} 2> ${ERR} || fail ${T} "query failed: `cat ${ERR}`"
+CHECKS=$((CHECKS + 1))
+[ `wc -l < ${OUT}` -eq 4 ] || fail ${T} "expected 4 lines, got:
+`cat ${OUT}`"
+expect_line ${T} ${OUT} "^export SDKROOT='${SCRATCH}/dev/SDKs/Test.sdk'\$"
+expect_line ${T} ${OUT} "^export SDK_VERSION='1.0'\$"
+expect_line ${T} ${OUT} "^export TOOLCHAIN_DIR='${SCRATCH}/dev/Toolchains/Test.toolchain'\$"
+expect_line ${T} ${OUT} "^export TOOL='${TOOLS}/tool'\$"
+
+# With --find-sdk, the tool comes from another SDK than the values, still from one call.
+mkdir -p ${SCRATCH}/dev/SDKs/Other.sdk/usr/bin
+sed 's/^name = Test$/name = Other/' ${SCRATCH}/dev/SDKs/Test.sdk/info.ini > ${SCRATCH}/dev/SDKs/Other.sdk/info.ini
+cp ${TOOLS}/tool ${SCRATCH}/dev/SDKs/Other.sdk/usr/bin/tool
+${XCRUN} --format kv --find-sdk Other --show-sdk-path -f tool > ${OUT} 2> ${ERR} || fail ${T} "--find-sdk query failed: `cat ${ERR}`"
+expect_line ${T} ${OUT} "^SDKROOT=${SCRATCH}/dev/SDKs/Test.sdk\$"
+expect_line ${T} ${OUT} "^TOOL=${SCRATCH}/dev/SDKs/Other.sdk/usr/bin/tool\$"
+
+# A tool that can't be found fails the whole query, with a single error and no values.
+${XCRUN} --format kv --show-sdk-path -f nosuchtool > ${OUT} 2> ${ERR}
+STATUS=${?}
+CHECKS=$((CHECKS + 1))
+[ ${STATUS} -eq 1 ] || fail ${T} "failed query exited with ${STATUS}"
+CHECKS=$((CHECKS + 1))
+[ -s ${OUT} ] && fail ${T} "failed query printed:
+`cat ${OUT}`"
+CHECKS=$((CHECKS + 1))
+[ `wc -l < ${ERR}` -eq 1 ] || fail ${T} "expected a single error, got:
+`cat ${ERR}`"
+
+finish ${T}
@@ -0,0 +1,223 @@
+/* rss_test.c - bound the peak memory and stack of an xcrun invocation
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * xcrun runs once per compiler, linker and tool invocation of a build, on machines whose
+ * threads may have small stacks. Each invocation below is run against a scratch developer
+ * directory, cold and then with warm caches, with its stack limited to STACK_LIMIT, and its
+ * peak resident set, as reported by wait4(), must stay under RSS_LIMIT. A fixed-size buffer
+ * of a megabyte, on the stack or zero-filled on the heap, fails one or the other.
+ *
+ * Run from the directory xcrun was built in.
+ */
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define XCRUN_PATH "./xcrun"
+
+#define RSS_LIMIT	(4 * 1024)	/* in kilobytes, as ru_maxrss is on Linux */
+#define STACK_LIMIT	(128 * 1024)	/* in bytes */
+
+static char root[] = "/tmp/xcrun-rss.XXXXXX";
+static char *envp[6];
+static long peak_rss;
+static int runs;
+static int failures;
+
+/* helper function to create a file with the given contents and mode */
+static int write_file(const char *path, const char *contents, mode_t mode)
+{
+	int fd;
+	size_t len = strlen(contents);
+
+	if ((fd = open(path, (O_WRONLY | O_CREAT | O_TRUNC), mode)) == -1)
+		return -1;
+	if (write(fd, contents, len) != (ssize_t)len) {
+		close(fd);
+		return -1;
+	}
+
+	return close(fd);
+}
+
+/* helper function to join the scratch root and a relative path */
+static const char *scratch_path(const char *rel)
+{
+	static char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", root, rel);
+
+	return path;
+}
+
+/**
+ * @func make_developer_dir -- Lay out a developer directory with one SDK, one toolchain and one tool.
+ * @return: 0 on success, -1 on failure
+ */
+static int make_developer_dir(void)
+{
+	static const char *dirs[] = {
+		"home", "dev", "dev/SDKs", "dev/SDKs/Test.sdk", "dev/Toolchains", "dev/Toolchains/Test.toolchain",
+		"dev/Toolchains/Test.toolchain/usr", "dev/Toolchains/Test.toolchain/usr/bin", NULL
+	};
+	static char env_home[PATH_MAX + 5], env_dev[PATH_MAX + 14];
+	int i;
+
+	if (mkdtemp(root) == NULL)
+		return -1;
+
+	for (i = 0; dirs[i] != NULL; i++) {
+		if (mkdir(scratch_path(dirs[i]), 0755) == -1)
+			return -1;
+	}
+
+	if (write_file(scratch_path("dev/SDKs/Test.sdk/info.ini"),
+	               "[SDK]\nname = Test\nversion = 1.0\ntoolchain = Test\ndefault_arch = arm\nmacosx_deployment_target = 10.7\n", 0644) == -1 ||
+	    write_file(scratch_path("dev/Toolchains/Test.toolchain/info.ini"), "[TOOLCHAIN]\nname = Test\nversion = 1.0\n", 0644) == -1 ||
+	    write_file(scratch_path("dev/Toolchains/Test.toolchain/usr/bin/tool"), "#!/bin/sh\nexit 0\n", 0755) == -1)
+		return -1;
+
+	/* SDKROOT and TOOLCHAINS select the scratch ones, whatever the host's xcrun.ini says. */
+	snprintf(env_home, sizeof(env_home), "HOME=%s/home", root);
+	snprintf(env_dev, sizeof(env_dev), "DEVELOPER_DIR=%s/dev", root);
+	envp[0] = env_home;
+	envp[1] = env_dev;
+	envp[2] = "SDKROOT=Test";
+	envp[3] = "TOOLCHAINS=Test";
+	envp[4] = "PATH=/usr/bin:/bin";
+	envp[5] = NULL;
+
+	return 0;
+}
+
+/* helper function to remove one entry of the scratch tree, children first */
+static int remove_entry(const char *path, const struct stat *sb, int type, struct FTW *ftw)
+{
+	(void)sb;
+	(void)type;
+	(void)ftw;
+
+	return remove(path);
+}
+
+/**
+ * @func run_xcrun -- Run xcrun with limited stack and check its exit status and peak resident set.
+ * @arg argv - arguments, argv[0] included
+ */
+static void run_xcrun(char *const argv[])
+{
+	pid_t pid;
+	int status;
+	struct rusage usage;
+	struct rlimit limit = { STACK_LIMIT, STACK_LIMIT };
+
+	if ((pid = fork()) == -1) {
+		perror("rss_test: fork");
+		exit(1);
+	}
+
+	if (pid == 0) {
+		if (setrlimit(RLIMIT_STACK, &limit) == -1 || freopen("/dev/null", "w", stdout) == NULL)
+			_exit(126);
+		execve(XCRUN_PATH, argv, envp);
+		_exit(127);
+	}
+
+	while (wait4(pid, &status, 0, &usage) == -1) {
+		if (errno != EINTR) {
+			perror("rss_test: wait4");
+			exit(1);
+		}
+	}
+
+	runs++;
+	if (usage.ru_maxrss > peak_rss)
+		peak_rss = usage.ru_maxrss;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		failures++;
+		if (WIFSIGNALED(status))
+			fprintf(stderr, "rss_test: xcrun %s: killed by signal %d\n", argv[1], WTERMSIG(status));
+		else
+			fprintf(stderr, "rss_test: xcrun %s: exited with %d\n", argv[1], WEXITSTATUS(status));
+	} else if (usage.ru_maxrss > RSS_LIMIT) {
+		failures++;
+		fprintf(stderr, "rss_test: xcrun %s: peak resident set of %ld KB, over %d KB\n", argv[1], usage.ru_maxrss, RSS_LIMIT);
+	}
+}
+
+int main(void)
+{
+	static char *find[] = { "xcrun", "-f", "tool", NULL };
+	static char *sdk_path[] = { "xcrun", "--show-sdk-path", NULL };
+	static char *target[] = { "xcrun", "--show-sdk-target-triple", NULL };
+	static char *run[] = { "xcrun", "tool", NULL };
+	static char *const *invocations[] = { find, sdk_path, target, run, NULL };
+	int pass, i;
+
+	if (make_developer_dir() == -1) {
+		perror("rss_test: cannot lay out the developer directory");
+		return 1;
+	}
+
+	/* The first pass fills the caches, the second reads them. */
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; invocations[i] != NULL; i++)
+			run_xcrun(invocations[i]);
+	}
+
+	nftw(root, remove_entry, 16, (FTW_DEPTH | FTW_PHYS));
+
+	if (failures > 0) {
+		fprintf(stderr, "rss_test: %d of %d runs failed\n", failures, runs);
+		return 1;
+	}
+
+	fprintf(stdout, "rss_test: %d runs passed, peak resident set %ld KB (limit %d KB, stack limit %d KB)\n",
+	        runs, peak_rss, RSS_LIMIT, (STACK_LIMIT / 1024));
+
+	return 0;
+}
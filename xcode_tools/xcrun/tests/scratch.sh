@@ -0,0 +1,73 @@
+#!/bin/bash
+
+##
+# Shared setup of the script tests, sourced by each of them.
+# Lays out a scratch developer folder with one SDK, one Toolchain and a few tools, and points xcrun at it.
+##
+
+XCRUN=${XCRUN:-`pwd`/xcrun}
+SCRATCH=`mktemp -d /tmp/xcrun-test.XXXXXX` || exit 1
+trap 'rm -rf "${SCRATCH}"' EXIT
+
+TOOLS=${SCRATCH}/dev/Toolchains/Test.toolchain/usr/bin
+mkdir -p ${SCRATCH}/home ${SCRATCH}/tmp ${SCRATCH}/dev/SDKs/Test.sdk ${TOOLS} || exit 1
+
+cat > ${SCRATCH}/dev/SDKs/Test.sdk/info.ini <<INI
+[SDK]
+name = Test
+version = 1.0
+toolchain = Test
+default_arch = arm
+macosx_deployment_target = 10.7
+INI
+
+cat > ${SCRATCH}/dev/Toolchains/Test.toolchain/info.ini <<INI
+[TOOLCHAIN]
+name = Test
+version = 1.0
+INI
+
+# A tool that succeeds, and one whose interpreter is missing, so that it can't be executed.
+printf '#!/bin/sh\nexit 0\n' > ${TOOLS}/tool
+printf '#!/nonexistent/sh\nexit 0\n' > ${TOOLS}/broken
+chmod +x ${TOOLS}/tool ${TOOLS}/broken
+
+# SDKROOT and TOOLCHAINS select the scratch ones, whatever the host's xcrun.ini says.
+# Private directories of xcrun and xcrund go to the scratch folder as well.
+unset XDG_CACHE_HOME XDG_RUNTIME_DIR XCRUND_SOCKET XCRUN_METRICS XCRUN_PROFILE XCRUN_CONTEXT XCRUN_TRACE TARGET_TRIPLE
+export HOME=${SCRATCH}/home TMPDIR=${SCRATCH}/tmp DEVELOPER_DIR=${SCRATCH}/dev SDKROOT=Test TOOLCHAINS=Test
+
+FAILURES=0
+CHECKS=0
+
+# helper function to report a failed check: fail <test> <message>
+fail() {
+	echo "${1}: ${2}" 1>&2
+	FAILURES=$((FAILURES + 1))
+}
+
+# helper function to check that a file has a line matching a regular expression: expect_line <test> <file> <regex>
+expect_line() {
+	CHECKS=$((CHECKS + 1))
+	grep -Eq -- "${3}" ${2} || fail ${1} "no line matching '${3}' in:
+`cat ${2}`"
+}
+
+# helper function to check that every line of a file matches a regular expression: expect_all <test> <file> <regex>
+expect_all() {
+	CHECKS=$((CHECKS + 1))
+	if grep -Evq -- "${3}" ${2}; then
+		fail ${1} "lines not matching '${3}':
+`grep -Ev -- "${3}" ${2}`"
+	fi
+}
+
+# helper function to end a test with a summary: finish <test>
+finish() {
+	if [ ${FAILURES} -ne 0 ]; then
+		echo "${1}: ${FAILURES} of ${CHECKS} checks failed" 1>&2
+		exit 1
+	fi
+	echo "${1}: ${CHECKS} checks passed"
+	exit 0
+}
@@ -0,0 +1,64 @@
+#!/bin/bash
+
+##
+# Checks the metrics recorded with XCRUN_METRICS set, and the --stats reports made from them.
+##
+
+. `dirname ${0}`/scratch.sh
+
+T=stats_test
+METRICS=${HOME}/.cache/xcrun/metrics
+
+export XCRUN_METRICS=1
+${XCRUN} -f tool > /dev/null || fail ${T} "xcrun -f tool failed"
+${XCRUN} -f tool > /dev/null || fail ${T} "xcrun -f tool failed"
+${XCRUN} tool || fail ${T} "xcrun tool failed"
+${XCRUN} -f nosuch 2> /dev/null && fail ${T} "xcrun -f nosuch succeeded"
+${XCRUN} broken 2> /dev/null && fail ${T} "xcrun broken succeeded"
+unset XCRUN_METRICS
+
+# One line per outcome: version, kind, lookup source, latency in microseconds, tool, SDK and toolchain.
+CHECKS=$((CHECKS + 1))
+[ `wc -l < ${METRICS}` -eq 6 ] || fail ${T} "expected 6 metrics lines, got:
+`cat ${METRICS}`"
+expect_all ${T} ${METRICS} '^1 (run|find|notfound|execfail) (xcrund|shared|cache|search|-) [0-9]+ [^ ]+ [^ ]+ [^ ]+$'
+expect_line ${T} ${METRICS} '^1 run [a-z]+ [0-9]+ tool Test Test$'
+expect_line ${T} ${METRICS} '^1 notfound - [0-9]+ nosuch - -$'
+expect_line ${T} ${METRICS} '^1 execfail [a-z]+ [0-9]+ broken Test Test$'
+
+${XCRUN} --stats > ${SCRATCH}/plain || fail ${T} "xcrun --stats failed"
+expect_line ${T} ${SCRATCH}/plain '^invocations: 5 \(run 2, find 2, not found 1\)$'
+expect_line ${T} ${SCRATCH}/plain '^exec failures: 1$'
+expect_line ${T} ${SCRATCH}/plain '^lookups: 4 \(xcrund [0-9]+, shared [0-9]+, cache [0-9]+, search [0-9]+, [0-9]+\.[0-9]% hits\)$'
+expect_line ${T} ${SCRATCH}/plain '^resolution latency: mean [0-9]+\.[0-9]{3} ms$'
+expect_line ${T} ${SCRATCH}/plain '^  tool +3 \(run 1, find 2, not found 0, exec failures 0\)$'
+expect_line ${T} ${SCRATCH}/plain '^  broken +1 \(run 1, find 0, not found 0, exec failures 1\)$'
+expect_line ${T} ${SCRATCH}/plain '^  Test +2$'
+
+# The histogram counts every invocation once.
+CHECKS=$((CHECKS + 1))
+BUCKETS=`grep -E '^ +(<=|>) +[0-9]+\.[0-9]{2} ms +[0-9]+$' ${SCRATCH}/plain | awk '{ n++; sum += $NF } END { print n, sum }'`
+[ "${BUCKETS}" = "11 5" ] || fail ${T} "expected 11 histogram buckets adding up to 5, got ${BUCKETS}"
+
+${XCRUN} --stats --format prometheus > ${SCRATCH}/prom || fail ${T} "xcrun --stats --format prometheus failed"
+expect_all ${T} ${SCRATCH}/prom '^(# (HELP|TYPE) xcrun_[a-z_]+ .+|xcrun_[a-z_]+(\{[a-z_]+="[^"]*"(,[a-z_]+="[^"]*")*\})? [0-9]+(\.[0-9]+)?)$'
+expect_line ${T} ${SCRATCH}/prom '^xcrun_invocations_total\{tool="tool",result="find"\} 2$'
+expect_line ${T} ${SCRATCH}/prom '^xcrun_invocations_total\{tool="nosuch",result="not_found"\} 1$'
+expect_line ${T} ${SCRATCH}/prom '^xcrun_exec_failures_total\{tool="broken"\} 1$'
+expect_line ${T} ${SCRATCH}/prom '^xcrun_sdk_invocations_total\{sdk="Test"\} 2$'
+expect_line ${T} ${SCRATCH}/prom '^xcrun_resolve_seconds_bucket\{le="\+Inf"\} 5$'
+expect_line ${T} ${SCRATCH}/prom '^xcrun_resolve_seconds_count 5$'
+
+# Every family is described before its samples, and the histogram buckets are cumulative.
+CHECKS=$((CHECKS + 1))
+ERRORS=`awk '
+	/^# TYPE / { typed[$3] = 1; next }
+	/^#/ { next }
+	{
+		family = $1; sub(/\{.*/, "", family); base = family; sub(/_(bucket|sum|count)$/, "", base)
+		if (!typed[family] && !typed[base]) print "untyped sample: " $0
+		if (family == "xcrun_resolve_seconds_bucket") { if ($2 < last) print "bucket below the previous one: " $0; last = $2 }
+	}' ${SCRATCH}/prom`
+[ -z "${ERRORS}" ] || fail ${T} "${ERRORS}"
+
+finish ${T}
@@ -0,0 +1,253 @@
+/* trace.c - Chrome trace-event output for xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Every xcrun started with TRACE_FILE_ENV set appends complete ("X") events for its phases to that
+ * file, in the JSON array format of the Chrome trace viewer (chrome://tracing, Perfetto), which
+ * doesn't need the closing bracket. Timestamps come from the monotonic clock, which all processes
+ * of a machine share. Tools run by xcrun get TRACE_PARENT_ENV, so a wrapper script calling xcrun
+ * again lands in the same trace: every process of a chain reports the pid of the xcrun that started
+ * it, with its own pid as the thread, and a flow event links each process to the xcrun that ran it.
+ * Events are written with a single write() to a file opened in append mode, so concurrent xcruns
+ * never interleave their lines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "trace.h"
+
+/* Tracing state of the process */
+static struct {
+	bool on;
+	bool finished;
+	int fd;
+	pid_t pid;
+	unsigned long long trace_id;
+	unsigned long long next_flow;
+	char parent_flow[64];
+	unsigned long long start;
+	char name[NAME_MAX];
+	char path[PATH_MAX];
+} trace = { false, false, -1, 0, 0, 0, "", 0, "", "" };
+
+/* helper function to read the monotonic clock, in microseconds */
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000ULL);
+}
+
+/* helper function to copy a string into a JSON string body, escaping what needs to be */
+static void json_escape(char *dst, size_t size, const char *src)
+{
+	size_t n = 0;
+
+	for (; *src != '\0' && n + 7 < size; src++) {
+		if (*src == '"' || *src == '\\') {
+			dst[n++] = '\\';
+			dst[n++] = *src;
+		} else if ((unsigned char)*src < 0x20) {
+			n += sprintf(dst + n, "\\u%04x", (unsigned char)*src);
+		} else {
+			dst[n++] = *src;
+		}
+	}
+
+	dst[n] = '\0';
+}
+
+/**
+ * @func open_trace -- open the trace file for appending, creating it with its opening bracket first
+ * @return: 0 on success, -1 on failure
+ */
+static int open_trace(void)
+{
+	int fd;
+	char tmp[PATH_MAX];
+
+	/* link() makes the file appear with its bracket already in, no other xcrun can append before it. */
+	if (access(trace.path, F_OK) != 0 && snprintf(tmp, sizeof(tmp), "%s.%d", trace.path, (int)getpid()) < (int)sizeof(tmp)) {
+		if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) != -1) {
+			if (write(fd, "[\n", 2) == 2)
+				(void)link(tmp, trace.path);
+			close(fd);
+			unlink(tmp);
+		}
+	}
+
+	return ((trace.fd = open(trace.path, O_WRONLY | O_APPEND | O_CLOEXEC)) != -1 ? 0 : -1);
+}
+
+/* helper function to append one event to the trace file */
+static void emit(const char *fmt, ...)
+{
+	int len;
+	va_list args;
+	char buf[PATH_MAX * 2];
+
+	if (!trace.on || (trace.fd == -1 && open_trace() != 0))
+		return;
+
+	va_start(args, fmt);
+	len = vsnprintf(buf, sizeof(buf) - 2, fmt, args);
+	va_end(args);
+
+	/* A truncated event would break the whole file. */
+	if (len < 0 || len >= (int)sizeof(buf) - 2)
+		return;
+
+	buf[len++] = ',';
+	buf[len++] = '\n';
+	(void)write(trace.fd, buf, len);
+}
+
+/* helper function to record a complete event */
+static void emit_span(const char *name, unsigned long long start, unsigned long long end)
+{
+	emit("{\"name\":\"%s\",\"cat\":\"xcrun\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%llu,\"tid\":%d}",
+	     name, start, end - start, trace.trace_id, (int)trace.pid);
+}
+
+/* helper function to close the root span, once, and only in the process that opened it */
+static void trace_finish(void)
+{
+	char name[NAME_MAX * 2];
+
+	if (!trace.on || trace.finished || getpid() != trace.pid)
+		return;
+
+	trace.finished = true;
+	json_escape(name, sizeof(name), trace.name);
+	emit("{\"name\":\"%s\",\"cat\":\"xcrun\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%llu,\"tid\":%d,"
+	     "\"args\":{\"trace\":%llu,\"parent\":\"%s\"}}",
+	     name, trace.start, now_us() - trace.start, trace.trace_id, (int)trace.pid, trace.trace_id, trace.parent_flow);
+}
+
+/* See documentation in header file. */
+void trace_start(const char *name)
+{
+	const char *path, *parent;
+	char escaped[NAME_MAX * 2];
+	int len = 0;
+
+	if (trace.on || (path = getenv(TRACE_FILE_ENV)) == NULL || *path == '\0' ||
+	    snprintf(trace.path, sizeof(trace.path), "%s", path) >= (int)sizeof(trace.path))
+		return;
+
+	trace.on = true;
+	trace.pid = getpid();
+	trace.start = now_us();
+	trace.trace_id = (unsigned long long)trace.pid;
+	snprintf(trace.name, sizeof(trace.name), "%s", name);
+
+	/* The flow id is only ever copied around, but it ends up in JSON strings, so it has to be plain. */
+	if ((parent = getenv(TRACE_PARENT_ENV)) == NULL || sscanf(parent, "%llu:%n", &trace.trace_id, &len) != 1 || len == 0 ||
+	    strlen(parent + len) >= sizeof(trace.parent_flow) || strspn(parent + len, "0123456789-") != strlen(parent + len)) {
+		trace.trace_id = (unsigned long long)trace.pid;
+		len = 0;
+	}
+	snprintf(trace.parent_flow, sizeof(trace.parent_flow), "%s", (len > 0 ? parent + len : ""));
+
+	json_escape(escaped, sizeof(escaped), name);
+	emit("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%llu,\"tid\":%d,\"args\":{\"name\":\"%s[%d]\"}}",
+	     trace.trace_id, (int)trace.pid, escaped, (int)trace.pid);
+
+	if (*trace.parent_flow != '\0') {
+		emit("{\"name\":\"run\",\"cat\":\"xcrun\",\"ph\":\"f\",\"bp\":\"e\",\"id\":\"%s\",\"ts\":%llu,\"pid\":%llu,\"tid\":%d}",
+		     trace.parent_flow, trace.start, trace.trace_id, (int)trace.pid);
+	}
+
+	atexit(trace_finish);
+}
+
+/* See documentation in header file. */
+void trace_begin(trace_span *span, const char *name)
+{
+	span->name = name;
+	span->start = (trace.on ? now_us() : 0);
+}
+
+/* See documentation in header file. */
+void trace_end(trace_span *span)
+{
+	if (trace.on && span->start != 0)
+		emit_span(span->name, span->start, now_us());
+}
+
+/* See documentation in header file. */
+int trace_child_env(char *vars[2])
+{
+	int n = 0;
+	char flow[64];
+
+	if (!trace.on)
+		return 0;
+
+	/* A process keeps its pid across exec, so the start time tells apart the xcruns of a chain of execs. */
+	snprintf(flow, sizeof(flow), "%d-%llu-%llu", (int)trace.pid, trace.start, ++trace.next_flow);
+
+	emit("{\"name\":\"run\",\"cat\":\"xcrun\",\"ph\":\"s\",\"id\":\"%s\",\"ts\":%llu,\"pid\":%llu,\"tid\":%d}",
+	     flow, now_us(), trace.trace_id, (int)trace.pid);
+
+	if ((vars[n] = (char *)malloc(strlen(TRACE_FILE_ENV) + strlen(trace.path) + 2)) != NULL)
+		sprintf(vars[n++], "%s=%s", TRACE_FILE_ENV, trace.path);
+	if ((vars[n] = (char *)malloc(strlen(TRACE_PARENT_ENV) + strlen(flow) + 24)) != NULL)
+		sprintf(vars[n++], "%s=%llu:%s", TRACE_PARENT_ENV, trace.trace_id, flow);
+
+	return n;
+}
+
+/* See documentation in header file. */
+void trace_exec(const char *path)
+{
+	char escaped[PATH_MAX + 64];
+
+	if (!trace.on)
+		return;
+
+	json_escape(escaped, sizeof(escaped), path);
+	emit("{\"name\":\"exec\",\"cat\":\"xcrun\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%llu,\"tid\":%d,\"args\":{\"path\":\"%s\"}}",
+	     now_us(), trace.trace_id, (int)trace.pid, escaped);
+
+	/* exec skips atexit handlers. */
+	trace_finish();
+}
@@ -0,0 +1,82 @@
+/* trace.h - Chrome trace-event output for xcrun
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/* File that trace events are appended to, tracing is off unless it is set */
+#define TRACE_FILE_ENV "XCRUN_TRACE"
+
+/* Trace id and flow id a parent xcrun passes to the tools it runs, as "<trace>:<flow>" */
+#define TRACE_PARENT_ENV "XCRUN_TRACE_PARENT"
+
+/* A phase being timed */
+typedef struct {
+	const char *name;
+	unsigned long long start;
+} trace_span;
+
+/**
+ * @func trace_start -- start tracing this process if TRACE_FILE_ENV is set, opening its root span
+ * @arg name - name of the root span (the name xcrun was called as)
+ *
+ * The root span ends at exit, or at trace_exec. Until trace_start is called, every other function
+ * of this module does nothing, so library users and the daemon are never traced.
+ */
+void trace_start(const char *name);
+
+/**
+ * @func trace_begin -- start timing a phase
+ * @arg span - span to start
+ * @arg name - name of the phase (a string constant)
+ */
+void trace_begin(trace_span *span, const char *name);
+
+/**
+ * @func trace_end -- stop timing a phase and record it
+ * @arg span - span started by trace_begin
+ */
+void trace_end(trace_span *span);
+
+/**
+ * @func trace_child_env -- build the environment variables that let a tool about to be run join this trace
+ * @arg vars - filled with up to 2 newly allocated "NAME=value" strings
+ * @return: number of strings filled in, 0 if tracing is off
+ */
+int trace_child_env(char *vars[2]);
+
+/**
+ * @func trace_exec -- record that this process is about to become a tool, and end its root span
+ * @arg path - path of the tool
+ */
+void trace_exec(const char *path);
+
+#endif /* __TRACE_H__ */
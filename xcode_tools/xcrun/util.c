@@ -0,0 +1,94 @@
+/* util.c - small helpers shared by xcrun's modules
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "util.h"
+
+/* See documentation in header file. */
+bool name_in_list(const char *name, const char *list)
+{
+	size_t len = strlen(name);
+
+	while (list != NULL && *list != '\0') {
+		list += strspn(list, " \t,");
+		if (strncmp(list, name, len) == 0 && (list[len] == '\0' || strchr(" \t,", list[len]) != NULL))
+			return true;
+		list += strcspn(list, " \t,");
+	}
+
+	return false;
+}
+
+/* See documentation in header file. */
+int wait_status(pid_t pid)
+{
+	int status;
+
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno != EINTR)
+			return 1;
+	}
+
+	if (WIFSIGNALED(status))
+		return (128 + WTERMSIG(status));
+
+	return WEXITSTATUS(status);
+}
+
+/* See documentation in header file. */
+int private_dir(char *buf, size_t size, const char *base, const char *name, int create)
+{
+	struct stat st;
+
+	if (base == NULL || *base == '\0') {
+		if ((base = getenv("TMPDIR")) == NULL || *base == '\0')
+			base = "/tmp";
+	}
+
+	if (snprintf(buf, size, "%s/%s.%lu", base, name, (unsigned long)getuid()) >= (int)size)
+		return -1;
+
+	if (create && mkdir(buf, 0700) != 0 && errno != EEXIST)
+		return -1;
+
+	/* Anyone could have made it first in a shared directory, so it must be ours and closed to everybody else. */
+	if (lstat(buf, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077) != 0)
+		return -1;
+
+	return 0;
+}
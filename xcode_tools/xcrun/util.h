@@ -0,0 +1,65 @@
+/* util.h - small helpers shared by xcrun's modules
+ *
+ * Copyright (c) 2013-2017, Brian McKenzie <mckenzba@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *
+ *  3. Neither the name of the organization nor the names of its contributors may
+ *     be used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __UTIL_H__
+#define __UTIL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @func name_in_list -- tell whether a name is one of a list of names
+ * @arg name - name to look for
+ * @arg list - names separated by white space or commas (may be NULL)
+ * @return: true if the name is listed, false otherwise
+ */
+bool name_in_list(const char *name, const char *list);
+
+/**
+ * @func wait_status -- wait for a child process and turn its fate into an exit status
+ * @arg pid - process id
+ * @return: exit status, 128 plus the signal number if it was killed, 1 if it can't be waited for
+ */
+int wait_status(pid_t pid);
+
+/**
+ * @func private_dir -- build the path of a directory of the current user that nobody else can get into
+ * @arg buf    - buffer to hold the path
+ * @arg size   - size of buffer
+ * @arg base   - directory to keep it in, NULL or empty for $TMPDIR (or /tmp)
+ * @arg name   - name of the directory, the user id is appended
+ * @arg create - create the directory if it is missing
+ * @return: 0 on success, -1 if it is missing, isn't ours alone, or the path doesn't fit
+ */
+int private_dir(char *buf, size_t size, const char *base, const char *name, int create);
+
+#endif /* __UTIL_H__ */
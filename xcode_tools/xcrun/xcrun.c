@@ -39,36 +39,19 @@
 #include <limits.h>
 #include <errno.h>
 #include <stdbool.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 
-#include "ini.h"
+#include "libxcrun.h"
+#include "batch.h"
+#include "fanout.h"
+#include "compcache.h"
+#include "flight.h"
+#include "trace.h"
+#include "metrics.h"
+#include "profile.h"
+#include "admission.h"
 
 /* General stuff */
 #define TOOL_VERSION "1.0.0"
-#define SDK_CFG ".xcdev.dat"
-#define XCRUN_DEFAULT_CFG "/etc/xcrun.ini"
-
-/* Toolchain configuration struct */
-typedef struct {
-	const char *name;
-	const char *version;
-} toolchain_config;
-
-/* SDK configuration struct */
-typedef struct {
-	const char *name;
-	const char *version;
-	const char *toolchain;
-	const char *default_arch;
-	const char *deployment_target;
-} sdk_config;
-
-/* xcrun default configuration struct */
-typedef struct {
-	const char *sdk;
-	const char *toolchain;
-} default_config;
 
 /* Output mode flags */
 static int logging_mode = 0;
@@ -76,75 +59,44 @@ static int verbose_mode = 0;
 static int finding_mode = 0;
 
 /* Behavior mode flags */
-static int explicit_sdk_mode = 0;
-static int explicit_toolchain_mode = 0;
-static int ios_deployment_target_set = 0;
-static int macosx_deployment_target_set = 0;
+static int nocache_mode = 0;
+static int admission_mode = 0;
+
+/* Limits of the tool being run, when admission_mode is set */
+static xcrun_limits admission_limits;
+
+/* Output formats for --show-sdk-* and --find queries, and --stats */
+enum {
+	QUERY_FORMAT_PLAIN,	/* the historic human readable output */
+	QUERY_FORMAT_SH,	/* export NAME='value' lines, meant to be eval'd by a shell */
+	QUERY_FORMAT_KV,	/* NAME=value lines, meant to be read by other programs */
+	QUERY_FORMAT_PROMETHEUS	/* Prometheus text exposition format (--stats only) */
+};
+
+static int query_format = QUERY_FORMAT_PLAIN;
+
+/* SDK and Toolchain requested on the command line */
+static char *requested_sdk;
+static char *requested_toolchain;
 
-/* Runtime info */
-static char developer_dir[PATH_MAX];
-static char current_sdk[PATH_MAX];
-static char current_toolchain[PATH_MAX];
+/* SDK a --find query resolves the tool against, when it isn't the SDK the other values are about */
+static char *requested_find_sdk;
 
-/* Alternate behavior flags */
-static char *alternate_sdk_path;
-static char *alternate_toolchain_path;
+/* Architectures requested with --archs, overriding the SDK's */
+static char *requested_archs;
 
 /* Ways that this tool may be called */
-static const char *multicall_tool_names[4] = {
+static const char *multicall_tool_names[5] = {
 	"xcrun",
 	"xcrun_log",
 	"xcrun_verbose",
-	"xcrun_nocache"
+	"xcrun_nocache",
+	"xcrund"
 };
 
 /* Our program's name as called by the user */
 static char *progname;
 
-/* helper function to strip file extensions */
-static void stripext(char *dst, const char *src)
-{
-	int len;
-	char *s;
-
-	if ((s = strchr(src, '.')) != NULL)
-		len = (s - src);
-	else
-		len = strlen(src);
-
-	strncpy(dst, src, len);
-}
-
-/* helper function to test for the authenticity of an sdk */
-static int test_sdk_authenticity(const char *path)
-{
-	int retval = 0;
-	char fname[PATH_MAX];
-
-	sprintf(fname, "%s/info.ini", path);
-	if (access(fname, F_OK) != (-1))
-		retval = 1;
-
-	return retval;
-}
-
-/**
- * @func verbose_printf -- Print output to fp in verbose mode.
- * @arg fp  - pointer to file (file, stderr, or stdio)
- * @arg str - string to print
- * @arg ... - additional arguments used
- */
-static void verbose_printf(FILE *fp, const char *str, ...)
-{
-	va_list args;
-
-	if (verbose_mode) {
-		va_start(args, str);
-		vfprintf(fp, str, args);
-		va_end(args);
-	}
-}
-
 /**
  * @func logging_printf -- Print output to fp in logging mode.
  * @arg fp  - pointer to file (file, stderr, or stdio)
@@ -184,15 +136,27 @@ static int usage(void)
 		"  -l, --log                    show commands to be executed (with --run)\n"
 		"  -f, --find                   only find and print the tool path\n"
 		"  -r, --run                    find and execute the tool (the default behavior)\n"
-#if 0
-		"  -n, --no-cache               do not use the lookup cache (not implemented yet - does nothing)\n"
-		"  -k, --kill-cache             invalidate all existing cache entries (not implemented yet - does nothing)\n"
-#endif
+		"  -n, --no-cache               do not use the lookup cache\n"
+		"  -k, --kill-cache             invalidate all existing cache entries\n"
 		"  --show-sdk-path              show selected SDK install path\n"
 		"  --show-sdk-version           show selected SDK version\n"
 		"  --show-sdk-target-triple     show selected SDK target triple\n"
 		"  --show-sdk-toolchain-path    show selected SDK toolchain path\n"
-		"  --show-sdk-toolchain-version show selected SDK toolchain version\n\n"
+		"  --show-sdk-toolchain-version show selected SDK toolchain version\n"
+		"  --format <plain|sh|kv>       print --show-sdk-* and --find results as plain text,\n"
+		"                               shell exports or NAME=value pairs\n"
+		"  --find-sdk <sdk name>        find the tool of a --show-sdk-* query for the given SDK\n"
+		"  --stats                      summarize the metrics recorded with XCRUN_METRICS set\n"
+		"                               (--format prometheus for the Prometheus text format)\n"
+		"  --profile-summary <log>      rank the tools and source files of an XCRUN_PROFILE log\n"
+		"                               by CPU time and peak memory\n"
+		"  --batch <file>               run the tools listed in file (- for stdin), one per line\n"
+		"                               along with their arguments, in parallel\n"
+		"  --null                       batch arguments are NUL terminated, jobs end with an empty one\n"
+		"  --jobs <count>               run at most count batch jobs at a time\n"
+		"  --archs <arch,...>           build for the given architectures, compiling and linking\n"
+		"                               each of them in parallel and merging them with lipo\n"
+		"  --reindex                    rebuild the manifest of the developer directory\n\n"
 		, progname);
 
 	return 0;
@@ -208,606 +172,199 @@ static int version(void)
 	return 0;
 }
 
-/**
- * @func validate_directory_path -- validate if requested directory path exists
- * @arg dir - directory to validate
- * @return: 0 on success, -1 on failure
- */
-static int validate_directory_path(const char *dir)
-{
-	struct stat fstat;
-
-	if (stat(dir, &fstat) != 0) {
-		fprintf(stderr, "xcrun: error: unable to validate path \'%s\' (%s)\n", dir, strerror(errno));
-		return -1;
-	}
-
-	if (S_ISDIR(fstat.st_mode) == 0) {
-		fprintf(stderr, "xcrun: error: \'%s\' is not a valid path\n", dir);
-		return -1;
-	}
-
-	return 0;
-}
-
-/**
- * @func toolchain_cfg_handler -- handler used to process toolchain info.ini contents
- * @arg user    - ini user pointer (see ini.h)
- * @arg section - ini section name (see ini.h)
- * @arg name    - ini variable name (see ini.h)
- * @arg value   - ini variable value (see ini.h)
- * @return: 1 on success, 0 on failure
- */
-static int toolchain_cfg_handler(void *user, const char *section, const char *name, const char *value)
+/* helper function to print a missing value as an empty string */
+static const char *or_empty(const char *str)
 {
-	toolchain_config *config = (toolchain_config *)user;
-
-	if (MATCH_INI_STON("TOOLCHAIN", "name"))
-		config->name = strdup(value);
-	else if (MATCH_INI_STON("TOOLCHAIN", "version"))
-		config->version = strdup(value);
-	else
-		return 0;
-
-	return 1;
+	return (str != NULL ? str : "");
 }
 
 /**
- * @func sdk_cfg_handler -- handler used to process sdk info.ini contents
- * @arg user    - ini user pointer (see ini.h)
- * @arg section - ini section name (see ini.h)
- * @arg name    - ini variable name (see ini.h)
- * @arg value   - ini variable value (see ini.h)
- * @return: 1 on success, 0 on failure
+ * @func print_error -- Report the last failure of a resolution context.
+ * @arg ctx - context
+ * @return: 1, for use as an exit status
  */
-static int sdk_cfg_handler(void *user, const char *section, const char *name, const char *value)
+static int print_error(xcrun_ctx *ctx)
 {
-	sdk_config *config = (sdk_config *)user;
-
-	if (MATCH_INI_STON("SDK", "name"))
-		config->name = strdup(value);
-	else if (MATCH_INI_STON("SDK", "version"))
-		config->version = strdup(value);
-	else if (MATCH_INI_STON("SDK", "toolchain"))
-		config->toolchain = strdup(value);
-	else if (MATCH_INI_STON("SDK", "default_arch"))
-		config->default_arch = strdup(value);
-	else if (MATCH_INI_STON("SDK", "iphoneos_deployment_target")) {
-		ios_deployment_target_set = 1;
-		macosx_deployment_target_set = 0;
-		config->deployment_target = strdup(value);
-	} else if (MATCH_INI_STON("SDK", "macosx_deployment_target")) {
-		ios_deployment_target_set = 0;
-		macosx_deployment_target_set = 1;
-		config->deployment_target = strdup(value);
-	} else
-		return 0;
+	fprintf(stderr, "xcrun: error: %s\n", (xcrun_error(ctx) != NULL ? xcrun_error(ctx) : strerror(errno)));
 
 	return 1;
 }
 
 /**
- * @func default_cfg_handler -- handler used to process xcrun's xcrun.ini contents
- * @arg user    - ini user pointer (see ini.h)
- * @arg section - ini section name (see ini.h)
- * @arg name    - ini variable name (see ini.h)
- * @arg value   - ini variable value (see ini.h)
- * @return: 1 on success, 0 on failure
+ * @func create_context -- Create the resolution context for this invocation.
+ * @arg sdk     - SDK requested (see requested_sdk)
+ * @arg verbose - describe what is going on
+ * @arg flags   - context creation flags (see libxcrun.h)
+ * @return: context, or NULL on failure
  */
-static int default_cfg_handler(void *user, const char *section, const char *name, const char *value)
+static xcrun_ctx *create_context(const char *sdk, bool verbose, int flags)
 {
-	default_config *config = (default_config *)user;
-
-	if (MATCH_INI_STON("SDK", "name"))
-		config->sdk = strdup(value);
-	else if (MATCH_INI_STON("TOOLCHAIN", "name"))
-		config->toolchain = strdup(value);
-	else
-		return 0;
-
-	return 1;
-}
-
-/**
- * @func get_toolchain_info -- fetch config info from a toolchain's info.ini
- * @arg path - path to toolchain's info.ini
- * @return: struct containing toolchain config info
- */
-static toolchain_config get_toolchain_info(const char *path)
-{
-	toolchain_config config;
-	char info_path[PATH_MAX] = { 0 };
-
-	sprintf(info_path, "%s/info.ini", path);
-
-	if (ini_parse(info_path, toolchain_cfg_handler, &config) != (-1))
-		return config;
-
-	fprintf(stderr, "xcrun: error: failed to retrieve toolchain info from '\%s\'. (%s)\n", info_path, strerror(errno));
+	xcrun_ctx *ctx;
+	xcrun_options options = { 0 };
 
-	exit(1);
-}
-
-/**
- * @func get_sdk_info -- fetch config info from a toolchain's info.ini
- * @arg path - path to sdk's info.ini
- * @return: struct containing sdk config info
- */
-static sdk_config get_sdk_info(const char *path)
-{
-	sdk_config config;
-	char info_path[PATH_MAX] = { 0 };
-
-	sprintf(info_path, "%s/info.ini", path);
-
-	if (ini_parse(info_path, sdk_cfg_handler, &config) != (-1))
-		return config;
-
-	fprintf(stderr, "xcrun: error: failed to retrieve sdk info from '\%s\'. (%s)\n", info_path, strerror(errno));
-
-	exit(1);
-}
-
-/**
- * @func get_default_info -- fetch default configuration for xcrun
- * @arg path - path to xcrun.ini
- * @return: struct containing default config info
- */
-static default_config get_default_info(const char *path)
-{
-	default_config config;
-
-	if (ini_parse(path, default_cfg_handler, &config) != (-1))
-		return config;
-
-	fprintf(stderr, "xcrun: error: failed to retrieve default info from '\%s\'. (%s)\n", path, strerror(errno));
-
-	exit(1);
-}
+	options.sdk = sdk;
+	options.toolchain = requested_toolchain;
+	options.verbose = (verbose ? stdout : NULL);
+	options.flags = (flags | (nocache_mode ? XCRUN_NO_CACHE : 0));
 
-/**
- * @func get_developer_path -- retrieve current developer path
- * @arg path - buffer to hold the developer dir absolute path
- * @return: number of bytes read.
- */
-static int get_developer_path(char *path)
-{
-	FILE *fp;
-	int len = 0;
-	char *home_path, *dev_path;
-	char cfg_path[PATH_MAX] = { 0 };
-
-	verbose_printf(stdout, "xcrun: info: attempting to retrieve developer path from DEVELOPER_DIR...\n");
-
-	if ((dev_path = getenv("DEVELOPER_DIR")) != NULL) {
-		verbose_printf(stdout, "xcrun: info: using developer path \'%s\' from DEVELOPER_DIR.\n", dev_path);
-		len = strlen(dev_path);
-		strncpy(path, dev_path, len);
-		return len;
-	}
-
-	verbose_printf(stdout, "xcrun: info: attempting to retrieve developer path from configuration cache...\n");
-	if ((home_path = getenv("HOME")) == NULL) {
-		fprintf(stderr, "xcrun: error: failed to read HOME variable.\n");
-		return len;
+	if ((ctx = xcrun_create(&options)) == NULL) {
+		fprintf(stderr, "xcrun: error: failed to create resolution context. (%s)\n", strerror(errno));
+		return NULL;
 	}
 
-	strcat(cfg_path, home_path);
-	strcat(cfg_path, "/");
-	strcat(cfg_path, SDK_CFG);
-
-	if ((fp = fopen(cfg_path, "r")) != NULL) {
-		fseek(fp, 0, SEEK_END);
-		int fsize = ftell(fp);
-		fseek(fp, SEEK_SET, 0);
-		len = fread(path, fsize, 1, fp);
-		fclose(fp);
-	} else {
-		fprintf(stderr, "xcrun: error: unable to read configuration cache. (%s)\n", strerror(errno));
-		return len;
+	/* Without a developer dir, there is nothing we can do. */
+	if (xcrun_developer_dir(ctx) == NULL) {
+		print_error(ctx);
+		xcrun_free(ctx);
+		return NULL;
 	}
 
-	verbose_printf(stdout, "xcrun: info: using developer path \'%s\' from configuration cache.\n", path);
-
-	return len;
+	return ctx;
 }
 
 /**
- * @func get_toolchain_path -- Return the specified toolchain path
- * @arg name - name of the toolchain
- * @return: absolute path of toolchain on success, exit on failure
+ * @func run_tool -- Run a resolved tool, from the compile cache if possible, otherwise by executing it (or spawning it, when profiling or admitting).
+ * @arg name - name of the tool
+ * @arg tool - resolved tool
+ * @arg envp - environment the tool runs with
+ * @arg argv - arguments the tool runs with
+ * @return: exit status of a profiled or admitted tool or of a compile answered through the compile cache, -1 on failure, otherwise no return
  */
-static char *get_toolchain_path(const char *name)
+static int run_tool(const char *name, const xcrun_tool *tool, char *const envp[], char *const argv[])
 {
-	char *devpath, *path;
+	int status;
 
-	devpath = developer_dir;
-	path = (char *)calloc(PATH_MAX, sizeof(char));
-
-	if (devpath == NULL) {
-		fprintf(stderr, "xcrun: error: failed to retrieve developer path, do you have it set?\n");
-		goto failure;
+	/* Heavy tools wait for their turn, then run as children so that their turn ends with them. */
+	if (admission_mode == 1) {
+		if ((status = admission_run(name, tool, envp, argv, &admission_limits, logging_mode)) == -1)
+			metrics_record(METRICS_EXEC_FAILURE, name, tool);
+		return status;
 	}
 
-	sprintf(path, "%s/Toolchains/%s.toolchain", devpath, name);
-	if (validate_directory_path(path) != (-1))
-		return path;
-
-	fprintf(stderr, "xcrun: error: \'%s\' is not a valid toolchain path.\n", path);
-
-failure:
-	free(path);
-	exit(1);
-}
-
-/**
- * @func get_sdk_path -- Return the specified sdk path
- * @arg name - name of the sdk
- * @return: absolute path of sdk on success, exit on failure
- */
-static char *get_sdk_path(const char *name)
-{
-	char *devpath, *path;
-
-	devpath = developer_dir;
-	path = (char *)calloc(PATH_MAX, sizeof(char));
-
-	if (devpath == NULL) {
-		fprintf(stderr, "xcrun: error: failed to retrieve developer path, do you have it set?\n");
-		goto failure;
+	/* Profiled tools always run, so that what they cost is measured, even with a compile cache. */
+	if (profile_enabled()) {
+		if ((status = profile_run(name, tool, envp, argv)) == -1)
+			metrics_record(METRICS_EXEC_FAILURE, name, tool);
+		return status;
 	}
 
-	sprintf(path, "%s/SDKs/%s.sdk", devpath, name);
-	if (validate_directory_path(path) != (-1))
-		return path;
+	/* Compiles may be answered from the compile cache instead. */
+	if ((status = compcache_run(name, tool, envp, argv, logging_mode)) != -1)
+		return status;
+
+	/* Don't lose verbose/logging output that is still buffered. */
+	fflush(stdout);
 
-	fprintf(stderr, "xcrun: error: \'%s\' is not a valid sdk path.\n", path);
+	trace_exec(tool->path);
+	execve(tool->path, argv, envp);
+	fprintf(stderr, "xcrun: error: can't exec \'%s\' (%s)\n", tool->path, strerror(errno));
+	metrics_record(METRICS_EXEC_FAILURE, name, tool);
 
-failure:
-	free(path);
-	exit(1);
+	return -1;
 }
 
 /**
- * @func parse_target_triple -- Generate target triple by parsing iOS/MacOSX version and cpu architecture
- * @arg triple - buffer to place the target triple
- * @arg ver    - macOS or iOS version
- * @arg arch   - macOS or iOS cpu architecture
+ * @func request_command -- Request a program.
+ * @arg ctx  - resolution context
+ * @arg name - name of program
+ * @arg argc - number of arguments to be passed if program found
+ * @arg argv - arguments to be passed if program found
+ * @return: -1 on failed search, 0 on successful search, no return on execute
  */
-static void parse_target_triple(char *triple, const char *ver, const char *arch)
+static int request_command(xcrun_ctx *ctx, const char *name, int argc, char *argv[])
 {
-	int where = 1;
-	bool is_macosx = false;
-	int xx, yy, zz, ch, kern_ver;
-
-	if (ver == NULL)
-		return;
-
-	/* For now, assume that any x86 target is macOS. */
-	if ((strcmp(arch, "x86_64") == 0) || (strcmp(arch, "i386") == 0))
-		is_macosx = true;
-
-	xx = yy = zz = 0;
-
-	do {
-		ch = (int)*ver;
-
-		switch (ch) {
-			case '9':
-			case '8':
-			case '7':
-			case '6':
-			case '5':
-			case '4':
-			case '3':
-			case '2':
-			case '1':
-			case '0':
-				{
-					switch (where) {
-						case 1: /* major */
-							xx *= 10;
-							xx += (ch - '0');
-							break;
-						case 2: /* minor */
-							yy *= 10;
-							yy += (ch - '0');
-							break;
-						case 3: /* patch */
-							zz *= 10;
-							zz += (ch - '0');
-						default:
-							break;
-					}
-					break;
-				}
-			case '.':
-			default:
-				where++;
-				break;
+	int i, status;
+	xcrun_tool tool;
+	char **envp, **new_argv;
+
+	if (finding_mode == 1) {
+		if (xcrun_find_tool(ctx, name, &tool) != 0) {
+			print_error(ctx);
+			metrics_record(METRICS_NOT_FOUND, name, NULL);
+			return -1;
 		}
-	} while (*ver++ != '\0');
-
-	switch (xx) {
-		case 11:
-			kern_ver = 17;
-			break;
-		case 10:
-			{
-				if (is_macosx)
-					kern_ver = (yy + 4);
-				else
-					kern_ver = 16;
-				break;
-			}
-		case 9:
-			kern_ver = 15;
-			break;
-		case 8:
-		case 7:
-			kern_ver = 14;
-			break;
-		case 6:
-			kern_ver = 13;
-			break;
-		case 5:
-			kern_ver = 11;
-			break;
-		case 4:
-			{
-				if (yy <= 2)
-					kern_ver = 10;
-				else
-					kern_ver = 11;
-				break;
-			}
-		case 3:
-			kern_ver = 10;
-			break;
-		case 2:
-			kern_ver = 9;
-			break;
-		case 1:
-		default:
-			kern_ver = 9;
-			break;
+		if (access(tool.path, (F_OK | X_OK)) == 0) {
+			fprintf(stdout, "%s\n", tool.path);
+			metrics_record(METRICS_FIND, name, &tool);
+			return 0;
+		}
+		metrics_record(METRICS_NOT_FOUND, name, &tool);
+		return -1;
 	}
 
-	sprintf(triple, "%s-apple-darwin%d", arch, kern_ver);
-
-	return;
-}
-
-/**
- * @func get_target_triple -- get the target triple for the current sdk.
- * @arg current_sdk - specified sdk (ignored if TARGET_TRIPLE env variable is set)
- * @return: target triple string or NULL on error
- */
-static char *get_target_triple(const char *current_sdk)
-{
-	char *triple, *default_arch, *deployment_target;
-
-	if ((triple = getenv("TARGET_TRIPLE")) != NULL)
-		return triple;
-
-	triple = (char *)calloc(NAME_MAX, sizeof(char));
-
-	if ((default_arch = strdup(get_sdk_info(get_sdk_path(current_sdk)).default_arch)) == NULL)
-		return NULL;
-
-	if ((deployment_target = strdup(get_sdk_info(get_sdk_path(current_sdk)).deployment_target)) == NULL)
-		return NULL;
-
-	parse_target_triple(triple, deployment_target, default_arch);
-
-	return triple;
-}
+	/* Compile and link steps for more than one architecture build every slice in parallel. */
+	if ((status = fanout_run(ctx, name, requested_archs, argc, argv, logging_mode)) != -1)
+		exit(status);
 
-/**
- * @func call_command -- Execute new process to replace this one.
- * @arg cmd  - absolute path to the program
- * @arg argc - number of arguments to be passed to new process
- * @arg argv - arguments to be passed to new process
- * @return: -1 on error, otherwise no return
- */
-static int call_command(const char *cmd, int argc, char *argv[])
-{
-	int i;
-	char *envp[8] = { NULL };
-	char *target_triple, *deployment_target;
-
-	/*
-	 * Pass useful variables to the enviroment of the program to be executed.
-	 *
-	 *  * SDKROOT is used for when programs such as clang need to know the location of the sdk.
-	 *
-	 *  * PATH is used for when programs such as clang need to call on another program (such as the linker).
-	 *
-	 *  * HOME is used for recursive calls to xcrun (such as when xcrun calls a script calling xcrun ect).
-	 *
-	 *  * LD_LIBRARY_PATH is used for when tools needs to access libraries that are specific to the toolchain.
-	 *
-	 *  * TARGET_TRIPLE is used for clang/clang++ cross compilation when building on a foreign host.
-	 *
-	 *  * {MACOSX|IPHONEOS}_DEPLOYMENT_TARGET is used for tools like ld that need to set the minimum compatibility
-	 *    version number for a linked binary.
-	 *
-	 *  * DEVELOPER_DIR is used as a performance optimization when making recursive calls to xcrun.
-	 */
+	if (xcrun_resolve_tool(ctx, name, &tool) != 0 ||
+	    (requested_archs != NULL && strpbrk(requested_archs, " \t,") == NULL && xcrun_set_tool_arch(ctx, &tool, requested_archs) != 0) ||
+	    (envp = xcrun_build_env(ctx, &tool)) == NULL || (new_argv = xcrun_build_argv(ctx, &tool, argc, argv)) == NULL) {
+		print_error(ctx);
+		metrics_record(METRICS_NOT_FOUND, name, NULL);
+		return -1;
+	}
 
-	envp[0] = (char *)calloc(PATH_MAX, sizeof(char));
-	envp[1] = (char *)calloc(PATH_MAX, sizeof(char));
-	envp[2] = (char *)calloc(PATH_MAX, sizeof(char));
-	envp[3] = (char *)calloc(PATH_MAX, sizeof(char));
-	envp[4] = (char *)calloc(NAME_MAX, sizeof(char));
-	envp[5] = (char *)calloc(NAME_MAX, sizeof(char));
-	envp[6] = (char *)calloc(PATH_MAX, sizeof(char));
-
-	sprintf(envp[0], "SDKROOT=%s", get_sdk_path(current_sdk));
-	sprintf(envp[1], "PATH=%s/usr/bin:%s/usr/bin:%s", developer_dir, get_toolchain_path(current_toolchain), getenv("PATH"));
-	sprintf(envp[2], "LD_LIBRARY_PATH=%s/usr/lib", get_toolchain_path(current_toolchain));
-	sprintf(envp[3], "HOME=%s", getenv("HOME"));
-	sprintf(envp[6], "DEVELOPER_DIR=%s", developer_dir);
-
-	if ((target_triple = get_target_triple(current_sdk)) != NULL)
-		sprintf(envp[4], "TARGET_TRIPLE=%s", target_triple);
-	else
-		fprintf(stderr, "xcrun: warning: failed to retrieve target triple information for %s.sdk.\n", current_sdk);
-
-	if ((deployment_target = getenv("IPHONEOS_DEPLOYMENT_TARGET")) != NULL)
-		sprintf(envp[5], "IPHONEOS_DEPLOYMENT_TARGET=%s", deployment_target);
-	else if ((deployment_target = getenv("MACOSX_DEPLOYMENT_TARGET")) != NULL)
-		sprintf(envp[5], "MACOSX_DEPLOYMENT_TARGET=%s", deployment_target);
-	else {
-		/* Use the deployment target info that is provided by the SDK. */
-		if ((deployment_target = strdup(get_sdk_info(get_sdk_path(current_sdk)).deployment_target)) != NULL) {
-			if (macosx_deployment_target_set == 1)
-				sprintf(envp[5], "MACOSX_DEPLOYMENT_TARGET=%s", deployment_target);
-			else if (ios_deployment_target_set == 1)
-				sprintf(envp[5], "IPHONEOS_DEPLOYMENT_TARGET=%s", deployment_target);
-		} else {
-			fprintf(stderr, "xcrun: error: failed to retrieve deployment target information for %s.sdk.\n", current_sdk);
-			return -1;
-		}
+	/* Heavy tools only run once there is room for them. */
+	if ((admission_mode = xcrun_tool_limits(ctx, name, &tool, &admission_limits)) == -1) {
+		print_error(ctx);
+		return -1;
 	}
 
+	if (getenv("TARGET_TRIPLE") == NULL && *tool.target_triple == '\0')
+		fprintf(stderr, "xcrun: warning: failed to retrieve target triple information for %s.\n", tool.sdk_path);
+
 	if (logging_mode == 1) {
-		logging_printf(stdout, "xcrun: info: invoking command:\n\t\"%s", cmd);
-		for (i = 1; i < argc; i++)
-			logging_printf(stdout, " %s", argv[i]);
+		logging_printf(stdout, "xcrun: info: invoking command:\n\t\"%s", tool.path);
+		for (i = 1; new_argv[i] != NULL; i++)
+			logging_printf(stdout, " %s", new_argv[i]);
 		logging_printf(stdout, "\"\n");
 	}
 
-	return execve(cmd, argv, envp);
-}
+	metrics_record(METRICS_RUN, name, &tool);
 
-/**
- * @func search_command -- Search a set of directories for a given command
- * @arg buf  - buffer to hold the absolute path to the command
- * @arg name - command name
- * @arg dirs - set of directories to search, seperated by colons
- * @return: 0 on a successful search, -1 on failure
- */
-static int search_command(char *buf, const char *name, char *dirs)
-{
-	char *cmd_search_path;
-	char cmd_absl_path[PATH_MAX] = { 0 };
+	/* Identical compiles and links already running elsewhere are waited for, not run again. */
+	if ((status = flight_run(name, &tool, envp, new_argv, logging_mode, run_tool)) != -1)
+		exit(status);
 
-	/* Search each path entry in dirs until we find our program. */
-	cmd_search_path = strtok(dirs, ":");
-	while (cmd_search_path != NULL) {
-		verbose_printf(stdout, "xcrun: info: checking directory \'%s\' for command \'%s\'...\n", cmd_search_path, name);
-
-		/* Construct our program's absolute path. */
-		sprintf(cmd_absl_path, "%s/%s", cmd_search_path, name);
-
-		/* Does it exist? Is it an executable? */
-		if (access(cmd_absl_path, (F_OK | X_OK)) == 0) {
-			verbose_printf(stdout, "xcrun: info: found command's absolute path: \'%s\'\n", cmd_absl_path);
-			strncpy(buf, cmd_absl_path, strlen(cmd_absl_path));
-			return 0;
-		}
-
-		/* If not, move onto the next entry.. */
-		memset(cmd_absl_path, 0, PATH_MAX);
-		cmd_search_path = strtok(NULL, ":");
-	}
+	if ((status = run_tool(name, &tool, envp, new_argv)) != -1)
+		exit(status);
 
 	return -1;
 }
 
 /**
- * @func request_command -- Request a program.
- * @arg name - name of program
- * @arg argv - arguments to be passed if program found
- * @return: -1 on failed search, 0 on successful search, no return on execute
+ * @func print_query_value -- Print the result of a query in the requested format.
+ * @arg out   - stream to print to
+ * @arg name  - variable name used by the sh and kv formats
+ * @arg value - raw value used by the sh and kv formats
+ * @arg plain - line printed in plain format
  */
-static int request_command(const char *name, int argc, char *argv[])
+static void print_query_value(FILE *out, const char *name, const char *value, const char *plain)
 {
-	char cmd[PATH_MAX] = { 0 };
-	char search_string[PATH_MAX * 256] = { 0 };
-	char *sdk_env, *toolch_name, *toolchain_env;
-
-	/*
-	 * If xcrun was called in a multicall state, we still want to specify current_sdk for SDKROOT and
-	 * current_toolchain for PATH.
-	 */
-	if (strlen(current_sdk) == 0) {
-		if ((sdk_env = getenv("SDKROOT")) != NULL) {
-			stripext(current_sdk, basename(sdk_env));
-		} else {
-			const char *sdk_info = get_default_info(XCRUN_DEFAULT_CFG).sdk;
-			strncpy(current_sdk, sdk_info, strlen(sdk_info));
-		}
-	}
-
-	if (strlen(current_toolchain) == 0) {
-		if ((toolchain_env = getenv("TOOLCHAINS")) != NULL) {
-			stripext(current_toolchain, basename(toolchain_env));
-		} else {
-			const char *toolch_info = get_default_info(XCRUN_DEFAULT_CFG).toolchain;
-			strncpy(current_toolchain, toolch_info, strlen(toolch_info));
-		}
-	}
-
-	/* No matter the circumstance, search the developer dir. */
-	sprintf(search_string, "%s/usr/bin:", developer_dir);
-
-	/* If we explicitly specified an sdk, search the sdk and it's associated toolchain. */
-	if (explicit_sdk_mode == 1) {
-		toolch_name = strdup(get_sdk_info(get_sdk_path(current_sdk)).toolchain);
-		sprintf((search_string + strlen(search_string)), "%s/usr/bin:%s/usr/bin", get_sdk_path(current_sdk), get_toolchain_path(toolch_name));
-		goto do_search;
-	}
+	const char *p;
 
-	/* If we explicitly specified a toolchain, only search the toolchain. */
-	if (explicit_toolchain_mode == 1) {
-		sprintf((search_string + strlen(search_string)), "%s/usr/bin", get_toolchain_path(current_toolchain));
-		goto do_search;
-	}
-
-	/* If we explicitly specified an SDK, append it to the search string. */
-	if (alternate_sdk_path != NULL) {
-		sprintf((search_string + strlen(search_string)), "%s/usr/bin:", alternate_sdk_path);
-		/* We also want to append an associated toolchain if this is really an SDK folder. */
-		if (test_sdk_authenticity(alternate_sdk_path) == 1) {
-			toolch_name = strdup(get_sdk_info(alternate_sdk_path).toolchain);
-			sprintf((search_string + strlen(search_string)), "%s/usr/bin", get_toolchain_path(toolch_name));
-			/* We now have a toolchain, so skip to search. */
-			goto do_search;
-		}
-	}
+	if (value == NULL)
+		value = "";
 
-	/* If we explicitly specified a toolchain, append it to the search string. */
-	if (alternate_toolchain_path != NULL)
-		sprintf((search_string + strlen(search_string)), "%s/usr/bin", alternate_toolchain_path);
-
-	/* By default, we search our developer dir, our default sdk, and our default toolchain only. */
-	if (explicit_sdk_mode == 0 && explicit_toolchain_mode == 0 && alternate_toolchain_path == NULL && alternate_sdk_path == NULL)
-		sprintf((search_string + strlen(search_string)), "%s/usr/bin:%s/usr/bin", get_sdk_path(current_sdk), get_toolchain_path(current_toolchain));
-
-	/* Search each path entry in search_string until we find our program. */
-do_search:
-	if (search_command(cmd, name, search_string) == 0) {
-		if (finding_mode == 1) {
-			if (access(cmd, (F_OK | X_OK)) == 0) {
-				fprintf(stdout, "%s\n", cmd);
-				return 0;
-			} else {
-				return -1;
-			}
-		} else {
-			if (call_command(cmd, argc, argv) != 0) {
-				fprintf(stderr, "xcrun: error: can't exec \'%s\' (%s)\n", cmd, strerror(errno));
-				return -1;
+	switch (query_format) {
+		case QUERY_FORMAT_SH:
+			fprintf(out, "export %s='", name);
+			for (p = value; *p != '\0'; p++) {
+				if (*p == '\'')
+					fputs("'\\''", out);
+				else
+					putc(*p, out);
 			}
-		}
+			fprintf(out, "'\n");
+			break;
+		case QUERY_FORMAT_KV:
+			fprintf(out, "%s=%s\n", name, value);
+			break;
+		case QUERY_FORMAT_PLAIN:
+		default:
+			fprintf(out, "%s\n", plain);
+			break;
 	}
-
-	/* We have searched everywhere, but we haven't found our program. State why. */
-	fprintf(stderr, "xcrun: error: can't stat \'%s\' (%s)\n", name, strerror(errno));
-
-	return -1;
 }
 
 /**
@@ -821,11 +378,24 @@ static int xcrun_main(int argc, char *argv[])
 	int ch;
 	int optindex = 0;
 	int argc_offset = 0;
-	char *sdk_env, *toolchain_env;
-	char *sdk, *toolchain, *tool_called;
-
-	static int help_f, verbose_f, log_f, find_f, run_f, nocache_f, killcache_f, version_f, sdk_f, toolchain_f, ssdkp_f, ssdkv_f, ssdkpp_f, ssdktt_f, ssdkpv_f;
-	help_f = verbose_f = log_f = find_f = run_f = nocache_f = killcache_f = version_f = sdk_f = toolchain_f = ssdkp_f = ssdkv_f = ssdkpp_f = ssdktt_f = ssdkpv_f = 0;
+	int status = 1;
+	char *tool_called = NULL;
+
+	bool query_f;
+	char plain[PATH_MAX * 2];
+	char *output = NULL;
+	size_t output_len = 0;
+	FILE *out;
+	const char *value;
+	xcrun_ctx *ctx, *find_ctx;
+	xcrun_tool tool;
+	FILE *batch_fp;
+	char *batch_file = NULL;
+	char *profile_log = NULL;
+	batch_options batch = { 0 };
+
+	static int help_f, verbose_f, log_f, find_f, run_f, nocache_f, killcache_f, version_f, sdk_f, toolchain_f, ssdkp_f, ssdkv_f, ssdkpp_f, ssdktt_f, ssdkpv_f, format_f, batch_f, null_f, jobs_f, archs_f, reindex_f, stats_f, profsum_f, findsdk_f;
+	help_f = verbose_f = log_f = find_f = run_f = nocache_f = killcache_f = version_f = sdk_f = toolchain_f = ssdkp_f = ssdkv_f = ssdkpp_f = ssdktt_f = ssdkpv_f = format_f = batch_f = null_f = jobs_f = archs_f = reindex_f = stats_f = profsum_f = findsdk_f = 0;
 
 	/* Supported options */
 	static struct option options[] = {
@@ -844,6 +414,15 @@ static int xcrun_main(int argc, char *argv[])
 		{ "show-sdk-target-triple", no_argument, &ssdktt_f, 1},
 		{ "show-sdk-toolchain-path", no_argument, &ssdkpp_f, 1 },
 		{ "show-sdk-toolchain-version", no_argument, &ssdkpv_f, 1 },
+		{ "format", required_argument, &format_f, 1 },
+		{ "batch", required_argument, &batch_f, 1 },
+		{ "null", no_argument, &null_f, 1 },
+		{ "jobs", required_argument, &jobs_f, 1 },
+		{ "archs", required_argument, &archs_f, 1 },
+		{ "reindex", no_argument, &reindex_f, 1 },
+		{ "stats", no_argument, &stats_f, 1 },
+		{ "profile-summary", required_argument, &profsum_f, 1 },
+		{ "find-sdk", required_argument, &findsdk_f, 1 },
 		{ NULL, 0, 0, 0 }
 	};
 
@@ -889,17 +468,8 @@ static int xcrun_main(int argc, char *argv[])
 						case 3: /* --sdk */
 							if (*optarg != '-') {
 								++argc_offset;
-								sdk = optarg;
-								/* we support absolute paths and short names */
-								if (*sdk == '/') {
-									if (validate_directory_path(sdk) != (-1))
-										alternate_sdk_path = sdk;
-									else
-										return 1;
-								} else {
-									explicit_sdk_mode = 1;
-									stripext(current_sdk, sdk);
-								}
+								/* we support absolute paths and short names (see xcrun_create) */
+								requested_sdk = optarg;
 							} else {
 								fprintf(stderr, "xcrun: error: sdk flag requires an argument.\n");
 								return 1;
@@ -908,17 +478,8 @@ static int xcrun_main(int argc, char *argv[])
 						case 4: /* --toolchain */
 							if (*optarg != '-') {
 								++argc_offset;
-								toolchain = optarg;
-								/* we support absolute paths and short names */
-								if (*toolchain == '/') {
-									if (validate_directory_path(toolchain) != (-1))
-										alternate_toolchain_path = toolchain;
-									else
-										return 1;
-								} else {
-									explicit_toolchain_mode = 1;
-									stripext(current_toolchain, toolchain);
-								}
+								/* we support absolute paths and short names (see xcrun_create) */
+								requested_toolchain = optarg;
 							} else {
 								fprintf(stderr, "xcrun: error: toolchain flag requires an argument.\n");
 								return 1;
@@ -934,6 +495,56 @@ static int xcrun_main(int argc, char *argv[])
 							break;
 						case 14: /* --show-sdk-toolchain-version */
 							break;
+						case 15: /* --format */
+							++argc_offset;
+							if (strcmp(optarg, "plain") == 0)
+								query_format = QUERY_FORMAT_PLAIN;
+							else if (strcmp(optarg, "sh") == 0)
+								query_format = QUERY_FORMAT_SH;
+							else if (strcmp(optarg, "kv") == 0)
+								query_format = QUERY_FORMAT_KV;
+							else if (strcmp(optarg, "prometheus") == 0)
+								query_format = QUERY_FORMAT_PROMETHEUS;
+							else {
+								fprintf(stderr, "xcrun: error: unknown output format \'%s\'.\n", optarg);
+								return 1;
+							}
+							break;
+						case 16: /* --batch */
+							++argc_offset;
+							batch_file = optarg;
+							break;
+						case 17: /* --null */
+							break;
+						case 18: /* --jobs */
+							++argc_offset;
+							if ((batch.max_jobs = atoi(optarg)) <= 0) {
+								fprintf(stderr, "xcrun: error: invalid job count \'%s\'.\n", optarg);
+								return 1;
+							}
+							break;
+						case 19: /* --archs */
+							++argc_offset;
+							requested_archs = optarg;
+							break;
+						case 20: /* --reindex */
+							break;
+						case 21: /* --stats */
+							break;
+						case 22: /* --profile-summary */
+							++argc_offset;
+							profile_log = optarg;
+							break;
+						case 23: /* --find-sdk */
+							if (*optarg != '-') {
+								++argc_offset;
+								/* we support absolute paths and short names (see xcrun_create) */
+								requested_find_sdk = optarg;
+							} else {
+								fprintf(stderr, "xcrun: error: find-sdk flag requires an argument.\n");
+								return 1;
+							}
+							break;
 					}
 					break;
 				case '?':
@@ -954,13 +565,13 @@ static int xcrun_main(int argc, char *argv[])
 	}
 
 	/* The last non-option argument may be the command called. */
-	if (optind < argc && ((!run_f || !find_f) && tool_called == NULL)) {
+	if (optind < argc && ((!run_f || !find_f) && tool_called == NULL) && !batch_f) {
 		tool_called = basename(argv[optind++]);
 		++argc_offset;
 	}
 
 	/* Don't continue if we are missing arguments. */
-	if ((verbose_f || log_f) && tool_called == NULL) {
+	if ((verbose_f || log_f) && tool_called == NULL && !batch_f && !reindex_f) {
 		fprintf(stderr, "xcrun: error: specified arguments require -r or -f arguments.\n");
 		return 1;
 	}
@@ -973,71 +584,171 @@ static int xcrun_main(int argc, char *argv[])
 	if (version_f)
 		return version();
 
-	/* If our SDK and/or Toolchain hasn't been specified, fall back to environment or defaults. */
-	if (strlen(current_sdk) == 0) {
-		if ((sdk_env = getenv("SDKROOT")) != NULL) {
-			stripext(current_sdk, basename(sdk_env));
-		} else {
-			const char *sdk_info = get_default_info(XCRUN_DEFAULT_CFG).sdk;
-			strncpy(current_sdk, sdk_info, strlen(sdk_info));
-		}
-	}
-
-	if (strlen(current_toolchain) == 0) {
-		if ((toolchain_env = getenv("TOOLCHAINS")) != NULL) {
-			stripext(current_toolchain, basename(toolchain_env));
-		} else {
-			const char *toolch_info = get_default_info(XCRUN_DEFAULT_CFG).toolchain;
-			strncpy(current_toolchain, toolch_info, strlen(toolch_info));
-		}
-	}
-
-	/* Show SDK path? */
-	if (ssdkp_f) {
-		printf("%s\n", get_sdk_path(current_sdk));
-		return 0;
-	}
-
-	/* Show SDK version? */
-	if (ssdkv_f) {
-		printf("%s SDK version %s\n", get_sdk_info(get_sdk_path(current_sdk)).name, get_sdk_info(get_sdk_path(current_sdk)).version);
-		return 0;
-	}
+	/* Summarize the metrics? Nothing needs to be resolved for it. */
+	if (stats_f)
+		return (metrics_report(stdout, (query_format == QUERY_FORMAT_PROMETHEUS)) != 0);
 
-	/* Show SDK toolchain path? */
-	if (ssdkpp_f) {
-		printf("%s\n", get_toolchain_path(current_toolchain));
-		return 0;
-	}
+	/* Rank what the profiled tools cost? */
+	if (profsum_f)
+		return (profile_report(profile_log, stdout) != 0);
 
-	/* Show SDK toolchain version? */
-	if (ssdkpv_f) {
-		printf("%s SDK Toolchain version %s (%s)\n", get_sdk_info(get_sdk_path(current_sdk)).name, get_toolchain_info(get_toolchain_path(current_toolchain)).version, get_toolchain_info(get_toolchain_path(current_toolchain)).name);
-		return 0;
-	}
-
-	/* Show SDK target triple ? */
-	if (ssdktt_f) {
-		printf("%s\n", get_target_triple(current_sdk));
-		return 0;
+	if (query_format == QUERY_FORMAT_PROMETHEUS) {
+		fprintf(stderr, "xcrun: error: the prometheus format is only available with --stats.\n");
+		return 1;
 	}
 
 	/* Clear the lookup cache? */
-	if (killcache_f)
-		fprintf(stderr, "xcrun: warning: --kill-cache not supported.\n");
+	if (killcache_f) {
+		if (xcrun_kill_cache() != 0) {
+			fprintf(stderr, "xcrun: error: failed to invalidate the lookup cache. (%s)\n", strerror(errno));
+			return 1;
+		}
+		/* Invalidating the cache is a valid request on its own. */
+		if (tool_called == NULL && !(ssdkp_f || ssdkv_f || ssdkpp_f || ssdkpv_f || ssdktt_f))
+			return 0;
+	}
 
 	/* Don't use the lookup cache? */
 	if (nocache_f)
-		fprintf(stderr, "xcrun: warning: --no-cache not supported.\n");
+		nocache_mode = 1;
 
-	/* Turn on verbose mode? */
-	if (verbose_f)
+	/*
+	 * Answer any combination of --show-sdk-* queries (and --find, when a format or --find-sdk is
+	 * requested) from a single invocation, so that wrapper scripts only need to call us once.
+	 */
+	query_f = (ssdkp_f || ssdkv_f || ssdkpp_f || ssdkpv_f || ssdktt_f || (find_f && (query_format != QUERY_FORMAT_PLAIN || findsdk_f)));
+
+	/* Turn on verbose mode? (queries are always answered quietly) */
+	if (verbose_f && !query_f)
 		verbose_mode = 1;
 
 	/* Turn on logging mode? */
 	if (log_f)
 		logging_mode = 1;
 
+	if ((ctx = create_context(requested_sdk, verbose_mode, 0)) == NULL)
+		return 1;
+
+	/* Rebuild the manifest of the developer folder? */
+	if (reindex_f) {
+		if (xcrun_reindex(ctx) != 0)
+			return print_error(ctx);
+		/* Rebuilding the manifest is a valid request on its own. */
+		if (tool_called == NULL && !query_f && !batch_f) {
+			xcrun_free(ctx);
+			return 0;
+		}
+	}
+
+	if (query_f) {
+		/* The tool found may come from another SDK than the one the other values are about. */
+		if (find_f && findsdk_f) {
+			if ((find_ctx = create_context(requested_find_sdk, false, 0)) == NULL) {
+				xcrun_free(ctx);
+				return 1;
+			}
+		} else {
+			find_ctx = ctx;
+		}
+
+		/* Nothing is printed until every value asked for has resolved, a failed query only prints its error. */
+		if ((out = open_memstream(&output, &output_len)) == NULL) {
+			fprintf(stderr, "xcrun: error: failed to buffer query output. (%s)\n", strerror(errno));
+			goto query_done;
+		}
+
+		/* Show SDK path? */
+		if (ssdkp_f) {
+			if ((value = xcrun_sdk_path(ctx)) == NULL)
+				goto query_failure;
+			print_query_value(out, "SDKROOT", value, value);
+		}
+
+		/* Show SDK version? */
+		if (ssdkv_f) {
+			if ((value = xcrun_sdk_version(ctx)) == NULL && xcrun_error(ctx) != NULL)
+				goto query_failure;
+			snprintf(plain, sizeof(plain), "%s SDK version %s", or_empty(xcrun_sdk_name(ctx)), or_empty(value));
+			print_query_value(out, "SDK_VERSION", value, plain);
+		}
+
+		/* Show SDK target triple ? */
+		if (ssdktt_f) {
+			if ((value = xcrun_target_triple(ctx)) == NULL && xcrun_error(ctx) != NULL)
+				goto query_failure;
+			print_query_value(out, "TARGET_TRIPLE", value, or_empty(value));
+		}
+
+		/* Show SDK toolchain path? */
+		if (ssdkpp_f) {
+			if ((value = xcrun_toolchain_path(ctx)) == NULL)
+				goto query_failure;
+			print_query_value(out, "TOOLCHAIN_DIR", value, value);
+		}
+
+		/* Show SDK toolchain version? */
+		if (ssdkpv_f) {
+			if ((value = xcrun_toolchain_version(ctx)) == NULL && xcrun_error(ctx) != NULL)
+				goto query_failure;
+			snprintf(plain, sizeof(plain), "%s SDK Toolchain version %s (%s)", or_empty(xcrun_sdk_name(ctx)), or_empty(value), or_empty(xcrun_toolchain_name(ctx)));
+			print_query_value(out, "TOOLCHAIN_VERSION", value, plain);
+		}
+
+		/* Search for program? */
+		if (find_f && tool_called != NULL) {
+			if (xcrun_find_tool(find_ctx, tool_called, &tool) != 0) {
+				print_error(find_ctx);
+				metrics_record(METRICS_NOT_FOUND, tool_called, NULL);
+				goto query_done;
+			}
+			print_query_value(out, "TOOL", tool.path, tool.path);
+			metrics_record(METRICS_FIND, tool_called, &tool);
+		}
+
+		if (fclose(out) == 0) {
+			fwrite(output, 1, output_len, stdout);
+			status = 0;
+		} else {
+			fprintf(stderr, "xcrun: error: failed to buffer query output. (%s)\n", strerror(errno));
+		}
+		out = NULL;
+		goto query_done;
+
+query_failure:
+		print_error(ctx);
+query_done:
+		if (out != NULL)
+			fclose(out);
+		free(output);
+		if (find_ctx != ctx)
+			xcrun_free(find_ctx);
+		xcrun_free(ctx);
+
+		return status;
+	}
+
+	/* Run a whole batch of tools, resolved against this one context? */
+	if (batch_f) {
+		if (strcmp(batch_file, "-") == 0) {
+			batch_fp = stdin;
+		} else if ((batch_fp = fopen(batch_file, "r")) == NULL) {
+			fprintf(stderr, "xcrun: error: unable to open batch \'%s\' (%s)\n", batch_file, strerror(errno));
+			return 1;
+		}
+
+		batch.null_separated = null_f;
+		batch.logging = logging_mode;
+		batch.verbose = (verbose_mode ? stdout : NULL);
+
+		ch = batch_run(ctx, batch_fp, &batch);
+
+		if (batch_fp != stdin)
+			fclose(batch_fp);
+		xcrun_free(ctx);
+
+		return (ch != 0);
+	}
+
 	/* Before we continue, double check if we have a tool to call. */
 	if (tool_called == NULL) {
 		fprintf(stderr, "xcrun: error: no tool specified.\n");
@@ -1047,7 +758,7 @@ static int xcrun_main(int argc, char *argv[])
 	/* Search for program? */
 	if (find_f) {
 		finding_mode = 1;
-		if (request_command(tool_called, 0, NULL) == 0) {
+		if (request_command(ctx, tool_called, 0, NULL) == 0) {
 			return 0;
 		} else {
 			fprintf(stderr, "xcrun: error: unable to locate command \'%s\' (%s)\n", tool_called, strerror(errno));
@@ -1056,7 +767,7 @@ static int xcrun_main(int argc, char *argv[])
 	}
 
 	/* Search and execute program. (default behavior) */
-	if (request_command(tool_called, (argc - argc_offset),  (argv += ((argc - argc_offset) - (argc - argc_offset) + (argc_offset)))) != 0) {
+	if (request_command(ctx, tool_called, (argc - argc_offset),  (argv += ((argc - argc_offset) - (argc - argc_offset) + (argc_offset)))) != 0) {
 		fprintf(stderr, "xcrun: error: failed to execute command \'%s\'. aborting.\n", tool_called);
 		return 1;
 	}
@@ -1064,6 +775,30 @@ static int xcrun_main(int argc, char *argv[])
 	return 1;
 }
 
+/**
+ * @func xcrund_main -- xcrund's main routine, serves resolutions for the active developer dir until killed
+ * @arg argc - number of arguments passed by user
+ * @arg argv - array of arguments passed by user
+ * @return: 1 on failure, otherwise no return
+ */
+static int xcrund_main(int argc, char *argv[])
+{
+	xcrun_ctx *ctx;
+
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "-v") != 0 && strcmp(argv[1], "--verbose") != 0)) {
+		fprintf(stderr, "Usage: %s [-v|--verbose]\n", progname);
+		return 1;
+	}
+
+	/* We are the daemon, not one of its clients. */
+	if ((ctx = create_context(requested_sdk, (argc == 2), XCRUN_NO_DAEMON)) == NULL)
+		return 1;
+
+	xcrun_daemon(ctx);
+
+	return print_error(ctx);
+}
+
 /**
  * @func get_multicall_state -- Return a number that is associated to a given multicall state.
  * @arg cmd        - command that binary is being called
@@ -1075,7 +810,7 @@ static int get_multicall_state(const char *cmd, const char *state[], int state_s
 {
 	int i;
 
-	for (i = 0; i < (state_size - 1); i++) {
+	for (i = 0; i < state_size; i++) {
 		if (strcmp(cmd, state[i]) == 0)
 			return (i + 1);
 	}
@@ -1086,16 +821,20 @@ static int get_multicall_state(const char *cmd, const char *state[], int state_s
 int main(int argc, char *argv[])
 {
 	int call_state;
+	const char *tool_name;
+	xcrun_ctx *ctx;
 
 	/* Strip out any path name that may have been passed into argv[0] */
 	progname = basename(argv[0]);
 
-	/* Get our developer dir */
-	if (!get_developer_path(developer_dir))
-		return 1;
-
 	/* Check if we are being treated as a multi-call binary. */
-	call_state = get_multicall_state(progname, multicall_tool_names, 4);
+	call_state = get_multicall_state(progname, multicall_tool_names, 5);
+
+	/* The daemon outlives any build, only invocations are traced and measured. */
+	if (call_state != 5) {
+		trace_start(progname);
+		metrics_start();
+	}
 
 	/* Execute based on the state that we were called in. */
 	switch (call_state) {
@@ -1111,12 +850,23 @@ int main(int argc, char *argv[])
 			return xcrun_main(argc, argv);
 			break;
 		case 4: /* xcrun_nocache */
+			nocache_mode = 1;
 			return xcrun_main(argc, argv);
 			break;
+		case 5: /* xcrund */
+			return xcrund_main(argc, argv);
+			break;
 		case -1:
 		default: /* called as tool name */
+			if ((ctx = create_context(requested_sdk, false, 0)) == NULL)
+				return 1;
+
+			/* Cross tools called through a target triple prefix run the plain tool, under its plain name. */
+			if ((tool_name = xcrun_strip_target_triple(ctx, progname)) != progname)
+				argv[0] = (char *)tool_name;
+
 			/* Locate and execute the command */
-			if (request_command(progname, argc, argv) != -1) {
+			if (request_command(ctx, tool_name, argc, argv) != -1) {
 				return 1; /* NOREACH */
 			} else {
 				fprintf(stderr, "xcrun: error: failed to execute command \'%s\'. aborting.\n", progname);